@@ -13,40 +13,209 @@
  */
 
 #include <cctype>
+#include <climits>
+#include <fstream>
 #include <iostream>
 #include <string>
+#include "arena.h"
+#include "batch.h"
+#include "bytecode.h"
+#include "checkpoint.h"
+#include "compiler.h"
 #include "console.h"
+#include "error.h"
 #include "exp.h"
+#include "frozen.h"
+#include "governor.h"
+#include "image.h"
+#include "interpreter.h"
+#include "lexer.h"
+#include "loader.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "profiler.h"
 #include "program.h"
-#include "tokenscanner.h"
+#include "server.h"
+#include "transpiler.h"
 #include "simpio.h"
 #include "strlib.h"
+#include "threadpool.h"
+#include "value.h"
 using namespace std;
 
 /* Constants */
 
-const int END_PROGRAM_LINE_NUMBER = -1;
+const int PROFILE_REPORT_LINES = 20;
 
 /* Function prototypes */
 
-void processLine(string line, Program & program, EvalState & state);
-void runCommand(string line, Program & program, EvalState & state);
-void listCommand(Program & program);
-void variableCommand(TokenScanner & scanner, EvalState & state, string stringInitialToken);
-void lineNumberCommand(string stringInitialToken, string line, TokenScanner & scanner, Program & program);
-void helpCommand();
+bool processLine(string line, Program & program, IncrementalCompiler & compiler, EvalState & state,
+                 ostream & out);
+void runCommand(Lexer & lexer, Program & program, IncrementalCompiler & compiler, EvalState & state,
+                ostream & out);
+void runProfile(Lexer & lexer, Program & program, EvalState & state, ostream & out);
+void reportProfile(Profiler & profiler, string csvFilename, EvalState & state, ostream & out);
+int runBatchFile(Program & program, string inputFilename, int threadCount,
+                 const ResourceLimits & limits);
+void listCommand(Lexer & lexer, Program & program, ostream & out);
+int readListBound(Lexer & lexer, int defaultBound);
+void variableCommand(Lexer & lexer, Program & program, EvalState & state, Keyword keyword);
+void statsCommand(Program & program, ostream & out);
+void compileCommand(Program & program, EvalState & state);
+void imageCommand(string command, Lexer & lexer, Program & program);
+void limitCommand(Lexer & lexer, EvalState & state, ostream & out);
+void setLimit(ResourceLimits & limits, string resource, Lexer & lexer);
+bool parseLimitFlag(string arg, ResourceLimits & limits);
+void checkpointCommand(Lexer & lexer, EvalState & state, ostream & out);
+void setCheckpoint(EvalState & state, string filename, long long interval);
+void resumeCommand(Lexer & lexer, IncrementalCompiler & compiler, EvalState & state);
+bool isInputFrom(Lexer & lexer);
+void inputFromCommand(Lexer & lexer, EvalState & state);
+void helpCommand(ostream & out);
 
-/* Main program */
+/*
+ * Main program
+ * ------------
+ * Run without arguments, the interpreter reads commands from the console.
+ * Given a file name, as in
+ *
+ *    basic prog.bas [--run] [--flush=line|block] [--limit-resource=n ...]
+ *                   [--checkpoint=file [--checkpoint-every=n]] [--resume=file]
+ *                   [--input=file]
+ *    basic prog.bas --batch=inputs.txt [--threads=n] [--limit-resource=n ...]
+ *    basic --serve=socket [--threads=n] [--limit-resource=n ...]
+ *
+ * it first loads that program with loadProgramFile, or installs it if
+ * the file is a program image written by SAVE IMAGE.  With --run it then
+ * runs the program and exits, returning a nonzero status on any error;
+ * an image is then run straight from the mapped file without building
+ * its statements.  Otherwise it continues at the console with the
+ * program in memory.
+ * With --batch it runs the program once for every line of the inputs
+ * file, as described for runBatchFile, and exits.
+ * With --serve it serves sessions on the named Unix-domain socket, as
+ * described for runServer in server.h, each with its own program, and
+ * runs their programs on --threads workers.
+ * PRINT output is line buffered at the console and block buffered with
+ * --run, unless --flush selects the policy.  Buffered output is always
+ * flushed before an error message, so the two appear in order.
+ * Each --limit flag sets one of the limits of the LIMIT command, as in
+ * --limit-statements=1000000 or --limit-time=2.5, for every run.
+ * --checkpoint saves every run to the named file as CHECKPOINT does,
+ * every DEFAULT_CHECKPOINT_INTERVAL statements unless --checkpoint-every
+ * says otherwise.  --resume restores the named checkpoint, continues
+ * the program from it as RESUME does and exits as --run would, so that
+ *
+ *    basic job.bas --checkpoint=job.ckp --resume=job.ckp
+ *
+ * picks up a job that was interrupted and goes on saving it.
+ * --input reads the values for INPUT from the named file, or from
+ * standard input if the name is -, without prompting, as INPUT FROM
+ * does.
+ */
 
-int main() {
+int main(int argc, char *argv[]) {
    EvalState state;
    Program program;
+   IncrementalCompiler compiler(program);
+   string filename;
+   bool runAndExit = false;
+   string flush = "";
+   string batchFilename = "";
+   int threadCount = 0;
+   ResourceLimits limits = state.getGovernor().getLimits();
+   bool badLimit = false;
+   string checkpointFilename = "";
+   long long checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL;
+   string resumeFilename = "";
+   string inputFilename = "";
+   string socketPath = "";
+   for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      if (arg == "--run") runAndExit = true;
+      else if (startsWith(arg, "--limit-")) badLimit |= !parseLimitFlag(arg, limits);
+      else if (startsWith(arg, "--flush=")) flush = arg.substr(8);
+      else if (startsWith(arg, "--batch=")) batchFilename = arg.substr(8);
+      else if (startsWith(arg, "--checkpoint=")) checkpointFilename = arg.substr(13);
+      else if (startsWith(arg, "--checkpoint-every=") && stringIsInteger(arg.substr(19))
+               && stringToInteger(arg.substr(19)) > 0) {
+         checkpointInterval = stringToInteger(arg.substr(19));
+      }
+      else if (startsWith(arg, "--resume=")) resumeFilename = arg.substr(9);
+      else if (startsWith(arg, "--input=")) inputFilename = arg.substr(8);
+      else if (startsWith(arg, "--serve=")) socketPath = arg.substr(8);
+      else if (startsWith(arg, "--threads=") && stringIsInteger(arg.substr(10))) {
+         threadCount = stringToInteger(arg.substr(10));
+      }
+      else filename = arg;
+   }
+   if (resumeFilename != "") runAndExit = true;
+   if (((runAndExit || batchFilename != "") && filename == "") || badLimit
+       || (socketPath != "" && (filename != "" || runAndExit))
+       || (flush != "" && flush != "line" && flush != "block")) {
+      cerr << "Usage: basic [file [--run]] [--flush=line|block] [--input=file] [limits] [checkpoints]" << endl;
+      cerr << "       basic file --batch=inputs [--threads=n] [limits]" << endl;
+      cerr << "       basic --serve=socket [--threads=n] [limits]" << endl;
+      cerr << "Limits: --limit-statements=n --limit-time=seconds" << endl;
+      cerr << "        --limit-variables=n --limit-memory=bytes" << endl;
+      cerr << "Checkpoints: --checkpoint=file [--checkpoint-every=n] [--resume=file]" << endl;
+      return 2;
+   }
+   state.getGovernor().setLimits(limits);
+   if (checkpointFilename != "") setCheckpoint(state, checkpointFilename, checkpointInterval);
+   if (flush == "") flush = runAndExit ? "block" : "line";
+   state.getOutput().setFlushPolicy((flush == "block") ? BLOCK_BUFFERED : LINE_BUFFERED);
+   if (socketPath != "") {
+      try {
+         runServer(socketPath, processLine, threadCount, limits);
+      } catch (ErrorException & ex) {
+         cerr << "Error: " << ex.getMessage() << endl;
+         return 1;
+      }
+      return 0;
+   }
+   if (filename != "") {
+      try {
+         if (inputFilename != "") state.getInput().setFile(inputFilename);
+         if (isProgramImage(filename)) {
+            ProgramImage image(filename);
+            if (runAndExit && batchFilename == "" && checkpointFilename == ""
+                && resumeFilename == "") {
+               image.run(state);
+               state.getOutput().flush();
+               return 0;
+            }
+            image.install(program);
+         } else {
+            loadProgramFile(filename, program);
+         }
+         if (batchFilename != "") {
+            return runBatchFile(program, batchFilename, threadCount, limits);
+         }
+         if (resumeFilename != "") {
+            int lineNumber = restoreCheckpoint(resumeFilename, program, state);
+            resumeProgram(compiler, state, lineNumber);
+            state.getOutput().flush();
+            return 0;
+         }
+         if (runAndExit) {
+            runProgram(program, state);
+            state.getOutput().flush();
+            return 0;
+         }
+      } catch (ErrorException & ex) {
+         state.getOutput().flush();
+         cerr << "Error: " << ex.getMessage() << endl;
+         return 1;
+      }
+   }
    cout << "Minimal BASIC -- Type HELP for help" << endl;
    while (true) {
       try {
-         processLine(getLine(), program, state);
+         if (!processLine(getLine(), program, compiler, state, cout)) break;
+         state.getOutput().flush();
       } catch (ErrorException & ex) {
+         state.getOutput().flush();
          cerr << "Error: " << ex.getMessage() << endl;
       }
    }
@@ -55,8 +224,8 @@ int main() {
 
 /*
  * Function: processLine
- * Usage: processLine(line, program, state);
- * -----------------------------------------
+ * Usage: if (!processLine(line, program, compiler, state, out)) . . .
+ * -------------------------------------------------------------------
  * Processes a single line entered by the user.  In this version,
  * the implementation does exactly what the interpreter program
  * does in Chapter 19: read a line, parse it as an expression,
@@ -64,74 +233,331 @@ int main() {
  * need to replace this method with one that can respond correctly
  * when the user enters a program line (which begins with a number)
  * or one of the BASIC commands, such as LIST or RUN.
+ * What the commands themselves print, such as the lines of LIST, goes
+ * to out; PRINT output goes to the state's OutputBuffer.  The result
+ * is false if the line is QUIT, which ends the session.
  */
 
-void processLine(string line, Program & program, EvalState & state) {
-   TokenScanner scanner;
-   scanner.ignoreWhitespace();
-   scanner.scanNumbers();
-   scanner.setInput(line);
-   string stringInitialToken = scanner.nextToken();
-   if (toUpperCase(line) == "RUN") runCommand(toUpperCase(line), program, state);
-   else if (toUpperCase(line) == "HELP") helpCommand();
-   else if (toUpperCase(line) == "QUIT") exit(0);
-   else if (toUpperCase(line) == "LIST") listCommand(program);
-   else if (toUpperCase(line) == "CLEAR") program.clear();
-   else if (toUpperCase(stringInitialToken) == "LET" || toUpperCase(stringInitialToken) == "PRINT" || toUpperCase(stringInitialToken) == "INPUT") variableCommand(scanner, state, toUpperCase(stringInitialToken));
-   else if (line.length() > stringInitialToken.length() && stringIsInteger(stringInitialToken)) lineNumberCommand(toUpperCase(stringInitialToken), line, scanner, program);
-   else if (!scanner.hasMoreTokens()) { //Remove that line number from program
-       int intLineNumber = stringToInteger(stringInitialToken);
-       program.removeSourceLine(intLineNumber);
+bool processLine(string line, Program & program, IncrementalCompiler & compiler, EvalState & state,
+                 ostream & out) {
+   Lexer lexer(line);
+   Token initialToken = lexer.nextToken();
+   Keyword keyword = initialToken.keyword;
+   bool alone = !lexer.hasMoreTokens();
+   if (keyword == RUN_KEYWORD) runCommand(lexer, program, compiler, state, out);
+   else if (keyword == HELP_KEYWORD && alone) helpCommand(out);
+   else if (keyword == QUIT_KEYWORD && alone) return false;
+   else if (keyword == LIST_KEYWORD) listCommand(lexer, program, out);
+   else if (keyword == CLEAR_KEYWORD && alone) program.clear();
+   else if (keyword == STATS_KEYWORD && alone) statsCommand(program, out);
+   else if (keyword == COMPILE_KEYWORD && alone) compileCommand(program, state);
+   else if (keyword == SAVE_KEYWORD || keyword == LOAD_KEYWORD) imageCommand(toUpperCase(string(initialToken.text)), lexer, program);
+   else if (initialToken.kind == WORD_TOKEN && toUpperCase(string(initialToken.text)) == "LIMIT") limitCommand(lexer, state, out);
+   else if (initialToken.kind == WORD_TOKEN && toUpperCase(string(initialToken.text)) == "CHECKPOINT") checkpointCommand(lexer, state, out);
+   else if (initialToken.kind == WORD_TOKEN && toUpperCase(string(initialToken.text)) == "RESUME") resumeCommand(lexer, compiler, state);
+   else if (keyword == INPUT_KEYWORD && isInputFrom(lexer)) inputFromCommand(lexer, state);
+   else if (keyword == LET_KEYWORD || keyword == PRINT_KEYWORD || keyword == INPUT_KEYWORD
+            || keyword == DIM_KEYWORD || keyword == MAT_KEYWORD) variableCommand(lexer, program, state, keyword);
+   else if (initialToken.kind == NUMBER_TOKEN && !alone) addProgramLine(program, line);
+   else if (initialToken.kind == NUMBER_TOKEN) { //Remove that line number from program
+       program.removeSourceLine(getLineNumber(initialToken));
    }
-   else cout << "Not a valid statement" << endl;
+   else if (initialToken.kind != END_TOKEN) out << "Not a valid statement" << endl;
+   return true;
 }
 
-//Runs all commands in the program when user requests
-void runCommand(string line, Program & program, EvalState & state) {
-    int currentLineNumber = program.getFirstLineNumber();
-    state.setCurrentLine(currentLineNumber); //Sets the current line number to the first one
-    while (currentLineNumber != END_PROGRAM_LINE_NUMBER) {
-        program.getParsedStatement(currentLineNumber)->execute(state);
-        if (currentLineNumber != state.getCurrentLine()) {
-            currentLineNumber = state.getCurrentLine();
-        }
-        else {
-            currentLineNumber = program.getNextLineNumber(currentLineNumber);
-            state.setCurrentLine(currentLineNumber);
+//Runs all commands in the program when user requests. Plain RUN brings the
+//bytecode up to date, compiling only the lines edited since the last RUN, and
+//executes it on the virtual machine; RUN AST walks the parsed statements
+//instead, so the two engines can be checked against each other. RUN JIT
+//compiles the whole program afresh, so that every loop is contiguous, runs it
+//on the virtual machine and compiles hot loops to native code.
+//RUN PROFILE walks the statements while timing each line.
+void runCommand(Lexer & lexer, Program & program, IncrementalCompiler & compiler, EvalState & state,
+                ostream & out) {
+    Token mode = lexer.nextToken();
+    if (mode.kind == END_TOKEN) runProgram(compiler, state);
+    else if (mode.keyword == AST_KEYWORD) runStatements(program, state);
+    else if (mode.keyword == JIT_KEYWORD) runProgramJIT(program, state);
+    else if (mode.keyword == PROFILE_KEYWORD) runProfile(lexer, program, state, out);
+    else error("Unknown RUN mode: " + toUpperCase(string(mode.text)));
+}
+
+//Runs the statements under a Profiler and then prints the lines that took the most
+//cycles. The rest of the line after PROFILE names a file that also receives the data
+//for every line as CSV, as in RUN PROFILE prof.csv. The report is produced even if
+//the program stops with an error.
+void runProfile(Lexer & lexer, Program & program, EvalState & state, ostream & out) {
+    string csvFilename(lexer.getRest());
+    Profiler profiler;
+    try {
+        walkStatements(program, state, profiler);
+    } catch (ErrorException &) {
+        reportProfile(profiler, csvFilename, state, out);
+        throw;
+    }
+    reportProfile(profiler, csvFilename, state, out);
+}
+
+//Prints the ranked profile after the program's own output and writes the CSV file.
+void reportProfile(Profiler & profiler, string csvFilename, EvalState & state, ostream & out) {
+    state.getOutput().flush();
+    profiler.printReport(out, PROFILE_REPORT_LINES);
+    if (csvFilename != "") {
+        ofstream csvFile(csvFilename.c_str());
+        if (csvFile.fail()) error("Cannot open " + csvFilename);
+        profiler.writeCSV(csvFile);
+    }
+}
+
+//Runs the program once for each line of the inputs file, which holds the values
+//read by INPUT for that run, on a pool of threadCount threads (0 means one per
+//core). The program is frozen once and shared. The output of each run is printed
+//in the order of the input lines, followed by its error message if it failed, and
+//the result is the exit status: 1 if any run failed, 0 otherwise. Each run is held
+//to the limits on its own.
+int runBatchFile(Program & program, string inputFilename, int threadCount,
+                 const ResourceLimits & limits) {
+    ifstream inputFile(inputFilename.c_str());
+    if (inputFile.fail()) error("Cannot open " + inputFilename);
+    vector<string> inputSets;
+    string line;
+    while (getline(inputFile, line)) {
+        inputSets.push_back(line);
+    }
+    FrozenProgram frozen(program);
+    vector<BatchResult> results;
+    ThreadPool pool(threadCount);
+    runBatch(frozen, inputSets, limits, results, pool);
+    int status = 0;
+    for (int i = 0; i < (int) results.size(); i++) {
+        cout << results[i].output;
+        if (results[i].failed) {
+            cout.flush();
+            cerr << "Error: " << inputFilename << ":" << (i + 1) << ": "
+                 << results[i].errorMessage << endl;
+            status = 1;
         }
     }
+    cout.flush();
+    return status;
 }
 
-//Outputs all the inputted lines by the user that are stored.
-void listCommand(Program & program) {
-    int currentLineNumber = program.getFirstLineNumber();
-    while (currentLineNumber != END_PROGRAM_LINE_NUMBER) {
-        cout << program.getSourceLine(currentLineNumber) << endl;
+//Outputs the inputted lines by the user that are stored. LIST shows every line,
+//LIST n shows one line and LIST a-b, LIST a- and LIST -b show the lines in that
+//range. The first line is found with one ordered lookup and each following line
+//with another, so listing a range does not touch the lines outside it.
+void listCommand(Lexer & lexer, Program & program, ostream & out) {
+    int first = INT_MIN;
+    int last = INT_MAX;
+    if (lexer.hasMoreTokens()) {
+        first = readListBound(lexer, INT_MIN);
+        if (!lexer.hasMoreTokens()) last = first;
+        else if (lexer.nextToken().op == '-') last = readListBound(lexer, INT_MAX);
+        else error("Illegal LIST range");
+        if (lexer.hasMoreTokens()) error("Illegal LIST range");
+    }
+    int currentLineNumber = program.getLineNumberAtOrAfter(first);
+    while (currentLineNumber != END_PROGRAM_LINE_NUMBER && currentLineNumber <= last) {
+        out << program.getSourceLine(currentLineNumber) << endl;
         currentLineNumber = program.getNextLineNumber(currentLineNumber);
     }
 }
 
-//Parses the statement and then executes the statement
-void variableCommand(TokenScanner & scanner, EvalState & state, string stringInitialToken) {
-    scanner.saveToken(stringInitialToken);
-    Statement *stmt = parseStatement(scanner);
+//Reads one end of a LIST range, returning defaultBound if the next token is not a number.
+int readListBound(Lexer & lexer, int defaultBound) {
+    if (lexer.peekToken().kind == NUMBER_TOKEN) return getLineNumber(lexer.nextToken());
+    return defaultBound;
+}
+
+//Parses the statement and then executes the statement. The statement is not kept,
+//so it lives in a local arena that is freed on return. The keyword has already
+//been read, and at the console it may be typed in any case.
+void variableCommand(Lexer & lexer, Program & program, EvalState & state, Keyword keyword) {
+    Arena arena;
+    Statement *stmt = parseStatement(keyword, lexer, program.getSymbolTable(), arena);
+    optimizeStatement(stmt, arena);
     stmt->execute(state);
-    delete stmt;
 }
 
-//When line starts with a line number, store the line and set the parsed statement
-void lineNumberCommand(string stringInitialToken, string line, TokenScanner & scanner, Program & program) {
-    int intLineNumber = stringToInteger(stringInitialToken);
-    program.addSourceLine(intLineNumber, line);
-    Statement *stmt = parseStatement(scanner);
-    program.setParsedStatement(intLineNumber, stmt);
+//Reports what the optimizer has done for the current program and, after compiling
+//it to bytecode, how many of each idiom the compiler fused into a superinstruction.
+void statsCommand(Program & program, ostream & out) {
+    out << "Lines: " << program.size() << endl;
+    out << "Expression nodes removed by optimizer: " << program.getRemovedNodes() << endl;
+    out << "Parse tree memory: " << program.getArena().getBytesUsed() << " bytes" << endl;
+    Bytecode bytecode;
+    compileProgram(program, bytecode);
+    out << "Fused idioms:" << endl;
+    for (int i = 0; i < IDIOM_COUNT; i++) {
+        out << "   " << idiomToString(Idiom(i)) << ": " << bytecode.fusedCounts[i] << endl;
+    }
+}
+
+//Translates the program to C++, builds it with the system compiler unless an
+//identical build is already cached, and runs the result in-process.
+void compileCommand(Program & program, EvalState & state) {
+    program.keepDoubles(state);
+    NativeProgram native(program);
+    native.run(state);
+}
+
+//Handles SAVE IMAGE file, which writes the program to a binary image, and
+//LOAD IMAGE file, which replaces the program with the one in an image. The
+//file name is the rest of the line after IMAGE, as for RUN PROFILE.
+void imageCommand(string command, Lexer & lexer, Program & program) {
+    if (lexer.nextToken().keyword != IMAGE_KEYWORD) error("Expected IMAGE after " + command);
+    string filename(lexer.getRest());
+    if (filename == "") error(command + " IMAGE needs a file name");
+    if (command == "SAVE") {
+        saveProgramImage(program, filename);
+    } else {
+        ProgramImage image(filename);
+        image.install(program);
+    }
+}
+
+//Shows the limits every run is held to, or changes one of them. LIMIT STATEMENTS n,
+//LIMIT TIME seconds, LIMIT VARIABLES n and LIMIT MEMORY bytes set a limit, 0 removes
+//it and LIMIT OFF removes them all. LIMIT is not a keyword, so that programs may
+//still use it as a variable name.
+void limitCommand(Lexer & lexer, EvalState & state, ostream & out) {
+    Governor & governor = state.getGovernor();
+    ResourceLimits limits = governor.getLimits();
+    if (!lexer.hasMoreTokens()) {
+        out << "Statements: " << ((limits.maxStatements == 0) ? "none" : to_string(limits.maxStatements)) << endl;
+        out << "Time: " << ((limits.maxSeconds == 0) ? "none" : doubleToString(limits.maxSeconds) + " seconds") << endl;
+        out << "Variables: " << ((limits.maxVariables == 0) ? "none" : to_string(limits.maxVariables)) << endl;
+        out << "Memory: " << ((limits.maxMemory == 0) ? "none" : to_string(limits.maxMemory) + " bytes") << endl;
+        return;
+    }
+    string resource = toUpperCase(string(lexer.nextToken().text));
+    if (resource == "OFF" && !lexer.hasMoreTokens()) limits = ResourceLimits();
+    else setLimit(limits, resource, lexer);
+    governor.setLimits(limits);
+}
+
+//Sets the limit on one resource from the rest of the lexer's line, which must be a
+//single whole number, or a real for TIME.
+void setLimit(ResourceLimits & limits, string resource, Lexer & lexer) {
+    if (resource != "STATEMENTS" && resource != "TIME" && resource != "VARIABLES"
+        && resource != "MEMORY") {
+        error("Unknown limit: " + resource);
+    }
+    Token amount = lexer.nextToken();
+    bool isReal = amount.kind == REAL_TOKEN && resource == "TIME";
+    if ((amount.kind != NUMBER_TOKEN && !isReal) || lexer.hasMoreTokens()) {
+        error("Illegal amount for LIMIT " + resource);
+    }
+    if (resource == "STATEMENTS") limits.maxStatements = amount.value;
+    else if (resource == "TIME") limits.maxSeconds = isReal ? amount.real : amount.value;
+    else if (resource == "VARIABLES") limits.maxVariables = amount.value;
+    else limits.maxMemory = amount.value;
+}
+
+//Applies a command-line flag such as --limit-time=2.5, returning false if it is
+//not one.
+bool parseLimitFlag(string arg, ResourceLimits & limits) {
+    size_t equals = arg.find('=');
+    if (equals == string::npos) return false;
+    string amount = arg.substr(equals + 1);
+    Lexer lexer(amount);
+    try {
+        setLimit(limits, toUpperCase(arg.substr(8, equals - 8)), lexer);
+    } catch (ErrorException &) {
+        return false;
+    }
+    return true;
+}
+
+//Shows where and how often runs are checkpointed, or changes it. CHECKPOINT n file
+//saves the state of every later run to file each time it has executed another n
+//statements, and CHECKPOINT OFF stops saving. Like LIMIT, CHECKPOINT is not a
+//keyword.
+void checkpointCommand(Lexer & lexer, EvalState & state, ostream & out) {
+    Checkpointer & checkpointer = state.getCheckpointer();
+    if (!lexer.hasMoreTokens()) {
+        if (checkpointer.getFilename() == "") {
+            out << "Checkpoints: none" << endl;
+        } else {
+            out << "Checkpoints: every " << state.getGovernor().getCheckpointInterval()
+                 << " statements to " << checkpointer.getFilename() << endl;
+        }
+        return;
+    }
+    Token interval = lexer.nextToken();
+    if (toUpperCase(string(interval.text)) == "OFF" && !lexer.hasMoreTokens()) {
+        setCheckpoint(state, "", 0);
+        return;
+    }
+    string filename(lexer.getRest());
+    if (interval.kind != NUMBER_TOKEN || interval.value <= 0 || filename == "") {
+        error("CHECKPOINT needs a number of statements and a file name");
+    }
+    setCheckpoint(state, filename, interval.value);
+}
+
+//Sends checkpoints to a new file, or none, once the last one has been written.
+void setCheckpoint(EvalState & state, string filename, long long interval) {
+    state.getCheckpointer().wait();
+    state.getCheckpointer().setFilename(filename);
+    state.getGovernor().setCheckpointInterval(interval);
+}
+
+//Restores the variables and pending output saved in a checkpoint of the current
+//program and continues the program on the virtual machine from the line at which
+//the checkpoint was taken. The file name is the rest of the line, as for RUN PROFILE.
+void resumeCommand(Lexer & lexer, IncrementalCompiler & compiler, EvalState & state) {
+    string filename(lexer.getRest());
+    if (filename == "") error("RESUME needs a file name");
+    int lineNumber = restoreCheckpoint(filename, compiler.getProgram(), state);
+    resumeProgram(compiler, state, lineNumber);
+}
+
+//Returns true if the line after INPUT is FROM followed by a file name, which makes
+//it the INPUT FROM command rather than an INPUT of a variable called FROM.
+bool isInputFrom(Lexer & lexer) {
+    Token from = lexer.nextToken();
+    if (from.kind == WORD_TOKEN && toUpperCase(string(from.text)) == "FROM"
+        && lexer.hasMoreTokens()) {
+        return true;
+    }
+    lexer.saveToken(from);
+    return false;
+}
+
+//Sends later INPUT statements to the file named by the rest of the line, which they
+//read without prompting. The name - stands for standard input, and CONSOLE returns
+//them to prompting at the console.
+void inputFromCommand(Lexer & lexer, EvalState & state) {
+    string filename(lexer.getRest());
+    if (toUpperCase(filename) == "CONSOLE") state.getInput().setConsole();
+    else state.getInput().setFile(filename);
 }
 
-void helpCommand() {
-    cout << "Available commands:" << endl;
-    cout << "   RUN - Runs the program" << endl;
-    cout << "   LIST - Lists the program" << endl;
-    cout << "   CLEAR - Clears the program" << endl;
-    cout << "   HELP -- Prints this message" << endl;
-    cout << "   QUIT - Exits from the BASIC interpreter" << endl;
+void helpCommand(ostream & out) {
+    out << "Available commands:" << endl;
+    out << "   RUN - Runs the program" << endl;
+    out << "   RUN AST - Runs the program on the statement interpreter" << endl;
+    out << "   RUN JIT - Runs the program, compiling hot loops to native code" << endl;
+    out << "   RUN PROFILE [file] - Runs the program and reports the time spent on each line" << endl;
+    out << "   COMPILE - Compiles the program to native code through C++ and runs it" << endl;
+    out << "   SAVE IMAGE file - Saves the parsed and compiled program to a binary image" << endl;
+    out << "   LOAD IMAGE file - Replaces the program with the one saved in an image" << endl;
+    out << "   DIM A(n) or DIM A(r, c) - Creates an array with subscripts from 1" << endl;
+    out << "   MAT C = A op B, A op (k), (k) or A - Operates on whole arrays; op is +, - or *" << endl;
+    out << "   Numbers are 64-bit integers, or doubles if written as 1.5 or 2E10;" << endl;
+    out << "   a variable holds doubles if a line assigns it one or it holds one at RUN" << endl;
+    out << "   LIST - Lists the program" << endl;
+    out << "   LIST a-b - Lists the lines numbered a through b" << endl;
+    out << "   CLEAR - Clears the program" << endl;
+    out << "   STATS - Reports optimizer and compiler statistics for the program" << endl;
+    out << "   LIMIT - Shows the limits on each run" << endl;
+    out << "   LIMIT STATEMENTS|TIME|VARIABLES|MEMORY n - Sets a limit; 0 or LIMIT OFF removes it" << endl;
+    out << "   CHECKPOINT n file - Saves each run to file every n statements; CHECKPOINT OFF stops" << endl;
+    out << "   RESUME file - Restores a checkpoint and continues the program from it" << endl;
+    out << "   INPUT FROM file - Reads INPUT values from file without prompting; - is standard" << endl;
+    out << "   input and INPUT FROM CONSOLE prompts again" << endl;
+    out << "   HELP -- Prints this message" << endl;
+    out << "   QUIT - Exits from the BASIC interpreter" << endl;
 }
@@ -0,0 +1,145 @@
+/*
+ * File: arena.cpp
+ * ---------------
+ * This file implements the Arena class.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include "arena.h"
+using namespace std;
+
+/* Constants */
+
+const size_t ALIGNMENT = alignof(max_align_t);
+const size_t BLOCK_SIZE = 64 * 1024;
+const size_t LARGE_REQUEST = BLOCK_SIZE / 4;
+
+/*
+ * Function: roundUp
+ * Usage: size = roundUp(size);
+ * ----------------------------
+ * Rounds size up to a multiple of ALIGNMENT.
+ */
+
+static size_t roundUp(size_t size) {
+   return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+/*
+ * Type: Block
+ * -----------
+ * Each block begins with this header, and its memory follows the
+ * header at the next aligned address.  The blocks form a singly linked
+ * list, with the block being filled at the head.
+ */
+
+struct Arena::Block {
+   Block *link;
+   size_t size;
+};
+
+#define HEADER_SIZE roundUp(sizeof(Block))
+
+Arena::Arena() {
+   blocks = NULL;
+   next = NULL;
+   limit = NULL;
+   bytesUsed = 0;
+}
+
+Arena::~Arena() {
+   clear();
+}
+
+/*
+ * Implementation notes: allocate
+ * ------------------------------
+ * The fast path only advances next.  When the current block is full a
+ * new one becomes current, and the unused tail of the old one is
+ * abandoned.  Requests larger than a quarter of a block get a block
+ * of their own, which is linked in behind the current block so that
+ * the space left in the current block is not wasted.
+ */
+
+void *Arena::allocate(size_t size) {
+   size = roundUp(size);
+   if (size > (size_t) (limit - next)) {
+      if (size > LARGE_REQUEST && blocks != NULL) {
+         Block *block = newBlock(size);
+         block->link = blocks->link;
+         blocks->link = block;
+         bytesUsed += size;
+         return (char *) block + HEADER_SIZE;
+      }
+      Block *block = newBlock((size > BLOCK_SIZE) ? size : BLOCK_SIZE);
+      block->link = blocks;
+      blocks = block;
+      next = (char *) block + HEADER_SIZE;
+      limit = next + block->size;
+   }
+   void *result = next;
+   next += size;
+   bytesUsed += size;
+   return result;
+}
+
+const char *Arena::copyString(const string & str) {
+   char *copy = (char *) allocate(str.length() + 1);
+   memcpy(copy, str.c_str(), str.length() + 1);
+   return copy;
+}
+
+/*
+ * Implementation notes: adopt
+ * ---------------------------
+ * The other arena's blocks are spliced in behind the current block,
+ * which keeps filling.  If this arena is empty, it takes over the
+ * other arena's current block as well.
+ */
+
+void Arena::adopt(Arena & other) {
+   if (other.blocks == NULL) return;
+   if (blocks == NULL) {
+      blocks = other.blocks;
+      next = other.next;
+      limit = other.limit;
+   } else {
+      Block *tail = other.blocks;
+      while (tail->link != NULL) {
+         tail = tail->link;
+      }
+      tail->link = blocks->link;
+      blocks->link = other.blocks;
+   }
+   bytesUsed += other.bytesUsed;
+   other.blocks = NULL;
+   other.next = NULL;
+   other.limit = NULL;
+   other.bytesUsed = 0;
+}
+
+void Arena::clear() {
+   while (blocks != NULL) {
+      Block *link = blocks->link;
+      free(blocks);
+      blocks = link;
+   }
+   next = NULL;
+   limit = NULL;
+   bytesUsed = 0;
+}
+
+size_t Arena::getBytesUsed() {
+   return bytesUsed;
+}
+
+Arena::Block *Arena::newBlock(size_t size) {
+   Block *block = (Block *) malloc(HEADER_SIZE + size);
+   if (block == NULL) throw bad_alloc();
+   block->link = NULL;
+   block->size = size;
+   return block;
+}
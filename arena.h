@@ -0,0 +1,122 @@
+/*
+ * File: arena.h
+ * -------------
+ * This interface exports an Arena class, a bump allocator that holds
+ * the statements and expression trees parsed for a program.  Nodes
+ * allocated in an arena are never freed one at a time; all of them
+ * are released together when the arena is cleared or destroyed.
+ */
+
+#ifndef _arena_h
+#define _arena_h
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Class: Arena
+ * ------------
+ * This class hands out memory from large blocks by advancing a
+ * pointer, so that allocating a node costs a few instructions and the
+ * nodes parsed from one line lie next to each other in memory.  Only
+ * objects whose destructors have nothing to do may live in an arena,
+ * because clearing it does not run destructors.  An arena must be
+ * used by one thread at a time.
+ */
+
+class Arena {
+
+public:
+
+/*
+ * Constructor: Arena
+ * Usage: Arena arena;
+ * -------------------
+ * Creates an empty arena.  No memory is reserved until the first
+ * allocation.
+ */
+
+   Arena();
+
+/*
+ * Destructor: ~Arena
+ * Usage: usually implicit
+ * -----------------------
+ * Frees every block the arena owns.
+ */
+
+   ~Arena();
+
+/*
+ * Method: allocate
+ * Usage: void *ptr = arena.allocate(size);
+ * ----------------------------------------
+ * Returns size bytes of memory aligned for any fundamental type.
+ * The memory remains valid until the arena is cleared or destroyed.
+ */
+
+   void *allocate(size_t size);
+
+/*
+ * Method: copyString
+ * Usage: const char *str = arena.copyString(name);
+ * ------------------------------------------------
+ * Copies the string into the arena and returns the null-terminated
+ * copy, which lets nodes hold text without owning heap storage.
+ */
+
+   const char *copyString(const std::string & str);
+
+/*
+ * Method: adopt
+ * Usage: arena.adopt(other);
+ * --------------------------
+ * Transfers every block of the other arena to this one, leaving the
+ * other arena empty.  Nodes allocated in the other arena stay where
+ * they are and now live as long as this arena.  This operation takes
+ * time proportional to the number of blocks, not the number of nodes.
+ */
+
+   void adopt(Arena & other);
+
+/*
+ * Method: clear
+ * Usage: arena.clear();
+ * ---------------------
+ * Releases every node allocated in the arena at once.  Any pointer
+ * into the arena becomes invalid.
+ */
+
+   void clear();
+
+/*
+ * Method: getBytesUsed
+ * Usage: size_t bytes = arena.getBytesUsed();
+ * -------------------------------------------
+ * Returns the number of bytes handed out since the arena was created
+ * or last cleared, including those adopted from other arenas.
+ */
+
+   size_t getBytesUsed();
+
+private:
+
+/* The header at the start of each block, defined in arena.cpp */
+
+   struct Block;
+
+   Block *blocks;          /* The list of blocks, current block first */
+   char *next;             /* The next free byte in the current block */
+   char *limit;            /* The end of the current block            */
+   size_t bytesUsed;       /* The total returned by allocate          */
+
+   Block *newBlock(size_t size);
+
+/* Arenas cannot be copied, since two copies would free the same blocks */
+
+   Arena(const Arena & src) = delete;
+   Arena & operator=(const Arena & src) = delete;
+
+};
+
+#endif
@@ -0,0 +1,475 @@
+/*
+ * File: array.cpp
+ * ---------------
+ * This file implements the Array class and the kernels that carry out
+ * MAT operations.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include "array.h"
+#include "error.h"
+#include "strlib.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/* Private function prototypes */
+
+static string formatSubscripts(const string & key, int rank, long long row, long long column);
+static void requireDimensioned(Array & array, const char *key);
+static void reportDisagreement(const char *lhsKey, const char *rhsKey);
+static long long multiply(Array & target, Array & lhs, Array & rhs, const char *targetKey,
+                          const char *lhsKey, const char *rhsKey);
+
+/* Implementation of the Array class */
+
+Array::Array() {
+   rank = 0;
+   rows = 0;
+   columns = 0;
+}
+
+/*
+ * Implementation notes: dimension
+ * -------------------------------
+ * The extents are checked while they are still 64 bits wide, so that
+ * a huge extent cannot pass by wrapping around.  Once the total size
+ * is known to be at most MAX_ARRAY_SIZE, both extents fit in an int.
+ */
+
+void Array::dimension(const string & key, int rank, long long rows, long long columns) {
+   if (rows < 1 || columns < 1) {
+      error("Illegal dimension: " + formatSubscripts(key, rank, rows, columns));
+   }
+   if (rows > MAX_ARRAY_SIZE || columns > MAX_ARRAY_SIZE || rows * columns > MAX_ARRAY_SIZE) {
+      error("Array too large: " + formatSubscripts(key, rank, rows, columns));
+   }
+   if (rank == this->rank && rows == this->rows && columns == this->columns) {
+      memset(elements.get(), 0, (size_t) rows * columns * sizeof(long long));
+   } else {
+      reshape(rank, (int) rows, (int) columns);
+   }
+}
+
+/*
+ * Implementation notes: reshape
+ * -----------------------------
+ * The aligned_alloc function requires a size that is a multiple of the
+ * alignment, so the allocation is rounded up to whole cache lines.
+ */
+
+void Array::reshape(int rank, int rows, int columns) {
+   if (rank == this->rank && rows == this->rows && columns == this->columns) return;
+   size_t bytes = (size_t) rows * columns * sizeof(long long);
+   bytes = (bytes + ARRAY_ALIGNMENT - 1) & ~(size_t) (ARRAY_ALIGNMENT - 1);
+   long long *storage = (long long *) aligned_alloc(ARRAY_ALIGNMENT, bytes);
+   if (storage == NULL) error("Out of memory for array");
+   memset(storage, 0, bytes);
+   elements.reset(storage);
+   this->rank = rank;
+   this->rows = rows;
+   this->columns = columns;
+}
+
+void Array::reportElementError(const string & key, int rank, long long row, long long column) {
+   if (this->rank == 0) error(key + " is not dimensioned");
+   if (rank != this->rank) error("Wrong number of subscripts for " + key);
+   error("Subscript out of range: " + formatSubscripts(key, rank, row, column));
+}
+
+/*
+ * Implementation notes: formatSubscripts
+ * --------------------------------------
+ * Writes a reference to an array element as it appears in a program,
+ * taking the name from the symbol table key by dropping its "()".
+ */
+
+static string formatSubscripts(const string & key, int rank, long long row, long long column) {
+   string name = key.substr(0, key.length() - 2);
+   string result = name + "(" + to_string(row);
+   if (rank == 2) result += ", " + to_string(column);
+   return result + ")";
+}
+
+/*
+ * Implementation notes: kernels
+ * -----------------------------
+ * Each set of kernels provides the loops that MAT and SUM spend their
+ * time in.  The portable kernels do their arithmetic on unsigned values
+ * so that overflow wraps without undefined behavior.  The SSE2 and AVX2
+ * kernels process two or four elements per instruction and finish the
+ * last few with the portable code.  Rows of a matrix begin on a cache
+ * line only when the row length allows it, so all loads and stores are
+ * unaligned, which costs nothing on aligned data.  Neither instruction
+ * set has a 64-bit multiply that keeps the low half of each product,
+ * so it is built from three 32 x 32 -> 64 bit multiplies: the product
+ * of the low halves plus the two cross products shifted into the high
+ * half.  The product of the high halves lies entirely above bit 63.
+ *
+ * The product C = A * B is computed a row at a time: row i of C is the
+ * sum over k of A(i, k) times row k of B, which reads B sequentially
+ * and keeps the row of C in cache.  Its kernel is therefore the axpy
+ * operation dst += k * src.
+ */
+
+struct Kernels {
+   void (*add)(long long *dst, const long long *a, const long long *b, size_t n);
+   void (*sub)(long long *dst, const long long *a, const long long *b, size_t n);
+   void (*addScalar)(long long *dst, const long long *a, long long k, size_t n);
+   void (*scale)(long long *dst, const long long *a, long long k, size_t n);
+   void (*axpy)(long long *dst, const long long *src, long long k, size_t n);
+   long long (*sum)(const long long *a, size_t n);
+};
+
+typedef unsigned long long Unsigned;
+
+static void addPortable(long long *dst, const long long *a, const long long *b, size_t n) {
+   for (size_t i = 0; i < n; i++) {
+      dst[i] = (long long) ((Unsigned) a[i] + (Unsigned) b[i]);
+   }
+}
+
+static void subPortable(long long *dst, const long long *a, const long long *b, size_t n) {
+   for (size_t i = 0; i < n; i++) {
+      dst[i] = (long long) ((Unsigned) a[i] - (Unsigned) b[i]);
+   }
+}
+
+static void addScalarPortable(long long *dst, const long long *a, long long k, size_t n) {
+   for (size_t i = 0; i < n; i++) {
+      dst[i] = (long long) ((Unsigned) a[i] + (Unsigned) k);
+   }
+}
+
+static void scalePortable(long long *dst, const long long *a, long long k, size_t n) {
+   for (size_t i = 0; i < n; i++) {
+      dst[i] = (long long) ((Unsigned) a[i] * (Unsigned) k);
+   }
+}
+
+static void axpyPortable(long long *dst, const long long *src, long long k, size_t n) {
+   for (size_t i = 0; i < n; i++) {
+      dst[i] = (long long) ((Unsigned) dst[i] + (Unsigned) k * (Unsigned) src[i]);
+   }
+}
+
+static long long sumPortable(const long long *a, size_t n) {
+   Unsigned sum = 0;
+   for (size_t i = 0; i < n; i++) {
+      sum += (Unsigned) a[i];
+   }
+   return (long long) sum;
+}
+
+static const Kernels PORTABLE_KERNELS = {
+   addPortable, subPortable, addScalarPortable, scalePortable, axpyPortable, sumPortable
+};
+
+#if defined(__x86_64__)
+
+static inline __m128i load128(const long long *p) {
+   return _mm_loadu_si128((const __m128i *) p);
+}
+
+static inline void store128(long long *p, __m128i v) {
+   _mm_storeu_si128((__m128i *) p, v);
+}
+
+static inline __m128i mulLow128(__m128i a, __m128i b) {
+   __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b),
+                                 _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+   return _mm_add_epi64(_mm_mul_epu32(a, b), _mm_slli_epi64(cross, 32));
+}
+
+static void addSSE2(long long *dst, const long long *a, const long long *b, size_t n) {
+   size_t i = 0;
+   for (; i + 2 <= n; i += 2) {
+      store128(dst + i, _mm_add_epi64(load128(a + i), load128(b + i)));
+   }
+   addPortable(dst + i, a + i, b + i, n - i);
+}
+
+static void subSSE2(long long *dst, const long long *a, const long long *b, size_t n) {
+   size_t i = 0;
+   for (; i + 2 <= n; i += 2) {
+      store128(dst + i, _mm_sub_epi64(load128(a + i), load128(b + i)));
+   }
+   subPortable(dst + i, a + i, b + i, n - i);
+}
+
+static void addScalarSSE2(long long *dst, const long long *a, long long k, size_t n) {
+   __m128i vk = _mm_set1_epi64x(k);
+   size_t i = 0;
+   for (; i + 2 <= n; i += 2) {
+      store128(dst + i, _mm_add_epi64(load128(a + i), vk));
+   }
+   addScalarPortable(dst + i, a + i, k, n - i);
+}
+
+static void scaleSSE2(long long *dst, const long long *a, long long k, size_t n) {
+   __m128i vk = _mm_set1_epi64x(k);
+   size_t i = 0;
+   for (; i + 2 <= n; i += 2) {
+      store128(dst + i, mulLow128(load128(a + i), vk));
+   }
+   scalePortable(dst + i, a + i, k, n - i);
+}
+
+static void axpySSE2(long long *dst, const long long *src, long long k, size_t n) {
+   __m128i vk = _mm_set1_epi64x(k);
+   size_t i = 0;
+   for (; i + 2 <= n; i += 2) {
+      store128(dst + i, _mm_add_epi64(load128(dst + i), mulLow128(load128(src + i), vk)));
+   }
+   axpyPortable(dst + i, src + i, k, n - i);
+}
+
+static long long sumSSE2(const long long *a, size_t n) {
+   __m128i total = _mm_setzero_si128();
+   size_t i = 0;
+   for (; i + 2 <= n; i += 2) {
+      total = _mm_add_epi64(total, load128(a + i));
+   }
+   total = _mm_add_epi64(total, _mm_unpackhi_epi64(total, total));
+   return (long long) ((Unsigned) _mm_cvtsi128_si64(total) + (Unsigned) sumPortable(a + i, n - i));
+}
+
+static const Kernels SSE2_KERNELS = {
+   addSSE2, subSSE2, addScalarSSE2, scaleSSE2, axpySSE2, sumSSE2
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i load256(const long long *p) {
+   return _mm256_loadu_si256((const __m256i *) p);
+}
+
+AVX2 static inline void store256(long long *p, __m256i v) {
+   _mm256_storeu_si256((__m256i *) p, v);
+}
+
+AVX2 static inline __m256i mulLow256(__m256i a, __m256i b) {
+   __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                    _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+   return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+AVX2 static void addAVX2(long long *dst, const long long *a, const long long *b, size_t n) {
+   size_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      store256(dst + i, _mm256_add_epi64(load256(a + i), load256(b + i)));
+   }
+   addPortable(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static void subAVX2(long long *dst, const long long *a, const long long *b, size_t n) {
+   size_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      store256(dst + i, _mm256_sub_epi64(load256(a + i), load256(b + i)));
+   }
+   subPortable(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static void addScalarAVX2(long long *dst, const long long *a, long long k, size_t n) {
+   __m256i vk = _mm256_set1_epi64x(k);
+   size_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      store256(dst + i, _mm256_add_epi64(load256(a + i), vk));
+   }
+   addScalarPortable(dst + i, a + i, k, n - i);
+}
+
+AVX2 static void scaleAVX2(long long *dst, const long long *a, long long k, size_t n) {
+   __m256i vk = _mm256_set1_epi64x(k);
+   size_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      store256(dst + i, mulLow256(load256(a + i), vk));
+   }
+   scalePortable(dst + i, a + i, k, n - i);
+}
+
+AVX2 static void axpyAVX2(long long *dst, const long long *src, long long k, size_t n) {
+   __m256i vk = _mm256_set1_epi64x(k);
+   size_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      __m256i product = mulLow256(load256(src + i), vk);
+      store256(dst + i, _mm256_add_epi64(load256(dst + i), product));
+   }
+   axpyPortable(dst + i, src + i, k, n - i);
+}
+
+AVX2 static long long sumAVX2(const long long *a, size_t n) {
+   __m256i total = _mm256_setzero_si256();
+   size_t i = 0;
+   for (; i + 4 <= n; i += 4) {
+      total = _mm256_add_epi64(total, load256(a + i));
+   }
+   __m128i half = _mm_add_epi64(_mm256_castsi256_si128(total),
+                                _mm256_extracti128_si256(total, 1));
+   half = _mm_add_epi64(half, _mm_unpackhi_epi64(half, half));
+   return (long long) ((Unsigned) _mm_cvtsi128_si64(half) + (Unsigned) sumPortable(a + i, n - i));
+}
+
+static const Kernels AVX2_KERNELS = {
+   addAVX2, subAVX2, addScalarAVX2, scaleAVX2, axpyAVX2, sumAVX2
+};
+
+#endif
+
+/*
+ * Implementation notes: dispatch
+ * ------------------------------
+ * The kernels are chosen once, while the program's static data is
+ * initialized.  That happens before main, when the processor model
+ * used by __builtin_cpu_supports may not be set up yet, so it is
+ * initialized explicitly first.
+ */
+
+static const Kernels *kernelsForLevel(SimdLevel level) {
+#if defined(__x86_64__)
+   if (level == AVX2_SIMD) return &AVX2_KERNELS;
+   if (level == SSE2_SIMD) return &SSE2_KERNELS;
+#endif
+   return &PORTABLE_KERNELS;
+}
+
+SimdLevel getSupportedLevel() {
+#if defined(__x86_64__)
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) return AVX2_SIMD;
+   return SSE2_SIMD;
+#else
+   return PORTABLE_SIMD;
+#endif
+}
+
+static SimdLevel currentLevel = getSupportedLevel();
+static const Kernels *kernels = kernelsForLevel(currentLevel);
+
+SimdLevel getKernelLevel() {
+   return currentLevel;
+}
+
+SimdLevel setKernelLevel(SimdLevel level) {
+   currentLevel = min(level, getSupportedLevel());
+   kernels = kernelsForLevel(currentLevel);
+   return currentLevel;
+}
+
+string simdLevelToString(SimdLevel level) {
+   switch (level) {
+    case SSE2_SIMD: return "sse2";
+    case AVX2_SIMD: return "avx2";
+    default: return "portable";
+   }
+}
+
+/*
+ * Implementation notes: executeMat
+ * --------------------------------
+ * The target is given its shape only after the operands have been
+ * checked, so an error leaves it as it was.  Element-wise operations
+ * read each element before writing the same position, so they can run
+ * in place when the target is an operand.  A product reads whole rows
+ * of its operands while it writes, so it is computed into a separate
+ * array when the target is one of them.
+ */
+
+long long executeMat(MatOperation op, Array & target, Array *lhs, Array *rhs, long long scalar,
+                     const char *targetKey, const char *lhsKey, const char *rhsKey) {
+   if (op == MAT_FILL) {
+      requireDimensioned(target, targetKey);
+      fill(target.getElements(), target.getElements() + target.getSize(), scalar);
+      return target.getSize();
+   }
+   requireDimensioned(*lhs, lhsKey);
+   if (op == MAT_ADD || op == MAT_SUB || op == MAT_PRODUCT) requireDimensioned(*rhs, rhsKey);
+   if (op == MAT_PRODUCT) return multiply(target, *lhs, *rhs, targetKey, lhsKey, rhsKey);
+   if ((op == MAT_ADD || op == MAT_SUB)
+       && (lhs->getRank() != rhs->getRank() || lhs->getRows() != rhs->getRows()
+           || lhs->getColumns() != rhs->getColumns())) {
+      reportDisagreement(lhsKey, rhsKey);
+   }
+   target.reshape(lhs->getRank(), lhs->getRows(), lhs->getColumns());
+   long long *dst = target.getElements();
+   const long long *a = lhs->getElements();
+   size_t n = lhs->getSize();
+   switch (op) {
+    case MAT_COPY:
+      if (dst != a) memcpy(dst, a, n * sizeof(long long));
+      break;
+    case MAT_ADD:
+      kernels->add(dst, a, rhs->getElements(), n);
+      break;
+    case MAT_SUB:
+      kernels->sub(dst, a, rhs->getElements(), n);
+      break;
+    case MAT_ADD_SCALAR:
+      kernels->addScalar(dst, a, scalar, n);
+      break;
+    case MAT_SUB_SCALAR:
+      kernels->addScalar(dst, a, (long long) (0ull - (Unsigned) scalar), n);
+      break;
+    case MAT_SCALE:
+      kernels->scale(dst, a, scalar, n);
+      break;
+    default:
+      error("Illegal MAT operation");
+   }
+   return n;
+}
+
+/*
+ * Implementation notes: multiply
+ * ------------------------------
+ * Each of the rows * columns elements of the product takes inner
+ * multiplications, which is the work reported.
+ */
+
+static long long multiply(Array & target, Array & lhs, Array & rhs, const char *targetKey,
+                          const char *lhsKey, const char *rhsKey) {
+   if (lhs.getColumns() != rhs.getRows()) reportDisagreement(lhsKey, rhsKey);
+   int rows = lhs.getRows();
+   int inner = lhs.getColumns();
+   int columns = rhs.getColumns();
+   int rank = (rhs.getRank() == 1) ? 1 : 2;
+   if ((long long) rows * columns > MAX_ARRAY_SIZE) {
+      error("Array too large: " + formatSubscripts(targetKey, rank, rows, columns));
+   }
+   Array temporary;
+   bool aliased = &target == &lhs || &target == &rhs;
+   Array & result = aliased ? temporary : target;
+   result.reshape(rank, rows, columns);
+   const long long *a = lhs.getElements();
+   const long long *b = rhs.getElements();
+   long long *c = result.getElements();
+   for (int i = 0; i < rows; i++) {
+      long long *row = c + (size_t) i * columns;
+      fill(row, row + columns, 0);
+      for (int k = 0; k < inner; k++) {
+         kernels->axpy(row, b + (size_t) k * columns, a[(size_t) i * inner + k], columns);
+      }
+   }
+   if (aliased) target = move(temporary);
+   return (long long) rows * columns * max(inner, 1);
+}
+
+long long sumArray(Array & array, const char *key) {
+   requireDimensioned(array, key);
+   return kernels->sum(array.getElements(), array.getSize());
+}
+
+static void requireDimensioned(Array & array, const char *key) {
+   if (array.getRank() == 0) error(string(key) + " is not dimensioned");
+}
+
+static void reportDisagreement(const char *lhsKey, const char *rhsKey) {
+   error("Dimensions of " + string(lhsKey) + " and " + string(rhsKey) + " do not agree");
+}
@@ -0,0 +1,270 @@
+/*
+ * File: array.h
+ * -------------
+ * This interface exports the Array class, which holds the elements of
+ * a variable created by DIM, and the vectorized operations behind the
+ * MAT statement.
+ */
+
+#ifndef _array_h
+#define _array_h
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+/* Constants */
+
+const int ARRAY_ALIGNMENT = 64;
+const int MAX_ARRAY_SIZE = 1 << 26;
+
+/*
+ * Class: Array
+ * ------------
+ * This class holds a one- or two-dimensional array of 64-bit
+ * integers.  The elements are stored contiguously in row-major order,
+ * starting on a cache line boundary, and subscripts run from 1 to the
+ * extent given in DIM.  A one-dimensional array of n elements is stored as a
+ * column of n rows, which is how MAT treats it in a product.  An
+ * array that has not been dimensioned has rank 0 and no elements.
+ *
+ * Arrays live in the EvalState, one for each slot, and are moved
+ * rather than copied when the state grows.  The name used in error
+ * messages is the key under which the array is interned in the symbol
+ * table, which is its name followed by "()".
+ */
+
+class Array {
+
+public:
+
+/*
+ * Constructor: Array
+ * Usage: Array array;
+ * -------------------
+ * Creates an array that has not been dimensioned.
+ */
+
+   Array();
+
+/*
+ * Method: dimension
+ * Usage: array.dimension(key, rank, rows, columns);
+ * -------------------------------------------------
+ * Gives the array the specified shape, with every element 0, as DIM
+ * does.  For a one-dimensional array, columns must be 1.  An extent
+ * less than 1 or an array of more than MAX_ARRAY_SIZE elements is
+ * reported by calling error.
+ */
+
+   void dimension(const std::string & key, int rank, long long rows, long long columns);
+
+/*
+ * Method: reshape
+ * Usage: array.reshape(rank, rows, columns);
+ * ------------------------------------------
+ * Gives the array the specified shape, which must already be valid.
+ * The elements are kept if the shape is unchanged and are otherwise
+ * replaced by zeros, so MAT can store into an operand of its own.
+ */
+
+   void reshape(int rank, int rows, int columns);
+
+/*
+ * Methods: getRank, getRows, getColumns, getSize
+ * Usage: int rank = array.getRank();
+ * ----------------------------------
+ * These methods return the shape of the array.  The size is the
+ * number of elements.
+ */
+
+   int getRank() const;
+   int getRows() const;
+   int getColumns() const;
+   int getSize() const;
+
+/*
+ * Method: getElements
+ * Usage: long long *elements = array.getElements();
+ * -------------------------------------------------
+ * Returns the first element, or NULL if the array has no elements.
+ */
+
+   long long *getElements();
+
+/*
+ * Method: getElement
+ * Usage: long long *element = array.getElement(rank, row, column);
+ * ----------------------------------------------------------------
+ * Returns the element at the specified subscripts, given as written,
+ * or NULL if the array is not dimensioned, was dimensioned with a
+ * different number of subscripts or the subscripts are out of range.
+ * A reference to a one-dimensional array passes 1 as the column.
+ * The caller reports a NULL result with reportElementError, so that
+ * the check costs one comparison per subscript.
+ */
+
+   long long *getElement(int rank, long long row, long long column);
+
+/*
+ * Method: reportElementError
+ * Usage: array.reportElementError(key, rank, row, column);
+ * --------------------------------------------------------
+ * Calls error with the message that explains why getElement returned
+ * NULL for the same arguments.
+ */
+
+   void reportElementError(const std::string & key, int rank, long long row,
+                           long long column);
+
+private:
+
+   struct FreeDeleter {
+      void operator()(long long *elements) const {
+         free(elements);
+      }
+   };
+
+   std::unique_ptr<long long[], FreeDeleter> elements;
+   int rank;
+   int rows;
+   int columns;
+
+};
+
+/*
+ * Implementation notes: element access
+ * ------------------------------------
+ * An array that has not been dimensioned has rank 0, so a single
+ * comparison of the rank rejects both that case and a wrong number of
+ * subscripts.  Subtracting one and comparing as unsigned tests both
+ * ends of the range at once.
+ */
+
+inline int Array::getRank() const {
+   return rank;
+}
+
+inline int Array::getRows() const {
+   return rows;
+}
+
+inline int Array::getColumns() const {
+   return columns;
+}
+
+inline int Array::getSize() const {
+   return rows * columns;
+}
+
+inline long long *Array::getElements() {
+   return elements.get();
+}
+
+inline long long *Array::getElement(int rank, long long row, long long column) {
+   if (rank != this->rank || (unsigned long long) row - 1 >= (unsigned long long) rows
+       || (unsigned long long) column - 1 >= (unsigned long long) columns) {
+      return NULL;
+   }
+   return elements.get() + (size_t) (row - 1) * columns + (column - 1);
+}
+
+/*
+ * Type: MatOperation
+ * ------------------
+ * This enumerated type identifies the forms of the MAT statement:
+ *
+ *    MAT_COPY        MAT C = A
+ *    MAT_FILL        MAT C = (e)
+ *    MAT_ADD         MAT C = A + B
+ *    MAT_SUB         MAT C = A - B
+ *    MAT_PRODUCT     MAT C = A * B
+ *    MAT_ADD_SCALAR  MAT C = A + (e)
+ *    MAT_SUB_SCALAR  MAT C = A - (e)
+ *    MAT_SCALE       MAT C = A * (e) or MAT C = (e) * A
+ */
+
+enum MatOperation {
+   MAT_COPY, MAT_FILL, MAT_ADD, MAT_SUB, MAT_PRODUCT, MAT_ADD_SCALAR, MAT_SUB_SCALAR,
+   MAT_SCALE, ILLEGAL_MAT
+};
+
+/*
+ * Function: matTakesScalar
+ * Usage: if (matTakesScalar(op)) . . .
+ * ------------------------------------
+ * Returns true if the operation takes a scalar operand.
+ */
+
+inline bool matTakesScalar(MatOperation op) {
+   return op == MAT_FILL || op == MAT_ADD_SCALAR || op == MAT_SUB_SCALAR || op == MAT_SCALE;
+}
+
+/*
+ * Function: executeMat
+ * Usage: executeMat(op, target, lhs, rhs, scalar, targetKey, lhsKey, rhsKey);
+ * ---------------------------------------------------------------------------
+ * Performs a MAT operation, storing the result in target, which takes
+ * the shape of the result.  The operands not used by the operation are
+ * ignored and may be NULL; the keys name the arrays in error messages.
+ * Every operand must be dimensioned and the shapes must agree, except
+ * that a fill requires the target to be dimensioned instead.  In a
+ * product the columns of lhs must equal the rows of rhs, and the result
+ * is one-dimensional if rhs is.  The target may be one of the operands.
+ * Arithmetic wraps on overflow, as it does in expressions.  The result
+ * is the number of elements the operation touched, which the engines
+ * charge to the governor.
+ */
+
+long long executeMat(MatOperation op, Array & target, Array *lhs, Array *rhs, long long scalar,
+                     const char *targetKey, const char *lhsKey, const char *rhsKey);
+
+/*
+ * Function: sumArray
+ * Usage: long long sum = sumArray(array, key);
+ * --------------------------------------------
+ * Returns the sum of the elements of the array, which wraps on
+ * overflow, or calls error if the array is not dimensioned.
+ */
+
+long long sumArray(Array & array, const char *key);
+
+/*
+ * Type: SimdLevel
+ * ---------------
+ * This enumerated type identifies the sets of kernels that carry out
+ * MAT operations and SUM.  Portable kernels are plain C++; the others
+ * use the SSE2 or AVX2 instructions of x86-64 processors.  The best
+ * level the processor supports is chosen when the program starts.
+ */
+
+enum SimdLevel { PORTABLE_SIMD, SSE2_SIMD, AVX2_SIMD };
+
+/*
+ * Functions: getKernelLevel, setKernelLevel, getSupportedLevel
+ * Usage: SimdLevel level = getKernelLevel();
+ *        level = setKernelLevel(level);
+ * ----------------------------------------
+ * These functions report and select the kernels in use.  The
+ * setKernelLevel function selects the requested level or the best one
+ * the processor supports, whichever is lower, and returns the level it
+ * selected.  It is meant for benchmarks and must not be called while
+ * a program runs on another thread.
+ */
+
+SimdLevel getKernelLevel();
+SimdLevel setKernelLevel(SimdLevel level);
+SimdLevel getSupportedLevel();
+
+/*
+ * Function: simdLevelToString
+ * Usage: string str = simdLevelToString(level);
+ * ---------------------------------------------
+ * Returns the name of the level for reports: "portable", "sse2" or
+ * "avx2".
+ */
+
+std::string simdLevelToString(SimdLevel level);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * File: batch.cpp
+ * ---------------
+ * This file implements the batch runner.
+ */
+
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "batch.h"
+#include "error.h"
+#include "evalstate.h"
+using namespace std;
+
+/*
+ * Function: runOne
+ * Usage: runOne(program, inputSet, limits, result);
+ * -------------------------------------------------
+ * Executes the program against one input set.  The output is block
+ * buffered into a string stream, and the stream is declared before the
+ * EvalState so that the buffer's final flush still has a destination.
+ * Any other exception, such as bad_alloc, fails this input set alone,
+ * since one that escaped a pool thread would end the process.
+ */
+
+static void runOne(const FrozenProgram & program, const string & inputSet,
+                   const ResourceLimits & limits, BatchResult & result) {
+   ostringstream out;
+   istringstream in(inputSet);
+   EvalState state;
+   state.getOutput().setStream(out);
+   state.getOutput().setFlushPolicy(BLOCK_BUFFERED);
+   state.getInput().setStream(in);
+   state.getGovernor().setLimits(limits);
+   result.failed = false;
+   try {
+      program.run(state);
+   } catch (ErrorException & ex) {
+      result.failed = true;
+      result.errorMessage = ex.getMessage();
+   } catch (exception & ex) {
+      result.failed = true;
+      result.errorMessage = ex.what();
+   }
+   state.getOutput().flush();
+   result.output = out.str();
+}
+
+void runBatch(const FrozenProgram & program, const vector<string> & inputSets,
+              const ResourceLimits & limits, vector<BatchResult> & results,
+              ThreadPool & pool) {
+   results.clear();
+   results.resize(inputSets.size());
+   pool.run(inputSets.size(), [&](int i) {
+      runOne(program, inputSets[i], limits, results[i]);
+   });
+}
@@ -0,0 +1,47 @@
+/*
+ * File: batch.h
+ * -------------
+ * This interface exports the batch runner, which executes one compiled
+ * program against many independent sets of input values in parallel.
+ */
+
+#ifndef _batch_h
+#define _batch_h
+
+#include <string>
+#include <vector>
+#include "frozen.h"
+#include "governor.h"
+#include "threadpool.h"
+
+/*
+ * Type: BatchResult
+ * -----------------
+ * This structure holds the outcome of one run: everything the program
+ * printed and, if the run stopped with an error or any other
+ * exception, its message.
+ */
+
+struct BatchResult {
+   std::string output;
+   bool failed;
+   std::string errorMessage;
+};
+
+/*
+ * Function: runBatch
+ * Usage: runBatch(program, inputSets, limits, results, pool);
+ * -----------------------------------------------------------
+ * Runs the program once for every string in inputSets, each of which
+ * supplies the whitespace-separated values read by INPUT, and stores
+ * the outcome of run i in results[i].  The runs execute on the pool's
+ * threads.  Each has its own EvalState, with its own variables, input
+ * and output buffers and governor, which holds it to the specified
+ * limits, and shares only the frozen program, which no run modifies.
+ */
+
+void runBatch(const FrozenProgram & program, const std::vector<std::string> & inputSets,
+              const ResourceLimits & limits, std::vector<BatchResult> & results,
+              ThreadPool & pool);
+
+#endif
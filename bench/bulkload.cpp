@@ -0,0 +1,82 @@
+/*
+ * File: bulkload.cpp
+ * ------------------
+ * This program measures how long it takes to load BASIC programs of
+ * increasing size into a Program, adding each line with addProgramLine
+ * as the console does for each line that is typed or pasted at it.  Each size is loaded once with the lines
+ * in ascending order and once in a shuffled order.  The program is
+ * built from the interpreter sources without Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/bulkload.cpp arena.cpp array.cpp checkpoint.cpp evalstate.cpp
+ *        exp.cpp governor.cpp inference.cpp input.cpp lexer.cpp loader.cpp
+ *        mappedfile.cpp optimizer.cpp output.cpp parser.cpp program.cpp
+ *        statement.cpp symtab.cpp value.cpp  + the Stanford library
+ *
+ * and takes an optional argument giving the largest program size.
+ * It prints one line per run with the number of lines, the order,
+ * the total load time and the time per line.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "loader.h"
+#include "program.h"
+#include "strlib.h"
+using namespace std;
+
+/*
+ * Function: makeLine
+ * Usage: string line = makeLine(lineNumber);
+ * ------------------------------------------
+ * Returns a representative source line for the specified line number.
+ */
+
+static string makeLine(int lineNumber) {
+   string var = "X" + integerToString(lineNumber % 97);
+   return integerToString(lineNumber) + " LET " + var + " = " + var + " + "
+        + integerToString(lineNumber % 13) + " * 2";
+}
+
+/*
+ * Function: loadLines
+ * Usage: double seconds = loadLines(program, lines);
+ * --------------------------------------------------
+ * Adds, parses and optimizes every line, returning the elapsed time in seconds.
+ */
+
+static double loadLines(Program & program, const vector<string> & lines) {
+   auto start = chrono::steady_clock::now();
+   for (const string & line : lines) {
+      addProgramLine(program, line);
+   }
+   program.link();
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   return elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+   int maxLines = (argc > 1) ? atoi(argv[1]) : 1000000;
+   mt19937 random(12345);
+   cout << "lines,order,seconds,ns_per_line" << endl;
+   for (int size = 1000; size <= maxLines; size *= 10) {
+      vector<string> lines;
+      for (int i = 1; i <= size; i++) {
+         lines.push_back(makeLine(i * 10));
+      }
+      for (int shuffled = 0; shuffled <= 1; shuffled++) {
+         if (shuffled) shuffle(lines.begin(), lines.end(), random);
+         Program program;
+         double seconds = loadLines(program, lines);
+         cout << size << "," << (shuffled ? "shuffled" : "ascending") << ","
+              << fixed << setprecision(4) << seconds << ","
+              << setprecision(1) << seconds * 1e9 / size << endl;
+      }
+   }
+   return 0;
+}
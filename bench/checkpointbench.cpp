@@ -0,0 +1,99 @@
+/*
+ * File: checkpointbench.cpp
+ * -------------------------
+ * This program measures what checkpoints cost a running program.  It
+ * runs a BASIC loop that writes into a large array, first without
+ * checkpoints and then with checkpoints at a range of intervals, and
+ * reports how much longer each run took.  The array makes every
+ * checkpoint carry real data, so that the cost of forking a process of
+ * that size shows up.  The program is built from the interpreter
+ * sources without Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/checkpointbench.cpp arena.cpp array.cpp checkpoint.cpp
+ *        compiler.cpp evalstate.cpp exp.cpp governor.cpp inference.cpp input.cpp
+ *        jit.cpp lexer.cpp loader.cpp mappedfile.cpp optimizer.cpp output.cpp
+ *        parser.cpp program.cpp statement.cpp symtab.cpp value.cpp vm.cpp
+ *        + the Stanford library
+ *
+ * and takes optional arguments giving the number of loop iterations,
+ * the number of array elements and the checkpoint file.  Each interval
+ * is run REPEATS times and the fastest run is reported, one line per
+ * interval with the checkpoints that run took and skipped, its time
+ * and the overhead relative to the run without checkpoints.  The time
+ * is what the program itself takes; the last checkpoint is finished
+ * afterwards, outside the measurement.  The writer competes with the
+ * program for the processor, so the overhead is lowest when the
+ * machine has a core to spare.
+ */
+
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "bytecode.h"
+#include "checkpoint.h"
+#include "compiler.h"
+#include "evalstate.h"
+#include "loader.h"
+#include "program.h"
+#include "strlib.h"
+#include "vm.h"
+using namespace std;
+
+/* Constants */
+
+const int REPEATS = 3;
+
+int main(int argc, char *argv[]) {
+   long long count = (argc > 1) ? atoll(argv[1]) : 50000000;
+   long long size = (argc > 2) ? atoll(argv[2]) : 1000000;
+   string filename = (argc > 3) ? argv[3] : "/tmp/checkpointbench.ckp";
+   string n = integerToString(size);
+   Program program;
+   addProgramLine(program, "10 DIM A(" + n + ")");
+   addProgramLine(program, "20 LET I = 0");
+   addProgramLine(program, "30 LET I = I + 1");
+   addProgramLine(program, "40 LET A(I - (I / " + n + ") * " + n + " + 1) = I");
+   addProgramLine(program, "50 IF I < " + to_string(count) + " THEN 30");
+   addProgramLine(program, "60 PRINT SUM(A)");
+   Bytecode bytecode;
+   compileProgram(program, bytecode);
+   double statements = 3.0 * count;
+   double baseline = 0;
+   cout << "interval,checkpoints,skipped,seconds,ns_per_statement,overhead_percent" << endl;
+   for (long long interval : { 0LL, 1000000000LL, 100000000LL, 10000000LL, 1000000LL }) {
+      double best = 0;
+      int saved = 0;
+      int skipped = 0;
+      for (int i = 0; i < REPEATS; i++) {
+         ofstream null("/dev/null");
+         EvalState state;
+         state.getOutput().setStream(null);
+         if (interval != 0) {
+            state.getCheckpointer().setFilename(filename);
+            state.getGovernor().setCheckpointInterval(interval);
+            state.getCheckpointer().prepare(program);
+         }
+         auto start = chrono::steady_clock::now();
+         executeBytecode(bytecode, state);
+         chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+         state.getCheckpointer().wait();
+         if (i == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+            saved = state.getCheckpointer().getSavedCount();
+            skipped = state.getCheckpointer().getSkippedCount();
+         }
+      }
+      if (interval == 0) baseline = best;
+      cout << ((interval == 0) ? string("none") : to_string(interval)) << ","
+           << saved << "," << skipped << ","
+           << fixed << setprecision(4) << best << ","
+           << setprecision(2) << best * 1e9 / statements << ","
+           << setprecision(1) << (best / baseline - 1) * 100 << endl;
+   }
+   unlink(filename.c_str());
+   return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * File: frozenstress.cpp
+ * ----------------------
+ * This program runs one FrozenProgram from many threads at once and
+ * checks every run against a reference.  The program reads a count
+ * with INPUT and exercises variables of both types, arrays, MAT, jumps
+ * and PRINT.  Each thread has its own EvalState and alternates between
+ * the virtual machine and the statement walker, so both engines read
+ * the shared statements and bytecode concurrently.  It is built from
+ * the interpreter sources without Basic.cpp, for example
+ *
+ *    g++ -O2 -pthread -I. bench/frozenstress.cpp arena.cpp array.cpp
+ *        checkpoint.cpp compiler.cpp evalstate.cpp exp.cpp frozen.cpp
+ *        governor.cpp inference.cpp input.cpp jit.cpp lexer.cpp loader.cpp
+ *        mappedfile.cpp optimizer.cpp output.cpp parser.cpp program.cpp
+ *        statement.cpp symtab.cpp value.cpp vm.cpp  + the Stanford library
+ *
+ * and again with -O1 -g -fsanitize=thread in place of -O2 to have
+ * ThreadSanitizer watch the runs.  It takes optional arguments giving
+ * the number of threads and the runs per thread, and prints the runs
+ * per second and the number of runs whose output or error differed
+ * from the reference, which must be zero.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "error.h"
+#include "evalstate.h"
+#include "frozen.h"
+#include "loader.h"
+#include "program.h"
+#include "strlib.h"
+using namespace std;
+
+/* Constants */
+
+const int INPUT_VALUES = 16;
+
+/* Private function prototypes */
+
+static string runOnce(const FrozenProgram & frozen, int value, bool useVM);
+
+int main(int argc, char *argv[]) {
+   int threadCount = (argc > 1) ? atoi(argv[1]) : 8;
+   int runsPerThread = (argc > 2) ? atoi(argv[2]) : 2000;
+   Program program;
+   addProgramLine(program, "10 INPUT N");
+   addProgramLine(program, "20 DIM A(N)");
+   addProgramLine(program, "30 DIM B(N)");
+   addProgramLine(program, "40 LET X = 0.5");
+   addProgramLine(program, "50 LET I = 1");
+   addProgramLine(program, "60 LET A(I) = I * I");
+   addProgramLine(program, "70 LET B(I) = N - I");
+   addProgramLine(program, "80 LET X = X + I / 4");
+   addProgramLine(program, "90 LET I = I + 1");
+   addProgramLine(program, "100 IF I <= N THEN 60");
+   addProgramLine(program, "110 MAT A = A + B");
+   addProgramLine(program, "120 PRINT SUM(A)");
+   addProgramLine(program, "130 PRINT X");
+   addProgramLine(program, "140 IF N > 12 THEN 170");
+   addProgramLine(program, "150 PRINT N * 1000");
+   addProgramLine(program, "160 GOTO 180");
+   addProgramLine(program, "170 PRINT A(N) / (N - 16)");
+   addProgramLine(program, "180 END");
+   FrozenProgram frozen(program);
+   vector<string> reference;
+   for (int value = 1; value <= INPUT_VALUES; value++) {
+      reference.push_back(runOnce(frozen, value, true));
+      if (runOnce(frozen, value, false) != reference.back()) {
+         cerr << "Engines disagree for N = " << value << endl;
+         return 1;
+      }
+   }
+   atomic<int> mismatches(0);
+   vector<thread> threads;
+   auto start = chrono::steady_clock::now();
+   for (int t = 0; t < threadCount; t++) {
+      threads.push_back(thread([&, t]() {
+         for (int i = 0; i < runsPerThread; i++) {
+            int value = (t + i) % INPUT_VALUES + 1;
+            if (runOnce(frozen, value, (t + i) % 2 == 0) != reference[value - 1]) {
+               mismatches++;
+            }
+         }
+      }));
+   }
+   for (thread & th : threads) {
+      th.join();
+   }
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   long long runs = (long long) threadCount * runsPerThread;
+   cout << "threads,runs,seconds,runs_per_second,mismatches" << endl;
+   cout << threadCount << "," << runs << "," << fixed << setprecision(4) << elapsed.count()
+        << "," << setprecision(0) << runs / elapsed.count() << "," << mismatches << endl;
+   return (mismatches == 0) ? 0 : 1;
+}
+
+/*
+ * Function: runOnce
+ * Usage: string result = runOnce(frozen, value, useVM);
+ * -----------------------------------------------------
+ * Runs the frozen program with its own state, reading value with
+ * INPUT, and returns what it printed followed by the message of the
+ * error that stopped it, if any.
+ */
+
+static string runOnce(const FrozenProgram & frozen, int value, bool useVM) {
+   ostringstream out;
+   istringstream in(integerToString(value));
+   EvalState state;
+   state.getOutput().setStream(out);
+   state.getInput().setStream(in);
+   try {
+      if (useVM) {
+         frozen.run(state);
+      } else {
+         frozen.runStatements(state);
+      }
+   } catch (ErrorException & ex) {
+      state.getOutput().flush();
+      out << "Error: " << ex.getMessage() << endl;
+   }
+   state.getOutput().flush();
+   return out.str();
+}
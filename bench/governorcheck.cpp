@@ -0,0 +1,135 @@
+/*
+ * File: governorcheck.cpp
+ * -----------------------
+ * This program checks that every engine stops a program at the same
+ * point when it exceeds its statement limit.  Each test program prints
+ * as it goes, so the output up to the error shows exactly where the
+ * run stopped.  Every program is run under each limit from 1 to
+ * MAX_LIMIT on the virtual machine, with the JIT compiler, by the
+ * statement walker and by both engines of a FrozenProgram, and the
+ * output and error of each run are compared with those of the virtual
+ * machine.  It is built from the interpreter sources without
+ * Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/governorcheck.cpp arena.cpp array.cpp checkpoint.cpp
+ *        compiler.cpp evalstate.cpp exp.cpp frozen.cpp governor.cpp inference.cpp
+ *        input.cpp interpreter.cpp jit.cpp lexer.cpp loader.cpp mappedfile.cpp
+ *        optimizer.cpp output.cpp parser.cpp program.cpp statement.cpp symtab.cpp
+ *        value.cpp vm.cpp  + the Stanford library
+ *
+ * It prints one line for each program and engine with the number of
+ * runs whose result differed from the virtual machine's, which must be
+ * zero, and exits with status 1 if any did.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "error.h"
+#include "evalstate.h"
+#include "frozen.h"
+#include "governor.h"
+#include "interpreter.h"
+#include "loader.h"
+#include "program.h"
+using namespace std;
+
+/* Constants */
+
+const int MAX_LIMIT = 1500;
+
+/*
+ * Type: Engine
+ * ------------
+ * This enumerated type lists the ways a program is run.
+ */
+
+enum Engine { VM, JIT, WALKER, FROZEN_VM, FROZEN_WALKER, ENGINE_COUNT };
+
+/*
+ * Constant: ENGINE_NAMES
+ * ----------------------
+ * The names of the engines in the report, in the order of Engine.
+ */
+
+const char *const ENGINE_NAMES[] = { "vm", "jit", "walker", "frozen_vm", "frozen_walker" };
+
+/*
+ * Constant: PROGRAMS
+ * ------------------
+ * The test programs: a loop after a few straight-line statements, a
+ * loop whose increment and test the compiler fuses, nested loops with
+ * a forward jump inside, and a loop closed by GOTO.
+ */
+
+const vector<vector<string>> PROGRAMS = {
+   { "10 LET A = 1", "20 LET B = 2", "30 LET I = 0", "40 LET I = I + 1",
+     "50 PRINT I", "60 IF I < 2000 THEN 40", "70 END" },
+   { "10 LET I = 0", "20 PRINT I * 3", "30 LET I = I + 1", "40 IF I <= 2000 THEN 20" },
+   { "10 LET I = 1", "20 LET J = 1", "30 IF J = 2 THEN 50", "40 PRINT I * 100 + J",
+     "50 LET J = J + 1", "60 IF J <= 4 THEN 30", "70 LET I = I + 1", "80 IF I <= 200 THEN 20" },
+   { "10 LET X = 0.5", "20 LET X = X + 1", "30 PRINT X", "40 GOTO 20" }
+};
+
+/* Private function prototypes */
+
+static string runOnce(Program & program, FrozenProgram & frozen, Engine engine, int limit);
+
+int main() {
+   bool failed = false;
+   for (int p = 0; p < (int) PROGRAMS.size(); p++) {
+      Program program;
+      for (const string & line : PROGRAMS[p]) {
+         addProgramLine(program, line);
+      }
+      FrozenProgram frozen(program);
+      vector<int> mismatches(ENGINE_COUNT, 0);
+      for (int limit = 1; limit <= MAX_LIMIT; limit++) {
+         string reference = runOnce(program, frozen, VM, limit);
+         for (int engine = JIT; engine < ENGINE_COUNT; engine++) {
+            if (runOnce(program, frozen, (Engine) engine, limit) != reference) {
+               mismatches[engine]++;
+            }
+         }
+      }
+      for (int engine = JIT; engine < ENGINE_COUNT; engine++) {
+         cout << "program " << p + 1 << ", " << ENGINE_NAMES[engine] << ": "
+              << mismatches[engine] << " of " << MAX_LIMIT << " runs differ" << endl;
+         if (mismatches[engine] != 0) failed = true;
+      }
+   }
+   return failed ? 1 : 0;
+}
+
+/*
+ * Function: runOnce
+ * Usage: string result = runOnce(program, frozen, engine, limit);
+ * ---------------------------------------------------------------
+ * Runs the program on the engine with a fresh state limited to the
+ * specified number of statements, and returns what it printed followed
+ * by the message of the error that stopped it, if any.
+ */
+
+static string runOnce(Program & program, FrozenProgram & frozen, Engine engine, int limit) {
+   ostringstream out;
+   EvalState state;
+   state.getOutput().setStream(out);
+   ResourceLimits limits = { limit, 0, 0, 0 };
+   state.getGovernor().setLimits(limits);
+   try {
+      switch (engine) {
+       case VM: runProgram(program, state); break;
+       case JIT: runProgramJIT(program, state); break;
+       case WALKER: runStatements(program, state); break;
+       case FROZEN_VM: frozen.run(state); break;
+       case FROZEN_WALKER: frozen.runStatements(state); break;
+       default: break;
+      }
+   } catch (ErrorException & ex) {
+      state.getOutput().flush();
+      out << "Error: " << ex.getMessage() << endl;
+   }
+   state.getOutput().flush();
+   return out.str();
+}
@@ -0,0 +1,103 @@
+/*
+ * File: inputbench.cpp
+ * --------------------
+ * This program measures how fast INPUT reads prepared values.  It
+ * writes a file of integers of varying length, eight to a line, and
+ * runs a BASIC loop that reads and sums them, once with the file
+ * attached as a stream, once attached as a file read in blocks, and
+ * once more in blocks into a double variable.  The program is built
+ * from the interpreter sources without Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/inputbench.cpp arena.cpp array.cpp checkpoint.cpp compiler.cpp
+ *        evalstate.cpp exp.cpp governor.cpp inference.cpp input.cpp jit.cpp lexer.cpp
+ *        loader.cpp mappedfile.cpp optimizer.cpp output.cpp parser.cpp program.cpp
+ *        statement.cpp symtab.cpp value.cpp vm.cpp  + the Stanford library
+ *
+ * and takes optional arguments giving the number of values and the
+ * file to write them to.  Each source is run REPEATS times and the
+ * fastest run is reported, one line per source with its time and the
+ * values and megabytes read per second.
+ */
+
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "bytecode.h"
+#include "compiler.h"
+#include "evalstate.h"
+#include "loader.h"
+#include "program.h"
+#include "strlib.h"
+#include "vm.h"
+using namespace std;
+
+/* Constants */
+
+const int REPEATS = 3;
+
+/*
+ * Function: compileSum
+ * Usage: compileSum(bytecode, count, initial);
+ * --------------------------------------------
+ * Compiles a loop that reads count values into X and sums them, where
+ * X starts as initial, so that 0.5 makes X a double variable.
+ */
+
+static void compileSum(Bytecode & bytecode, long long count, const string & initial) {
+   Program program;
+   addProgramLine(program, "10 LET X = " + initial);
+   addProgramLine(program, "20 LET S = 0");
+   addProgramLine(program, "30 LET I = 0");
+   addProgramLine(program, "40 INPUT X");
+   addProgramLine(program, "50 LET S = S + X");
+   addProgramLine(program, "60 LET I = I + 1");
+   addProgramLine(program, "70 IF I < " + to_string(count) + " THEN 40");
+   addProgramLine(program, "80 PRINT S");
+   compileProgram(program, bytecode);
+}
+
+int main(int argc, char *argv[]) {
+   long long count = (argc > 1) ? atoll(argv[1]) : 20000000;
+   string filename = (argc > 2) ? argv[2] : "/tmp/inputbench.txt";
+   ofstream data(filename.c_str());
+   unsigned long long seed = 12345;
+   for (long long i = 0; i < count; i++) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      long long value = (long long) (seed >> 33) >> ((seed >> 20) % 28);
+      data << ((seed & 1) ? -value : value) << ((i % 8 == 7) ? '\n' : ' ');
+   }
+   data.close();
+   double megabytes = ifstream(filename.c_str(), ios::ate).tellg() / 1e6;
+   Bytecode integers;
+   Bytecode doubles;
+   compileSum(integers, count, "0");
+   compileSum(doubles, count, "0.5");
+   cout << "source,values,seconds,values_per_second,mb_per_second" << endl;
+   for (string source : { "stream", "file", "file-double" }) {
+      double best = 0;
+      for (int i = 0; i < REPEATS; i++) {
+         ofstream null("/dev/null");
+         ifstream in(filename.c_str());
+         EvalState state;
+         state.getOutput().setStream(null);
+         if (source == "stream") {
+            state.getInput().setStream(in);
+         } else {
+            state.getInput().setFile(filename);
+         }
+         auto start = chrono::steady_clock::now();
+         executeBytecode((source == "file-double") ? doubles : integers, state);
+         chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+         if (i == 0 || elapsed.count() < best) best = elapsed.count();
+      }
+      cout << source << "," << count << "," << fixed << setprecision(4) << best << ","
+           << setprecision(0) << count / best << ","
+           << setprecision(1) << megabytes / best << endl;
+   }
+   unlink(filename.c_str());
+   return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * File: inputcheck.cpp
+ * --------------------
+ * This program checks that INPUT reads the values of a file attached
+ * with INPUT FROM correctly, including files whose bytes are not text.
+ * It writes each case's contents to a file, reads it through an
+ * InputSource as integers or as doubles, and compares what it reads,
+ * up to the first error, with what the case expects.  It is built from
+ * the input sources alone, for example
+ *
+ *    g++ -O2 -I. bench/inputcheck.cpp input.cpp  + the Stanford library
+ *
+ * and takes an optional argument giving the file to write.  It prints
+ * one line for each case and exits with status 1 if any failed.
+ */
+
+#include <unistd.h>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "error.h"
+#include "input.h"
+using namespace std;
+
+/*
+ * Type: InputCase
+ * ---------------
+ * This structure describes a file, whether its values are read as
+ * doubles, and what reading them must give: the values in order,
+ * separated by spaces, then "error" if the next value is illegal or
+ * "end" if the file runs out.
+ */
+
+struct InputCase {
+   string name;
+   string contents;
+   bool doubles;
+   string expected;
+};
+
+/*
+ * Constant: INPUT_CASES
+ * ---------------------
+ * The cases, which give NUL bytes before, inside and after a number,
+ * alongside a few ordinary files as a baseline.
+ */
+
+const vector<InputCase> INPUT_CASES = {
+   { "integers", "1 -2\n+3\t4", false, "1 -2 3 4 end" },
+   { "doubles", "1.5 -2e3\n.25", true, "1.5 -2000 0.25 end" },
+   { "integer-garbage", "1 2x 3", false, "1 error" },
+   { "double-garbage", "1.5 2.5x 3", true, "1.5 error" },
+   { "integer-nul-after", string("1\0 2", 4), false, "error" },
+   { "double-nul-after", string("1.5\0 2.5", 8), true, "error" },
+   { "double-nul-alone", string("1.5 \0 2.5", 9), true, "1.5 error" },
+   { "double-nul-inside", string("1.\0" "5 2.5", 8), true, "error" },
+   { "double-nul-last", string("1.5 2.5\0", 8), true, "1.5 error" }
+};
+
+/* Private function prototypes */
+
+static bool checkCase(const InputCase & test, const string & filename);
+
+int main(int argc, char *argv[]) {
+   string filename = (argc > 1) ? argv[1] : "/tmp/inputcheck.txt";
+   bool passed = true;
+   for (const InputCase & test : INPUT_CASES) {
+      if (!checkCase(test, filename)) passed = false;
+   }
+   unlink(filename.c_str());
+   return passed ? 0 : 1;
+}
+
+/*
+ * Function: checkCase
+ * Usage: bool ok = checkCase(test, filename);
+ * -------------------------------------------
+ * Writes the case to the file and reads values from it until reading
+ * fails, which an exhausted file reports as "No more input values".
+ * A case that would read zeros forever stops once it has read more
+ * values than it expects.
+ */
+
+static bool checkCase(const InputCase & test, const string & filename) {
+   ofstream(filename.c_str(), ios::binary) << test.contents;
+   InputSource input;
+   input.setFile(filename);
+   ostringstream actual;
+   int limit = 0;
+   for (char ch : test.expected) {
+      if (ch == ' ') limit++;
+   }
+   for (int count = 0; count <= limit; count++) {
+      try {
+         if (test.doubles) {
+            actual << input.readDouble() << " ";
+         } else {
+            actual << input.readInteger() << " ";
+         }
+      } catch (ErrorException & ex) {
+         actual << ((ex.getMessage() == "No more input values") ? "end" : "error");
+         break;
+      }
+   }
+   bool ok = actual.str() == test.expected;
+   cout << "input " << test.name << ": " << (ok ? "ok" : "FAILED, read " + actual.str())
+        << endl;
+   return ok;
+}
@@ -0,0 +1,252 @@
+/*
+ * File: loadgen.cpp
+ * -----------------
+ * This program puts load on a session server started with
+ *
+ *    basic --serve=/tmp/basic.sock
+ *
+ * and reports how long its commands take.  It opens many sessions at
+ * once, enters a short program in each, and then runs rounds of
+ * commands in every session: an edit, RUN, PRINT and LIST.  Each
+ * session has one command in flight at a time and sends the next as
+ * soon as the answer arrives, and one epoll loop drives all of them.
+ * Optional hog sessions run a long loop over and over while the others
+ * work, to show that a long RUN does not hold up other sessions.  The
+ * program needs no interpreter sources, for example
+ *
+ *    g++ -O2 bench/loadgen.cpp -o loadgen
+ *
+ * and takes the socket path and optional arguments giving the number
+ * of sessions, the rounds per session and the number of hogs.  It
+ * prints one line per kind of command with the count and the 50th and
+ * 99th percentile and the largest latency in microseconds, and a last
+ * line with the commands answered per second.
+ */
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+/* Constants */
+
+const int SHORT_COMMAND = 0;
+const int RUN_COMMAND = 1;
+const int KIND_COUNT = 2;
+const string KIND_NAMES[] = { "short", "run" };
+
+/*
+ * Type: Client
+ * ------------
+ * This structure holds one session: its socket, the commands it sends
+ * and how far it has got, and the answer it is reading.
+ */
+
+struct Client {
+   int fd;
+   vector<string> script;
+   size_t next;
+   bool hog;
+   bool waiting;             /* True while an answer is expected */
+   string input;
+   chrono::steady_clock::time_point sent;
+};
+
+/* Private function prototypes */
+
+static int connectTo(const string & path);
+static vector<string> makeScript(int rounds, bool hog);
+static void sendNext(Client & client);
+static bool readAnswers(Client & client, vector<double> latencies[], int & errors);
+static int kindOf(const string & command);
+static double percentile(vector<double> & values, double fraction);
+
+int main(int argc, char *argv[]) {
+   if (argc < 2) {
+      cerr << "Usage: loadgen socket [sessions [rounds [hogs]]]" << endl;
+      return 2;
+   }
+   string path = argv[1];
+   int sessions = (argc > 2) ? atoi(argv[2]) : 200;
+   int rounds = (argc > 3) ? atoi(argv[3]) : 50;
+   int hogs = (argc > 4) ? atoi(argv[4]) : 0;
+   int epollFd = epoll_create1(0);
+   vector<Client> clients(sessions + hogs);
+   for (int i = 0; i < (int) clients.size(); i++) {
+      Client & client = clients[i];
+      client.fd = connectTo(path);
+      if (client.fd < 0) {
+         cerr << "Cannot connect to " << path << ": " << strerror(errno) << endl;
+         return 1;
+      }
+      client.hog = i >= sessions;
+      client.script = makeScript(rounds, client.hog);
+      client.next = 0;
+      epoll_event event;
+      event.events = EPOLLIN;
+      event.data.u32 = i;
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &event);
+   }
+   vector<double> latencies[KIND_COUNT];
+   int errors = 0;
+   int working = sessions;
+   auto start = chrono::steady_clock::now();
+   for (Client & client : clients) {
+      sendNext(client);
+   }
+   epoll_event events[256];
+   while (working > 0) {
+      int count = epoll_wait(epollFd, events, 256, -1);
+      for (int i = 0; i < count; i++) {
+         Client & client = clients[events[i].data.u32];
+         if (!readAnswers(client, latencies, errors)) {
+            cerr << "Server closed a session" << endl;
+            return 1;
+         }
+         if (client.waiting) continue;
+         if (client.next == client.script.size()) {
+            if (!client.hog) {
+               working--;
+               continue;
+            }
+            client.next--;
+         }
+         sendNext(client);
+      }
+   }
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   long long total = 0;
+   cout << "kind,commands,p50_us,p99_us,max_us" << endl;
+   for (int kind = 0; kind < KIND_COUNT; kind++) {
+      vector<double> & values = latencies[kind];
+      total += values.size();
+      if (values.empty()) continue;
+      cout << KIND_NAMES[kind] << "," << values.size() << fixed << setprecision(1)
+           << "," << percentile(values, 0.50) << "," << percentile(values, 0.99)
+           << "," << *max_element(values.begin(), values.end()) << endl;
+   }
+   cout << "commands_per_second," << setprecision(0) << total / elapsed.count()
+        << ",errors," << errors << endl;
+   for (Client & client : clients) {
+      close(client.fd);
+   }
+   return 0;
+}
+
+/*
+ * Function: connectTo
+ * Usage: int fd = connectTo(path);
+ * --------------------------------
+ * Connects to the server and returns a nonblocking socket, or -1.
+ */
+
+static int connectTo(const string & path) {
+   sockaddr_un address;
+   memset(&address, 0, sizeof address);
+   address.sun_family = AF_UNIX;
+   strncpy(address.sun_path, path.c_str(), sizeof address.sun_path - 1);
+   int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (fd < 0) return -1;
+   if (connect(fd, (sockaddr *) &address, sizeof address) < 0) {
+      close(fd);
+      return -1;
+   }
+   fcntl(fd, F_SETFL, O_NONBLOCK);
+   return fd;
+}
+
+/*
+ * Function: makeScript
+ * Usage: vector<string> script = makeScript(rounds, hog);
+ * -------------------------------------------------------
+ * Returns the commands of one session.  A hog's program loops a
+ * hundred million times and its last command, RUN, is repeated until
+ * the other sessions are done.
+ */
+
+static vector<string> makeScript(int rounds, bool hog) {
+   vector<string> script = {
+      "10 LET S = 0",
+      "20 LET I = 0",
+      "30 LET S = S + I",
+      "40 LET I = I + 1",
+      string("50 IF I < ") + (hog ? "100000000" : "1000") + " THEN 30",
+      "60 PRINT S"
+   };
+   if (hog) {
+      script.push_back("RUN");
+      return script;
+   }
+   for (int i = 0; i < rounds; i++) {
+      script.push_back("40 LET I = I + " + to_string(1 + i % 3));
+      script.push_back("RUN");
+      script.push_back("PRINT S");
+      script.push_back("LIST 30-50");
+   }
+   return script;
+}
+
+static void sendNext(Client & client) {
+   string line = client.script[client.next++] + "\n";
+   client.sent = chrono::steady_clock::now();
+   client.waiting = true;
+   size_t written = 0;
+   while (written < line.size()) {
+      ssize_t count = write(client.fd, line.data() + written, line.size() - written);
+      if (count > 0) written += count;
+   }
+}
+
+/*
+ * Function: readAnswers
+ * Usage: if (!readAnswers(client, latencies, errors)) . . .
+ * ---------------------------------------------------------
+ * Reads what the server has sent the client.  An answer ends with a
+ * line that is OK or begins with "Error: ", and its latency is then
+ * recorded under the kind of the command that was sent.  Returns false
+ * if the server has closed the connection.
+ */
+
+static bool readAnswers(Client & client, vector<double> latencies[], int & errors) {
+   char buffer[65536];
+   ssize_t count = read(client.fd, buffer, sizeof buffer);
+   if (count == 0) return false;
+   if (count < 0) return errno == EAGAIN || errno == EINTR;
+   client.input.append(buffer, count);
+   size_t start = 0;
+   size_t newline;
+   while ((newline = client.input.find('\n', start)) != string::npos) {
+      string line = client.input.substr(start, newline - start);
+      start = newline + 1;
+      bool failed = line.compare(0, 7, "Error: ") == 0;
+      if (line == "OK" || failed) {
+         chrono::duration<double, micro> latency = chrono::steady_clock::now() - client.sent;
+         if (!client.hog) latencies[kindOf(client.script[client.next - 1])].push_back(latency.count());
+         if (failed) errors++;
+         client.waiting = false;
+      }
+   }
+   client.input.erase(0, start);
+   return true;
+}
+
+static int kindOf(const string & command) {
+   return (command == "RUN") ? RUN_COMMAND : SHORT_COMMAND;
+}
+
+static double percentile(vector<double> & values, double fraction) {
+   size_t index = min(values.size() - 1, (size_t) (fraction * values.size()));
+   nth_element(values.begin(), values.begin() + index, values.end());
+   return values[index];
+}
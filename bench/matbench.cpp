@@ -0,0 +1,292 @@
+/*
+ * File: matbench.cpp
+ * ------------------
+ * This program measures the MAT statement and SUM against the loops
+ * of LET statements they replace, and compares the kernels that carry
+ * out whole-array operations at each instruction set level.  It is
+ * built from the interpreter sources without Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/matbench.cpp arena.cpp array.cpp checkpoint.cpp compiler.cpp
+ *        evalstate.cpp exp.cpp governor.cpp inference.cpp input.cpp interpreter.cpp
+ *        jit.cpp lexer.cpp loader.cpp mappedfile.cpp optimizer.cpp output.cpp
+ *        parser.cpp program.cpp statement.cpp symtab.cpp value.cpp vm.cpp
+ *        + the Stanford library
+ *
+ * It takes an optional scale factor that multiplies the number of
+ * repetitions of every workload.  The output is CSV with the columns
+ *
+ *    workload,engine,elements,seconds,ns_per_element,checksum
+ *
+ * The program workloads run the same computation twice, once with
+ * element-by-element loops ("loop") and once with MAT ("mat"), on the
+ * virtual machine and on the statement interpreter:
+ *
+ *    add      C = A + B over a one-dimensional array
+ *    product  C = A * B for square matrices
+ *
+ * The kernel workloads call the MAT operations directly, once for each
+ * level the processor supports ("portable", "sse2", "avx2"):
+ *
+ *    k_add      MAT C = A + B
+ *    k_scale    MAT C = A * (k)
+ *    k_product  MAT C = A * B
+ *    k_sum      SUM(A)
+ *
+ * An element is one element of the result computed, or for a product
+ * one multiply-add.  The checksum is the sum of the result, so every
+ * row of a workload must report the same checksum.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "array.h"
+#include "evalstate.h"
+#include "interpreter.h"
+#include "loader.h"
+#include "output.h"
+#include "program.h"
+#include "strlib.h"
+using namespace std;
+
+/*
+ * Type: Workload
+ * --------------
+ * This structure describes one program workload: its source lines,
+ * the element operations a run performs and whether it uses MAT.
+ */
+
+struct Workload {
+   string name;
+   string form;
+   vector<string> lines;
+   long long elements;
+};
+
+/* Private function prototypes */
+
+static double runWorkload(const Workload & workload, const string & engine,
+                          string & checksum);
+static Workload makeAdd(bool useMat, int n, int reps);
+static Workload makeProduct(bool useMat, int n, int reps);
+static void runKernels(SimdLevel level, double scale);
+static void report(const string & workload, const string & engine,
+                   long long elements, double seconds, const string & checksum);
+
+int main(int argc, char *argv[]) {
+   double scale = (argc > 1) ? atof(argv[1]) : 1.0;
+   if (scale <= 0) scale = 1.0;
+   cout << "workload,engine,elements,seconds,ns_per_element,checksum" << endl;
+   int addReps = max(1, (int) (200 * scale));
+   int productReps = max(1, (int) (4 * scale));
+   vector<Workload> workloads;
+   for (bool useMat : { false, true }) {
+      workloads.push_back(makeAdd(useMat, 10000, addReps));
+      workloads.push_back(makeProduct(useMat, 60, productReps));
+   }
+   for (const Workload & workload : workloads) {
+      for (string engine : { "vm", "ast" }) {
+         string checksum;
+         double seconds = runWorkload(workload, engine, checksum);
+         report(workload.name, engine + "_" + workload.form, workload.elements,
+                seconds, checksum);
+      }
+   }
+   SimdLevel supported = getSupportedLevel();
+   for (int level = PORTABLE_SIMD; level <= supported; level++) {
+      runKernels(setKernelLevel(SimdLevel(level)), scale);
+   }
+   setKernelLevel(supported);
+   return 0;
+}
+
+/*
+ * Function: report
+ * Usage: report(workload, engine, elements, seconds, checksum);
+ * -------------------------------------------------------------
+ * Prints one CSV row.
+ */
+
+static void report(const string & workload, const string & engine,
+                   long long elements, double seconds, const string & checksum) {
+   cout << workload << "," << engine << "," << elements << ","
+        << fixed << setprecision(4) << seconds << ","
+        << setprecision(3) << seconds * 1e9 / elements << ","
+        << checksum << endl;
+}
+
+/*
+ * Function: runWorkload
+ * Usage: double seconds = runWorkload(workload, engine, checksum);
+ * ----------------------------------------------------------------
+ * Loads the workload and runs it once on the named engine, returning
+ * the time the run took and setting checksum to what it printed, which
+ * is the sum of its result.
+ */
+
+static double runWorkload(const Workload & workload, const string & engine,
+                          string & checksum) {
+   Program program;
+   for (const string & line : workload.lines) {
+      addProgramLine(program, line);
+   }
+   ostringstream out;
+   EvalState state;
+   state.getOutput().setStream(out);
+   auto start = chrono::steady_clock::now();
+   if (engine == "vm") {
+      runProgram(program, state);
+   } else {
+      runStatements(program, state);
+   }
+   state.getOutput().flush();
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   checksum = trim(out.str());
+   return elapsed.count();
+}
+
+/*
+ * Function: runKernels
+ * Usage: runKernels(level, scale);
+ * --------------------------------
+ * Times each kernel workload at the selected level and prints a row
+ * for it.  The operands are filled with values that overflow when
+ * multiplied, so that wrapping arithmetic is exercised as well.
+ */
+
+static void runKernels(SimdLevel level, double scale) {
+   string engine = simdLevelToString(level);
+   const int n = 1 << 20;
+   const int m = 256;
+   int reps = max(1, (int) (200 * scale));
+   Array a, b, c, p, q;
+   a.dimension("A()", 1, n, 1);
+   b.dimension("B()", 1, n, 1);
+   p.dimension("P()", 2, m, m);
+   q.dimension("Q()", 2, m, m);
+   for (int i = 0; i < n; i++) {
+      a.getElements()[i] = (long long) ((unsigned long long) i * 0x9E3779B97F4A7C15ULL);
+      b.getElements()[i] = (long long) ((unsigned long long) (i ^ 0x5555) * 104729u << 32);
+   }
+   for (int i = 0; i < m * m; i++) {
+      p.getElements()[i] = i % 1013 - 500;
+      q.getElements()[i] = (i * 31) % 977 + 3;
+   }
+   struct Kernel {
+      string name;
+      MatOperation op;
+      Array *lhs;
+      Array *rhs;
+      long long elements;
+      int reps;
+   };
+   int productReps = max(1, reps / 20);
+   Kernel kernels[] = {
+      { "k_add", MAT_ADD, &a, &b, n, reps },
+      { "k_scale", MAT_SCALE, &a, NULL, n, reps },
+      { "k_product", MAT_PRODUCT, &p, &q, (long long) m * m * m, productReps },
+      { "k_sum", ILLEGAL_MAT, &a, NULL, n, reps },
+   };
+   for (const Kernel & kernel : kernels) {
+      unsigned long long sum = 0;
+      auto start = chrono::steady_clock::now();
+      for (int r = 0; r < kernel.reps; r++) {
+         if (kernel.op == ILLEGAL_MAT) {
+            sum += sumArray(*kernel.lhs, "A()");
+         } else {
+            executeMat(kernel.op, c, kernel.lhs, kernel.rhs, 37, "C()", "A()", "B()");
+         }
+      }
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      if (kernel.op != ILLEGAL_MAT) sum = sumArray(c, "C()");
+      report(kernel.name, engine, kernel.elements * kernel.reps, elapsed.count(),
+             to_string((long long) sum));
+   }
+}
+
+/*
+ * Workload constructors
+ * ---------------------
+ * Each function below returns one program workload in its loop or its
+ * MAT form.  Both forms fill the operands with the same loops, which
+ * are not counted, and print the sum of the result.
+ */
+
+static Workload makeAdd(bool useMat, int n, int reps) {
+   Workload workload;
+   workload.name = "add";
+   workload.form = useMat ? "mat" : "loop";
+   string size = integerToString(n);
+   workload.lines = {
+      "10 DIM A(" + size + ")",
+      "20 DIM B(" + size + ")",
+      "30 DIM C(" + size + ")",
+      "40 LET I = 1",
+      "50 LET A(I) = I * 7",
+      "60 LET B(I) = I * I",
+      "70 LET I = I + 1",
+      "80 IF I <= " + size + " THEN 50",
+      "90 LET R = 0",
+   };
+   if (useMat) {
+      workload.lines.push_back("100 MAT C = A + B");
+   } else {
+      workload.lines.push_back("100 LET I = 1");
+      workload.lines.push_back("110 LET C(I) = A(I) + B(I)");
+      workload.lines.push_back("120 LET I = I + 1");
+      workload.lines.push_back("130 IF I <= " + size + " THEN 110");
+   }
+   workload.lines.push_back("140 LET R = R + 1");
+   workload.lines.push_back("150 IF R < " + integerToString(reps) + " THEN 100");
+   workload.lines.push_back("160 PRINT SUM(C)");
+   workload.elements = (long long) n * reps;
+   return workload;
+}
+
+static Workload makeProduct(bool useMat, int n, int reps) {
+   Workload workload;
+   workload.name = "product";
+   workload.form = useMat ? "mat" : "loop";
+   string size = integerToString(n);
+   workload.lines = {
+      "10 DIM A(" + size + ", " + size + ")",
+      "20 DIM B(" + size + ", " + size + ")",
+      "30 DIM C(" + size + ", " + size + ")",
+      "40 LET I = 1",
+      "50 LET J = 1",
+      "60 LET A(I, J) = I - J",
+      "70 LET B(I, J) = I * J + 1",
+      "80 LET J = J + 1",
+      "90 IF J <= " + size + " THEN 60",
+      "100 LET I = I + 1",
+      "110 IF I <= " + size + " THEN 50",
+      "120 LET R = 0",
+   };
+   if (useMat) {
+      workload.lines.push_back("200 MAT C = A * B");
+   } else {
+      workload.lines.insert(workload.lines.end(), {
+         "200 LET I = 1",
+         "210 LET J = 1",
+         "220 LET S = 0",
+         "230 LET K = 1",
+         "240 LET S = S + A(I, K) * B(K, J)",
+         "250 LET K = K + 1",
+         "260 IF K <= " + size + " THEN 240",
+         "270 LET C(I, J) = S",
+         "280 LET J = J + 1",
+         "290 IF J <= " + size + " THEN 220",
+         "300 LET I = I + 1",
+         "310 IF I <= " + size + " THEN 210",
+      });
+   }
+   workload.lines.push_back("400 LET R = R + 1");
+   workload.lines.push_back("410 IF R < " + integerToString(reps) + " THEN 200");
+   workload.lines.push_back("420 PRINT SUM(C)");
+   workload.elements = (long long) n * n * n * reps;
+   return workload;
+}
@@ -0,0 +1,87 @@
+/*
+ * File: parsefree.cpp
+ * -------------------
+ * This program measures the cost of building and of discarding the
+ * parsed form of large BASIC programs.  For each size it parses and
+ * optimizes every line into a Program with addProgramLine, and
+ * then clears the program, which releases all of the statement and
+ * expression nodes through the program's arena.  The program is built
+ * from the interpreter sources without Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/parsefree.cpp arena.cpp array.cpp checkpoint.cpp evalstate.cpp
+ *        exp.cpp governor.cpp inference.cpp input.cpp lexer.cpp loader.cpp
+ *        mappedfile.cpp optimizer.cpp output.cpp parser.cpp program.cpp statement.cpp
+ *        symtab.cpp value.cpp  + the Stanford library
+ *
+ * and takes an optional argument giving the largest program size.
+ * It prints one line per size with the time to parse, the time to
+ * tear down, each per line, and the arena size.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "loader.h"
+#include "program.h"
+#include "strlib.h"
+using namespace std;
+
+/*
+ * Function: makeLine
+ * Usage: string line = makeLine(lineNumber);
+ * ------------------------------------------
+ * Returns a source line whose expression has a dozen or so nodes, so
+ * that the cost per node dominates the cost per line.
+ */
+
+static string makeLine(int lineNumber) {
+   string var = "X" + integerToString(lineNumber % 97);
+   string other = "Y" + integerToString(lineNumber % 31);
+   return integerToString(lineNumber) + " LET " + var + " = (" + var + " + " + other
+        + ") * (" + other + " - " + integerToString(lineNumber % 13) + ") / ("
+        + var + " + " + other + " * 3 + 1)";
+}
+
+/*
+ * Function: parseLines
+ * Usage: double seconds = parseLines(program, lines);
+ * ---------------------------------------------------
+ * Adds, parses and optimizes every line, returning the elapsed time
+ * in seconds.
+ */
+
+static double parseLines(Program & program, const vector<string> & lines) {
+   auto start = chrono::steady_clock::now();
+   for (const string & line : lines) {
+      addProgramLine(program, line);
+   }
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   return elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+   int maxLines = (argc > 1) ? atoi(argv[1]) : 1000000;
+   cout << "lines,parse_seconds,parse_ns_per_line,teardown_seconds,"
+        << "teardown_ns_per_line,arena_bytes" << endl;
+   for (int size = 1000; size <= maxLines; size *= 10) {
+      vector<string> lines;
+      for (int i = 1; i <= size; i++) {
+         lines.push_back(makeLine(i * 10));
+      }
+      Program program;
+      double parseSeconds = parseLines(program, lines);
+      size_t bytes = program.getArena().getBytesUsed();
+      auto start = chrono::steady_clock::now();
+      program.clear();
+      chrono::duration<double> teardown = chrono::steady_clock::now() - start;
+      double teardownSeconds = teardown.count();
+      cout << size << "," << fixed << setprecision(4) << parseSeconds << ","
+           << setprecision(1) << parseSeconds * 1e9 / size << ","
+           << setprecision(4) << teardownSeconds << ","
+           << setprecision(1) << teardownSeconds * 1e9 / size << "," << bytes << endl;
+   }
+   return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * File: printbench.cpp
+ * --------------------
+ * This program measures the throughput of PRINT output.  It runs a
+ * BASIC loop that does nothing but print, once with each flush
+ * policy, sending the output to a file that defaults to /dev/null, so
+ * that the cost of the write system calls shows up as it would when
+ * output goes to a pipe.  The program is built from the interpreter
+ * sources without Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/printbench.cpp arena.cpp array.cpp checkpoint.cpp compiler.cpp
+ *        evalstate.cpp exp.cpp governor.cpp inference.cpp input.cpp jit.cpp lexer.cpp
+ *        loader.cpp mappedfile.cpp optimizer.cpp output.cpp parser.cpp program.cpp
+ *        statement.cpp symtab.cpp value.cpp vm.cpp  + the Stanford library
+ *
+ * and takes optional arguments giving the number of lines to print and
+ * the output file.  It prints one line per policy with the bytes
+ * written, the time and the throughput in MB/s.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "bytecode.h"
+#include "compiler.h"
+#include "evalstate.h"
+#include "loader.h"
+#include "output.h"
+#include "program.h"
+#include "strlib.h"
+#include "vm.h"
+using namespace std;
+
+int main(int argc, char *argv[]) {
+   int count = (argc > 1) ? atoi(argv[1]) : 5000000;
+   string filename = (argc > 2) ? argv[2] : "/dev/null";
+   Program program;
+   addProgramLine(program, "10 LET I = 0");
+   addProgramLine(program, "20 LET I = I + 1");
+   addProgramLine(program, "30 PRINT I * 3");
+   addProgramLine(program, "40 IF I < " + integerToString(count) + " THEN 20");
+   Bytecode bytecode;
+   compileProgram(program, bytecode);
+   double bytes = 0;
+   for (int i = 1; i <= count; i++) {
+      bytes += integerToString(i * 3).length() + 1;
+   }
+   cout << "policy,lines,bytes,seconds,mb_per_second" << endl;
+   for (int block = 0; block <= 1; block++) {
+      ofstream file(filename.c_str(), ios::binary);
+      if (file.fail()) {
+         cerr << "Cannot open " << filename << endl;
+         return 1;
+      }
+      EvalState state;
+      state.getOutput().setStream(file);
+      state.getOutput().setFlushPolicy(block ? BLOCK_BUFFERED : LINE_BUFFERED);
+      auto start = chrono::steady_clock::now();
+      executeBytecode(bytecode, state);
+      state.getOutput().flush();
+      chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      cout << (block ? "block" : "line") << "," << count << "," << (long long) bytes << ","
+           << fixed << setprecision(4) << elapsed.count() << ","
+           << setprecision(1) << bytes / 1e6 / elapsed.count() << endl;
+   }
+   return 0;
+}
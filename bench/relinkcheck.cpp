@@ -0,0 +1,181 @@
+/*
+ * File: relinkcheck.cpp
+ * ---------------------
+ * This program checks that editing a program whose variables include
+ * doubles relinks only the lines the edit touches, and that a variable
+ * narrows again once no line makes it a double.  It loads a large
+ * program in which many lines widen a few variables, then replaces and
+ * deletes lines at random, linking after each edit, and counts the
+ * links that worked the types out for the whole program again, which
+ * every one did before.  It then runs a few small programs whose types
+ * must narrow after an edit.  It is built from the interpreter sources
+ * without Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/relinkcheck.cpp arena.cpp array.cpp checkpoint.cpp
+ *        evalstate.cpp exp.cpp governor.cpp inference.cpp input.cpp lexer.cpp
+ *        loader.cpp mappedfile.cpp optimizer.cpp output.cpp parser.cpp
+ *        program.cpp statement.cpp symtab.cpp value.cpp  + the Stanford library
+ *
+ * and takes optional arguments giving the number of lines and of
+ * edits.  It prints the time per edit and the number of full passes,
+ * which must be zero, followed by one line for each narrowing case,
+ * and exits with status 1 if any check failed.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "loader.h"
+#include "program.h"
+#include "strlib.h"
+using namespace std;
+
+/* Constants */
+
+const int VARIABLES = 40;
+
+/*
+ * Type: NarrowingCase
+ * -------------------
+ * This structure describes a program, a line to delete from it, and a
+ * variable that is a double before the deletion and an integer after.
+ */
+
+struct NarrowingCase {
+   string name;
+   vector<string> lines;
+   int deleted;
+   string variable;
+};
+
+/*
+ * Constant: NARROWING_CASES
+ * -------------------------
+ * The small programs: a variable whose only constant double is deleted
+ * while a line adds to it, a second variable copied from the first,
+ * and two variables copied from each other.
+ */
+
+const vector<NarrowingCase> NARROWING_CASES = {
+   { "self", { "10 LET X = 0.5", "20 LET X = X + 1", "30 PRINT X / 3" }, 10, "X" },
+   { "copy", { "10 LET X = 0.5", "20 LET Y = X", "30 LET Y = Y * 2" }, 10, "Y" },
+   { "cycle", { "10 LET X = Y", "20 LET Y = X", "30 LET X = 0.5" }, 30, "Y" }
+};
+
+/* Private function prototypes */
+
+static string makeLine(int lineNumber, int variant);
+static bool checkIncremental(int lineCount, int editCount);
+static bool checkNarrowing(const NarrowingCase & test);
+static ValueType getType(Program & program, const string & name);
+
+int main(int argc, char *argv[]) {
+   int lineCount = (argc > 1) ? atoi(argv[1]) : 100000;
+   int editCount = (argc > 2) ? atoi(argv[2]) : 10000;
+   bool passed = checkIncremental(lineCount, editCount);
+   for (const NarrowingCase & test : NARROWING_CASES) {
+      if (!checkNarrowing(test)) passed = false;
+   }
+   return passed ? 0 : 1;
+}
+
+/*
+ * Function: makeLine
+ * Usage: string line = makeLine(lineNumber, variant);
+ * ---------------------------------------------------
+ * Returns a line for the large program.  Every fourth line makes one
+ * of the D variables a double, so each of them has many lines that do;
+ * the others work with integers or print.  The variant changes the
+ * text of a line without changing what it does to the types.
+ */
+
+static string makeLine(int lineNumber, int variant) {
+   string n = integerToString(lineNumber);
+   string k = integerToString(lineNumber / 10 % VARIABLES);
+   string v = integerToString(variant);
+   switch (lineNumber / 10 % 4) {
+    case 0: return n + " LET D" + k + " = D" + k + " * 1.5 + " + v;
+    case 1: return n + " LET I" + k + " = I" + k + " + " + v;
+    case 2: return n + " PRINT D" + k + " / (I" + k + " + " + v + ")";
+    default: return n + " IF I" + k + " < " + v + " THEN " + integerToString(lineNumber - 20);
+   }
+}
+
+/*
+ * Function: checkIncremental
+ * Usage: bool ok = checkIncremental(lineCount, editCount);
+ * --------------------------------------------------------
+ * Loads the large program, links it, and then makes the edits, each a
+ * replacement or deletion of a random line that leaves every type as
+ * it was.  A link that works the types out again resets the table,
+ * which changes its type generation, so a generation that moves
+ * reveals a full pass.
+ */
+
+static bool checkIncremental(int lineCount, int editCount) {
+   Program program;
+   for (int i = 1; i <= lineCount; i++) {
+      addProgramLine(program, makeLine(i * 10, i % 7));
+   }
+   program.link();
+   SymbolTable & symbols = program.getSymbolTable();
+   mt19937 random(12345);
+   int fullPasses = 0;
+   auto start = chrono::steady_clock::now();
+   for (int edit = 0; edit < editCount; edit++) {
+      int lineNumber = (random() % lineCount + 1) * 10;
+      int before = symbols.getTypeGeneration();
+      if (edit % 5 == 4 && lineNumber / 10 % 4 != 1) {
+         program.removeSourceLine(lineNumber);
+         addProgramLine(program, makeLine(lineNumber, edit % 7));
+      } else {
+         addProgramLine(program, makeLine(lineNumber, edit % 7));
+      }
+      program.link();
+      if (symbols.getTypeGeneration() != before) fullPasses++;
+   }
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   cout << "lines,edits,seconds,ns_per_edit,full_passes" << endl;
+   cout << lineCount << "," << editCount << "," << fixed << setprecision(4) << elapsed.count()
+        << "," << setprecision(1) << elapsed.count() * 1e9 / editCount << ","
+        << fullPasses << endl;
+   return fullPasses == 0;
+}
+
+/*
+ * Function: checkNarrowing
+ * Usage: bool ok = checkNarrowing(test);
+ * --------------------------------------
+ * Loads and links a small program, deletes the line, links again and
+ * checks that the variable was a double and has become an integer.
+ */
+
+static bool checkNarrowing(const NarrowingCase & test) {
+   Program program;
+   for (const string & line : test.lines) {
+      addProgramLine(program, line);
+   }
+   program.link();
+   bool wide = getType(program, test.variable) == DOUBLE_TYPE;
+   program.removeSourceLine(test.deleted);
+   program.link();
+   bool narrow = getType(program, test.variable) == INTEGER_TYPE;
+   cout << "narrowing " << test.name << ": " << ((wide && narrow) ? "ok" : "FAILED") << endl;
+   return wide && narrow;
+}
+
+/*
+ * Function: getType
+ * Usage: ValueType type = getType(program, name);
+ * -----------------------------------------------
+ * Returns the type of the named variable in the program's table.
+ */
+
+static ValueType getType(Program & program, const string & name) {
+   SymbolTable & symbols = program.getSymbolTable();
+   return symbols.getType(symbols.lookup(name));
+}
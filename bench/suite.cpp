@@ -0,0 +1,397 @@
+/*
+ * File: suite.cpp
+ * ---------------
+ * This program runs a fixed corpus of BASIC workloads and reports how
+ * fast the interpreter executes them, so that changes to the engines
+ * can be compared by numbers.  It is built from the interpreter
+ * sources without Basic.cpp, for example
+ *
+ *    g++ -O2 -I. bench/suite.cpp arena.cpp array.cpp checkpoint.cpp compiler.cpp
+ *        evalstate.cpp exp.cpp governor.cpp inference.cpp input.cpp interpreter.cpp
+ *        jit.cpp lexer.cpp loader.cpp mappedfile.cpp optimizer.cpp output.cpp
+ *        parser.cpp program.cpp statement.cpp symtab.cpp value.cpp vm.cpp
+ *        + the Stanford library
+ *
+ * It takes an optional scale factor that multiplies the size of every
+ * workload; with the default of 1 each run takes between a fraction
+ * of a second and a few seconds on a current machine.  With --limits,
+ * every program workload also runs on each engine under limits too
+ * generous to be reached, reported as engine "vm+limits" and so on,
+ * which measures what the governor costs.  The workloads are:
+ *
+ *    loop       a tight IF/GOTO counting loop
+ *    expr       a chain of LET statements with large expressions
+ *    print      a loop that prints every value, written to /dev/null
+ *    load_list  loading a large program from a file and listing it
+ *    many_vars  a loop assigning a thousand distinct variables
+ *    real       a loop of double arithmetic mixed with an integer counter
+ *
+ * Each program workload runs once on the virtual machine ("vm"), once
+ * on the virtual machine with native code for hot loops ("jit") and
+ * once on the statement interpreter ("ast").  Every run happens in a
+ * child process of its own, so that the peak resident set size it
+ * reports belongs to that run alone.  The output is CSV with the
+ * columns
+ *
+ *    workload,engine,statements,seconds,statements_per_second,
+ *    ns_per_statement,peak_rss_kb,checksum
+ *
+ * The checksum is a hash of everything the run printed and the final
+ * value of every variable, so all engines must report the same
+ * checksum for a workload.  For load_list, a statement is one program
+ * line loaded and listed, and the checksum is left empty.
+ */
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "evalstate.h"
+#include "interpreter.h"
+#include "loader.h"
+#include "output.h"
+#include "program.h"
+#include "strlib.h"
+using namespace std;
+
+/*
+ * Type: Workload
+ * --------------
+ * This structure describes one program workload: its source lines and
+ * the number of statements a complete run executes.
+ */
+
+struct Workload {
+   string name;
+   vector<string> lines;
+   long long statements;
+};
+
+/*
+ * Class: HashingBuffer
+ * --------------------
+ * This stream buffer discards the characters written to it, keeping
+ * only their 64-bit FNV-1a hash.
+ */
+
+class HashingBuffer : public streambuf {
+
+public:
+
+   HashingBuffer() {
+      hash = 14695981039346656037ULL;
+   }
+
+   void addBytes(const char *bytes, streamsize count) {
+      for (streamsize i = 0; i < count; i++) {
+         hash = (hash ^ (unsigned char) bytes[i]) * 1099511628211ULL;
+      }
+   }
+
+   unsigned long long getHash() {
+      return hash;
+   }
+
+protected:
+
+   virtual int overflow(int ch) {
+      if (ch != EOF) {
+         char c = ch;
+         addBytes(&c, 1);
+      }
+      return ch;
+   }
+
+   virtual streamsize xsputn(const char *s, streamsize count) {
+      addBytes(s, count);
+      return count;
+   }
+
+private:
+
+   unsigned long long hash;
+
+};
+
+/* Private function prototypes */
+
+static Workload makeLoop(int n);
+static Workload makeExpr(int n);
+static Workload makePrint(int n);
+static Workload makeManyVars(int n, int variables);
+static Workload makeReal(int n);
+static double runWorkload(const Workload & workload, const string & engine, bool limited,
+                          unsigned long long & checksum);
+static long long runLoadList(int n, double & seconds);
+static void report(const string & workload, const string & engine,
+                   long long statements, double seconds, const string & checksum);
+template <typename Job>
+static void inChild(Job job);
+
+int main(int argc, char *argv[]) {
+   double scale = 1.0;
+   bool withLimits = false;
+   for (int i = 1; i < argc; i++) {
+      if (string(argv[i]) == "--limits") withLimits = true;
+      else scale = atof(argv[i]);
+   }
+   if (scale <= 0) scale = 1.0;
+   cout << "workload,engine,statements,seconds,statements_per_second,"
+        << "ns_per_statement,peak_rss_kb,checksum" << endl;
+   vector<Workload> workloads;
+   workloads.push_back(makeLoop((int) (30000000 * scale)));
+   workloads.push_back(makeExpr((int) (5000000 * scale)));
+   workloads.push_back(makePrint((int) (10000000 * scale)));
+   workloads.push_back(makeManyVars((int) (50000 * scale), 1000));
+   workloads.push_back(makeReal((int) (5000000 * scale)));
+   for (const Workload & workload : workloads) {
+      for (string engine : { "vm", "jit", "ast" }) {
+         for (bool limited : { false, true }) {
+            if (limited && !withLimits) continue;
+            inChild([&] {
+               unsigned long long checksum;
+               double seconds = runWorkload(workload, engine, limited, checksum);
+               ostringstream hex;
+               hex << std::hex << setw(16) << setfill('0') << checksum;
+               report(workload.name, limited ? engine + "+limits" : engine,
+                      workload.statements, seconds, hex.str());
+            });
+         }
+      }
+   }
+   inChild([&] {
+      double seconds;
+      long long statements = runLoadList((int) (500000 * scale), seconds);
+      report("load_list", "-", statements, seconds, "");
+   });
+   return 0;
+}
+
+/*
+ * Function: inChild
+ * Usage: inChild(job);
+ * --------------------
+ * Runs the job in a child process and waits for it to finish.
+ */
+
+template <typename Job>
+static void inChild(Job job) {
+   cout.flush();
+   pid_t pid = fork();
+   if (pid < 0) {
+      perror("fork");
+      exit(1);
+   }
+   if (pid == 0) {
+      job();
+      cout.flush();
+      _exit(0);
+   }
+   int status;
+   waitpid(pid, &status, 0);
+}
+
+/*
+ * Function: report
+ * Usage: report(workload, engine, statements, seconds, checksum);
+ * ---------------------------------------------------------------
+ * Prints one CSV row, reading the peak resident set size of the
+ * calling process.
+ */
+
+static void report(const string & workload, const string & engine,
+                   long long statements, double seconds, const string & checksum) {
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   cout << workload << "," << engine << "," << statements << ","
+        << fixed << setprecision(4) << seconds << ","
+        << setprecision(0) << statements / seconds << ","
+        << setprecision(2) << seconds * 1e9 / statements << ","
+        << usage.ru_maxrss << "," << checksum << endl;
+}
+
+/*
+ * Function: runWorkload
+ * Usage: double seconds = runWorkload(workload, engine, limited, checksum);
+ * -------------------------------------------------------------------------
+ * Loads the workload and runs it once on the named engine, returning
+ * the time the run took and setting checksum to the hash of its output
+ * and final variables.  For the virtual machine the time includes
+ * compiling to bytecode.  Output is block buffered into a stream that
+ * only hashes it.  If limited is true, every limit is set, far above
+ * what the workload uses.
+ */
+
+static double runWorkload(const Workload & workload, const string & engine, bool limited,
+                          unsigned long long & checksum) {
+   Program program;
+   for (const string & line : workload.lines) {
+      addProgramLine(program, line);
+   }
+   HashingBuffer hashingBuffer;
+   ostream hashingStream(&hashingBuffer);
+   EvalState state;
+   state.getOutput().setStream(hashingStream);
+   state.getOutput().setFlushPolicy(BLOCK_BUFFERED);
+   if (limited) {
+      ResourceLimits limits;
+      limits.maxStatements = 1LL << 50;
+      limits.maxSeconds = 1e6;
+      limits.maxVariables = 1LL << 30;
+      limits.maxMemory = 1LL << 40;
+      state.getGovernor().setLimits(limits);
+   }
+   auto start = chrono::steady_clock::now();
+   if (engine == "vm") {
+      runProgram(program, state);
+   } else if (engine == "jit") {
+      runProgramJIT(program, state);
+   } else {
+      runStatements(program, state);
+   }
+   state.getOutput().flush();
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   SymbolTable & symbols = program.getSymbolTable();
+   for (int slot = 0; slot < symbols.size(); slot++) {
+      long long value = 0;
+      if (state.getType(slot) == DOUBLE_TYPE) {
+         double real = state.getDouble(slot);
+         memcpy(&value, &real, sizeof value);
+      } else if (state.isDefined(slot)) {
+         value = state.getValue(slot);
+      }
+      hashingBuffer.addBytes((const char *) &value, sizeof value);
+   }
+   checksum = hashingBuffer.getHash();
+   return elapsed.count();
+}
+
+/*
+ * Function: runLoadList
+ * Usage: long long statements = runLoadList(n, seconds);
+ * ------------------------------------------------------
+ * Writes a program of n lines to a temporary file, then times loading
+ * it with loadProgramFile and listing every line in order, as LIST
+ * does.  Returns the number of lines loaded and listed.
+ */
+
+static long long runLoadList(int n, double & seconds) {
+   char filename[] = "/tmp/basic-suite-XXXXXX";
+   int fd = mkstemp(filename);
+   if (fd < 0) {
+      perror("mkstemp");
+      exit(1);
+   }
+   close(fd);
+   {
+      ofstream file(filename);
+      for (int i = 1; i <= n; i++) {
+         string var = "X" + integerToString(i % 97);
+         file << i * 10 << " LET " << var << " = " << var << " + " << i % 13 << " * 2\n";
+      }
+   }
+   ofstream devNull("/dev/null");
+   Program program;
+   auto start = chrono::steady_clock::now();
+   loadProgramFile(filename, program);
+   for (int lineNumber = program.getFirstLineNumber(); lineNumber != -1;
+        lineNumber = program.getNextLineNumber(lineNumber)) {
+      devNull << program.getSourceLine(lineNumber) << '\n';
+   }
+   devNull.flush();
+   chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+   seconds = elapsed.count();
+   unlink(filename);
+   return 2LL * n;
+}
+
+/*
+ * Workload constructors
+ * ---------------------
+ * Each function below returns the program for one workload together
+ * with the number of statements it executes, which follows from the
+ * shape of its loop.
+ */
+
+static Workload makeLoop(int n) {
+   Workload workload;
+   workload.name = "loop";
+   workload.lines = {
+      "10 LET I = 0",
+      "20 LET I = I + 1",
+      "30 IF I < " + integerToString(n) + " THEN 20",
+   };
+   workload.statements = 1 + 2LL * n;
+   return workload;
+}
+
+static Workload makeExpr(int n) {
+   Workload workload;
+   workload.name = "expr";
+   workload.lines = {
+      "10 LET I = 0",
+      "20 LET A = I * 3 + 7",
+      "30 LET B = (A - I) / 3 + I * 2",
+      "40 LET C = A + B * 2 - (A / 7) + (B - A) * 3",
+      "50 LET D = (C - B) * 3 + A / 5 - (C + 1) / (B + 1)",
+      "60 LET I = I + 1",
+      "70 IF I < " + integerToString(n) + " THEN 20",
+   };
+   workload.statements = 1 + 6LL * n;
+   return workload;
+}
+
+static Workload makePrint(int n) {
+   Workload workload;
+   workload.name = "print";
+   workload.lines = {
+      "10 LET I = 0",
+      "20 LET I = I + 1",
+      "30 PRINT I",
+      "40 IF I < " + integerToString(n) + " THEN 20",
+   };
+   workload.statements = 1 + 3LL * n;
+   return workload;
+}
+
+static Workload makeManyVars(int n, int variables) {
+   Workload workload;
+   workload.name = "many_vars";
+   workload.lines.push_back("10 LET I = 0");
+   workload.lines.push_back("20 LET V1 = I");
+   for (int k = 2; k <= variables; k++) {
+      workload.lines.push_back(integerToString(k * 10 + 10) + " LET V" + integerToString(k)
+                               + " = V" + integerToString(k - 1) + " + " + integerToString(k));
+   }
+   int next = variables * 10 + 20;
+   workload.lines.push_back(integerToString(next) + " LET I = I + 1");
+   workload.lines.push_back(integerToString(next + 10) + " IF I < " + integerToString(n)
+                            + " THEN 20");
+   workload.statements = 1 + (long long) (variables + 2) * n;
+   return workload;
+}
+
+static Workload makeReal(int n) {
+   Workload workload;
+   workload.name = "real";
+   workload.lines = {
+      "10 LET I = 0",
+      "20 LET X = 0.0",
+      "30 LET X = X + 1.0 / (I + 1)",
+      "40 LET Y = X * 0.5 - I * 0.25",
+      "50 LET I = I + 1",
+      "60 IF I < " + integerToString(n) + " THEN 30",
+   };
+   workload.statements = 2 + 4LL * n;
+   return workload;
+}
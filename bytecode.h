@@ -0,0 +1,255 @@
+/*
+ * File: bytecode.h
+ * ----------------
+ * This interface defines the instruction format shared by the bytecode
+ * compiler and the virtual machine.  A compiled program is a single
+ * contiguous array of integers in which each instruction is an opcode
+ * followed by its operands, if any.  Jump operands are indices into
+ * that same array, so no line number lookups remain at run time.
+ *
+ * The compiler knows the type of every expression, so each instruction
+ * works on values of one type, and values on the evaluation stack carry
+ * no tag.  The plain instructions work on integers; those whose names
+ * end in DOUBLE work on doubles, and explicit conversions sit where an
+ * expression of one type is used as the other.
+ */
+
+#ifndef _bytecode_h
+#define _bytecode_h
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*
+ * Type: OpCode
+ * ------------
+ * This enumerated type lists the instructions understood by the virtual
+ * machine.  The comment after each opcode shows its operands and its
+ * effect on the evaluation stack.
+ */
+
+enum OpCode {
+   OP_HALT,             /*                Stops the program                        */
+   OP_PUSH,             /* k              Pushes the constant k                    */
+   OP_LOAD,             /* v              Pushes the value of variable v           */
+   OP_STORE,            /* v              Pops a value into variable v             */
+   OP_ASSIGN,           /* v              Stores the top value into v, keeps it    */
+   OP_POP,              /*                Discards the top value                   */
+   OP_ADD,              /*                Replaces a, b with a + b                 */
+   OP_SUB,              /*                Replaces a, b with a - b                 */
+   OP_MUL,              /*                Replaces a, b with a * b                 */
+   OP_DIV,              /*                Replaces a, b with a / b                 */
+   OP_SHL,              /* k              Replaces a with a * 2^k                  */
+   OP_SHR,              /* k              Replaces a with a / 2^k                  */
+   OP_PRINT,            /*                Pops a value and prints it               */
+   OP_INPUT,            /* v              Reads an integer into variable v         */
+   OP_JUMP,             /* addr           Continues at addr                        */
+   OP_JUMP_EQ,          /* addr           Pops a, b; continues at addr if a = b    */
+   OP_JUMP_GT,          /* addr           Pops a, b; continues at addr if a > b    */
+   OP_JUMP_LT,          /* addr           Pops a, b; continues at addr if a < b    */
+   OP_JUMP_NE,          /* addr           Pops a, b; continues at addr if a <> b   */
+   OP_JUMP_LE,          /* addr           Pops a, b; continues at addr if a <= b   */
+   OP_JUMP_GE,          /* addr           Pops a, b; continues at addr if a >= b   */
+   OP_ERROR,            /* m              Reports error message m                  */
+
+/* Instructions for 64-bit constants and doubles; r is a Relation */
+
+   OP_PUSH_WIDE,        /* lo hi          Pushes the integer with these halves     */
+   OP_PUSH_DOUBLE,      /* lo hi          Pushes the double with these halves      */
+   OP_LOAD_DOUBLE,      /* v              Pushes variable v as a double            */
+   OP_STORE_DOUBLE,     /* v              Pops a double into variable v            */
+   OP_ASSIGN_DOUBLE,    /* v              Stores the top double into v, keeps it   */
+   OP_ADD_DOUBLE,       /*                Replaces doubles a, b with a + b         */
+   OP_SUB_DOUBLE,       /*                Replaces doubles a, b with a - b         */
+   OP_MUL_DOUBLE,       /*                Replaces doubles a, b with a * b         */
+   OP_DIV_DOUBLE,       /*                Replaces doubles a, b with a / b         */
+   OP_TO_DOUBLE,        /*                Converts the top integer to a double     */
+   OP_TO_INTEGER,       /*                Converts the top double to an integer    */
+   OP_PRINT_DOUBLE,     /*                Pops a double and prints it              */
+   OP_INPUT_DOUBLE,     /* v              Reads a double into variable v           */
+   OP_JUMP_DOUBLE,      /* r addr         Pops doubles a, b; jumps if a r b        */
+
+/* Array instructions; a is an array slot and r the number of subscripts */
+
+   OP_DIM,              /* a r            Pops r extents and dimensions a          */
+   OP_LOAD_ELEMENT,     /* a r            Pops r subscripts, pushes the element    */
+   OP_STORE_ELEMENT,    /* a r            Pops a value and r subscripts, stores it */
+   OP_SUM,              /* a              Pushes the sum of the elements of a      */
+   OP_MAT,              /* m t a b        Performs MatOperation m, popping its     */
+                        /*                scalar if it has one; unused slots are -1 */
+
+/* Superinstructions; r is a Relation */
+
+   OP_ADD_TO,           /* v k            Adds k to variable v                     */
+   OP_MUL_TO,           /* v k            Multiplies variable v by k               */
+   OP_JUMP_CONST,       /* r k addr       Pops a; continues at addr if a r k       */
+   OP_JUMP_VAR_CONST,   /* v r k addr     Continues at addr if v r k               */
+   OP_INC_JUMP_CONST,   /* v k r n addr   Adds k to v; continues at addr if v r n  */
+   OP_INC_JUMP_VAR      /* v k r w addr   Adds k to v; continues at addr if v r w  */
+};
+
+/*
+ * Function: instructionLength
+ * Usage: int length = instructionLength(op);
+ * ------------------------------------------
+ * Returns the number of words occupied by an instruction with the
+ * specified opcode, including the opcode itself.
+ */
+
+inline int instructionLength(int op) {
+   switch (op) {
+    case OP_PUSH: case OP_LOAD: case OP_STORE: case OP_ASSIGN: case OP_SHL:
+    case OP_SHR: case OP_INPUT: case OP_JUMP: case OP_JUMP_EQ: case OP_JUMP_GT:
+    case OP_JUMP_LT: case OP_JUMP_NE: case OP_JUMP_LE: case OP_JUMP_GE: case OP_ERROR:
+    case OP_SUM: case OP_LOAD_DOUBLE: case OP_STORE_DOUBLE: case OP_ASSIGN_DOUBLE:
+    case OP_INPUT_DOUBLE:
+      return 2;
+    case OP_ADD_TO: case OP_MUL_TO: case OP_DIM: case OP_LOAD_ELEMENT: case OP_STORE_ELEMENT:
+    case OP_PUSH_WIDE: case OP_PUSH_DOUBLE: case OP_JUMP_DOUBLE:
+      return 3;
+    case OP_JUMP_CONST:
+      return 4;
+    case OP_MAT:
+      return 5;
+    case OP_JUMP_VAR_CONST:
+      return 5;
+    case OP_INC_JUMP_CONST: case OP_INC_JUMP_VAR:
+      return 6;
+    default:
+      return 1;
+   }
+}
+
+/*
+ * Function: jumpTargetIndex
+ * Usage: int index = jumpTargetIndex(op);
+ * ---------------------------------------
+ * Returns the position of the target address within a jump
+ * instruction, which is always its last word, or 0 if the opcode is
+ * not a jump.
+ */
+
+inline int jumpTargetIndex(int op) {
+   switch (op) {
+    case OP_JUMP: case OP_JUMP_EQ: case OP_JUMP_GT: case OP_JUMP_LT:
+    case OP_JUMP_NE: case OP_JUMP_LE: case OP_JUMP_GE: case OP_JUMP_CONST:
+    case OP_JUMP_VAR_CONST: case OP_INC_JUMP_CONST: case OP_INC_JUMP_VAR: case OP_JUMP_DOUBLE:
+      return instructionLength(op) - 1;
+    default:
+      return 0;
+   }
+}
+
+/*
+ * Functions: wideOperand, doubleOperand
+ * Usage: long long value = wideOperand(pc + 1);
+ *        double value = doubleOperand(pc + 1);
+ * -------------------------------------------
+ * These functions return the 64-bit operand of OP_PUSH_WIDE or
+ * OP_PUSH_DOUBLE, which occupies the two words at the specified
+ * address, low half first.
+ */
+
+inline long long wideOperand(const int *operand) {
+   return (long long) (((unsigned long long) (unsigned) operand[1] << 32) | (unsigned) operand[0]);
+}
+
+inline double doubleOperand(const int *operand) {
+   long long bits = wideOperand(operand);
+   double value;
+   std::memcpy(&value, &bits, sizeof value);
+   return value;
+}
+
+/*
+ * Type: Idiom
+ * -----------
+ * This enumerated type lists the statement patterns that the compiler
+ * replaces with superinstructions:
+ *
+ *    INCREMENT_AND_BRANCH   LET I = I + k followed by IF I r n THEN,
+ *                           where n is a constant or variable
+ *    UPDATE_WITH_CONSTANT   LET X = X + k, X - k or X * k
+ *    COMPARE_WITH_CONSTANT  IF e r k THEN
+ *
+ * The increment is fused with the IF on the next line only when no
+ * jump leads to that line.
+ */
+
+enum Idiom {
+   INCREMENT_AND_BRANCH, UPDATE_WITH_CONSTANT, COMPARE_WITH_CONSTANT, IDIOM_COUNT
+};
+
+/*
+ * Function: idiomToString
+ * Usage: string str = idiomToString(idiom);
+ * -----------------------------------------
+ * Returns a description of the idiom for reports.
+ */
+
+std::string idiomToString(Idiom idiom);
+
+/*
+ * Type: Bytecode
+ * --------------
+ * This structure holds a compiled program.  The code array contains
+ * the instructions, whose variable operands are symbol table slots;
+ * the names array records the name of each slot for error messages
+ * and tells the machine how many slots to reserve; the messages array holds
+ * the text of errors that the compiler could only report at run time.
+ * The maxStack field is the deepest the evaluation stack can grow, and
+ * fusedCounts records how many times the compiler fused each idiom.
+ *
+ * The backEdgeCosts array runs parallel to the code.  At the address of
+ * each jump to an earlier address it holds the number of statements
+ * from the target through the statement that jumps, which is what one
+ * pass around that loop costs the governor; it is 0 everywhere else.
+ * The count is exact for a pass that takes no forward jump and never
+ * falls short.  It is empty when an incremental update has moved lines
+ * out of order, since jumps then no longer follow the program's loops.
+ *
+ * The lineNumbers and lineAddresses arrays run parallel to each other.
+ * They hold, in increasing order, each line whose code begins a block
+ * and the address at which it begins, which is every line apart from
+ * an IF fused into the line before it.  Like backEdgeCosts, they are
+ * filled in only by a full compilation.
+ */
+
+struct Bytecode {
+   std::vector<int> code;
+   std::vector<std::string> names;
+   std::vector<std::string> messages;
+   std::vector<int> backEdgeCosts;
+   std::vector<int> lineNumbers;
+   std::vector<int> lineAddresses;
+   int maxStack;
+   int fusedCounts[IDIOM_COUNT];
+};
+
+/*
+ * Functions: findLineAddress, findLineNumber
+ * Usage: int address = findLineAddress(bytecode, lineNumber);
+ *        int lineNumber = findLineNumber(bytecode, address);
+ * ----------------------------------------------------------
+ * These functions look up the line tables of a full compilation in
+ * either direction.  Each returns -1 if the line has no block of its
+ * own or no line begins at the address.
+ */
+
+inline int findLineAddress(const Bytecode & bytecode, int lineNumber) {
+   const std::vector<int> & lines = bytecode.lineNumbers;
+   auto found = std::lower_bound(lines.begin(), lines.end(), lineNumber);
+   if (found == lines.end() || *found != lineNumber) return -1;
+   return bytecode.lineAddresses[found - lines.begin()];
+}
+
+inline int findLineNumber(const Bytecode & bytecode, int address) {
+   const std::vector<int> & addresses = bytecode.lineAddresses;
+   auto found = std::lower_bound(addresses.begin(), addresses.end(), address);
+   if (found == addresses.end() || *found != address) return -1;
+   return bytecode.lineNumbers[found - addresses.begin()];
+}
+
+#endif
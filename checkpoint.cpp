@@ -0,0 +1,428 @@
+/*
+ * File: checkpoint.cpp
+ * --------------------
+ * This file implements checkpoints.
+ */
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "array.h"
+#include "checkpoint.h"
+#include "error.h"
+#include "evalstate.h"
+#include "mappedfile.h"
+#include "program.h"
+#include "strlib.h"
+#include "symtab.h"
+using namespace std;
+
+/* Constants */
+
+static const char CHECKPOINT_SIGNATURE[8] = { 'B', 'A', 'S', 'I', 'C', 'C', 'K', 'P' };
+
+/*
+ * Implementation notes: checkpoint format
+ * ---------------------------------------
+ * A checkpoint is a header followed by four sections, each starting
+ * at an offset that is a multiple of eight:
+ *
+ *    slots      a CheckpointSlot for each variable slot of the state
+ *    names      the characters of every slot's name, back to back
+ *    output     the output held in the buffer
+ *    elements   the elements of every dimensioned array, in slot order
+ *
+ * The elements come last, so that everything before them can be built
+ * in memory before the process forks and the child only has to write
+ * that block and then the arrays straight from its copy of the heap.
+ * The checksum is an FNV-1a hash of everything after the header taken
+ * eight bytes at a time, as for program images, and the fingerprint
+ * is an FNV-1a hash of the number and text of every program line.
+ */
+
+struct CheckpointHeader {
+   char signature[8];
+   uint32_t version;
+   uint32_t headerSize;
+   uint64_t fileSize;
+   uint64_t checksum;
+   uint64_t fingerprint;
+   int32_t lineNumber;
+   uint32_t slotCount;
+   uint64_t slotsOffset;
+   uint64_t namesOffset;
+   uint64_t namesSize;
+   uint64_t outputOffset;
+   uint64_t outputSize;
+   uint64_t elementsOffset;
+   uint64_t elementCount;
+};
+
+/*
+ * Type: CheckpointSlot
+ * --------------------
+ * This structure stores one slot of the state: the value of the
+ * variable in it and the shape of the array in it.  The type holds
+ * the ValueType of the variable, and the value the bits of its value.
+ * An array that was never dimensioned has a rank of 0, and the
+ * elements of one that was start at the element index given, counting
+ * in elements from the start of the elements section.
+ */
+
+struct CheckpointSlot {
+   uint64_t nameOffset;
+   uint32_t nameLength;
+   int32_t type;
+   int64_t value;
+   int32_t rank;
+   int32_t rows;
+   int32_t columns;
+   int32_t reserved;
+   uint64_t elementIndex;
+};
+
+/*
+ * Type: ElementBlock
+ * ------------------
+ * This structure records the elements of one array that a checkpoint
+ * writes after its prefix.
+ */
+
+struct ElementBlock {
+   const char *data;
+   size_t size;
+};
+
+/* Private function prototypes */
+
+static uint64_t fingerprintProgram(Program & program);
+static bool writeCheckpoint(const char *filename, const char *temporary, string & prefix,
+                            const vector<ElementBlock> & blocks);
+static bool writeAll(int fd, const char *data, size_t size);
+static uint64_t checksumWords(uint64_t hash, const char *data, size_t size);
+static uint64_t alignSection(uint64_t offset);
+
+Checkpointer::Checkpointer() {
+   fingerprint = 0;
+   writer = 0;
+   failed = false;
+   savedCount = 0;
+   skippedCount = 0;
+}
+
+Checkpointer::~Checkpointer() {
+   reap(true);
+}
+
+void Checkpointer::setFilename(const string & filename) {
+   this->filename = filename;
+}
+
+string Checkpointer::getFilename() {
+   return filename;
+}
+
+void Checkpointer::prepare(Program & program) {
+   if (filename == "") return;
+   fingerprint = fingerprintProgram(program);
+   SymbolTable & symbols = program.getSymbolTable();
+   names.clear();
+   for (int slot = 0; slot < symbols.size(); slot++) {
+      names.push_back(symbols.getName(slot));
+   }
+}
+
+/*
+ * Implementation notes: save
+ * --------------------------
+ * Everything but the array elements is copied into the prefix, which
+ * costs time proportional to the number of slots.  The child uses only
+ * system calls that are safe after a fork, so a checkpoint can be
+ * taken even when other threads are running, and it leaves with _exit
+ * so that it never flushes the parent's buffers.
+ */
+
+void Checkpointer::save(EvalState & state, int lineNumber) {
+   state.getGovernor().clearCheckpoint();
+   if (filename == "") return;
+   if (!reap(false)) {
+      skippedCount++;
+      return;
+   }
+   if (failed) {
+      failed = false;
+      error("Cannot write checkpoint " + filename);
+   }
+   int slotCount = state.getSlotCount();
+   if (slotCount > (int) names.size()) slotCount = names.size();
+   EvalState::Binding *bindings = state.getBindings();
+   vector<CheckpointSlot> slots(slotCount);
+   vector<ElementBlock> blocks;
+   string nameText;
+   uint64_t elementCount = 0;
+   for (int slot = 0; slot < slotCount; slot++) {
+      CheckpointSlot & record = slots[slot];
+      memset(&record, 0, sizeof record);
+      record.nameOffset = nameText.size();
+      record.nameLength = names[slot].size();
+      nameText += names[slot];
+      record.type = bindings[slot].type;
+      memcpy(&record.value, &bindings[slot].value, sizeof record.value);
+      Array & array = state.getArray(slot);
+      record.rank = array.getRank();
+      if (record.rank != 0) {
+         record.rows = array.getRows();
+         record.columns = array.getColumns();
+         record.elementIndex = elementCount;
+         elementCount += array.getSize();
+         ElementBlock block = { (const char *) array.getElements(),
+                                (size_t) array.getSize() * sizeof(long long) };
+         blocks.push_back(block);
+      }
+   }
+   string output = state.getOutput().getPending();
+   CheckpointHeader header;
+   memset(&header, 0, sizeof header);
+   memcpy(header.signature, CHECKPOINT_SIGNATURE, sizeof header.signature);
+   header.version = CHECKPOINT_VERSION;
+   header.headerSize = sizeof header;
+   header.fingerprint = fingerprint;
+   header.lineNumber = lineNumber;
+   header.slotCount = slotCount;
+   header.slotsOffset = alignSection(sizeof header);
+   header.namesOffset = alignSection(header.slotsOffset + slots.size() * sizeof(CheckpointSlot));
+   header.namesSize = nameText.size();
+   header.outputOffset = alignSection(header.namesOffset + nameText.size());
+   header.outputSize = output.size();
+   header.elementsOffset = alignSection(header.outputOffset + output.size());
+   header.elementCount = elementCount;
+   header.fileSize = header.elementsOffset + elementCount * sizeof(long long);
+   string prefix(header.elementsOffset, '\0');
+   memcpy(&prefix[0], &header, sizeof header);
+   memcpy(&prefix[header.slotsOffset], slots.data(), slots.size() * sizeof(CheckpointSlot));
+   memcpy(&prefix[header.namesOffset], nameText.data(), nameText.size());
+   memcpy(&prefix[header.outputOffset], output.data(), output.size());
+   string temporary = filename + ".tmp" + integerToString(getpid());
+   savedCount++;
+   pid_t child = fork();
+   if (child == 0) {
+      _exit(writeCheckpoint(filename.c_str(), temporary.c_str(), prefix, blocks) ? 0 : 1);
+   } else if (child > 0) {
+      writer = child;
+   } else if (!writeCheckpoint(filename.c_str(), temporary.c_str(), prefix, blocks)) {
+      error("Cannot write checkpoint " + filename);
+   }
+}
+
+void Checkpointer::wait() {
+   reap(true);
+   if (failed) {
+      failed = false;
+      error("Cannot write checkpoint " + filename);
+   }
+}
+
+int Checkpointer::getSavedCount() {
+   return savedCount;
+}
+
+int Checkpointer::getSkippedCount() {
+   return skippedCount;
+}
+
+/*
+ * Implementation notes: reap
+ * --------------------------
+ * Collects the child writing the last checkpoint, waiting for it if
+ * block is true, and returns false if it is still running.  A child
+ * that failed sets the failed flag, which the callers that may throw
+ * report; the destructor only waits.
+ */
+
+bool Checkpointer::reap(bool block) {
+   if (writer == 0) return true;
+   int status;
+   pid_t result;
+   do {
+      result = waitpid(writer, &status, block ? 0 : WNOHANG);
+   } while (result < 0 && errno == EINTR);
+   if (result == 0) return false;
+   writer = 0;
+   if (result > 0 && (!WIFEXITED(status) || WEXITSTATUS(status) != 0)) failed = true;
+   return true;
+}
+
+/*
+ * Implementation notes: restoreCheckpoint
+ * ---------------------------------------
+ * Every record is checked before anything is restored, so that a
+ * damaged file leaves the state as it was.  Names are interned in the
+ * program's symbol table, which already holds them if the fingerprint
+ * matches, but may number them differently from the program that
+ * wrote the file if its lines were entered in another order.
+ */
+
+int restoreCheckpoint(const string & filename, Program & program, EvalState & state) {
+   MappedFile file(filename);
+   const char *data = file.getData();
+   size_t size = file.getSize();
+   string damaged = filename + " is truncated or damaged";
+   if (size < sizeof(CheckpointHeader)
+       || memcmp(data, CHECKPOINT_SIGNATURE, sizeof CHECKPOINT_SIGNATURE) != 0) {
+      error(filename + " is not a checkpoint");
+   }
+   const CheckpointHeader *header = (const CheckpointHeader *) data;
+   if (header->version != (uint32_t) CHECKPOINT_VERSION) {
+      error(filename + " is a checkpoint of version " + integerToString(header->version)
+            + ", but this interpreter reads version " + integerToString(CHECKPOINT_VERSION));
+   }
+   if (header->headerSize != sizeof(CheckpointHeader) || header->fileSize != size
+       || size % 8 != 0) {
+      error(damaged);
+   }
+   if (checksumWords(14695981039346656037ULL, data + sizeof(CheckpointHeader),
+                     size - sizeof(CheckpointHeader)) != header->checksum) {
+      error(filename + " fails its checksum");
+   }
+   if (header->fingerprint != fingerprintProgram(program)) {
+      error(filename + " was written by a different program");
+   }
+   auto inside = [&](uint64_t offset, uint64_t count, size_t width) {
+      return offset % 8 == 0 && offset >= sizeof(CheckpointHeader) && offset <= size
+          && count <= (size - offset) / width;
+   };
+   if (!inside(header->slotsOffset, header->slotCount, sizeof(CheckpointSlot))
+       || !inside(header->namesOffset, header->namesSize, 1)
+       || !inside(header->outputOffset, header->outputSize, 1)
+       || !inside(header->elementsOffset, header->elementCount, sizeof(long long))) {
+      error(damaged);
+   }
+   const CheckpointSlot *slots = (const CheckpointSlot *) (data + header->slotsOffset);
+   const char *names = data + header->namesOffset;
+   const long long *elements = (const long long *) (data + header->elementsOffset);
+   for (uint32_t i = 0; i < header->slotCount; i++) {
+      const CheckpointSlot & record = slots[i];
+      if (record.nameOffset > header->namesSize
+          || record.nameLength > header->namesSize - record.nameOffset
+          || record.type < UNDEFINED_TYPE || record.type > DOUBLE_TYPE
+          || record.rank < 0 || record.rank > 2) {
+         error(damaged);
+      }
+      if (record.rank != 0) {
+         uint64_t count = (uint64_t) record.rows * record.columns;
+         if (record.rows < 1 || record.columns < 1 || (record.rank == 1 && record.columns != 1)
+             || record.elementIndex > header->elementCount
+             || count > header->elementCount - record.elementIndex) {
+            error(damaged);
+         }
+      }
+   }
+   SymbolTable & symbols = program.getSymbolTable();
+   for (uint32_t i = 0; i < header->slotCount; i++) {
+      const CheckpointSlot & record = slots[i];
+      string name(names + record.nameOffset, record.nameLength);
+      int slot = symbols.intern(name);
+      if (record.type == INTEGER_TYPE) {
+         state.setValue(slot, record.value);
+      } else if (record.type == DOUBLE_TYPE) {
+         double value;
+         memcpy(&value, &record.value, sizeof value);
+         state.setDouble(slot, value);
+      }
+      if (record.rank != 0) {
+         state.dimensionArray(slot, name, record.rank, record.rows, record.columns);
+         memcpy(state.getArray(slot).getElements(), elements + record.elementIndex,
+                (size_t) record.rows * record.columns * sizeof(long long));
+      }
+   }
+   state.getOutput().printText(string(data + header->outputOffset, header->outputSize));
+   return header->lineNumber;
+}
+
+/*
+ * Implementation notes: fingerprintProgram
+ * ----------------------------------------
+ * The text of a line begins with its number, so hashing the text
+ * alone would do, but each line is followed by a newline so that two
+ * lines cannot run together into one.
+ */
+
+static uint64_t fingerprintProgram(Program & program) {
+   uint64_t hash = 14695981039346656037ULL;
+   for (int lineNumber = program.getFirstLineNumber(); lineNumber != -1;
+        lineNumber = program.getNextLineNumber(lineNumber)) {
+      string text = program.getSourceLine(lineNumber) + "\n";
+      for (char ch : text) {
+         hash = (hash ^ (unsigned char) ch) * 1099511628211ULL;
+      }
+   }
+   return hash;
+}
+
+/*
+ * Implementation notes: writeCheckpoint
+ * -------------------------------------
+ * The checksum is computed first and stored in the prefix, so that the
+ * file is written front to back in as few calls as there are arrays.
+ * Since this runs in the child after a fork, it must not allocate.
+ */
+
+static bool writeCheckpoint(const char *filename, const char *temporary, string & prefix,
+                            const vector<ElementBlock> & blocks) {
+   CheckpointHeader *header = (CheckpointHeader *) &prefix[0];
+   uint64_t hash = checksumWords(14695981039346656037ULL, prefix.data() + sizeof *header,
+                                 prefix.size() - sizeof *header);
+   for (const ElementBlock & block : blocks) {
+      hash = checksumWords(hash, block.data, block.size);
+   }
+   header->checksum = hash;
+   int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0) return false;
+   bool ok = writeAll(fd, prefix.data(), prefix.size());
+   for (const ElementBlock & block : blocks) {
+      ok = ok && writeAll(fd, block.data, block.size);
+   }
+   ok = ok && fsync(fd) == 0;
+   ok = (close(fd) == 0) && ok;
+   if (!ok || rename(temporary, filename) != 0) {
+      unlink(temporary);
+      return false;
+   }
+   return true;
+}
+
+static bool writeAll(int fd, const char *data, size_t size) {
+   while (size > 0) {
+      ssize_t count = write(fd, data, size);
+      if (count < 0 && errno == EINTR) continue;
+      if (count <= 0) return false;
+      data += count;
+      size -= count;
+   }
+   return true;
+}
+
+/*
+ * Implementation notes: checksumWords
+ * -----------------------------------
+ * The hash is passed in so that a checksum can be carried across the
+ * separate blocks of a file.  Each size must be a multiple of eight.
+ */
+
+static uint64_t checksumWords(uint64_t hash, const char *data, size_t size) {
+   for (size_t i = 0; i < size; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, sizeof word);
+      hash = (hash ^ word) * 1099511628211ULL;
+   }
+   return hash;
+}
+
+static uint64_t alignSection(uint64_t offset) {
+   return (offset + 7) & ~(uint64_t) 7;
+}
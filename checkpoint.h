@@ -0,0 +1,167 @@
+/*
+ * File: checkpoint.h
+ * ------------------
+ * This interface exports the checkpoints behind CHECKPOINT and RESUME:
+ * a class that saves the state of a running program to a file at
+ * intervals, and a function that restores a state from that file so
+ * that the program can continue where the checkpoint was taken.
+ */
+
+#ifndef _checkpoint_h
+#define _checkpoint_h
+
+#include <sys/types.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class EvalState;
+class Program;
+
+/* Constants */
+
+const int CHECKPOINT_VERSION = 1;
+const long long DEFAULT_CHECKPOINT_INTERVAL = 100000000;
+
+/*
+ * Class: Checkpointer
+ * -------------------
+ * This class writes checkpoints for an EvalState.  A checkpoint holds
+ * the line at which the program is to continue, the value of every
+ * variable, the elements of every array and the output that has been
+ * printed but is still held in the buffer, together with a fingerprint
+ * of the program's text, so that it is never restored into a program
+ * other than the one that wrote it.
+ *
+ * The governor decides when a checkpoint is due, once every interval
+ * of statements, and the engines take it when they next jump backward,
+ * before the line they jump to begins.  The program counter is then
+ * just that line number, since nothing else is in flight: the machine's
+ * stack is empty at every jump and native code has written its
+ * registers back.
+ *
+ * Taking a checkpoint does not wait for the file.  The small records
+ * are copied at once, and the process then forks: the child writes the
+ * file from its copy-on-write image of the parent, including arrays of
+ * any size, while the parent runs on.  The child writes under a
+ * temporary name, syncs the file and renames it into place, so the
+ * file on disk is always a complete checkpoint.  If the previous child
+ * is still writing when the next checkpoint is due, that checkpoint is
+ * skipped.  Only if fork fails is the file written before the run
+ * continues.
+ */
+
+class Checkpointer {
+
+public:
+
+/*
+ * Constructor: Checkpointer
+ * Usage: Checkpointer checkpointer;
+ * ---------------------------------
+ * Creates a checkpointer with no file, which takes no checkpoints.
+ */
+
+   Checkpointer();
+
+/*
+ * Destructor: ~Checkpointer
+ * Usage: usually implicit
+ * -----------------------
+ * Waits for a checkpoint that is still being written.
+ */
+
+   ~Checkpointer();
+
+/*
+ * Methods: setFilename, getFilename
+ * Usage: checkpointer.setFilename(filename);
+ *        string filename = checkpointer.getFilename();
+ * ----------------------------------------------------
+ * These methods set and return the file that receives checkpoints.
+ * An empty name turns them off.  The interval between them is set on
+ * the governor of the state.
+ */
+
+   void setFilename(const std::string & filename);
+   std::string getFilename();
+
+/*
+ * Method: prepare
+ * Usage: checkpointer.prepare(program);
+ * -------------------------------------
+ * Records the fingerprint and the variable names of the program about
+ * to run, which every checkpoint of the run stores.  Every function
+ * that runs a program under checkpoints calls this first.
+ */
+
+   void prepare(Program & program);
+
+/*
+ * Method: save
+ * Usage: checkpointer.save(state, lineNumber);
+ * --------------------------------------------
+ * Takes a checkpoint of the state, from which the program resumes at
+ * the specified line, and tells the state's governor that it has been
+ * taken.  A previous checkpoint that could not be written is reported
+ * here by calling error.
+ */
+
+   void save(EvalState & state, int lineNumber);
+
+/*
+ * Method: wait
+ * Usage: checkpointer.wait();
+ * ---------------------------
+ * Waits until the last checkpoint has reached its file, calling error
+ * if it could not be written.
+ */
+
+   void wait();
+
+/*
+ * Methods: getSavedCount, getSkippedCount
+ * Usage: int count = checkpointer.getSavedCount();
+ * ------------------------------------------------
+ * These methods return the number of checkpoints taken and skipped
+ * since the checkpointer was created.
+ */
+
+   int getSavedCount();
+   int getSkippedCount();
+
+private:
+
+   std::string filename;
+   uint64_t fingerprint;
+   std::vector<std::string> names;
+   pid_t writer;             /* The child writing a checkpoint, or 0 */
+   bool failed;              /* True if the last child could not write */
+   int savedCount;
+   int skippedCount;
+
+   bool reap(bool block);
+
+/* Checkpointers cannot be copied, since the copies would share one writer */
+
+   Checkpointer(const Checkpointer & src) = delete;
+   Checkpointer & operator=(const Checkpointer & src) = delete;
+
+};
+
+/*
+ * Function: restoreCheckpoint
+ * Usage: int lineNumber = restoreCheckpoint(filename, program, state);
+ * --------------------------------------------------------------------
+ * Reads the named checkpoint, which must have been written by the same
+ * program, into the state and returns the line at which the program
+ * resumes.  Variables and arrays take the values they had, and the
+ * output that was held in the buffer is printed again.  Variables that
+ * were undefined when the checkpoint was taken are left alone.  A file
+ * that is not a checkpoint, is damaged or belongs to another program is
+ * reported by calling error before the state is changed.
+ */
+
+int restoreCheckpoint(const std::string & filename, Program & program, EvalState & state);
+
+#endif
@@ -0,0 +1,828 @@
+/*
+ * File: compiler.cpp
+ * ------------------
+ * This file implements the bytecode compiler.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "bytecode.h"
+#include "compiler.h"
+#include "exp.h"
+#include "hashmap.h"
+#include "program.h"
+#include "statement.h"
+#include "strlib.h"
+#include "value.h"
+using namespace std;
+
+/*
+ * Function: relationToJump
+ * Usage: OpCode op = relationToJump(relation);
+ * --------------------------------------------
+ * Returns the conditional jump that tests the relation.  IfStmt never
+ * holds ILLEGAL_REL, since the parser rejects unknown relations.
+ */
+
+static OpCode relationToJump(Relation relation) {
+   switch (relation) {
+    case EQ_REL: return OP_JUMP_EQ;
+    case NE_REL: return OP_JUMP_NE;
+    case LT_REL: return OP_JUMP_LT;
+    case LE_REL: return OP_JUMP_LE;
+    case GT_REL: return OP_JUMP_GT;
+    default: return OP_JUMP_GE;
+   }
+}
+
+/*
+ * Function: fitsInWord
+ * Usage: if (fitsInWord(value)) . . .
+ * -----------------------------------
+ * Returns true if the integer can be an operand of a single word.
+ */
+
+static bool fitsInWord(long long value) {
+   return value >= INT_MIN && value <= INT_MAX;
+}
+
+/*
+ * Function: isSmallConstant
+ * Usage: if (isSmallConstant(exp)) . . .
+ * --------------------------------------
+ * Returns true if the expression is an integer constant that fits in
+ * a single word, as the constant operand of a superinstruction must.
+ */
+
+static bool isSmallConstant(Expression *exp) {
+   return exp->getType() == CONSTANT && fitsInWord(((ConstantExp *) exp)->getValue());
+}
+
+string idiomToString(Idiom idiom) {
+   switch (idiom) {
+    case INCREMENT_AND_BRANCH: return "Increment, compare and branch";
+    case UPDATE_WITH_CONSTANT: return "Update with constant";
+    case COMPARE_WITH_CONSTANT: return "Compare with constant";
+    default: return "Unknown idiom";
+   }
+}
+
+/*
+ * Implementation notes: ProgramCompiler
+ * -------------------------------------
+ * The compiler makes a single pass over the linked program, after
+ * noting which lines are jump targets.  The code starts with a jump to
+ * the first line, and the code of each line forms a block of at least
+ * two words, so that any line can later be replaced by a jump to new
+ * code.  Jumps are emitted with a placeholder operand and recorded in
+ * the references table under the line they refer to, together with
+ * the block that holds them; once every line has an address, the
+ * placeholders are patched.  Linking has already verified that every
+ * target exists.  The depth field tracks the height of the evaluation
+ * stack so that the virtual machine can allocate it once.
+ *
+ * The blocks of a full compilation lie in line order, and the spans
+ * table records the statements each one holds, numbering the lines
+ * from 0, so that the cost of every backward jump can be found once
+ * the addresses are known.  The line tables of the bytecode are
+ * filled in at the same time.
+ *
+ * The layout table records where the code for each line begins.  A
+ * line whose IF was fused into the line before has no code of its own
+ * and an address of -1.  The update method uses both tables to compile
+ * only the lines affected by a set of edits, as described for
+ * IncrementalCompiler.  A block that has been overwritten is marked
+ * dead, and references from dead blocks are ignored and dropped when
+ * next seen.
+ */
+
+class ProgramCompiler {
+
+public:
+
+   ProgramCompiler(Bytecode & bytecode);
+   void compile(Program & program);
+   void update(Program & program, const vector<int> & edits, int start);
+   bool needsFullCompile(int editCount, int lineCount);
+
+private:
+
+   struct LineCode {
+      int address;
+      int size;
+      int block;
+      int fusedWith; //line whose IF is fused into this one, or -1
+      int fusedInto; //line this IF is fused into, or -1
+   };
+
+   struct Reference {
+      int operandIndex;
+      int block;
+   };
+
+   struct Span {
+      int address;
+      int first;
+      int last;
+   };
+
+   void compileStatement(Program::SourceLine *line);
+   bool compileIncrementAndBranch(Program::SourceLine *line);
+   void compileExp(Expression *exp);
+   void compileExpAs(Expression *exp, ValueType type);
+   void compileSubscripts(ElementExp *element);
+   bool matchUpdate(Statement *stmt, Operator & op, int & k);
+   void emit(int word);
+   void emitWide(long long value);
+   void emitJump(OpCode op, Program::SourceLine *target);
+   void emitJumpTarget(Program::SourceLine *target);
+   void emitError(string message);
+   void adjustDepth(int delta);
+   int startBlock();
+   void finishBlock(int lineNumber, int address);
+   void patchReferences(int lineNumber);
+   void writeStub(const LineCode & old, int lineNumber);
+   void addNames(Program & program);
+   void computeBackEdgeCosts(const std::vector<Span> & spans);
+
+   Bytecode & bytecode;
+   std::unordered_map<int,LineCode> layout;
+   std::unordered_map<int, std::vector<Reference> > references;
+   std::vector<bool> liveBlocks;
+   HashMap<int,bool> jumpTargets;
+   int currentBlock;
+   int garbage;
+   int depth;
+
+};
+
+ProgramCompiler::ProgramCompiler(Bytecode & bytecode) : bytecode(bytecode) {
+   currentBlock = -1;
+   garbage = 0;
+   depth = 0;
+}
+
+void ProgramCompiler::compile(Program & program) {
+   Program::SourceLine *first = program.link();
+   bytecode.code.clear();
+   bytecode.names.clear();
+   bytecode.messages.clear();
+   bytecode.backEdgeCosts.clear();
+   bytecode.lineNumbers.clear();
+   bytecode.lineAddresses.clear();
+   bytecode.maxStack = 0;
+   for (int i = 0; i < IDIOM_COUNT; i++) {
+      bytecode.fusedCounts[i] = 0;
+   }
+   layout.clear();
+   references.clear();
+   liveBlocks.clear();
+   jumpTargets.clear();
+   garbage = 0;
+   if (first == NULL) {
+      emit(OP_HALT);
+      return;
+   }
+   for (Program::SourceLine *line = first; line != NULL; line = line->next) {
+      if (line->target != NULL) jumpTargets.put(line->target->lineNumber, true);
+   }
+   emit(OP_JUMP);
+   emit(-1);
+   std::vector<Span> spans;
+   Program::SourceLine *line = first;
+   while (line != NULL) {
+      int address = bytecode.code.size();
+      int ordinal = spans.empty() ? 0 : spans.back().last + 1;
+      bytecode.lineNumbers.push_back(line->lineNumber);
+      bytecode.lineAddresses.push_back(address);
+      startBlock();
+      if (compileIncrementAndBranch(line)) {
+         finishBlock(line->lineNumber, address);
+         layout[line->lineNumber].fusedWith = line->next->lineNumber;
+         LineCode fused = { -1, 0, -1, -1, line->lineNumber };
+         layout[line->next->lineNumber] = fused;
+         spans.push_back({ address, ordinal, ordinal + 1 });
+         line = line->next->next;
+      } else {
+         compileStatement(line);
+         finishBlock(line->lineNumber, address);
+         spans.push_back({ address, ordinal, ordinal });
+         line = line->next;
+      }
+   }
+   emit(OP_HALT);
+   for (auto & entry : references) {
+      patchReferences(entry.first);
+   }
+   bytecode.code[1] = layout[first->lineNumber].address;
+   addNames(program);
+   computeBackEdgeCosts(spans);
+}
+
+/*
+ * Implementation notes: update
+ * ----------------------------
+ * The lines to compile again are those edited and still present, the
+ * line before each new line, whose code used to fall through to the
+ * line after it, and the partners of any fused pair that an edit
+ * touches or that a new jump or fall-through now leads into.  Each is
+ * appended as a block that ends with a jump to the line that follows
+ * it.  The old block of a recompiled line becomes a jump to its new
+ * code, and the old block of a removed line becomes a jump to the line
+ * that now follows it, so that code falling into either still reaches
+ * the right place.  Linking happens before anything is changed, so an
+ * error leaves the bytecode as it was.
+ */
+
+void ProgramCompiler::update(Program & program, const vector<int> & edits, int start) {
+   Program::SourceLine *first = program.link();
+   bytecode.backEdgeCosts.clear();
+   bytecode.lineNumbers.clear();
+   bytecode.lineAddresses.clear();
+   std::set<int> work;
+   std::vector<int> pending;
+   std::vector<int> removed;
+   std::unordered_set<int> seen;
+   auto require = [&](int lineNumber) {
+      if (lineNumber != -1 && program.containsLine(lineNumber) && work.insert(lineNumber).second) {
+         pending.push_back(lineNumber);
+      }
+   };
+   auto requirePartners = [&](int lineNumber) {
+      auto it = layout.find(lineNumber);
+      if (it == layout.end()) return;
+      require(it->second.fusedWith);
+      require(it->second.fusedInto);
+   };
+   for (int i = start; i < (int) edits.size(); i++) {
+      int lineNumber = edits[i];
+      if (!seen.insert(lineNumber).second) continue;
+      bool compiled = layout.count(lineNumber) != 0;
+      if (program.containsLine(lineNumber)) {
+         require(lineNumber);
+         if (!compiled) require(program.getPreviousLineNumber(lineNumber));
+      } else if (compiled) {
+         removed.push_back(lineNumber);
+         requirePartners(lineNumber);
+         int next = program.getNextLineNumber(lineNumber);
+         if (next != -1 && layout.count(next) != 0 && layout[next].address == -1) require(next);
+      }
+   }
+   while (!pending.empty()) {
+      int lineNumber = pending.back();
+      pending.pop_back();
+      requirePartners(lineNumber);
+      Program::SourceLine *line = program.findLine(lineNumber);
+      for (Program::SourceLine *successor : { line->next, line->target }) {
+         if (successor == NULL) continue;
+         auto it = layout.find(successor->lineNumber);
+         if (it != layout.end() && it->second.address == -1) require(successor->lineNumber);
+      }
+   }
+   std::vector<std::pair<int,LineCode> > replaced;
+   for (int lineNumber : work) {
+      auto it = layout.find(lineNumber);
+      if (it != layout.end()) replaced.push_back(std::make_pair(lineNumber, it->second));
+      Program::SourceLine *line = program.findLine(lineNumber);
+      int address = bytecode.code.size();
+      startBlock();
+      compileStatement(line);
+      StatementType type = line->lineParsed->getType();
+      if (type != GOTO_STMT && type != END_STMT && type != REM_STMT) {
+         if (line->next == NULL) {
+            emit(OP_HALT);
+         } else {
+            emitJump(OP_JUMP, line->next);
+         }
+      }
+      finishBlock(lineNumber, address);
+   }
+   for (auto & entry : replaced) {
+      if (entry.second.address != -1) liveBlocks[entry.second.block] = false;
+   }
+   for (int lineNumber : removed) {
+      if (layout[lineNumber].address != -1) liveBlocks[layout[lineNumber].block] = false;
+   }
+   for (int lineNumber : work) {
+      patchReferences(lineNumber);
+   }
+   for (auto & entry : replaced) {
+      writeStub(entry.second, entry.first);
+   }
+   for (int lineNumber : removed) {
+      writeStub(layout[lineNumber], program.getNextLineNumber(lineNumber));
+      layout.erase(lineNumber);
+      references.erase(lineNumber);
+   }
+   bytecode.code[1] = layout[first->lineNumber].address;
+   addNames(program);
+}
+
+/*
+ * Implementation notes: needsFullCompile
+ * --------------------------------------
+ * Compiling everything again is cheaper than patching when many lines
+ * changed at once, and it reclaims the space left by old blocks once
+ * that space reaches half the code.
+ */
+
+bool ProgramCompiler::needsFullCompile(int editCount, int lineCount) {
+   return layout.empty() || 8 * editCount > lineCount
+       || 2 * garbage > (int) bytecode.code.size();
+}
+
+/*
+ * Implementation notes: compileStatement
+ * --------------------------------------
+ * Each statement leaves the evaluation stack exactly as it found it.
+ * A REM becomes a jump to the next line, which gives it room to be
+ * replaced.  LET X = X op k and IF e r k, with k an integer constant
+ * that fits in a word, become superinstructions that take their
+ * constant as an operand; their variables and expressions must be
+ * integers, since the superinstructions know no other type.
+ */
+
+void ProgramCompiler::compileStatement(Program::SourceLine *line) {
+   Statement *stmt = line->lineParsed;
+   Operator op;
+   int k;
+   ValueType type;
+   switch (stmt->getType()) {
+    case REM_STMT:
+      if (line->next == NULL) {
+         emit(OP_HALT);
+      } else {
+         emitJump(OP_JUMP, line->next);
+      }
+      break;
+    case LET_STMT:
+      if (matchUpdate(stmt, op, k)) {
+         emit((op == MUL_OP) ? OP_MUL_TO : OP_ADD_TO);
+         emit(((LetStmt *) stmt)->getSlot());
+         emit(k);
+         bytecode.fusedCounts[UPDATE_WITH_CONSTANT]++;
+         break;
+      }
+      type = ((LetStmt *) stmt)->getValueType();
+      compileExpAs(((LetStmt *) stmt)->getExp(), type);
+      emit((type == DOUBLE_TYPE) ? OP_STORE_DOUBLE : OP_STORE);
+      emit(((LetStmt *) stmt)->getSlot());
+      adjustDepth(-1);
+      break;
+    case PRINT_STMT:
+      compileExp(((PrintStmt *) stmt)->getExp());
+      type = ((PrintStmt *) stmt)->getExp()->getValueType();
+      emit((type == DOUBLE_TYPE) ? OP_PRINT_DOUBLE : OP_PRINT);
+      adjustDepth(-1);
+      break;
+    case INPUT_STMT:
+      type = ((InputStmt *) stmt)->getValueType();
+      emit((type == DOUBLE_TYPE) ? OP_INPUT_DOUBLE : OP_INPUT);
+      emit(((InputStmt *) stmt)->getSlot());
+      break;
+    case GOTO_STMT:
+      emitJump(OP_JUMP, line->target);
+      break;
+    case IF_STMT: {
+      IfStmt *ifStmt = (IfStmt *) stmt;
+      type = ifStmt->getValueType();
+      if (type == INTEGER_TYPE && isSmallConstant(ifStmt->getRHS())) {
+         Expression *lhs = ifStmt->getLHS();
+         int k = ((ConstantExp *) ifStmt->getRHS())->getValue();
+         if (lhs->getType() == IDENTIFIER) {
+            emit(OP_JUMP_VAR_CONST);
+            emit(((IdentifierExp *) lhs)->getSlot());
+         } else {
+            compileExp(lhs);
+            emit(OP_JUMP_CONST);
+            adjustDepth(-1);
+         }
+         emit(ifStmt->getRelation());
+         emit(k);
+         emitJumpTarget(line->target);
+         bytecode.fusedCounts[COMPARE_WITH_CONSTANT]++;
+         break;
+      }
+      compileExpAs(ifStmt->getLHS(), type);
+      compileExpAs(ifStmt->getRHS(), type);
+      if (type == DOUBLE_TYPE) {
+         emit(OP_JUMP_DOUBLE);
+         emit(ifStmt->getRelation());
+         emitJumpTarget(line->target);
+      } else {
+         emitJump(relationToJump(ifStmt->getRelation()), line->target);
+      }
+      adjustDepth(-2);
+      break;
+    }
+    case END_STMT:
+      emit(OP_HALT);
+      break;
+    case DIM_STMT: {
+      ElementExp *declarator = ((DimStmt *) stmt)->getDeclarator();
+      compileSubscripts(declarator);
+      emit(OP_DIM);
+      emit(declarator->getSlot());
+      emit(declarator->getRank());
+      adjustDepth(-declarator->getRank());
+      break;
+    }
+    case LET_ELEMENT_STMT: {
+      ElementExp *element = ((LetElementStmt *) stmt)->getElement();
+      compileSubscripts(element);
+      compileExpAs(((LetElementStmt *) stmt)->getExp(), INTEGER_TYPE);
+      emit(OP_STORE_ELEMENT);
+      emit(element->getSlot());
+      emit(element->getRank());
+      adjustDepth(-element->getRank() - 1);
+      break;
+    }
+    case MAT_STMT: {
+      MatStmt *mat = (MatStmt *) stmt;
+      if (mat->getScalar() != NULL) compileExpAs(mat->getScalar(), INTEGER_TYPE);
+      emit(OP_MAT);
+      emit(mat->getOperation());
+      emit(mat->getTargetSlot());
+      emit(mat->getLHSSlot());
+      emit(mat->getRHSSlot());
+      if (mat->getScalar() != NULL) adjustDepth(-1);
+      break;
+    }
+   }
+}
+
+/*
+ * Implementation notes: compileIncrementAndBranch
+ * -----------------------------------------------
+ * Compiles a LET I = I + k on this line and an IF I r n THEN on the
+ * next as one instruction, if the statements have that form and no
+ * jump leads to the IF, which then has no code of its own.  The
+ * instruction stores I before it reads n, as the two statements do,
+ * so an undefined n is reported with I already updated.  Returns
+ * false, having emitted nothing, if the lines do not match.
+ */
+
+bool ProgramCompiler::compileIncrementAndBranch(Program::SourceLine *line) {
+   Program::SourceLine *next = line->next;
+   if (next == NULL || next->lineParsed->getType() != IF_STMT) return false;
+   if (jumpTargets.containsKey(next->lineNumber)) return false;
+   Operator op;
+   int k;
+   if (!matchUpdate(line->lineParsed, op, k) || op == MUL_OP) return false;
+   int slot = ((LetStmt *) line->lineParsed)->getSlot();
+   IfStmt *ifStmt = (IfStmt *) next->lineParsed;
+   Expression *lhs = ifStmt->getLHS();
+   Expression *rhs = ifStmt->getRHS();
+   if (lhs->getType() != IDENTIFIER || ((IdentifierExp *) lhs)->getSlot() != slot) return false;
+   if (isSmallConstant(rhs)) {
+      emit(OP_INC_JUMP_CONST);
+      emit(slot);
+      emit(k);
+      emit(ifStmt->getRelation());
+      emit(((ConstantExp *) rhs)->getValue());
+   } else if (rhs->getType() == IDENTIFIER && rhs->getValueType() == INTEGER_TYPE) {
+      emit(OP_INC_JUMP_VAR);
+      emit(slot);
+      emit(k);
+      emit(ifStmt->getRelation());
+      emit(((IdentifierExp *) rhs)->getSlot());
+   } else {
+      return false;
+   }
+   emitJumpTarget(next->target);
+   bytecode.fusedCounts[INCREMENT_AND_BRANCH]++;
+   return true;
+}
+
+/*
+ * Implementation notes: matchUpdate
+ * ---------------------------------
+ * Recognizes LET X = X + k, X - k and X * k for an integer variable X
+ * and a constant k.  A subtraction is returned as the addition of -k.
+ * Both k and -k must fit in a word.
+ */
+
+bool ProgramCompiler::matchUpdate(Statement *stmt, Operator & op, int & k) {
+   if (stmt->getType() != LET_STMT) return false;
+   LetStmt *let = (LetStmt *) stmt;
+   if (let->getValueType() != INTEGER_TYPE || let->getExp()->getType() != COMPOUND) return false;
+   CompoundExp *compound = (CompoundExp *) let->getExp();
+   op = compound->getOperator();
+   if (op != ADD_OP && op != SUB_OP && op != MUL_OP) return false;
+   Expression *lhs = compound->getLHS();
+   Expression *rhs = compound->getRHS();
+   if (lhs->getType() != IDENTIFIER || ((IdentifierExp *) lhs)->getSlot() != let->getSlot()
+       || !isSmallConstant(rhs)) {
+      return false;
+   }
+   long long value = ((ConstantExp *) rhs)->getValue();
+   if (op == SUB_OP) {
+      op = ADD_OP;
+      value = -value;
+   }
+   if (!fitsInWord(value)) return false;
+   k = value;
+   return true;
+}
+
+/*
+ * Implementation notes: compileExp
+ * --------------------------------
+ * Expressions are compiled in postfix order, which mirrors the order
+ * in which CompoundExp::eval evaluates its operands.  The subscripts of
+ * an element are pushed row first and popped by the instruction that
+ * uses them, which locates the element only after all of them, and any
+ * value stored into it, have been evaluated.  The code leaves a value
+ * of the type of the expression; the operands of an arithmetic node
+ * are converted to its type, and those of an assignment to the type of
+ * its variable, as they are evaluated.
+ */
+
+void ProgramCompiler::compileExp(Expression *exp) {
+   switch (exp->getType()) {
+    case CONSTANT: {
+      long long value = ((ConstantExp *) exp)->getValue();
+      if (fitsInWord(value)) {
+         emit(OP_PUSH);
+         emit(value);
+      } else {
+         emit(OP_PUSH_WIDE);
+         emitWide(value);
+      }
+      adjustDepth(1);
+      return;
+    }
+    case DOUBLE_CONSTANT: {
+      double value = ((DoubleConstantExp *) exp)->getValue();
+      long long bits;
+      memcpy(&bits, &value, sizeof bits);
+      emit(OP_PUSH_DOUBLE);
+      emitWide(bits);
+      adjustDepth(1);
+      return;
+    }
+    case IDENTIFIER:
+      emit((exp->getValueType() == DOUBLE_TYPE) ? OP_LOAD_DOUBLE : OP_LOAD);
+      emit(((IdentifierExp *) exp)->getSlot());
+      adjustDepth(1);
+      return;
+    case ELEMENT: {
+      ElementExp *element = (ElementExp *) exp;
+      compileSubscripts(element);
+      emit(OP_LOAD_ELEMENT);
+      emit(element->getSlot());
+      emit(element->getRank());
+      adjustDepth(1 - element->getRank());
+      return;
+    }
+    case SUM:
+      emit(OP_SUM);
+      emit(((SumExp *) exp)->getSlot());
+      adjustDepth(1);
+      return;
+    case COMPOUND:
+      break;
+   }
+   CompoundExp *compound = (CompoundExp *) exp;
+   Operator op = compound->getOperator();
+   if (op == ASSIGN_OP) {
+      if (compound->getLHS()->getType() != IDENTIFIER) {
+         emitError("Illegal variable in assignment");
+         adjustDepth(1);
+         return;
+      }
+      ValueType type = compound->getLHS()->getValueType();
+      compileExpAs(compound->getRHS(), type);
+      emit((type == DOUBLE_TYPE) ? OP_ASSIGN_DOUBLE : OP_ASSIGN);
+      emit(((IdentifierExp *) compound->getLHS())->getSlot());
+      return;
+   }
+   ValueType type = compound->getValueType();
+   if (type == DOUBLE_TYPE) {
+      compileExpAs(compound->getLHS(), DOUBLE_TYPE);
+      compileExpAs(compound->getRHS(), DOUBLE_TYPE);
+      adjustDepth(-1);
+      switch (op) {
+       case ADD_OP: emit(OP_ADD_DOUBLE); break;
+       case SUB_OP: emit(OP_SUB_DOUBLE); break;
+       case MUL_OP: emit(OP_MUL_DOUBLE); break;
+       case DIV_OP: emit(OP_DIV_DOUBLE); break;
+       default: emitError("Illegal operator in expression"); break;
+      }
+      return;
+   }
+   if ((op == SHL_OP || op == SHR_OP) && compound->getRHS()->getType() == CONSTANT) {
+      compileExp(compound->getLHS());
+      emit((op == SHL_OP) ? OP_SHL : OP_SHR);
+      emit(((ConstantExp *) compound->getRHS())->getValue());
+      return;
+   }
+   compileExp(compound->getLHS());
+   compileExp(compound->getRHS());
+   adjustDepth(-1);
+   switch (op) {
+    case ADD_OP: emit(OP_ADD); break;
+    case SUB_OP: emit(OP_SUB); break;
+    case MUL_OP: emit(OP_MUL); break;
+    case DIV_OP: emit(OP_DIV); break;
+    default: emitError("Illegal operator in expression"); break;
+   }
+}
+
+/*
+ * Implementation notes: compileExpAs
+ * ----------------------------------
+ * Compiles the expression and converts its value to the specified
+ * type, which is how a double reaches an integer variable, a subscript
+ * or a MAT scalar, and how an integer joins a double computation.
+ */
+
+void ProgramCompiler::compileExpAs(Expression *exp, ValueType type) {
+   compileExp(exp);
+   ValueType actual = exp->getValueType();
+   if (actual == type) return;
+   emit((type == DOUBLE_TYPE) ? OP_TO_DOUBLE : OP_TO_INTEGER);
+}
+
+void ProgramCompiler::compileSubscripts(ElementExp *element) {
+   compileExpAs(element->getRow(), INTEGER_TYPE);
+   if (element->getColumn() != NULL) compileExpAs(element->getColumn(), INTEGER_TYPE);
+}
+
+void ProgramCompiler::emit(int word) {
+   bytecode.code.push_back(word);
+}
+
+void ProgramCompiler::emitWide(long long value) {
+   unsigned long long bits = value;
+   emit((int) (unsigned) bits);
+   emit((int) (unsigned) (bits >> 32));
+}
+
+void ProgramCompiler::emitJump(OpCode op, Program::SourceLine *target) {
+   emit(op);
+   emitJumpTarget(target);
+}
+
+void ProgramCompiler::emitJumpTarget(Program::SourceLine *target) {
+   Reference reference;
+   reference.operandIndex = bytecode.code.size();
+   reference.block = currentBlock;
+   references[target->lineNumber].push_back(reference);
+   auto it = layout.find(target->lineNumber);
+   emit((it == layout.end()) ? -1 : it->second.address);
+}
+
+void ProgramCompiler::emitError(string message) {
+   emit(OP_ERROR);
+   emit(bytecode.messages.size());
+   bytecode.messages.push_back(message);
+}
+
+void ProgramCompiler::adjustDepth(int delta) {
+   depth += delta;
+   if (depth > bytecode.maxStack) bytecode.maxStack = depth;
+}
+
+int ProgramCompiler::startBlock() {
+   currentBlock = liveBlocks.size();
+   liveBlocks.push_back(true);
+   return currentBlock;
+}
+
+/*
+ * Implementation notes: finishBlock
+ * ---------------------------------
+ * Pads the block that holds the code of a line to two words, which
+ * only an END needs, and records it in the layout.
+ */
+
+void ProgramCompiler::finishBlock(int lineNumber, int address) {
+   while ((int) bytecode.code.size() < address + 2) {
+      emit(OP_HALT);
+   }
+   LineCode code = { address, (int) bytecode.code.size() - address, currentBlock, -1, -1 };
+   layout[lineNumber] = code;
+}
+
+void ProgramCompiler::patchReferences(int lineNumber) {
+   auto found = references.find(lineNumber);
+   if (found == references.end()) return;
+   int address = layout[lineNumber].address;
+   std::vector<Reference> & list = found->second;
+   int live = 0;
+   for (Reference & reference : list) {
+      if (!liveBlocks[reference.block]) continue;
+      bytecode.code[reference.operandIndex] = address;
+      list[live++] = reference;
+   }
+   list.resize(live);
+}
+
+/*
+ * Implementation notes: writeStub
+ * -------------------------------
+ * Overwrites an abandoned block with a jump to the specified line, or
+ * with HALT if lineNumber is -1, filling the rest of the block with
+ * HALT so that the array can still be decoded from start to end.
+ */
+
+void ProgramCompiler::writeStub(const LineCode & old, int lineNumber) {
+   if (old.address == -1) return;
+   std::vector<int> & code = bytecode.code;
+   for (int i = old.address; i < old.address + old.size; i++) {
+      code[i] = OP_HALT;
+   }
+   if (lineNumber != -1) {
+      startBlock();
+      code[old.address] = OP_JUMP;
+      code[old.address + 1] = layout[lineNumber].address;
+      Reference reference = { old.address + 1, currentBlock };
+      references[lineNumber].push_back(reference);
+   }
+   garbage += old.size;
+}
+
+void ProgramCompiler::addNames(Program & program) {
+   SymbolTable & symbols = program.getSymbolTable();
+   for (int slot = bytecode.names.size(); slot < symbols.size(); slot++) {
+      bytecode.names.push_back(symbols.getName(slot));
+   }
+}
+
+/*
+ * Implementation notes: computeBackEdgeCosts
+ * ------------------------------------------
+ * The code is decoded from start to end, keeping track of the span
+ * that holds the current address.  A backward jump always lands on
+ * the start of a span, which a binary search finds, and the cost is
+ * the number of statements from the first of that span through the
+ * last of the span that jumps.  Only the jump at address 0 lies
+ * before every span, and it jumps forward.
+ */
+
+void ProgramCompiler::computeBackEdgeCosts(const std::vector<Span> & spans) {
+   const std::vector<int> & code = bytecode.code;
+   bytecode.backEdgeCosts.assign(code.size(), 0);
+   int current = -1;
+   for (int pc = 0; pc < (int) code.size(); pc += instructionLength(code[pc])) {
+      while (current + 1 < (int) spans.size() && spans[current + 1].address <= pc) current++;
+      int index = jumpTargetIndex(code[pc]);
+      if (index == 0 || code[pc + index] > pc || current < 0) continue;
+      int target = code[pc + index];
+      auto found = std::upper_bound(spans.begin(), spans.end(), target,
+                                    [](int address, const Span & span) {
+                                       return address < span.address;
+                                    }) - 1;
+      bytecode.backEdgeCosts[pc] = spans[current].last - found->first + 1;
+   }
+}
+
+void compileProgram(Program & program, Bytecode & bytecode) {
+   ProgramCompiler compiler(bytecode);
+   compiler.compile(program);
+}
+
+IncrementalCompiler::IncrementalCompiler(Program & program) : program(program) {
+   compiler = new ProgramCompiler(bytecode);
+   generation = -1;
+   editsSeen = 0;
+}
+
+IncrementalCompiler::~IncrementalCompiler() {
+   delete compiler;
+}
+
+/*
+ * Implementation notes: IncrementalCompiler::compile
+ * --------------------------------------------------
+ * Linking first brings the types of the statements up to date, which
+ * records every statement it retypes as an edit, so that those lines
+ * are compiled again along with the lines the user changed.
+ */
+
+const Bytecode & IncrementalCompiler::compile(bool inOrder) {
+   program.link();
+   const vector<int> & edits = program.getEdits();
+   int editCount = edits.size() - editsSeen;
+   if (generation != program.getGeneration()
+       || compiler->needsFullCompile(editCount, program.size())
+       || (inOrder && (editCount > 0 || bytecode.backEdgeCosts.empty()))) {
+      compiler->compile(program);
+   } else if (editCount > 0) {
+      compiler->update(program, edits, editsSeen);
+   }
+   generation = program.getGeneration();
+   editsSeen = edits.size();
+   return bytecode;
+}
+
+Program & IncrementalCompiler::getProgram() {
+   return program;
+}
@@ -0,0 +1,116 @@
+/*
+ * File: compiler.h
+ * ----------------
+ * This interface exports the function that lowers a parsed BASIC
+ * program into the bytecode executed by the virtual machine, and a
+ * class that keeps that bytecode up to date as the program is edited.
+ */
+
+#ifndef _compiler_h
+#define _compiler_h
+
+#include "bytecode.h"
+#include "program.h"
+
+/*
+ * Function: compileProgram
+ * Usage: compileProgram(program, bytecode);
+ * -----------------------------------------
+ * Translates every statement in the program, in line number order,
+ * into one contiguous bytecode array.  Any previous contents of the
+ * bytecode object are replaced.  The program is linked first, so a
+ * jump to a line that does not exist or a line that could not be
+ * parsed is reported before any code is produced; GOTO and IF targets
+ * become instruction addresses.
+ */
+
+void compileProgram(Program & program, Bytecode & bytecode);
+
+/* Private class defined in compiler.cpp */
+
+class ProgramCompiler;
+
+/*
+ * Class: IncrementalCompiler
+ * --------------------------
+ * This class holds the bytecode for a program across edits.  After an
+ * edit, only the lines that changed are compiled again: their new code
+ * is appended to the array, their old code is overwritten with a jump
+ * to it, and the jumps that led to their old addresses are patched.
+ * A line inserted between two others also moves the line before it,
+ * which then ends in a jump to the new line.  The cost of bringing the
+ * bytecode up to date is therefore proportional to the number of lines
+ * affected, not to the size of the program.
+ *
+ * The code of moved lines is never fused with the following line, and
+ * a moved line costs one extra jump when execution falls into its old
+ * address.  When the abandoned code grows to half the array, or when
+ * many lines changed at once, the whole program is compiled afresh.
+ * The fusedCounts field therefore describes only full compilations;
+ * STATS uses compileProgram for that reason.
+ */
+
+class IncrementalCompiler {
+
+public:
+
+/*
+ * Constructor: IncrementalCompiler
+ * Usage: IncrementalCompiler compiler(program);
+ * ---------------------------------------------
+ * Creates a compiler for the program, which must outlive it.  Nothing
+ * is compiled until the first call to compile.
+ */
+
+   IncrementalCompiler(Program & program);
+
+/*
+ * Destructor: ~IncrementalCompiler
+ * Usage: usually implicit
+ * -----------------------
+ * Frees the bytecode and the record of where each line was placed.
+ */
+
+   ~IncrementalCompiler();
+
+/*
+ * Method: compile
+ * Usage: const Bytecode & bytecode = compiler.compile();
+ *        const Bytecode & bytecode = compiler.compile(inOrder);
+ * -------------------------------------------------------------
+ * Brings the bytecode up to date with the program and returns it.  As
+ * with compileProgram, the program is linked first, so jumps to
+ * missing lines and lines that could not be parsed are reported before
+ * anything changes.  If inOrder is true, code that an update has moved
+ * out of line order is compiled afresh, so that the bytecode has its
+ * backEdgeCosts and line tables, as a governed run needs.  The reference stays valid
+ * until the next call.
+ */
+
+   const Bytecode & compile(bool inOrder = false);
+
+/*
+ * Method: getProgram
+ * Usage: Program & program = compiler.getProgram();
+ * -------------------------------------------------
+ * Returns the program this compiler compiles.
+ */
+
+   Program & getProgram();
+
+private:
+
+   Program & program;
+   Bytecode bytecode;
+   ProgramCompiler *compiler;
+   int generation;
+   int editsSeen;
+
+/* Compilers cannot be copied, since the copies would share one ProgramCompiler */
+
+   IncrementalCompiler(const IncrementalCompiler & src) = delete;
+   IncrementalCompiler & operator=(const IncrementalCompiler & src) = delete;
+
+};
+
+#endif
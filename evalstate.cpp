@@ -1,42 +1,103 @@
 /*
  * File: evalstate.cpp
  * -------------------
- * This file implements the EvalState class, which defines a symbol
- * table for keeping track of the value of identifiers.  The public
- * methods are simple enough that they need no individual documentation.
+ * This file implements the EvalState class, which keeps track of the
+ * value of each variable slot and the array in it, and owns the
+ * program's input, output, governor and checkpointer.  The public
+ * methods are simple enough that they need no individual
+ * documentation; the per-access slot accessors are defined inline in
+ * evalstate.h.
  */
 
-#include <string>
 #include "evalstate.h"
-#include "map.h"
 using namespace std;
 
 /* Implementation of the EvalState class */
 
 EvalState::EvalState() {
-   /* Empty */
+   currentLine = -1;
 }
 
 EvalState::~EvalState() {
    /* Empty */
 }
 
-void EvalState::setValue(string var, int value) {
-   symbolTable.put(var, value);
+void EvalState::reserveSlots(int count) {
+   if (count > (int) bindings.size()) {
+      if (governor.isActive()) {
+         governor.checkVariables(count);
+         governor.checkMemory(getMemoryUsage(count));
+      }
+      Binding undefined;
+      undefined.value.integer = 0;
+      undefined.type = UNDEFINED_TYPE;
+      bindings.resize(count, undefined);
+   }
+   if (count > (int) arrays.size()) arrays.resize(count);
+}
+
+int EvalState::getSlotCount() {
+   return bindings.size();
+}
+
+EvalState::Binding *EvalState::getBindings() {
+   return bindings.data();
+}
+
+void EvalState::dimensionArray(int slot, const string & key, int rank, long long rows,
+                               long long columns) {
+   Array & array = getArray(slot);
+   if (governor.isActive() && rows >= 1 && columns >= 1
+       && rows <= MAX_ARRAY_SIZE && columns <= MAX_ARRAY_SIZE) {
+      long long growth = (rows * columns - array.getSize()) * (long long) sizeof(long long);
+      governor.checkMemory(getMemoryUsage(bindings.size()) + growth);
+   }
+   array.dimension(key, rank, rows, columns);
+   governor.chargeElements(array.getSize());
+}
+
+void EvalState::checkMemory() {
+   if (governor.isActive()) governor.checkMemory(getMemoryUsage(bindings.size()));
+}
+
+void EvalState::startRun() {
+   governor.start();
+   if (governor.isActive()) {
+      governor.checkVariables(bindings.size());
+      governor.checkMemory(getMemoryUsage(bindings.size()));
+   }
+}
+
+Governor & EvalState::getGovernor() {
+   return governor;
 }
 
-int EvalState::getValue(string var) {
-   return symbolTable.get(var);
+Checkpointer & EvalState::getCheckpointer() {
+   return checkpointer;
 }
 
-bool EvalState::isDefined(string var) {
-   return symbolTable.containsKey(var);
+OutputBuffer & EvalState::getOutput() {
+   return output;
 }
 
-void EvalState::setCurrentLine(int lineNumber) { //Sets the current line of the program to the given line number
-    currentLine = lineNumber;
+InputSource & EvalState::getInput() {
+   return input;
 }
 
-int EvalState::getCurrentLine() { //Returns the current line of the program
-   return currentLine;
+/*
+ * Implementation notes: getMemoryUsage
+ * ------------------------------------
+ * The usage counts the value and array records of every slot, as if
+ * the state held the specified number of slots, together with the
+ * elements of every array.  It takes time proportional to the number
+ * of slots, which is acceptable because it is needed only when the
+ * state grows.
+ */
+
+long long EvalState::getMemoryUsage(int slotCount) {
+   long long bytes = (long long) slotCount * (sizeof(Binding) + sizeof(Array));
+   for (const Array & array : arrays) {
+      bytes += (long long) array.getSize() * sizeof(long long);
+   }
+   return bytes;
 }
@@ -9,19 +9,22 @@
 #ifndef _evalstate_h
 #define _evalstate_h
 
-#include <string>
-#include "map.h"
+#include <vector>
+#include "array.h"
+#include "checkpoint.h"
+#include "governor.h"
+#include "input.h"
+#include "output.h"
+#include "value.h"
 
 /*
  * Class: EvalState
  * ----------------
  * This class is passed by reference through the recursive levels
  * of the evaluator and contains information from the evaluation
- * environment that the evaluator may need to know.  In this
- * version, the only information maintained by the EvalState class
- * is a symbol table that maps variable names into their values.
- * Several of the exercises, however, require you to include
- * additional information in the EvalState class.
+ * environment that the evaluator may need to know.  Variables are
+ * identified by the slot that the program's SymbolTable assigned to
+ * their name, and their values live in a flat array indexed by slot.
  */
 
 class EvalState {
@@ -47,31 +50,201 @@ public:
    ~EvalState();
 
 /*
- * Method: setValue
- * Usage: state.setValue(var, value);
- * ----------------------------------
- * Sets the value associated with the specified var.
+ * Methods: setValue, setDouble
+ * Usage: state.setValue(slot, value);
+ *        state.setDouble(slot, value);
+ * ------------------------------------
+ * These methods set the variable in the specified slot to an integer
+ * or a double, growing the value array if the slot is new.
  */
 
-   void setValue(std::string var, int value);
+   void setValue(int slot, long long value);
+   void setDouble(int slot, double value);
 
 /*
- * Method: getValue
- * Usage: int value = state.getValue(var);
- * ---------------------------------------
- * Returns the value associated with the specified variable.
+ * Methods: getValue, getDouble
+ * Usage: long long value = state.getValue(slot);
+ *        double value = state.getDouble(slot);
+ * --------------------------------------------
+ * These methods return the value of the variable in the specified
+ * slot, which must be defined, converted to the requested type if it
+ * holds the other one.
+ */
+
+   long long getValue(int slot);
+   double getDouble(int slot);
+
+/*
+ * Method: getType
+ * Usage: ValueType type = state.getType(slot);
+ * --------------------------------------------
+ * Returns the type of the value the variable in the specified slot
+ * holds, or UNDEFINED_TYPE if it has none.
  */
 
-   int getValue(std::string var);
+   ValueType getType(int slot);
 
 /*
  * Method: isDefined
- * Usage: if (state.isDefined(var)) . . .
- * --------------------------------------
- * Returns true if the specified variable is defined.
+ * Usage: if (state.isDefined(slot)) . . .
+ * ---------------------------------------
+ * Returns true if the variable in the specified slot is defined.
+ */
+
+   bool isDefined(int slot);
+
+/*
+ * Methods: lookup, lookupDouble
+ * Usage: if (state.lookup(slot, value)) . . .
+ * -------------------------------------------
+ * These methods store the value of the variable in the specified slot
+ * into value, converted to the type of value if necessary, and return
+ * true, or return false if the variable is undefined.  Each combines
+ * isDefined and getValue into a single probe.
+ */
+
+   bool lookup(int slot, long long & value);
+   bool lookupDouble(int slot, double & value);
+
+/*
+ * Method: reserveSlots
+ * Usage: state.reserveSlots(count);
+ * ---------------------------------
+ * Ensures that slots 0 through count - 1 exist, both in the value
+ * array and in the array table, so that clients that index either of
+ * them directly never need to grow it.  Growing the state beyond the
+ * variable or memory limit of its governor is reported by calling
+ * error.
+ */
+
+   void reserveSlots(int count);
+
+/*
+ * Method: getSlotCount
+ * Usage: int count = state.getSlotCount();
+ * ----------------------------------------
+ * Returns the number of slots in the value array.
+ */
+
+   int getSlotCount();
+
+/*
+ * Type: Binding
+ * -------------
+ * This structure holds the value of one variable together with the
+ * type of the value, which is UNDEFINED_TYPE until the variable is
+ * assigned.  Keeping both in one record lets a single memory access
+ * answer whether the variable is defined and how to read it.  A
+ * variable whose static type is INTEGER_TYPE only ever holds integers;
+ * one whose static type is DOUBLE_TYPE holds doubles once the program
+ * has been linked, but may still hold an integer assigned before it was
+ * widened.
+ */
+
+   struct Binding {
+      Value value;
+      ValueType type;
+   };
+
+/*
+ * Method: getBindings
+ * Usage: EvalState::Binding *bindings = state.getBindings();
+ * ----------------------------------------------------------
+ * Returns the value array itself, for use by the virtual machine.
+ * The pointer remains valid until the array grows, which only happens
+ * when a slot beyond those reserved is assigned.
+ */
+
+   Binding *getBindings();
+
+/*
+ * Method: getArray
+ * Usage: Array & array = state.getArray(slot);
+ * --------------------------------------------
+ * Returns the array in the specified slot, which is the slot of the
+ * array's key "A()" rather than that of the variable A.  The table
+ * grows if the slot is new, which moves the arrays already in it, so a
+ * client that holds several arrays at once reserves their slots first.
+ */
+
+   Array & getArray(int slot);
+
+/*
+ * Method: dimensionArray
+ * Usage: state.dimensionArray(slot, key, rank, rows, columns);
+ * ------------------------------------------------------------
+ * Dimensions the array in the specified slot as Array::dimension
+ * does, after checking that the new elements fit within the memory
+ * limit.  Every engine executes DIM through this method.
+ */
+
+   void dimensionArray(int slot, const std::string & key, int rank, long long rows,
+                       long long columns);
+
+/*
+ * Method: checkMemory
+ * Usage: state.checkMemory();
+ * ---------------------------
+ * Calls error if the variables and arrays of the state exceed the
+ * memory limit.  This is used after MAT, whose result may be larger
+ * than its operands.
+ */
+
+   void checkMemory();
+
+/*
+ * Method: startRun
+ * Usage: state.startRun();
+ * ------------------------
+ * Starts the governor's accounts for a new run and checks what the
+ * state already holds against its variable and memory limits, which
+ * may have been lowered since the state grew.  Every engine calls this
+ * before it executes the first statement.
  */
 
-   bool isDefined(std::string var);
+   void startRun();
+
+/*
+ * Method: getGovernor
+ * Usage: Governor & governor = state.getGovernor();
+ * -------------------------------------------------
+ * Returns the governor that holds runs with this state to their
+ * limits.  It sets no limits unless they are changed.
+ */
+
+   Governor & getGovernor();
+
+/*
+ * Method: getCheckpointer
+ * Usage: Checkpointer & checkpointer = state.getCheckpointer();
+ * -------------------------------------------------------------
+ * Returns the checkpointer that saves runs with this state when the
+ * governor says a checkpoint is due.  It has no file unless one is
+ * set.
+ */
+
+   Checkpointer & getCheckpointer();
+
+/*
+ * Method: getOutput
+ * Usage: OutputBuffer & output = state.getOutput();
+ * -------------------------------------------------
+ * Returns the buffer that receives the output of PRINT statements run
+ * with this state.  It writes to cout unless its stream is changed.
+ */
+
+   OutputBuffer & getOutput();
+
+/*
+ * Method: getInput
+ * Usage: InputSource & input = state.getInput();
+ * ----------------------------------------------
+ * Returns the source from which INPUT statements run with this state
+ * read their values.  It reads from the console unless a stream or a
+ * file is attached.
+ */
+
+   InputSource & getInput();
 
 /*
 * Method: setCurrentLine
@@ -93,10 +266,96 @@ public:
 
 private:
 
-   Map<std::string,int> symbolTable;
+   std::vector<Binding> bindings;
+   std::vector<Array> arrays;
+   Governor governor;
+   Checkpointer checkpointer;
+   OutputBuffer output;
+   InputSource input;
    int currentLine;
 
+   long long getMemoryUsage(int slotCount);
+
 };
 
-#endif
+/*
+ * Implementation notes: slot accessors
+ * ------------------------------------
+ * The accessors used on every statement and every variable reference
+ * are defined here rather than in evalstate.cpp so that the
+ * interpreter loops can inline them.  Each tests first for the type a variable of the
+ * requested type holds, so the common case costs a single comparison.
+ */
+
+inline void EvalState::setCurrentLine(int lineNumber) {
+   currentLine = lineNumber;
+}
+
+inline int EvalState::getCurrentLine() {
+   return currentLine;
+}
+
+inline bool EvalState::isDefined(int slot) {
+   return slot < (int) bindings.size() && bindings[slot].type != UNDEFINED_TYPE;
+}
 
+inline ValueType EvalState::getType(int slot) {
+   return (slot < (int) bindings.size()) ? bindings[slot].type : UNDEFINED_TYPE;
+}
+
+inline long long EvalState::getValue(int slot) {
+   long long value = 0;
+   lookup(slot, value);
+   return value;
+}
+
+inline double EvalState::getDouble(int slot) {
+   double value = 0;
+   lookupDouble(slot, value);
+   return value;
+}
+
+inline bool EvalState::lookup(int slot, long long & value) {
+   if (slot >= (int) bindings.size()) return false;
+   const Binding & binding = bindings[slot];
+   if (binding.type == INTEGER_TYPE) {
+      value = binding.value.integer;
+      return true;
+   }
+   if (binding.type == UNDEFINED_TYPE) return false;
+   value = doubleToInteger(binding.value.real);
+   return true;
+}
+
+inline bool EvalState::lookupDouble(int slot, double & value) {
+   if (slot >= (int) bindings.size()) return false;
+   const Binding & binding = bindings[slot];
+   if (binding.type == DOUBLE_TYPE) {
+      value = binding.value.real;
+      return true;
+   }
+   if (binding.type == UNDEFINED_TYPE) return false;
+   value = (double) binding.value.integer;
+   return true;
+}
+
+inline Array & EvalState::getArray(int slot) {
+   if (slot >= (int) arrays.size()) reserveSlots(slot + 1);
+   return arrays[slot];
+}
+
+inline void EvalState::setValue(int slot, long long value) {
+   if (slot >= (int) bindings.size()) reserveSlots(slot + 1);
+   Binding & binding = bindings[slot];
+   binding.value.integer = value;
+   binding.type = INTEGER_TYPE;
+}
+
+inline void EvalState::setDouble(int slot, double value) {
+   if (slot >= (int) bindings.size()) reserveSlots(slot + 1);
+   Binding & binding = bindings[slot];
+   binding.value.real = value;
+   binding.type = DOUBLE_TYPE;
+}
+
+#endif
@@ -5,16 +5,18 @@
  */
 
 #include <string>
+#include "array.h"
 #include "error.h"
 #include "evalstate.h"
 #include "exp.h"
-#include "strlib.h"
+#include "value.h"
 using namespace std;
 
 /*
  * Implementation notes: the Expression class
  * ------------------------------------------
- * The Expression class declares no instance variables and needs no code.
+ * The Expression class declares no instance variables.  Its operator
+ * new takes the memory from the arena, which frees it wholesale.
  */
 
 Expression::Expression() {
@@ -25,6 +27,22 @@ Expression::~Expression() {
    /* Empty */
 }
 
+double Expression::evalDouble(EvalState & state) const {
+   return (double) eval(state);
+}
+
+ValueType Expression::getValueType() const {
+   return INTEGER_TYPE;
+}
+
+void *Expression::operator new(size_t size, Arena & arena) {
+   return arena.allocate(size);
+}
+
+void Expression::operator delete(void *ptr, Arena & arena) {
+   /* Empty */
+}
+
 /*
  * Implementation notes: the ConstantExp subclass
  * ----------------------------------------------
@@ -33,41 +51,96 @@ Expression::~Expression() {
  * value of state but needs it to match the general prototype for eval.
  */
 
-ConstantExp::ConstantExp(int value) {
+ConstantExp::ConstantExp(long long value) {
    this->value = value;
 }
 
-int ConstantExp::eval(EvalState & state) {
+long long ConstantExp::eval(EvalState & state) const {
    return value;
 }
 
 string ConstantExp::toString() {
-   return integerToString(value);
+   return to_string(value);
 }
 
 ExpressionType ConstantExp::getType() {
    return CONSTANT;
 }
 
-int ConstantExp::getValue() {
+long long ConstantExp::getValue() {
+   return value;
+}
+
+/*
+ * Implementation notes: the DoubleConstantExp subclass
+ * ----------------------------------------------------
+ * The DoubleConstantExp subclass stores its value as a double.  Its
+ * eval method is used only where an integer is required, such as a
+ * subscript, and converts the value.
+ */
+
+DoubleConstantExp::DoubleConstantExp(double value) {
+   this->value = value;
+}
+
+long long DoubleConstantExp::eval(EvalState & state) const {
+   return doubleToInteger(value);
+}
+
+double DoubleConstantExp::evalDouble(EvalState & state) const {
+   return value;
+}
+
+string DoubleConstantExp::toString() {
+   return doubleToString(value);
+}
+
+ExpressionType DoubleConstantExp::getType() {
+   return DOUBLE_CONSTANT;
+}
+
+ValueType DoubleConstantExp::getValueType() const {
+   return DOUBLE_TYPE;
+}
+
+double DoubleConstantExp::getValue() {
    return value;
 }
 
 /*
  * Implementation notes: the IdentifierExp subclass
  * ------------------------------------------------
- * The IdentifierExp subclass declares a single instance variable that
- * stores the name of the variable.  The implementation of eval must
- * look this variable up in the evaluation state.
+ * The IdentifierExp subclass stores the name of the variable, the
+ * slot that the symbol table assigned to it and its type.  The
+ * implementations of eval and evalDouble look the slot up in the
+ * evaluation state, which converts the value if the variable holds the
+ * other type; the name is needed only for toString and for the error
+ * message.
  */
 
-IdentifierExp::IdentifierExp(string name) {
-   this->name = name;
+IdentifierExp::IdentifierExp(string name, SymbolTable & symbols, Arena & arena) {
+   this->name = arena.copyString(name);
+   this->slot = symbols.intern(name, type);
 }
 
-int IdentifierExp::eval(EvalState & state) {
-   if (!state.isDefined(name)) error(name + " is undefined");
-   return state.getValue(name);
+long long IdentifierExp::eval(EvalState & state) const {
+   long long value;
+   if (!state.lookup(slot, value)) error(string(name) + " is undefined");
+   return value;
+}
+
+double IdentifierExp::evalDouble(EvalState & state) const {
+   double value;
+   if (!state.lookupDouble(slot, value)) error(string(name) + " is undefined");
+   return value;
+}
+
+ValueType IdentifierExp::getValueType() const {
+   return type;
+}
+
+void IdentifierExp::setValueType(ValueType type) {
+   this->type = type;
 }
 
 string IdentifierExp::toString() {
@@ -82,6 +155,176 @@ string IdentifierExp::getName() {
    return name;
 }
 
+int IdentifierExp::getSlot() {
+   return slot;
+}
+
+/*
+ * Implementation notes: the ElementExp subclass
+ * ---------------------------------------------
+ * The ElementExp subclass stores the key of the array, its slot and
+ * the subscript expressions.  Both subscripts are evaluated before the
+ * element is located, so an error in the second is reported before a
+ * bad value of the first.  A one-dimensional reference looks up
+ * column 1, which is where the elements of such an array are stored.
+ */
+
+ElementExp::ElementExp(string name, Expression *row, Expression *column,
+                       SymbolTable & symbols, Arena & arena) {
+   string key = arrayKey(name);
+   this->key = arena.copyString(key);
+   this->slot = symbols.intern(key);
+   this->row = row;
+   this->column = column;
+}
+
+long long ElementExp::eval(EvalState & state) const {
+   long long rowValue = row->eval(state);
+   long long columnValue = (column == NULL) ? 1 : column->eval(state);
+   return *locate(state, rowValue, columnValue);
+}
+
+long long *ElementExp::locate(EvalState & state, long long row, long long column) const {
+   int rank = getRank();
+   if (rank == 1) column = 1;
+   Array & array = state.getArray(slot);
+   long long *element = array.getElement(rank, row, column);
+   if (element == NULL) array.reportElementError(key, rank, row, column);
+   return element;
+}
+
+string ElementExp::toString() {
+   string result = getName() + "(" + row->toString();
+   if (column != NULL) result += ", " + column->toString();
+   return result + ")";
+}
+
+ExpressionType ElementExp::getType() {
+   return ELEMENT;
+}
+
+string ElementExp::getName() {
+   string name = key;
+   return name.substr(0, name.length() - 2);
+}
+
+string ElementExp::getKey() {
+   return key;
+}
+
+int ElementExp::getSlot() {
+   return slot;
+}
+
+int ElementExp::getRank() const {
+   return (column == NULL) ? 1 : 2;
+}
+
+Expression *ElementExp::getRow() {
+   return row;
+}
+
+Expression *ElementExp::getColumn() {
+   return column;
+}
+
+void ElementExp::setRow(Expression *row) {
+   this->row = row;
+}
+
+void ElementExp::setColumn(Expression *column) {
+   this->column = column;
+}
+
+/*
+ * Implementation notes: the SumExp subclass
+ * -----------------------------------------
+ * The work is done by sumArray, which uses the vectorized kernels, and
+ * the elements it reads are charged to the governor.
+ */
+
+SumExp::SumExp(string name, SymbolTable & symbols, Arena & arena) {
+   string key = arrayKey(name);
+   this->key = arena.copyString(key);
+   this->slot = symbols.intern(key);
+}
+
+long long SumExp::eval(EvalState & state) const {
+   Array & array = state.getArray(slot);
+   long long sum = sumArray(array, key);
+   state.getGovernor().chargeElements(array.getSize());
+   return sum;
+}
+
+string SumExp::toString() {
+   string name = key;
+   return "SUM(" + name.substr(0, name.length() - 2) + ")";
+}
+
+ExpressionType SumExp::getType() {
+   return SUM;
+}
+
+string SumExp::getKey() {
+   return key;
+}
+
+int SumExp::getSlot() {
+   return slot;
+}
+
+/*
+ * Implementation notes: operator and relation tokens
+ * --------------------------------------------------
+ * These conversions run only while parsing and printing.
+ */
+
+Operator stringToOperator(string token) {
+   if (token == "=") return ASSIGN_OP;
+   if (token == "+") return ADD_OP;
+   if (token == "-") return SUB_OP;
+   if (token == "*") return MUL_OP;
+   if (token == "/") return DIV_OP;
+   if (token == "<<") return SHL_OP;
+   if (token == ">>") return SHR_OP;
+   return ILLEGAL_OP;
+}
+
+string operatorToString(Operator op) {
+   switch (op) {
+    case ASSIGN_OP: return "=";
+    case ADD_OP: return "+";
+    case SUB_OP: return "-";
+    case MUL_OP: return "*";
+    case DIV_OP: return "/";
+    case SHL_OP: return "<<";
+    case SHR_OP: return ">>";
+    default: return "?";
+   }
+}
+
+Relation stringToRelation(string token) {
+   if (token == "=") return EQ_REL;
+   if (token == "<>") return NE_REL;
+   if (token == "<") return LT_REL;
+   if (token == "<=") return LE_REL;
+   if (token == ">") return GT_REL;
+   if (token == ">=") return GE_REL;
+   return ILLEGAL_REL;
+}
+
+string relationToString(Relation relation) {
+   switch (relation) {
+    case EQ_REL: return "=";
+    case NE_REL: return "<>";
+    case LT_REL: return "<";
+    case LE_REL: return "<=";
+    case GT_REL: return ">";
+    case GE_REL: return ">=";
+    default: return "?";
+   }
+}
+
 /*
  * Implementation notes: the CompoundExp subclass
  * ----------------------------------------------
@@ -91,45 +334,106 @@ string IdentifierExp::getName() {
  */
 
 CompoundExp::CompoundExp(string op, Expression *lhs, Expression *rhs) {
+   this->op = stringToOperator(op);
+   this->lhs = lhs;
+   this->rhs = rhs;
+}
+
+CompoundExp::CompoundExp(Operator op, Expression *lhs, Expression *rhs) {
    this->op = op;
    this->lhs = lhs;
    this->rhs = rhs;
 }
 
-CompoundExp::~CompoundExp() {
-   delete lhs;
-   delete rhs;
+/*
+ * Implementation notes: applyOperator, applyDoubleOperator
+ * --------------------------------------------------------
+ * These functions apply an arithmetic operator to two values.  When
+ * op is a compile-time constant, as it is in the specialized classes
+ * below, the compiler reduces the switch to the single operation.
+ * Integer arithmetic is done on unsigned values, so that overflow
+ * wraps without undefined behavior.  The shift operators never appear
+ * in a double node, since the optimizer introduces them only for
+ * integers.
+ */
+
+static inline long long applyOperator(Operator op, long long left, long long right) {
+   switch (op) {
+    case ADD_OP: return (long long) ((unsigned long long) left + (unsigned long long) right);
+    case SUB_OP: return (long long) ((unsigned long long) left - (unsigned long long) right);
+    case MUL_OP: return (long long) ((unsigned long long) left * (unsigned long long) right);
+    case DIV_OP:
+      if (right == 0) error("Division by zero");
+      return divideIntegers(left, right);
+    case SHL_OP: return shiftLeft(left, right);
+    case SHR_OP: return shiftRightTowardZero(left, right);
+    default:
+      error("Illegal operator in expression");
+      return 0;
+   }
+}
+
+static inline double applyDoubleOperator(Operator op, double left, double right) {
+   switch (op) {
+    case ADD_OP: return left + right;
+    case SUB_OP: return left - right;
+    case MUL_OP: return left * right;
+    case DIV_OP:
+      if (right == 0) error("Division by zero");
+      return left / right;
+    default:
+      error("Illegal operator in expression");
+      return 0;
+   }
 }
 
 /*
- * Implementation notes: eval
- * --------------------------
+ * Implementation notes: eval, evalDouble
+ * --------------------------------------
  * The eval method for the compound expression case must check for the
  * assignment operator as a special case.  Unlike the arithmetic operators
- * the assignment operator does not evaluate its left operand.
+ * the assignment operator does not evaluate its left operand.  This
+ * general version is used for assignments and for nodes constructed
+ * directly; nodes built by create use the specialized versions.  It
+ * tests its own type, which the specialized versions never need to.
  */
 
-int CompoundExp::eval(EvalState & state) {
-   if (op == "=") {
+long long CompoundExp::eval(EvalState & state) const {
+   if (getValueType() == DOUBLE_TYPE) return doubleToInteger(evalDouble(state));
+   if (op == ASSIGN_OP) {
+      if (lhs->getType() != IDENTIFIER) {
+         error("Illegal variable in assignment");
+      }
+      long long val = rhs->eval(state);
+      state.setValue(((IdentifierExp *) lhs)->getSlot(), val);
+      return val;
+   }
+   long long left = lhs->eval(state);
+   long long right = rhs->eval(state);
+   return applyOperator(op, left, right);
+}
+
+double CompoundExp::evalDouble(EvalState & state) const {
+   if (getValueType() == INTEGER_TYPE) return (double) eval(state);
+   if (op == ASSIGN_OP) {
       if (lhs->getType() != IDENTIFIER) {
          error("Illegal variable in assignment");
       }
-      int val = rhs->eval(state);
-      state.setValue(((IdentifierExp *) lhs)->getName(), val);
+      double val = rhs->evalDouble(state);
+      state.setDouble(((IdentifierExp *) lhs)->getSlot(), val);
       return val;
    }
-   int left = lhs->eval(state);
-   int right = rhs->eval(state);
-   if (op == "+") return left + right;
-   if (op == "-") return left - right;
-   if (op == "*") return left * right;
-   if (op == "/") return left / right;
-   error("Illegal operator in expression");
-   return 0;
+   double left = lhs->evalDouble(state);
+   double right = rhs->evalDouble(state);
+   return applyDoubleOperator(op, left, right);
 }
 
+ValueType CompoundExp::getValueType() const {
+   if (op == ASSIGN_OP) return lhs->getValueType();
+   return widerType(lhs->getValueType(), rhs->getValueType());
+}
 string CompoundExp::toString() {
-   return '(' + lhs->toString() + ' ' + op + ' ' + rhs->toString() + ')';
+   return '(' + lhs->toString() + ' ' + operatorToString(op) + ' ' + rhs->toString() + ')';
 }
 
 ExpressionType CompoundExp::getType() {
@@ -137,6 +441,10 @@ ExpressionType CompoundExp::getType() {
 }
 
 string CompoundExp::getOp() {
+   return operatorToString(op);
+}
+
+Operator CompoundExp::getOperator() {
    return op;
 }
 
@@ -148,3 +456,92 @@ Expression *CompoundExp::getRHS() {
    return rhs;
 }
 
+void CompoundExp::setLHS(Expression *lhs) {
+   this->lhs = lhs;
+}
+
+void CompoundExp::setRHS(Expression *rhs) {
+   this->rhs = rhs;
+}
+
+/*
+ * Implementation notes: ArithmeticExp, DoubleArithmeticExp
+ * --------------------------------------------------------
+ * Each instance of these templates is a CompoundExp specialized for
+ * one arithmetic operator on one type.  Its eval method is a separate
+ * virtual function with the operation built in, so evaluating a node
+ * costs one virtual call and no test of the operator or of a type.
+ * An integer node reached through evalDouble, or a double node reached
+ * through eval, converts its result once.
+ */
+
+template <Operator OP>
+class ArithmeticExp : public CompoundExp {
+
+public:
+
+   ArithmeticExp(Expression *lhs, Expression *rhs) : CompoundExp(OP, lhs, rhs) {
+      /* Empty */
+   }
+
+   virtual long long eval(EvalState & state) const {
+      long long left = lhs->eval(state);
+      long long right = rhs->eval(state);
+      return applyOperator(OP, left, right);
+   }
+
+   virtual double evalDouble(EvalState & state) const {
+      return (double) eval(state);
+   }
+
+   virtual ValueType getValueType() const {
+      return INTEGER_TYPE;
+   }
+
+};
+
+template <Operator OP>
+class DoubleArithmeticExp : public CompoundExp {
+
+public:
+
+   DoubleArithmeticExp(Expression *lhs, Expression *rhs) : CompoundExp(OP, lhs, rhs) {
+      /* Empty */
+   }
+
+   virtual long long eval(EvalState & state) const {
+      return doubleToInteger(evalDouble(state));
+   }
+
+   virtual double evalDouble(EvalState & state) const {
+      double left = lhs->evalDouble(state);
+      double right = rhs->evalDouble(state);
+      return applyDoubleOperator(OP, left, right);
+   }
+
+   virtual ValueType getValueType() const {
+      return DOUBLE_TYPE;
+   }
+
+};
+
+CompoundExp *CompoundExp::create(Operator op, Expression *lhs, Expression *rhs, Arena & arena) {
+   if (op != ASSIGN_OP && widerType(lhs->getValueType(), rhs->getValueType()) == DOUBLE_TYPE) {
+      switch (op) {
+       case ADD_OP: return new (arena) DoubleArithmeticExp<ADD_OP>(lhs, rhs);
+       case SUB_OP: return new (arena) DoubleArithmeticExp<SUB_OP>(lhs, rhs);
+       case MUL_OP: return new (arena) DoubleArithmeticExp<MUL_OP>(lhs, rhs);
+       case DIV_OP: return new (arena) DoubleArithmeticExp<DIV_OP>(lhs, rhs);
+       default: return new (arena) CompoundExp(op, lhs, rhs);
+      }
+   }
+   switch (op) {
+    case ADD_OP: return new (arena) ArithmeticExp<ADD_OP>(lhs, rhs);
+    case SUB_OP: return new (arena) ArithmeticExp<SUB_OP>(lhs, rhs);
+    case MUL_OP: return new (arena) ArithmeticExp<MUL_OP>(lhs, rhs);
+    case DIV_OP: return new (arena) ArithmeticExp<DIV_OP>(lhs, rhs);
+    case SHL_OP: return new (arena) ArithmeticExp<SHL_OP>(lhs, rhs);
+    case SHR_OP: return new (arena) ArithmeticExp<SHR_OP>(lhs, rhs);
+    default: return new (arena) CompoundExp(op, lhs, rhs);
+   }
+}
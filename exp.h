@@ -10,16 +10,63 @@
 #ifndef _exp_h
 #define _exp_h
 
+#include <string>
+#include "arena.h"
 #include "evalstate.h"
+#include "symtab.h"
 
 /*
  * Type: ExpressionType
  * --------------------
- * This enumerated type is used to differentiate the three different
- * expression types: CONSTANT, IDENTIFIER, and COMPOUND.
+ * This enumerated type is used to differentiate the expression types:
+ * CONSTANT, DOUBLE_CONSTANT, IDENTIFIER, COMPOUND, ELEMENT, and SUM.
  */
 
-enum ExpressionType { CONSTANT, IDENTIFIER, COMPOUND };
+enum ExpressionType { CONSTANT, DOUBLE_CONSTANT, IDENTIFIER, COMPOUND, ELEMENT, SUM };
+
+/*
+ * Type: Operator
+ * --------------
+ * This enumerated type identifies the operator of a compound
+ * expression.  The parser decodes each operator token once, so that
+ * evaluation never compares strings.  SHL_OP and SHR_OP are produced
+ * only by the optimizer, as described for CompoundExp below.
+ */
+
+enum Operator { ASSIGN_OP, ADD_OP, SUB_OP, MUL_OP, DIV_OP, SHL_OP, SHR_OP, ILLEGAL_OP };
+
+/*
+ * Type: Relation
+ * --------------
+ * This enumerated type identifies the comparison in an IF statement:
+ * =, <>, <, <=, > or >=.
+ */
+
+enum Relation { EQ_REL, NE_REL, LT_REL, LE_REL, GT_REL, GE_REL, ILLEGAL_REL };
+
+/*
+ * Functions: stringToOperator, operatorToString
+ * Usage: Operator op = stringToOperator(token);
+ *        string str = operatorToString(op);
+ * --------------------------------------------
+ * These functions convert between operator tokens and the Operator
+ * type.  An unrecognized token becomes ILLEGAL_OP.
+ */
+
+Operator stringToOperator(std::string token);
+std::string operatorToString(Operator op);
+
+/*
+ * Functions: stringToRelation, relationToString
+ * Usage: Relation relation = stringToRelation(token);
+ *        string str = relationToString(relation);
+ * --------------------------------------------------
+ * These functions convert between comparison tokens and the Relation
+ * type.  An unrecognized token becomes ILLEGAL_REL.
+ */
+
+Relation stringToRelation(std::string token);
+std::string relationToString(Relation relation);
 
 /*
  * Class: Expression
@@ -27,12 +74,15 @@ enum ExpressionType { CONSTANT, IDENTIFIER, COMPOUND };
  * This class is used to represent a node in an expression tree.
  * Expression is an example of an abstract class, which defines
  * the structure and behavior of a set of classes but has no
- * objects of its own.  Any object must be one of the three
+ * objects of its own.  Any object must be one of the six
  * concrete subclasses of Expression:
  *
- *  1. ConstantExp   -- an integer constant
- *  2. IdentifierExp -- a string representing an identifier
- *  3. CompoundExp   -- two expressions combined by an operator
+ *  1. ConstantExp       -- an integer constant
+ *  2. DoubleConstantExp -- a double constant
+ *  3. IdentifierExp     -- a string representing an identifier
+ *  4. CompoundExp       -- two expressions combined by an operator
+ *  5. ElementExp        -- an element of an array, such as A(I, J)
+ *  6. SumExp            -- the sum of the elements of an array, SUM(A)
  *
  * The Expression class defines the interface common to all
  * Expression objects; each subclass provides its own specific
@@ -42,6 +92,20 @@ enum ExpressionType { CONSTANT, IDENTIFIER, COMPOUND };
  * class is marked with the designation = 0 on the prototype line.
  * This notation is used in C++ to indicate that this method is
  * purely virtual and will always be supplied by the subclass.
+ *
+ * Every expression also has a value type, which getValueType returns.
+ * Integer expressions compute with 64-bit integers that wrap on
+ * overflow, and double expressions with doubles.  The type of a node
+ * is fixed by its class and by the types of its variables, so the
+ * evaluator never tests the type of a value: a caller that wants the
+ * value in the type of the node calls eval or evalDouble accordingly,
+ * and a caller that wants the other type calls the other method, which
+ * converts.
+ *
+ * Expressions are allocated in an Arena, normally the one owned by
+ * the program they belong to, and are freed with it rather than one
+ * at a time.  A node that the optimizer discards simply stays in the
+ * arena until then.
  */
 
 class Expression {
@@ -58,25 +122,39 @@ public:
    Expression();
 
 /*
- * Destructor: ~Expression
- * Usage: delete exp;
- * ------------------
- * The destructor deallocates the storage for this expression.
- * It must be declared virtual to ensure that the correct subclass
- * destructor is called when deleting an expression.
+ * Operators: new, delete
+ * Usage: Expression *exp = new (arena) ConstantExp(value);
+ * --------------------------------------------------------
+ * Allocates the node in the specified arena.  There is no ordinary
+ * form of new, so every node ends up in an arena.  The matching
+ * delete is used only when a constructor raises an error and does
+ * nothing, since the arena reclaims the memory later.
  */
 
-   virtual ~Expression();
+   static void *operator new(size_t size, Arena & arena);
+   static void operator delete(void *ptr, Arena & arena);
 
 /*
  * Method: eval
- * Usage: int value = exp->eval(state);
- * ------------------------------------
+ * Usage: long long value = exp->eval(state);
+ * ------------------------------------------
  * Evaluates this expression and returns its value in the context of
- * the specified EvalState object.
+ * the specified EvalState object.  The value of a double expression is
+ * converted to an integer with doubleToInteger.
+ */
+
+   virtual long long eval(EvalState & state) const = 0;
+
+/*
+ * Method: evalDouble
+ * Usage: double value = exp->evalDouble(state);
+ * ---------------------------------------------
+ * Evaluates this expression and returns its value as a double.  The
+ * default implementation converts the result of eval, which is right
+ * for every integer expression.
  */
 
-   virtual int eval(EvalState & state) = 0;
+   virtual double evalDouble(EvalState & state) const;
 
 /*
  * Method: toString
@@ -92,11 +170,33 @@ public:
  * Usage: ExpressionType type = exp->getType();
  * --------------------------------------------
  * Returns the type of the expression, which must be one of the constants
- * CONSTANT, IDENTIFIER, or COMPOUND.
+ * CONSTANT, DOUBLE_CONSTANT, IDENTIFIER, COMPOUND, ELEMENT, or SUM.
  */
 
    virtual ExpressionType getType() = 0;
 
+/*
+ * Method: getValueType
+ * Usage: ValueType type = exp->getValueType();
+ * --------------------------------------------
+ * Returns the type of the value the expression computes, which is
+ * INTEGER_TYPE or DOUBLE_TYPE.  The default implementation returns
+ * INTEGER_TYPE.
+ */
+
+   virtual ValueType getValueType() const;
+
+protected:
+
+/*
+ * Destructor: ~Expression
+ * -----------------------
+ * The destructor is protected, which makes deleting an expression
+ * a compile-time error, and nodes own nothing that would need it.
+ */
+
+   ~Expression();
+
 };
 
 /*
@@ -111,13 +211,13 @@ public:
 
 /*
  * Constructor: ConstantExp
- * Usage: Expression *exp = new ConstantExp(value);
- * ------------------------------------------------
+ * Usage: Expression *exp = new (arena) ConstantExp(value);
+ * --------------------------------------------------------
  * The constructor initializes a new integer constant expression
  * to the given value.
  */
 
-   ConstantExp(int value);
+   ConstantExp(long long value);
 
 /*
  * Prototypes for the virtual methods
@@ -126,23 +226,73 @@ public:
  * base class and don't require additional documentation.
  */
 
-   virtual int eval(EvalState & state);
+   virtual long long eval(EvalState & state) const;
    virtual std::string toString();
    virtual ExpressionType getType();
 
 /*
  * Method: getValue
- * Usage: int value = ((ConstantExp *) exp)->getValue();
- * -----------------------------------------------------
+ * Usage: long long value = ((ConstantExp *) exp)->getValue();
+ * -----------------------------------------------------------
  * Returns the value field without calling eval and can be applied
  * only to an object known to be a ConstantExp.
  */
 
-   int getValue();
+   long long getValue();
+
+private:
+
+   long long value;
+
+};
+
+/*
+ * Class: DoubleConstantExp
+ * ------------------------
+ * This subclass represents a constant double expression, which is
+ * written with a decimal point or an exponent.
+ */
+
+class DoubleConstantExp: public Expression {
+
+public:
+
+/*
+ * Constructor: DoubleConstantExp
+ * Usage: Expression *exp = new (arena) DoubleConstantExp(value);
+ * --------------------------------------------------------------
+ * The constructor initializes a new double constant expression to the
+ * given value.
+ */
+
+   DoubleConstantExp(double value);
+
+/*
+ * Prototypes for the virtual methods
+ * ----------------------------------
+ * These methods have the same prototypes as those in the Expression
+ * base class and don't require additional documentation.
+ */
+
+   virtual long long eval(EvalState & state) const;
+   virtual double evalDouble(EvalState & state) const;
+   virtual std::string toString();
+   virtual ExpressionType getType();
+   virtual ValueType getValueType() const;
+
+/*
+ * Method: getValue
+ * Usage: double value = ((DoubleConstantExp *) exp)->getValue();
+ * --------------------------------------------------------------
+ * Returns the value field without calling eval and can be applied
+ * only to an object known to be a DoubleConstantExp.
+ */
+
+   double getValue();
 
 private:
 
-   int value;
+   double value;
 
 };
 
@@ -158,13 +308,15 @@ public:
 
 /*
  * Constructor: IdentifierExp
- * Usage: Expression *exp = new IdentifierExp(name);
- * -------------------------------------------------
+ * Usage: Expression *exp = new (arena) IdentifierExp(name, symbols, arena);
+ * -------------------------------------------------------------------------
  * The constructor initializes a new identifier expression
- * for the variable named by name.
+ * for the variable named by name, interning the name in the
+ * specified symbol table to obtain its slot and its type.  The
+ * name is copied into the arena that holds the node.
  */
 
-   IdentifierExp(std::string name);
+   IdentifierExp(std::string name, SymbolTable & symbols, Arena & arena);
 
 /*
  * Prototypes for the virtual methods
@@ -173,9 +325,11 @@ public:
  * base class and don't require additional documentation.
  */
 
-   virtual int eval(EvalState & state);
+   virtual long long eval(EvalState & state) const;
+   virtual double evalDouble(EvalState & state) const;
    virtual std::string toString();
    virtual ExpressionType getType();
+   virtual ValueType getValueType() const;
 
 /*
  * Method: getName
@@ -187,9 +341,31 @@ public:
 
    std::string getName();
 
+/*
+ * Method: getSlot
+ * Usage: int slot = ((IdentifierExp *) exp)->getSlot();
+ * -----------------------------------------------------
+ * Returns the symbol table slot of the identifier and can be applied
+ * only to an object known to be an IdentifierExp.
+ */
+
+   int getSlot();
+
+/*
+ * Method: setValueType
+ * Usage: ((IdentifierExp *) exp)->setValueType(type);
+ * ---------------------------------------------------
+ * Changes the type of the identifier, as retyping does when the type
+ * of its variable has widened since the node was built.
+ */
+
+   void setValueType(ValueType type);
+
 private:
 
-   std::string name;
+   const char *name;
+   int slot;
+   ValueType type;
 
 };
 
@@ -197,7 +373,16 @@ private:
  * Class: CompoundExp
  * ------------------
  * This subclass represents a compound expression consisting of
- * two subexpressions joined by an operator.
+ * two subexpressions joined by an operator.  Besides the operators
+ * the parser produces, the optimizer uses "<<" and ">>" with a
+ * constant right operand k to stand for multiplying and dividing by
+ * 2 to the power k; ">>" rounds toward zero exactly as "/" does.
+ * The operator fields are protected so that the specialized
+ * subclasses returned by create can reach them directly.
+ *
+ * The type of an arithmetic node is the wider of the types of its
+ * operands.  An assignment has the type of its variable, which is
+ * widened when the assignment is parsed if the value is a double.
  */
 
 class CompoundExp: public Expression {
@@ -206,14 +391,31 @@ public:
 
 /*
  * Constructor: CompoundExp
- * Usage: Expression *exp = new CompoundExp(op, lhs, rhs);
- * -------------------------------------------------------
+ * Usage: Expression *exp = new (arena) CompoundExp(op, lhs, rhs);
+ * ---------------------------------------------------------------
  * The constructor initializes a new compound expression
  * which is composed of the operator (op) and the left and
- * right subexpression (lhs and rhs).
+ * right subexpression (lhs and rhs).  The operator may be
+ * given either as a token or as an Operator.
  */
 
    CompoundExp(std::string op, Expression *lhs, Expression *rhs);
+   CompoundExp(Operator op, Expression *lhs, Expression *rhs);
+
+/*
+ * Method: create
+ * Usage: Expression *exp = CompoundExp::create(op, lhs, rhs, arena);
+ * ------------------------------------------------------------------
+ * Returns a new compound expression, allocated in the arena, whose
+ * class is specialized for the operator and for the types of the
+ * operands, so that its eval method performs that one operation
+ * without any dispatch on the operator or test of a type.  The
+ * operands of a double node are evaluated as doubles, so an integer
+ * operand is promoted once, when its value is read.  The parser, the
+ * optimizer and retyping build all their compound nodes this way.
+ */
+
+   static CompoundExp *create(Operator op, Expression *lhs, Expression *rhs, Arena & arena);
 
 /*
  * Prototypes for the virtual methods
@@ -222,30 +424,269 @@ public:
  * base class and don't require additional documentation.
  */
 
-   virtual ~CompoundExp();
-   virtual int eval(EvalState & state);
+   virtual long long eval(EvalState & state) const;
+   virtual double evalDouble(EvalState & state) const;
    virtual std::string toString();
    virtual ExpressionType getType();
+   virtual ValueType getValueType() const;
 
 /*
- * Methods: getOp, getLHS, getRHS
+ * Methods: getOp, getOperator, getLHS, getRHS
  * Usage: string op = ((CompoundExp *) exp)->getOp();
+ *        Operator op = ((CompoundExp *) exp)->getOperator();
  *        Expression *lhs = ((CompoundExp *) exp)->getLHS();
  *        Expression *rhs = ((CompoundExp *) exp)->getRHS();
  * ---------------------------------------------------------
  * These methods return the components of a compound node and can
- * be applied only to an object known to be a CompoundExp.
+ * be applied only to an object known to be a CompoundExp.  The
+ * getOp method returns the operator as a token.
  */
 
    std::string getOp();
+   Operator getOperator();
    Expression *getLHS();
    Expression *getRHS();
 
-private:
+/*
+ * Methods: setLHS, setRHS
+ * Usage: ((CompoundExp *) exp)->setLHS(lhs);
+ *        ((CompoundExp *) exp)->setRHS(rhs);
+ * ------------------------------------------
+ * These methods replace a subexpression, as the optimizer does when
+ * it rewrites a tree in place.  The previous subexpression stays in
+ * its arena.
+ */
+
+   void setLHS(Expression *lhs);
+   void setRHS(Expression *rhs);
+
+protected:
 
-   std::string op;
+   Operator op;
    Expression *lhs, *rhs;
 
 };
 
+/*
+ * Class: ElementExp
+ * -----------------
+ * This subclass represents a reference to an element of an array
+ * created by DIM, with one or two subscripts.  The array is interned
+ * in the symbol table under its name followed by "()", so an array
+ * and a variable may share a name.  The same node serves as the
+ * target of an assignment to an element and as the declarator in a
+ * DIM statement, where its subscripts are the extents.
+ */
+
+class ElementExp : public Expression {
+
+public:
+
+/*
+ * Constructor: ElementExp
+ * Usage: Expression *exp = new (arena) ElementExp(name, row, column, symbols, arena);
+ * -----------------------------------------------------------------------------------
+ * The constructor initializes a reference to an element of the array
+ * with the given name.  The column is NULL for a one-dimensional
+ * reference.  The name is copied into the arena.
+ */
+
+   ElementExp(std::string name, Expression *row, Expression *column, SymbolTable & symbols,
+              Arena & arena);
+
+/*
+ * Prototypes for the virtual methods
+ * ----------------------------------
+ * These methods have the same prototypes as those in the Expression
+ * base class and don't require additional documentation.
+ */
+
+   virtual long long eval(EvalState & state) const;
+   virtual std::string toString();
+   virtual ExpressionType getType();
+
+/*
+ * Methods: getName, getKey, getSlot, getRank, getRow, getColumn
+ * Usage: string name = ((ElementExp *) exp)->getName();
+ *        string key = ((ElementExp *) exp)->getKey();
+ *        int slot = ((ElementExp *) exp)->getSlot();
+ *        int rank = ((ElementExp *) exp)->getRank();
+ *        Expression *row = ((ElementExp *) exp)->getRow();
+ *        Expression *column = ((ElementExp *) exp)->getColumn();
+ * ---------------------------------------------------------------
+ * These methods return the components of an element reference and can
+ * be applied only to an object known to be an ElementExp.  The key is
+ * the name under which the array is interned, the slot is that of the
+ * key, the rank is the number of subscripts and the column is NULL if
+ * the rank is 1.
+ */
+
+   std::string getName();
+   std::string getKey();
+   int getSlot();
+   int getRank() const;
+   Expression *getRow();
+   Expression *getColumn();
+
+/*
+ * Methods: setRow, setColumn
+ * Usage: ((ElementExp *) exp)->setRow(row);
+ *        ((ElementExp *) exp)->setColumn(column);
+ * -----------------------------------------------
+ * These methods replace a subscript without freeing the previous one,
+ * as the optimizer does when it rewrites the tree.
+ */
+
+   void setRow(Expression *row);
+   void setColumn(Expression *column);
+
+/*
+ * Method: locate
+ * Usage: long long *element = ((ElementExp *) exp)->locate(state, row, column);
+ * -----------------------------------------------------------------------------
+ * Returns the element at the specified subscript values, which have
+ * already been evaluated, calling error if there is no such element.
+ * The column is ignored if the rank is 1.  Arrays hold integers, so
+ * subscripts and elements are always evaluated with eval.
+ */
+
+   long long *locate(EvalState & state, long long row, long long column) const;
+
+private:
+
+   const char *key;
+   int slot;
+   Expression *row;
+   Expression *column;
+
+};
+
+/*
+ * Class: SumExp
+ * -------------
+ * This subclass represents SUM(A), the sum of all the elements of an
+ * array.  The sum wraps on overflow, as addition does.
+ */
+
+class SumExp : public Expression {
+
+public:
+
+/*
+ * Constructor: SumExp
+ * Usage: Expression *exp = new (arena) SumExp(name, symbols, arena);
+ * ------------------------------------------------------------------
+ * The constructor initializes the sum of the array with the given
+ * name, interning its key in the symbol table.
+ */
+
+   SumExp(std::string name, SymbolTable & symbols, Arena & arena);
+
+/*
+ * Prototypes for the virtual methods
+ * ----------------------------------
+ * These methods have the same prototypes as those in the Expression
+ * base class and don't require additional documentation.
+ */
+
+   virtual long long eval(EvalState & state) const;
+   virtual std::string toString();
+   virtual ExpressionType getType();
+
+/*
+ * Methods: getKey, getSlot
+ * Usage: string key = ((SumExp *) exp)->getKey();
+ *        int slot = ((SumExp *) exp)->getSlot();
+ * ----------------------------------------------
+ * These methods return the key and slot of the array and can be
+ * applied only to an object known to be a SumExp.
+ */
+
+   std::string getKey();
+   int getSlot();
+
+private:
+
+   const char *key;
+   int slot;
+
+};
+
+/*
+ * Function: arrayKey
+ * Usage: string key = arrayKey(name);
+ * -----------------------------------
+ * Returns the key under which the array with the given name is
+ * interned in the symbol table.
+ */
+
+inline std::string arrayKey(const std::string & name) {
+   return name + "()";
+}
+
+/*
+ * Functions: shiftLeft, shiftRightTowardZero
+ * Usage: long long product = shiftLeft(value, k);
+ *        long long quotient = shiftRightTowardZero(value, k);
+ * -----------------------------------------------------------
+ * These functions implement the "<<" and ">>" operators, which the
+ * optimizer substitutes for integer multiplication and division by 2
+ * to the power k, where k is between 1 and 62.  Both give exactly the
+ * result of the operation they replace: the product wraps on overflow,
+ * and the quotient of a negative value is rounded toward zero by
+ * adding 2^k - 1 before shifting.  They are shared by the tree
+ * interpreter and the virtual machine.
+ */
+
+inline long long shiftLeft(long long value, long long k) {
+   return (long long) ((unsigned long long) value << k);
+}
+
+inline long long shiftRightTowardZero(long long value, long long k) {
+   return (value + ((value >> 63) & ((1LL << k) - 1))) >> k;
+}
+
+/*
+ * Function: divideIntegers
+ * Usage: long long quotient = divideIntegers(dividend, divisor);
+ * --------------------------------------------------------------
+ * Returns the quotient of two integers, rounded toward zero, for a
+ * divisor that is not 0.  A 64-bit division is several times slower
+ * than a 32-bit one on most processors, so operands that are both
+ * nonnegative 31-bit values, as most are, use the narrow division,
+ * which gives the same quotient.  A divisor of -1 negates the dividend,
+ * so that the smallest integer divided by -1 wraps to itself, as the
+ * other operations wrap, instead of trapping.  The tree interpreter
+ * and the virtual machine share this function.
+ */
+
+inline long long divideIntegers(long long dividend, long long divisor) {
+   if ((((unsigned long long) dividend | (unsigned long long) divisor) >> 31) == 0) {
+      return (unsigned) dividend / (unsigned) divisor;
+   }
+   if (divisor == -1) return (long long) (0 - (unsigned long long) dividend);
+   return dividend / divisor;
+}
+
+/*
+ * Function: testRelation
+ * Usage: if (testRelation(relation, lhs, rhs)) . . .
+ * --------------------------------------------------
+ * Returns true if the values satisfy the relation.  The same template
+ * serves integer and double comparisons.
+ */
+
+template <typename T>
+inline bool testRelation(Relation relation, T lhs, T rhs) {
+   switch (relation) {
+    case EQ_REL: return lhs == rhs;
+    case NE_REL: return lhs != rhs;
+    case LT_REL: return lhs < rhs;
+    case LE_REL: return lhs <= rhs;
+    case GT_REL: return lhs > rhs;
+    case GE_REL: return lhs >= rhs;
+    default: return false;
+   }
+}
+
 #endif
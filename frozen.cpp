@@ -0,0 +1,129 @@
+/*
+ * File: frozen.cpp
+ * ----------------
+ * This file implements the FrozenProgram class.
+ */
+
+#include <algorithm>
+#include <string>
+#include "compiler.h"
+#include "error.h"
+#include "frozen.h"
+#include "interpreter.h"
+#include "loader.h"
+#include "vm.h"
+using namespace std;
+
+/*
+ * Implementation notes: FrozenProgram
+ * -----------------------------------
+ * The lines are added again with addProgramLine, as the console adds
+ * them, rather than shared with the program, since link retypes the
+ * statements of a program whose variables have widened and an edit
+ * frees them.  A line that fails to parse is stored without a
+ * statement, so that link reports it exactly as RUN would.  Once link
+ * has resolved the jumps, the index is built from its pointers: the
+ * lines are in numeric order, so the position of a target is found by
+ * binary search, and the cost of a jump backward is the difference of
+ * the two positions, counting both lines, as countLoopLines finds it.
+ * Everything the runs read is complete before the constructor returns,
+ * which is what makes sharing the object between threads safe.
+ */
+
+FrozenProgram::FrozenProgram(Program & source) {
+   for (int lineNumber = source.getFirstLineNumber(); lineNumber != -1;
+        lineNumber = source.getNextLineNumber(lineNumber)) {
+      try {
+         addProgramLine(program, source.getSourceLine(lineNumber));
+      } catch (ErrorException &) {
+         /* Reported by link below */
+      }
+   }
+   for (Program::SourceLine *line = program.link(); line != NULL; line = line->next) {
+      FrozenLine entry;
+      entry.lineNumber = line->lineNumber;
+      entry.statement = line->lineParsed;
+      entry.next = (line->next == NULL) ? -1 : lines.size() + 1;
+      entry.target = (line->target == NULL) ? -1 : line->target->lineNumber;
+      entry.cost = 0;
+      lines.push_back(entry);
+   }
+   for (int index = 0; index < (int) lines.size(); index++) {
+      FrozenLine & entry = lines[index];
+      if (entry.target == -1) continue;
+      int targetLineNumber = entry.target;
+      auto it = lower_bound(lines.begin(), lines.end(), targetLineNumber,
+                            [](const FrozenLine & line, int lineNumber) {
+                               return line.lineNumber < lineNumber;
+                            });
+      entry.target = it - lines.begin();
+      if (entry.target <= index) entry.cost = index - entry.target + 1;
+   }
+   SymbolTable & symbols = program.getSymbolTable();
+   for (int slot = 0; slot < symbols.size(); slot++) {
+      slotTypes.push_back(symbols.getType(slot));
+      slotNames.push_back(symbols.getName(slot));
+   }
+   compileProgram(program, bytecode);
+}
+
+void FrozenProgram::run(EvalState & state) const {
+   checkState(state);
+   executeBytecode(bytecode, state);
+}
+
+/*
+ * Implementation notes: runStatements
+ * -----------------------------------
+ * The loop is that of walkStatements, with positions in the index in
+ * place of the SourceLine pointers.  The governor is charged at each
+ * jump backward as it is there, from the costs in the index.
+ */
+
+void FrozenProgram::runStatements(EvalState & state) const {
+   checkState(state);
+   Governor & governor = state.getGovernor();
+   state.startRun();
+   int index = lines.empty() ? -1 : 0;
+   while (index != -1) {
+      const FrozenLine & line = lines[index];
+      int nextLineNumber = (line.next == -1) ? END_PROGRAM_LINE_NUMBER
+                                             : lines[line.next].lineNumber;
+      state.setCurrentLine(nextLineNumber);
+      line.statement->execute(state);
+      int currentLineNumber = state.getCurrentLine();
+      if (currentLineNumber == nextLineNumber) {
+         index = line.next;
+      } else if (currentLineNumber == END_PROGRAM_LINE_NUMBER) {
+         index = -1;
+      } else {
+         if (currentLineNumber <= line.lineNumber) governor.charge(line.cost);
+         index = line.target;
+      }
+   }
+}
+
+int FrozenProgram::getLineCount() const {
+   return lines.size();
+}
+
+/*
+ * Implementation notes: checkState
+ * --------------------------------
+ * A frozen program cannot be retyped, so a variable that the state
+ * already holds as a double but the program made an integer is
+ * reported rather than read as an integer, which would lose its
+ * fraction.
+ */
+
+void FrozenProgram::checkState(EvalState & state) const {
+   if (state.getCheckpointer().getFilename() != "") {
+      error("A frozen program cannot take checkpoints");
+   }
+   int count = min(state.getSlotCount(), (int) slotTypes.size());
+   for (int slot = 0; slot < count; slot++) {
+      if (state.getType(slot) == DOUBLE_TYPE && slotTypes[slot] != DOUBLE_TYPE) {
+         error(slotNames[slot] + " holds a double, which the frozen program reads as an integer");
+      }
+   }
+}
@@ -0,0 +1,113 @@
+/*
+ * File: frozen.h
+ * --------------
+ * This interface exports the FrozenProgram class, an immutable snapshot
+ * of a program that any number of threads can run at the same time.
+ */
+
+#ifndef _frozen_h
+#define _frozen_h
+
+#include <string>
+#include <vector>
+#include "bytecode.h"
+#include "evalstate.h"
+#include "program.h"
+#include "statement.h"
+
+/*
+ * Class: FrozenProgram
+ * --------------------
+ * This class holds a program that can no longer change: its parsed
+ * statements, an index of its lines with every jump resolved, and its
+ * bytecode.  Nothing in a frozen program is written once the
+ * constructor returns, and everything a run changes lives in the
+ * EvalState passed to it, which serves as the run's execution context.
+ * Threads may therefore run one frozen program concurrently without
+ * locks, provided each has an EvalState of its own.
+ */
+
+class FrozenProgram {
+
+public:
+
+/*
+ * Constructor: FrozenProgram
+ * Usage: FrozenProgram frozen(program);
+ * -------------------------------------
+ * Takes a snapshot of the program.  The source lines are parsed again
+ * into statements the frozen program owns, so later edits to the
+ * program do not affect it.  A line that cannot be parsed or a jump to
+ * a missing line is reported by calling error, as RUN reports it.
+ */
+
+   FrozenProgram(Program & program);
+
+/*
+ * Method: run
+ * Usage: frozen.run(state);
+ * -------------------------
+ * Executes the bytecode on the virtual machine with the specified
+ * state.  Checkpoints would need the program's source, so a state that
+ * takes them is reported by calling error, as is a state that already
+ * holds a double in a variable the program makes an integer.
+ */
+
+   void run(EvalState & state) const;
+
+/*
+ * Method: runStatements
+ * Usage: frozen.runStatements(state);
+ * -----------------------------------
+ * Executes the parsed statements one at a time, as runStatements in
+ * interpreter.h does, but following the frozen line index.  The output
+ * and errors are the same as those of run.
+ */
+
+   void runStatements(EvalState & state) const;
+
+/*
+ * Method: getLineCount
+ * Usage: int count = frozen.getLineCount();
+ * -----------------------------------------
+ * Returns the number of lines in the program.
+ */
+
+   int getLineCount() const;
+
+private:
+
+/*
+ * Type: FrozenLine
+ * ----------------
+ * This structure holds one entry of the line index.  The next and
+ * target fields hold the positions in the index of the following line
+ * and of the line a GOTO or IF statement names, or -1 if there is no
+ * such line.  For a line that jumps backward, cost holds what the
+ * governor is charged for the loop the jump closes.
+ */
+
+   struct FrozenLine {
+      int lineNumber;
+      const Statement *statement;
+      int next;
+      int target;
+      int cost;
+   };
+
+   Program program;                      /* Owns the statements              */
+   std::vector<FrozenLine> lines;        /* The line index, in numeric order */
+   Bytecode bytecode;
+   std::vector<ValueType> slotTypes;     /* The type of each variable        */
+   std::vector<std::string> slotNames;   /* The name of each variable        */
+
+   void checkState(EvalState & state) const;
+
+/* Frozen programs cannot be copied, since the index points into the statements */
+
+   FrozenProgram(const FrozenProgram & src) = delete;
+   FrozenProgram & operator=(const FrozenProgram & src) = delete;
+
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * File: governor.cpp
+ * ------------------
+ * This file implements the Governor class.
+ */
+
+#include <chrono>
+#include <climits>
+#include <string>
+#include "error.h"
+#include "governor.h"
+#include "value.h"
+using namespace std;
+
+Governor::Governor() {
+   limits.maxStatements = 0;
+   limits.maxSeconds = 0;
+   limits.maxVariables = 0;
+   limits.maxMemory = 0;
+   checkpointInterval = 0;
+   start();
+}
+
+void Governor::setLimits(const ResourceLimits & limits) {
+   this->limits = limits;
+}
+
+ResourceLimits Governor::getLimits() {
+   return limits;
+}
+
+bool Governor::isActive() {
+   return limits.maxStatements != 0 || limits.maxSeconds != 0
+       || limits.maxVariables != 0 || limits.maxMemory != 0 || checkpointInterval != 0;
+}
+
+void Governor::setCheckpointInterval(long long statements) {
+   checkpointInterval = statements;
+}
+
+long long Governor::getCheckpointInterval() {
+   return checkpointInterval;
+}
+
+void Governor::clearCheckpoint() {
+   checkpointDue = false;
+}
+
+/*
+ * Implementation notes: start
+ * ---------------------------
+ * The time limit is measured from here, and the first checkpoint is
+ * due after one interval.
+ */
+
+void Governor::start() {
+   charged = 0;
+   checkpointDue = false;
+   nextCheckpoint = checkpointInterval;
+   elementFuel = GOVERNOR_CHECK_INTERVAL;
+   if (limits.maxSeconds != 0) {
+      deadline = chrono::steady_clock::now()
+               + chrono::duration_cast<chrono::steady_clock::duration>(
+                    chrono::duration<double>(limits.maxSeconds));
+   }
+   grantFuel();
+}
+
+long long *Governor::getFuel() {
+   return &fuel;
+}
+
+/*
+ * Implementation notes: refuel
+ * ----------------------------
+ * The fuel is negative by the number of statements charged past the
+ * last grant, so the statements used since then are the grant minus
+ * what remains.  The statement limit is exceeded only once the count
+ * passes it.
+ */
+
+void Governor::refuel() {
+   charged += granted - fuel;
+   if (limits.maxStatements != 0 && charged > limits.maxStatements) {
+      fuel = granted = 0;
+      error("Statement limit of " + to_string(limits.maxStatements) + " exceeded");
+   }
+   if (limits.maxSeconds != 0 && chrono::steady_clock::now() >= deadline) {
+      fuel = granted = 0;
+      error("Time limit of " + doubleToString(limits.maxSeconds) + " seconds exceeded");
+   }
+   if (checkpointInterval != 0 && charged >= nextCheckpoint) {
+      checkpointDue = true;
+      nextCheckpoint = charged + checkpointInterval;
+   }
+   grantFuel();
+}
+
+/*
+ * Implementation notes: checkTime
+ * -------------------------------
+ * This is the slow path of chargeElements.  Only the time limit
+ * concerns elements, so the statement fuel is left as it is.
+ */
+
+void Governor::checkTime() {
+   elementFuel = GOVERNOR_CHECK_INTERVAL;
+   if (limits.maxSeconds != 0 && chrono::steady_clock::now() >= deadline) {
+      error("Time limit of " + doubleToString(limits.maxSeconds) + " seconds exceeded");
+   }
+}
+
+/*
+ * Implementation notes: grantFuel
+ * -------------------------------
+ * The next check is arranged for after no more statements than the
+ * statement limit allows and no later than the next checkpoint, so
+ * that a run with a small limit stops as soon as it is exceeded.
+ * Without a statement or time limit or a checkpoint there is nothing
+ * to check, and the fuel lasts as long as any run could.
+ */
+
+void Governor::grantFuel() {
+   if (limits.maxStatements == 0 && limits.maxSeconds == 0 && checkpointInterval == 0) {
+      granted = LLONG_MAX;
+   } else {
+      granted = GOVERNOR_CHECK_INTERVAL;
+      if (limits.maxStatements != 0 && limits.maxStatements - charged < granted) {
+         granted = limits.maxStatements - charged;
+      }
+      if (checkpointInterval != 0 && nextCheckpoint - charged < granted) {
+         granted = nextCheckpoint - charged;
+      }
+   }
+   fuel = granted;
+}
+
+void Governor::checkVariables(long long count) {
+   if (limits.maxVariables != 0 && count > limits.maxVariables) {
+      error("Variable limit of " + to_string(limits.maxVariables) + " exceeded");
+   }
+}
+
+void Governor::checkMemory(long long bytes) {
+   if (limits.maxMemory != 0 && bytes > limits.maxMemory) {
+      error("Memory limit of " + to_string(limits.maxMemory) + " bytes exceeded");
+   }
+}
+
+long long Governor::getStatementCount() {
+   return charged + (granted - fuel);
+}
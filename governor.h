@@ -0,0 +1,247 @@
+/*
+ * File: governor.h
+ * ----------------
+ * This interface exports the Governor class, which enforces the limits
+ * a run of a program is held to: how many statements it may execute,
+ * how long it may take, and how many variables and how much memory it
+ * may use.
+ */
+
+#ifndef _governor_h
+#define _governor_h
+
+#include <chrono>
+
+/* Constants */
+
+const long long GOVERNOR_CHECK_INTERVAL = 1LL << 16;
+
+/*
+ * Type: ResourceLimits
+ * --------------------
+ * This structure holds the limits for a run.  A field that is 0 sets
+ * no limit.  The time limit is in seconds of wall-clock time, including
+ * any time spent waiting for INPUT.  The variable limit counts slots,
+ * of which each array takes one, and the memory limit is in bytes and
+ * covers the table of slots and the elements of the arrays.
+ */
+
+struct ResourceLimits {
+   long long maxStatements;
+   double maxSeconds;
+   long long maxVariables;
+   long long maxMemory;
+};
+
+/*
+ * Class: Governor
+ * ---------------
+ * This class keeps the accounts for the limits of an EvalState.  The
+ * engines do not count statements one at a time.  Instead, each time a
+ * program jumps backward they charge the governor for the statements
+ * executed since the loop began, which costs a subtraction and a
+ * comparison against a counter called the fuel.  Only when the fuel
+ * runs out, every GOVERNOR_CHECK_INTERVAL statements at most, does the
+ * governor add up the statements and read the clock.  A program that
+ * never jumps backward runs each of its lines at most once, so it
+ * needs no checks at all, and the statements run after the last jump
+ * backward are never charged: a run may go past its statement limit
+ * by at most the length of the program.
+ *
+ * A statement that works on whole arrays, which MAT, DIM and any
+ * statement using SUM do, counts as one statement but may touch
+ * millions of elements.  The engines therefore also charge the
+ * elements it touches to a separate account, and the clock is read
+ * whenever GOVERNOR_CHECK_INTERVAL elements have been charged since the
+ * last reading.
+ *
+ * The variable and memory limits are checked whenever the state grows:
+ * when slots are added, which the virtual machine does before the
+ * program starts, at DIM and after MAT.
+ *
+ * A limit that is exceeded stops the run by calling error, so the
+ * program, its variables and the session remain as they were when it
+ * stopped.
+ *
+ * The governor also schedules checkpoints.  With a checkpoint interval
+ * set, no grant of fuel reaches past the next checkpoint, and the check
+ * that finds the run has reached it marks a checkpoint as due.  The
+ * engines look for that mark only after the fuel runs out, and take
+ * the checkpoint at the next line they are about to begin, as described
+ * in checkpoint.h.
+ */
+
+class Governor {
+
+public:
+
+/*
+ * Constructor: Governor
+ * Usage: Governor governor;
+ * -------------------------
+ * Creates a governor with no limits.
+ */
+
+   Governor();
+
+/*
+ * Methods: setLimits, getLimits
+ * Usage: governor.setLimits(limits);
+ *        ResourceLimits limits = governor.getLimits();
+ * ----------------------------------------------------
+ * These methods set and return the limits applied to later runs.
+ */
+
+   void setLimits(const ResourceLimits & limits);
+   ResourceLimits getLimits();
+
+/*
+ * Method: isActive
+ * Usage: if (governor.isActive()) . . .
+ * -------------------------------------
+ * Returns true if any limit is set.  Engines that pay for accounting
+ * in their inner loop use this to run without it when it is not.
+ */
+
+   bool isActive();
+
+/*
+ * Methods: setCheckpointInterval, getCheckpointInterval
+ * Usage: governor.setCheckpointInterval(statements);
+ *        long long statements = governor.getCheckpointInterval();
+ * ---------------------------------------------------------------
+ * These methods set and return the number of statements between
+ * checkpoints, which is 0 if none are taken.  A governor with an
+ * interval is active even if it sets no limits.
+ */
+
+   void setCheckpointInterval(long long statements);
+   long long getCheckpointInterval();
+
+/*
+ * Methods: isCheckpointDue, clearCheckpoint
+ * Usage: if (governor.isCheckpointDue()) . . .
+ *        governor.clearCheckpoint();
+ * -------------------------------------------
+ * The first method returns true once the run has executed another
+ * interval of statements since the last checkpoint; the second
+ * records that the checkpoint has been taken.
+ */
+
+   bool isCheckpointDue();
+   void clearCheckpoint();
+
+/*
+ * Method: start
+ * Usage: governor.start();
+ * ------------------------
+ * Begins a run: the statement count starts again from zero and the
+ * time limit is measured from now.
+ */
+
+   void start();
+
+/*
+ * Method: charge
+ * Usage: governor.charge(statements);
+ * -----------------------------------
+ * Charges the run for the specified number of statements, checking
+ * the statement and time limits if the fuel has run out.
+ */
+
+   void charge(long long statements);
+
+/*
+ * Method: getFuel
+ * Usage: long long *fuel = governor.getFuel();
+ * --------------------------------------------
+ * Returns the fuel counter itself, for native code that subtracts
+ * from it directly.  Such code must call refuel once the counter goes
+ * below zero and before it goes on to the next loop iteration.
+ */
+
+   long long *getFuel();
+
+/*
+ * Method: chargeElements
+ * Usage: governor.chargeElements(elements);
+ * -----------------------------------------
+ * Charges the run for work on the specified number of array elements,
+ * checking the time limit if enough elements have been charged since
+ * the last check.  The elements do not count as statements.
+ */
+
+   void chargeElements(long long elements);
+
+/*
+ * Method: refuel
+ * Usage: governor.refuel();
+ * -------------------------
+ * Checks the statement and time limits, calling error if either has
+ * been exceeded, and otherwise grants more fuel.  This is the slow
+ * path of charge.
+ */
+
+   void refuel();
+
+/*
+ * Methods: checkVariables, checkMemory
+ * Usage: governor.checkVariables(count);
+ *        governor.checkMemory(bytes);
+ * -------------------------------------
+ * These methods call error if a state holding the specified number of
+ * variable slots or the specified number of bytes would exceed its
+ * limit.  They are checked even between runs, so a state that grows at
+ * the console is held to the same limits.
+ */
+
+   void checkVariables(long long count);
+   void checkMemory(long long bytes);
+
+/*
+ * Method: getStatementCount
+ * Usage: long long count = governor.getStatementCount();
+ * ------------------------------------------------------
+ * Returns the number of statements charged since the run started.
+ */
+
+   long long getStatementCount();
+
+private:
+
+   ResourceLimits limits;
+   long long fuel;               /* Statements left before the next check     */
+   long long granted;            /* Fuel at the last check                     */
+   long long charged;            /* Statements accounted for at the last check */
+   long long checkpointInterval; /* Statements between checkpoints, or 0      */
+   long long nextCheckpoint;     /* The count at which the next one is due    */
+   bool checkpointDue;           /* True if a checkpoint is waiting           */
+   long long elementFuel;        /* Elements left before the next clock check */
+   std::chrono::steady_clock::time_point deadline;
+
+   void grantFuel();
+   void checkTime();
+
+};
+
+/*
+ * Implementation notes: charge, chargeElements, isCheckpointDue
+ * -------------------------------------------------------------
+ * These are defined here so that the engine loops can inline them.
+ */
+
+inline void Governor::charge(long long statements) {
+   fuel -= statements;
+   if (fuel < 0) refuel();
+}
+
+inline void Governor::chargeElements(long long elements) {
+   elementFuel -= elements;
+   if (elementFuel < 0) checkTime();
+}
+
+inline bool Governor::isCheckpointDue() {
+   return checkpointDue;
+}
+
+#endif
@@ -0,0 +1,752 @@
+/*
+ * File: image.cpp
+ * ---------------
+ * This file implements program images.
+ */
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "bytecode.h"
+#include "compiler.h"
+#include "error.h"
+#include "exp.h"
+#include "image.h"
+#include "program.h"
+#include "statement.h"
+#include "strlib.h"
+#include "vm.h"
+using namespace std;
+
+/* Constants */
+
+static const char IMAGE_SIGNATURE[8] = { 'B', 'A', 'S', 'I', 'C', 'I', 'M', 'G' };
+
+/*
+ * Implementation notes: image format
+ * ----------------------------------
+ * An image is a header followed by seven sections, each starting at an
+ * offset that is a multiple of eight:
+ *
+ *    symbols    an ImageString for the name of each variable slot,
+ *               whose flags field holds the type of the variable
+ *    messages   an ImageString for each error message in the bytecode
+ *    lines      an ImageLine for each program line, in increasing order
+ *    nodes      an ImageNode for each statement and expression
+ *    code       the bytecode, one 32-bit word per entry
+ *    costs      the backEdgeCosts of the bytecode, one word per entry
+ *    strings    the characters of every ImageString, back to back
+ *
+ * Nodes are stored children first, so that a node refers only to
+ * nodes with smaller indices and install can build all of them in one
+ * pass.  The file is padded to a multiple of eight bytes, and the
+ * checksum is an FNV-1a hash of everything after the header taken
+ * eight bytes at a time, which checks a large image at memory speed.
+ * IMAGE_VERSION must change whenever these records, the node kinds or
+ * the instruction set in bytecode.h change.
+ */
+
+struct ImageHeader {
+   char signature[8];
+   uint32_t version;
+   uint32_t headerSize;
+   uint64_t fileSize;
+   uint64_t checksum;
+   uint32_t symbolCount;
+   uint32_t messageCount;
+   uint32_t lineCount;
+   uint32_t nodeCount;
+   uint32_t codeLength;
+   uint32_t maxStack;
+   uint32_t removedNodes;
+   uint32_t reserved;
+   uint64_t symbolsOffset;
+   uint64_t messagesOffset;
+   uint64_t linesOffset;
+   uint64_t nodesOffset;
+   uint64_t codeOffset;
+   uint64_t costsOffset;
+   uint64_t stringsOffset;
+   uint64_t stringsSize;
+};
+
+struct ImageString {
+   uint64_t offset; //Position within the strings section
+   uint32_t length;
+   uint32_t flags;
+};
+
+struct ImageLine {
+   int32_t lineNumber;
+   int32_t node; //Index of the statement in the nodes section
+   ImageString text;
+};
+
+/*
+ * Type: ImageNode
+ * ---------------
+ * This structure stores one statement or expression.  The meaning of
+ * the fields depends on the kind:
+ *
+ *    kind             detail     value      left       right
+ *    CONSTANT_NODE               value
+ *    DOUBLE_NODE                 bits
+ *    IDENTIFIER_NODE             slot
+ *    COMPOUND_NODE    operator              lhs        rhs
+ *    REM_NODE
+ *    LET_NODE                    slot       exp
+ *    PRINT_NODE                             exp
+ *    INPUT_NODE                  slot
+ *    GOTO_NODE                   target
+ *    IF_NODE          relation   target     lhs        rhs
+ *    END_NODE
+ *    ELEMENT_NODE     rank       slot       row        column or -1
+ *    SUM_NODE                    slot
+ *    DIM_NODE                               element
+ *    LET_ELEMENT_NODE                       element    exp
+ *    MAT_NODE         operation  target     lhs slot   rhs slot or scalar
+ *
+ * The value of a DOUBLE_NODE holds the bits of the double.  The slots
+ * of ELEMENT_NODE, SUM_NODE and MAT_NODE are those of array
+ * keys, whose names end in "()".  A MAT_NODE holds -1 for an operand
+ * its operation does not use, and its right field holds the index of
+ * the scalar expression if the operation takes one.
+ */
+
+enum NodeKind {
+   CONSTANT_NODE, IDENTIFIER_NODE, COMPOUND_NODE, REM_NODE, LET_NODE,
+   PRINT_NODE, INPUT_NODE, GOTO_NODE, IF_NODE, END_NODE, ELEMENT_NODE,
+   SUM_NODE, DIM_NODE, LET_ELEMENT_NODE, MAT_NODE, DOUBLE_NODE
+};
+
+struct ImageNode {
+   int16_t kind;
+   int16_t detail;
+   int32_t left;
+   int32_t right;
+   int32_t reserved;
+   int64_t value;
+};
+
+/* Private function prototypes */
+
+static uint64_t checksumWords(const char *data, size_t size);
+static uint64_t alignSection(uint64_t offset);
+
+/*
+ * Function: copySection
+ * Usage: copySection(dst, records);
+ * ---------------------------------
+ * Copies the records into the image at dst.  An empty vector may have
+ * no storage at all, and memcpy must not be passed a null pointer even
+ * to copy nothing, so empty sections are skipped.
+ */
+
+template <typename Record>
+static void copySection(char *dst, const vector<Record> & records) {
+   if (!records.empty()) memcpy(dst, records.data(), records.size() * sizeof(Record));
+}
+
+/*
+ * Implementation notes: ImageWriter
+ * ---------------------------------
+ * The writer flattens the program into vectors that mirror the
+ * sections of the image and then copies them into a single buffer,
+ * which is written to the file in one call.
+ */
+
+class ImageWriter {
+
+public:
+
+   ImageWriter(Program & program);
+   void write(const string & filename);
+
+private:
+
+   int addStatement(Statement *stmt);
+   int addExp(Expression *exp);
+   int addNode(NodeKind kind, int detail, long long value, int left, int right);
+   ImageString addString(const string & str);
+
+   vector<ImageString> symbols;
+   vector<ImageString> messages;
+   vector<ImageLine> lines;
+   vector<ImageNode> nodes;
+   string strings;
+   Bytecode bytecode;
+   int removedNodes;
+
+};
+
+ImageWriter::ImageWriter(Program & program) {
+   compileProgram(program, bytecode);
+   SymbolTable & table = program.getSymbolTable();
+   for (int slot = 0; slot < (int) bytecode.names.size(); slot++) {
+      ImageString symbol = addString(bytecode.names[slot]);
+      symbol.flags = table.getType(slot);
+      symbols.push_back(symbol);
+   }
+   for (const string & message : bytecode.messages) {
+      messages.push_back(addString(message));
+   }
+   for (Program::SourceLine *line = program.link(); line != NULL; line = line->next) {
+      ImageLine record;
+      record.lineNumber = line->lineNumber;
+      record.node = addStatement(line->lineParsed);
+      record.text = addString(line->lineString);
+      lines.push_back(record);
+   }
+   removedNodes = program.getRemovedNodes();
+}
+
+void ImageWriter::write(const string & filename) {
+   ImageHeader header;
+   memset(&header, 0, sizeof header);
+   memcpy(header.signature, IMAGE_SIGNATURE, sizeof header.signature);
+   header.version = IMAGE_VERSION;
+   header.headerSize = sizeof header;
+   header.symbolCount = symbols.size();
+   header.messageCount = messages.size();
+   header.lineCount = lines.size();
+   header.nodeCount = nodes.size();
+   header.codeLength = bytecode.code.size();
+   header.maxStack = bytecode.maxStack;
+   header.removedNodes = removedNodes;
+   header.symbolsOffset = alignSection(sizeof header);
+   header.messagesOffset = alignSection(header.symbolsOffset + symbols.size() * sizeof(ImageString));
+   header.linesOffset = alignSection(header.messagesOffset + messages.size() * sizeof(ImageString));
+   header.nodesOffset = alignSection(header.linesOffset + lines.size() * sizeof(ImageLine));
+   header.codeOffset = alignSection(header.nodesOffset + nodes.size() * sizeof(ImageNode));
+   header.costsOffset = alignSection(header.codeOffset + bytecode.code.size() * sizeof(int32_t));
+   header.stringsOffset = alignSection(header.costsOffset + bytecode.code.size() * sizeof(int32_t));
+   header.stringsSize = strings.size();
+   header.fileSize = alignSection(header.stringsOffset + strings.size());
+   string image(header.fileSize, '\0');
+   char *base = &image[0];
+   copySection(base + header.symbolsOffset, symbols);
+   copySection(base + header.messagesOffset, messages);
+   copySection(base + header.linesOffset, lines);
+   copySection(base + header.nodesOffset, nodes);
+   copySection(base + header.codeOffset, bytecode.code);
+   copySection(base + header.costsOffset, bytecode.backEdgeCosts);
+   memcpy(base + header.stringsOffset, strings.data(), strings.size());
+   header.checksum = checksumWords(base + sizeof header, header.fileSize - sizeof header);
+   memcpy(base, &header, sizeof header);
+   string temporary = filename + ".tmp" + integerToString(getpid());
+   ofstream file(temporary.c_str(), ios::binary);
+   file.write(image.data(), image.size());
+   file.close();
+   if (file.fail() || rename(temporary.c_str(), filename.c_str()) != 0) {
+      unlink(temporary.c_str());
+      error("Cannot write " + filename);
+   }
+}
+
+int ImageWriter::addStatement(Statement *stmt) {
+   switch (stmt->getType()) {
+    case REM_STMT:
+      return addNode(REM_NODE, 0, 0, -1, -1);
+    case LET_STMT: {
+      int exp = addExp(((LetStmt *) stmt)->getExp());
+      return addNode(LET_NODE, 0, ((LetStmt *) stmt)->getSlot(), exp, -1);
+    }
+    case PRINT_STMT:
+      return addNode(PRINT_NODE, 0, 0, addExp(((PrintStmt *) stmt)->getExp()), -1);
+    case INPUT_STMT:
+      return addNode(INPUT_NODE, 0, ((InputStmt *) stmt)->getSlot(), -1, -1);
+    case GOTO_STMT:
+      return addNode(GOTO_NODE, 0, ((GoToStmt *) stmt)->getLineNumber(), -1, -1);
+    case IF_STMT: {
+      IfStmt *ifStmt = (IfStmt *) stmt;
+      int lhs = addExp(ifStmt->getLHS());
+      int rhs = addExp(ifStmt->getRHS());
+      return addNode(IF_NODE, ifStmt->getRelation(), ifStmt->getLineNumber(), lhs, rhs);
+    }
+    case DIM_STMT:
+      return addNode(DIM_NODE, 0, 0, addExp(((DimStmt *) stmt)->getDeclarator()), -1);
+    case LET_ELEMENT_STMT: {
+      int element = addExp(((LetElementStmt *) stmt)->getElement());
+      int exp = addExp(((LetElementStmt *) stmt)->getExp());
+      return addNode(LET_ELEMENT_NODE, 0, 0, element, exp);
+    }
+    case MAT_STMT: {
+      MatStmt *mat = (MatStmt *) stmt;
+      int right = mat->getRHSSlot();
+      if (mat->getScalar() != NULL) right = addExp(mat->getScalar());
+      return addNode(MAT_NODE, mat->getOperation(), mat->getTargetSlot(), mat->getLHSSlot(),
+                     right);
+    }
+    default:
+      return addNode(END_NODE, 0, 0, -1, -1);
+   }
+}
+
+int ImageWriter::addExp(Expression *exp) {
+   switch (exp->getType()) {
+    case CONSTANT:
+      return addNode(CONSTANT_NODE, 0, ((ConstantExp *) exp)->getValue(), -1, -1);
+    case DOUBLE_CONSTANT: {
+      double value = ((DoubleConstantExp *) exp)->getValue();
+      long long bits;
+      memcpy(&bits, &value, sizeof bits);
+      return addNode(DOUBLE_NODE, 0, bits, -1, -1);
+    }
+    case IDENTIFIER:
+      return addNode(IDENTIFIER_NODE, 0, ((IdentifierExp *) exp)->getSlot(), -1, -1);
+    case ELEMENT: {
+      ElementExp *element = (ElementExp *) exp;
+      int row = addExp(element->getRow());
+      int column = (element->getColumn() == NULL) ? -1 : addExp(element->getColumn());
+      return addNode(ELEMENT_NODE, element->getRank(), element->getSlot(), row, column);
+    }
+    case SUM:
+      return addNode(SUM_NODE, 0, ((SumExp *) exp)->getSlot(), -1, -1);
+    default: {
+      CompoundExp *compound = (CompoundExp *) exp;
+      int lhs = addExp(compound->getLHS());
+      int rhs = addExp(compound->getRHS());
+      return addNode(COMPOUND_NODE, compound->getOperator(), 0, lhs, rhs);
+    }
+   }
+}
+
+int ImageWriter::addNode(NodeKind kind, int detail, long long value, int left, int right) {
+   ImageNode node;
+   node.kind = kind;
+   node.detail = detail;
+   node.left = left;
+   node.right = right;
+   node.reserved = 0;
+   node.value = value;
+   nodes.push_back(node);
+   return nodes.size() - 1;
+}
+
+ImageString ImageWriter::addString(const string & str) {
+   ImageString result;
+   result.offset = strings.size();
+   result.length = str.size();
+   result.flags = 0;
+   strings += str;
+   return result;
+}
+
+void saveProgramImage(Program & program, const string & filename) {
+   ImageWriter writer(program);
+   writer.write(filename);
+}
+
+bool isProgramImage(const string & filename) {
+   ifstream file(filename.c_str(), ios::binary);
+   char signature[sizeof IMAGE_SIGNATURE];
+   if (!file.read(signature, sizeof signature)) return false;
+   return memcmp(signature, IMAGE_SIGNATURE, sizeof signature) == 0;
+}
+
+/*
+ * Implementation notes: ProgramImage
+ * ----------------------------------
+ * The constructor validates everything that run depends on, so the
+ * bytecode can be executed straight from the mapping: the sections lie
+ * within the file, and checkCode proves that no instruction can read
+ * or write outside the code, the variables, the messages or the stack.
+ * Only the names and messages, which the machine needs as strings for
+ * its error messages, are copied out of the file.
+ */
+
+ProgramImage::ProgramImage(const string & filename) : file(filename) {
+   this->filename = filename;
+   const char *data = file.getData();
+   if (file.getSize() < sizeof(ImageHeader)
+       || memcmp(data, IMAGE_SIGNATURE, sizeof IMAGE_SIGNATURE) != 0) {
+      error(filename + " is not a program image");
+   }
+   header = (const ImageHeader *) data;
+   if (header->version != (uint32_t) IMAGE_VERSION) {
+      error(filename + " is an image of version " + integerToString(header->version)
+            + ", but this interpreter reads version " + integerToString(IMAGE_VERSION));
+   }
+   if (header->headerSize != sizeof(ImageHeader) || header->fileSize != file.getSize()
+       || header->fileSize % 8 != 0) {
+      error(filename + " is truncated or damaged");
+   }
+   if (checksumWords(data + sizeof(ImageHeader), header->fileSize - sizeof(ImageHeader))
+       != header->checksum) {
+      error(filename + " fails its checksum");
+   }
+   getSection(header->stringsOffset, header->stringsSize, 1);
+   getSection(header->linesOffset, header->lineCount, sizeof(ImageLine));
+   getSection(header->nodesOffset, header->nodeCount, sizeof(ImageNode));
+   if (header->codeLength == 0) error(filename + " is truncated or damaged");
+   getSection(header->codeOffset, header->codeLength, sizeof(int32_t));
+   getSection(header->costsOffset, header->codeLength, sizeof(int32_t));
+   const ImageString *symbols = (const ImageString *)
+      getSection(header->symbolsOffset, header->symbolCount, sizeof(ImageString));
+   for (uint32_t i = 0; i < header->symbolCount; i++) {
+      tables.names.push_back(getString(symbols[i]));
+   }
+   const ImageString *messages = (const ImageString *)
+      getSection(header->messagesOffset, header->messageCount, sizeof(ImageString));
+   for (uint32_t i = 0; i < header->messageCount; i++) {
+      tables.messages.push_back(getString(messages[i]));
+   }
+   tables.maxStack = header->maxStack;
+   for (int i = 0; i < IDIOM_COUNT; i++) {
+      tables.fusedCounts[i] = 0;
+   }
+   checkCode((const int *) (data + header->codeOffset), header->codeLength);
+}
+
+void ProgramImage::run(EvalState & state) {
+   executeBytecode((const int *) (file.getData() + header->codeOffset),
+                   (const int *) (file.getData() + header->costsOffset), tables, state);
+}
+
+/*
+ * Implementation notes: install
+ * -----------------------------
+ * Every node is checked before it is used: its kind, operator and
+ * relation must be known, its slot must be one of the image's, the
+ * slot of an array must name an array, and its children must be
+ * earlier nodes of the right sort.  The statements
+ * are built in the program's arena, and the lines are added with a
+ * single call to addParsedLines.  The types of the variables are
+ * restored before any node is built, so that every node is built with
+ * the types it was saved with.
+ */
+
+void ProgramImage::install(Program & program) {
+   program.clear();
+   try {
+      const char *data = file.getData();
+      const ImageNode *nodes = (const ImageNode *) (data + header->nodesOffset);
+      const ImageLine *lines = (const ImageLine *) (data + header->linesOffset);
+      int nodeCount = header->nodeCount;
+      SymbolTable & symbols = program.getSymbolTable();
+      Arena & arena = program.getArena();
+      vector<Expression *> expressions(nodeCount, NULL);
+      vector<Statement *> statements(nodeCount, NULL);
+      string damaged = filename + " is truncated or damaged";
+      auto child = [&](int index, int parent) {
+         if (index < 0 || index >= parent || expressions[index] == NULL) error(damaged);
+         return expressions[index];
+      };
+      auto name = [&](long long slot) {
+         if (slot < 0 || slot >= (int) tables.names.size()) error(damaged);
+         return tables.names[slot];
+      };
+      auto arrayName = [&](long long slot) {
+         string key = name(slot);
+         if (key.length() < 3 || !endsWith(key, "()")) error(damaged);
+         return key.substr(0, key.length() - 2);
+      };
+      auto element = [&](int index, int parent) {
+         Expression *exp = child(index, parent);
+         if (exp->getType() != ELEMENT) error(damaged);
+         return (ElementExp *) exp;
+      };
+      const ImageString *records = (const ImageString *) (data + header->symbolsOffset);
+      for (uint32_t i = 0; i < header->symbolCount; i++) {
+         if (records[i].flags > DOUBLE_TYPE) error(damaged);
+         ValueType type = (ValueType) records[i].flags;
+         if (type == DOUBLE_TYPE) symbols.widenType(symbols.intern(tables.names[i]), type);
+      }
+      for (int i = 0; i < nodeCount; i++) {
+         const ImageNode & node = nodes[i];
+         switch (node.kind) {
+          case CONSTANT_NODE:
+            expressions[i] = new (arena) ConstantExp(node.value);
+            break;
+          case DOUBLE_NODE: {
+            double value;
+            memcpy(&value, &node.value, sizeof value);
+            expressions[i] = new (arena) DoubleConstantExp(value);
+            break;
+          }
+          case IDENTIFIER_NODE:
+            expressions[i] = new (arena) IdentifierExp(name(node.value), symbols, arena);
+            break;
+          case COMPOUND_NODE:
+            if (node.detail < ASSIGN_OP || node.detail > ILLEGAL_OP) error(damaged);
+            expressions[i] = CompoundExp::create((Operator) node.detail, child(node.left, i),
+                                                 child(node.right, i), arena);
+            break;
+          case REM_NODE:
+            statements[i] = new (arena) RemStmt();
+            break;
+          case LET_NODE:
+            statements[i] = new (arena) LetStmt(name(node.value), child(node.left, i),
+                                                symbols, arena);
+            break;
+          case PRINT_NODE:
+            statements[i] = new (arena) PrintStmt(child(node.left, i));
+            break;
+          case INPUT_NODE:
+            statements[i] = new (arena) InputStmt(name(node.value), symbols, arena);
+            break;
+          case GOTO_NODE:
+            statements[i] = new (arena) GoToStmt(node.value);
+            break;
+          case IF_NODE:
+            if (node.detail < EQ_REL || node.detail >= ILLEGAL_REL) error(damaged);
+            statements[i] = new (arena) IfStmt(child(node.left, i), (Relation) node.detail,
+                                               child(node.right, i), node.value);
+            break;
+          case END_NODE:
+            statements[i] = new (arena) EndStmt();
+            break;
+          case ELEMENT_NODE:
+            if (node.detail != 1 && node.detail != 2) error(damaged);
+            expressions[i] = new (arena) ElementExp(arrayName(node.value), child(node.left, i),
+                                                    (node.detail == 2) ? child(node.right, i) : NULL,
+                                                    symbols, arena);
+            break;
+          case SUM_NODE:
+            expressions[i] = new (arena) SumExp(arrayName(node.value), symbols, arena);
+            break;
+          case DIM_NODE:
+            statements[i] = new (arena) DimStmt(element(node.left, i));
+            break;
+          case LET_ELEMENT_NODE:
+            statements[i] = new (arena) LetElementStmt(element(node.left, i),
+                                                       child(node.right, i));
+            break;
+          case MAT_NODE: {
+            if (node.detail < MAT_COPY || node.detail >= ILLEGAL_MAT) error(damaged);
+            MatOperation op = (MatOperation) node.detail;
+            bool binary = op == MAT_ADD || op == MAT_SUB || op == MAT_PRODUCT;
+            statements[i] = new (arena) MatStmt(op, arrayName(node.value),
+                                                (op == MAT_FILL) ? "" : arrayName(node.left),
+                                                binary ? arrayName(node.right) : "",
+                                                matTakesScalar(op) ? child(node.right, i) : NULL,
+                                                symbols, arena);
+            break;
+          }
+          default:
+            error(damaged);
+         }
+      }
+      vector<Program::ParsedLine> parsedLines(header->lineCount);
+      for (uint32_t i = 0; i < header->lineCount; i++) {
+         const ImageLine & line = lines[i];
+         if (line.node < 0 || line.node >= nodeCount || statements[line.node] == NULL
+             || (i > 0 && line.lineNumber <= lines[i - 1].lineNumber)) {
+            error(damaged);
+         }
+         parsedLines[i].lineNumber = line.lineNumber;
+         parsedLines[i].text = getString(line.text);
+         parsedLines[i].stmt = statements[line.node];
+      }
+      program.addParsedLines(parsedLines);
+      program.addRemovedNodes(header->removedNodes);
+   } catch (ErrorException &) {
+      program.clear();
+      throw;
+   }
+}
+
+int ProgramImage::getLineCount() {
+   return header->lineCount;
+}
+
+/*
+ * Implementation notes: checkCode
+ * -------------------------------
+ * The first pass decodes the code from the start, as the compiler laid
+ * it out, and checks each instruction on its own: the opcode must be
+ * known, the instruction must fit in the code, and every operand must
+ * be in range for its kind.  Slots must be below the symbol count,
+ * message numbers below the message count, relations, ranks, shifts
+ * and MAT operations among those the machine knows, and each backward
+ * jump must cost at least one statement, or a loop would never be
+ * charged.  The first pass also records where each instruction begins.
+ *
+ * The second pass follows the control flow from address 0, recording
+ * the height of the evaluation stack on entry to each instruction.
+ * Every jump must land where an instruction begins, no instruction may
+ * pop more than the stack holds or push it past maxStack, two paths
+ * must reach an instruction with the same height, and no path may run
+ * off the end of the code.  Together the passes cover every check the
+ * machine leaves out.
+ */
+
+void ProgramImage::checkCode(const int *code, int length) {
+   string damaged = filename + " is truncated or damaged";
+   const int *costs = (const int *) (file.getData() + header->costsOffset);
+   int slots = header->symbolCount;
+   auto slot = [&](int operand) {
+      if (operand < 0 || operand >= slots) error(damaged);
+   };
+   auto relation = [&](int operand) {
+      if (operand < EQ_REL || operand >= ILLEGAL_REL) error(damaged);
+   };
+   auto rank = [&](int operand) {
+      if (operand != 1 && operand != 2) error(damaged);
+   };
+   if (length <= 0 || header->maxStack > (uint32_t) length) error(damaged);
+   vector<bool> starts(length, false);
+   int pc = 0;
+   while (pc < length) {
+      const int *op = code + pc;
+      if (*op < OP_HALT || *op > OP_INC_JUMP_VAR) error(damaged);
+      int size = instructionLength(*op);
+      if (size > length - pc) error(damaged);
+      switch (*op) {
+       case OP_LOAD: case OP_STORE: case OP_ASSIGN: case OP_INPUT: case OP_SUM:
+       case OP_LOAD_DOUBLE: case OP_STORE_DOUBLE: case OP_ASSIGN_DOUBLE: case OP_INPUT_DOUBLE:
+       case OP_ADD_TO: case OP_MUL_TO: case OP_INC_JUMP_CONST:
+         slot(op[1]);
+         break;
+       case OP_SHL: case OP_SHR:
+         if (op[1] < 1 || op[1] > 62) error(damaged);
+         break;
+       case OP_ERROR:
+         if (op[1] < 0 || op[1] >= (int) header->messageCount) error(damaged);
+         break;
+       case OP_JUMP_DOUBLE: case OP_JUMP_CONST:
+         relation(op[1]);
+         break;
+       case OP_DIM: case OP_LOAD_ELEMENT: case OP_STORE_ELEMENT:
+         slot(op[1]);
+         rank(op[2]);
+         break;
+       case OP_MAT: {
+         if (op[1] < MAT_COPY || op[1] >= ILLEGAL_MAT) error(damaged);
+         MatOperation matOp = (MatOperation) op[1];
+         bool binary = matOp == MAT_ADD || matOp == MAT_SUB || matOp == MAT_PRODUCT;
+         slot(op[2]);
+         if (matOp != MAT_FILL || op[3] != -1) slot(op[3]);
+         if (binary || op[4] != -1) slot(op[4]);
+         break;
+       }
+       case OP_JUMP_VAR_CONST:
+         slot(op[1]);
+         relation(op[2]);
+         break;
+       case OP_INC_JUMP_VAR:
+         slot(op[1]);
+         relation(op[3]);
+         slot(op[4]);
+         break;
+      }
+      int target = jumpTargetIndex(*op);
+      if (target != 0) {
+         if (op[target] < 0 || op[target] >= length) error(damaged);
+         if (op[target] <= pc && costs[pc] < 1) error(damaged);
+      }
+      if (costs[pc] < 0) error(damaged);
+      starts[pc] = true;
+      pc += size;
+   }
+   vector<int> heights(length, -1);
+   vector<int> pending;
+   auto reach = [&](int address, int height) {
+      if (address >= length || !starts[address]) error(damaged);
+      if (heights[address] == -1) {
+         heights[address] = height;
+         pending.push_back(address);
+      } else if (heights[address] != height) {
+         error(damaged);
+      }
+   };
+   reach(0, 0);
+   while (!pending.empty()) {
+      pc = pending.back();
+      pending.pop_back();
+      const int *op = code + pc;
+      int pops = 0;
+      int pushes = 0;
+      switch (*op) {
+       case OP_PUSH: case OP_LOAD: case OP_PUSH_WIDE: case OP_PUSH_DOUBLE:
+       case OP_LOAD_DOUBLE: case OP_SUM:
+         pushes = 1;
+         break;
+       case OP_STORE: case OP_POP: case OP_PRINT: case OP_STORE_DOUBLE: case OP_PRINT_DOUBLE:
+       case OP_JUMP_CONST:
+         pops = 1;
+         break;
+       case OP_ASSIGN: case OP_SHL: case OP_SHR: case OP_ASSIGN_DOUBLE: case OP_TO_DOUBLE:
+       case OP_TO_INTEGER:
+         pops = pushes = 1;
+         break;
+       case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_ADD_DOUBLE:
+       case OP_SUB_DOUBLE: case OP_MUL_DOUBLE: case OP_DIV_DOUBLE:
+         pops = 2;
+         pushes = 1;
+         break;
+       case OP_JUMP_EQ: case OP_JUMP_GT: case OP_JUMP_LT: case OP_JUMP_NE: case OP_JUMP_LE:
+       case OP_JUMP_GE: case OP_JUMP_DOUBLE:
+         pops = 2;
+         break;
+       case OP_DIM:
+         pops = op[2];
+         break;
+       case OP_LOAD_ELEMENT:
+         pops = op[2];
+         pushes = 1;
+         break;
+       case OP_STORE_ELEMENT:
+         pops = op[2] + 1;
+         break;
+       case OP_MAT:
+         pops = matTakesScalar((MatOperation) op[1]) ? 1 : 0;
+         break;
+      }
+      int height = heights[pc] - pops;
+      if (height < 0) error(damaged);
+      height += pushes;
+      if (height > (int) header->maxStack) error(damaged);
+      int target = jumpTargetIndex(*op);
+      if (target != 0) reach(op[target], height);
+      if (*op != OP_HALT && *op != OP_ERROR && *op != OP_JUMP) {
+         reach(pc + instructionLength(*op), height);
+      }
+   }
+}
+
+/*
+ * Implementation notes: getSection
+ * --------------------------------
+ * Returns the address of a section after checking that it is aligned
+ * and lies entirely within the file.  The count is at most 2^32, so
+ * the size of the section cannot overflow.
+ */
+
+const char *ProgramImage::getSection(uint64_t offset, uint64_t count, size_t size) {
+   if (offset % 8 != 0 || offset < sizeof(ImageHeader) || offset > header->fileSize
+       || count * size > header->fileSize - offset) {
+      error(filename + " is truncated or damaged");
+   }
+   return file.getData() + offset;
+}
+
+string ProgramImage::getString(const ImageString & str) {
+   if (str.offset > header->stringsSize || str.length > header->stringsSize - str.offset) {
+      error(filename + " is truncated or damaged");
+   }
+   return string(file.getData() + header->stringsOffset + str.offset, str.length);
+}
+
+/*
+ * Implementation notes: checksumWords
+ * -----------------------------------
+ * The size must be a multiple of eight, as every image's is.
+ */
+
+static uint64_t checksumWords(const char *data, size_t size) {
+   uint64_t hash = 14695981039346656037ULL;
+   for (size_t i = 0; i < size; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, sizeof word);
+      hash = (hash ^ word) * 1099511628211ULL;
+   }
+   return hash;
+}
+
+static uint64_t alignSection(uint64_t offset) {
+   return (offset + 7) & ~(uint64_t) 7;
+}
@@ -0,0 +1,138 @@
+/*
+ * File: image.h
+ * -------------
+ * This interface exports the program image behind SAVE IMAGE and
+ * LOAD IMAGE: a binary file holding a program that has already been
+ * parsed, optimized and compiled, so that it can be started again
+ * without tokenizing or parsing any of its lines.
+ */
+
+#ifndef _image_h
+#define _image_h
+
+#include <cstdint>
+#include <string>
+#include "bytecode.h"
+#include "evalstate.h"
+#include "mappedfile.h"
+#include "program.h"
+
+/* Constants */
+
+const int IMAGE_VERSION = 4;
+
+/* Records of the image format, defined in image.cpp */
+
+struct ImageHeader;
+struct ImageString;
+
+/*
+ * Function: saveProgramImage
+ * Usage: saveProgramImage(program, filename);
+ * -------------------------------------------
+ * Writes an image of the program to the named file.  The image holds
+ * the source text and the parsed statement of every line, the names of
+ * the variable slots and the bytecode produced by compileProgram, so
+ * the program is linked first and a missing line or an unparsed
+ * statement is reported before the file is touched.  The file is
+ * written under a temporary name and renamed into place, so a reader
+ * never sees half an image.
+ */
+
+void saveProgramImage(Program & program, const std::string & filename);
+
+/*
+ * Function: isProgramImage
+ * Usage: if (isProgramImage(filename)) . . .
+ * ------------------------------------------
+ * Returns true if the named file exists and begins with the signature
+ * of a program image.
+ */
+
+bool isProgramImage(const std::string & filename);
+
+/*
+ * Class: ProgramImage
+ * -------------------
+ * This class maps a program image into memory.  The image is position
+ * independent: every reference inside it is an offset or an index, and
+ * jump operands in its bytecode are instruction indices, so the
+ * mapping can be used wherever it lands.  Running the image executes
+ * the bytecode in place, without building any statements, which makes
+ * starting a large program cost little more than touching the pages
+ * it runs.
+ *
+ * Statements are C++ objects and cannot live in the file, so an
+ * editable program is rebuilt from the image by install, which reads
+ * the stored expression trees directly and costs a fraction of what
+ * parsing the source would.
+ */
+
+class ProgramImage {
+
+public:
+
+/*
+ * Constructor: ProgramImage
+ * Usage: ProgramImage image(filename);
+ * ------------------------------------
+ * Maps the named image and checks its signature, version, size and
+ * checksum, and then every instruction of its bytecode, calling error
+ * if any of them is wrong.  Images are written in the byte order of
+ * the machine that saved them.
+ */
+
+   ProgramImage(const std::string & filename);
+
+/*
+ * Method: run
+ * Usage: image.run(state);
+ * ------------------------
+ * Executes the program in the image with the specified state, which
+ * should not have been used with another program, since the image
+ * numbers its variables on its own.  The behavior is that of RUN.
+ */
+
+   void run(EvalState & state);
+
+/*
+ * Method: install
+ * Usage: image.install(program);
+ * ------------------------------
+ * Replaces the contents of the program with the lines stored in the
+ * image, as if they had been typed.  Variable names are interned in
+ * the program's symbol table, so the program may already number other
+ * variables.  A malformed image is reported by calling error, leaving
+ * the program empty.
+ */
+
+   void install(Program & program);
+
+/*
+ * Method: getLineCount
+ * Usage: int count = image.getLineCount();
+ * ----------------------------------------
+ * Returns the number of lines stored in the image.
+ */
+
+   int getLineCount();
+
+private:
+
+   const char *getSection(uint64_t offset, uint64_t count, size_t size);
+   void checkCode(const int *code, int length);
+   std::string getString(const ImageString & str);
+
+   MappedFile file;
+   std::string filename;
+   const ImageHeader *header;
+   Bytecode tables;
+
+/* Images cannot be copied, since the copies would share one mapping */
+
+   ProgramImage(const ProgramImage & src) = delete;
+   ProgramImage & operator=(const ProgramImage & src) = delete;
+
+};
+
+#endif
@@ -0,0 +1,339 @@
+/*
+ * File: inference.cpp
+ * -------------------
+ * This file implements the type inference pass.
+ */
+
+#include "exp.h"
+#include "inference.h"
+#include "statement.h"
+#include "symtab.h"
+#include "value.h"
+using namespace std;
+
+/* Private function prototypes */
+
+static Expression *retypeCompound(CompoundExp *compound, bool & changed, SymbolTable & symbols,
+                                  Arena & arena);
+static void widenVariable(int slot, Expression *exp, SymbolTable & symbols);
+static ValueType inferExp(Expression *exp, SymbolTable & symbols);
+static void findWidenedInExp(Expression *exp, SymbolTable & symbols, vector<int> & slots);
+static void checkWidening(int slot, Expression *value, SymbolTable & symbols,
+                          vector<int> & slots);
+static ValueType typeBefore(Expression *exp, int widening, SymbolTable & symbols);
+
+/*
+ * Implementation notes: retypeStatement
+ * -------------------------------------
+ * The statements that record a type of their own are LET and INPUT,
+ * which store the type of their variable, and IF, whose setters
+ * recompute the type of the comparison from its two sides.
+ */
+
+bool retypeStatement(Statement *stmt, SymbolTable & symbols, Arena & arena) {
+   bool changed = false;
+   switch (stmt->getType()) {
+    case LET_STMT: {
+      LetStmt *let = (LetStmt *) stmt;
+      let->setExp(retypeExp(let->getExp(), changed, symbols, arena));
+      widenVariable(let->getSlot(), let->getExp(), symbols);
+      ValueType type = symbols.getType(let->getSlot());
+      if (type != let->getValueType()) {
+         let->setValueType(type);
+         changed = true;
+      }
+      break;
+    }
+    case PRINT_STMT: {
+      PrintStmt *print = (PrintStmt *) stmt;
+      print->setExp(retypeExp(print->getExp(), changed, symbols, arena));
+      break;
+    }
+    case INPUT_STMT: {
+      InputStmt *input = (InputStmt *) stmt;
+      ValueType type = symbols.getType(input->getSlot());
+      if (type != input->getValueType()) {
+         input->setValueType(type);
+         changed = true;
+      }
+      break;
+    }
+    case IF_STMT: {
+      IfStmt *ifStmt = (IfStmt *) stmt;
+      ifStmt->setLHS(retypeExp(ifStmt->getLHS(), changed, symbols, arena));
+      ifStmt->setRHS(retypeExp(ifStmt->getRHS(), changed, symbols, arena));
+      break;
+    }
+    case DIM_STMT:
+      retypeExp(((DimStmt *) stmt)->getDeclarator(), changed, symbols, arena);
+      break;
+    case LET_ELEMENT_STMT: {
+      LetElementStmt *let = (LetElementStmt *) stmt;
+      retypeExp(let->getElement(), changed, symbols, arena);
+      let->setExp(retypeExp(let->getExp(), changed, symbols, arena));
+      break;
+    }
+    case MAT_STMT: {
+      MatStmt *mat = (MatStmt *) stmt;
+      if (mat->getScalar() != NULL) {
+         mat->setScalar(retypeExp(mat->getScalar(), changed, symbols, arena));
+      }
+      break;
+    }
+    default:
+      break;
+   }
+   return changed;
+}
+
+/*
+ * Implementation notes: retypeExp
+ * -------------------------------
+ * The tree is retyped bottom-up, so that each compound node sees the
+ * final types of its operands.  Array elements and sums are always
+ * integers, but the subscripts of an element may contain variables.
+ */
+
+Expression *retypeExp(Expression *exp, bool & changed, SymbolTable & symbols, Arena & arena) {
+   switch (exp->getType()) {
+    case IDENTIFIER: {
+      IdentifierExp *id = (IdentifierExp *) exp;
+      ValueType type = symbols.getType(id->getSlot());
+      if (type != id->getValueType()) {
+         id->setValueType(type);
+         changed = true;
+      }
+      return id;
+    }
+    case ELEMENT: {
+      ElementExp *element = (ElementExp *) exp;
+      element->setRow(retypeExp(element->getRow(), changed, symbols, arena));
+      if (element->getColumn() != NULL) {
+         element->setColumn(retypeExp(element->getColumn(), changed, symbols, arena));
+      }
+      return element;
+    }
+    case COMPOUND:
+      return retypeCompound((CompoundExp *) exp, changed, symbols, arena);
+    default:
+      return exp;
+   }
+}
+
+/*
+ * Implementation notes: retypeCompound
+ * ------------------------------------
+ * An assignment widens its variable and keeps its node, whose type is
+ * computed from the variable.  An arithmetic node whose class no longer
+ * matches the types of its operands is rebuilt by CompoundExp::create.
+ * The optimizer may have turned an integer multiplication or division
+ * by a power of two into a shift, which has no double form, so such a
+ * node goes back to the operation it replaced.
+ */
+
+static Expression *retypeCompound(CompoundExp *compound, bool & changed, SymbolTable & symbols,
+                                  Arena & arena) {
+   Expression *lhs = retypeExp(compound->getLHS(), changed, symbols, arena);
+   Expression *rhs = retypeExp(compound->getRHS(), changed, symbols, arena);
+   compound->setLHS(lhs);
+   compound->setRHS(rhs);
+   Operator op = compound->getOperator();
+   if (op == ASSIGN_OP) {
+      if (lhs->getType() == IDENTIFIER) {
+         widenVariable(((IdentifierExp *) lhs)->getSlot(), rhs, symbols);
+         retypeExp(lhs, changed, symbols, arena);
+      }
+      return compound;
+   }
+   ValueType type = widerType(lhs->getValueType(), rhs->getValueType());
+   if (type == compound->getValueType()) return compound;
+   if (type == DOUBLE_TYPE && (op == SHL_OP || op == SHR_OP)) {
+      long long k = ((ConstantExp *) rhs)->getValue();
+      op = (op == SHL_OP) ? MUL_OP : DIV_OP;
+      rhs = new (arena) ConstantExp(1LL << k);
+   }
+   changed = true;
+   return CompoundExp::create(op, lhs, rhs, arena);
+}
+
+static void widenVariable(int slot, Expression *exp, SymbolTable & symbols) {
+   symbols.widenType(slot, exp->getValueType());
+}
+
+/*
+ * Implementation notes: inferTypes
+ * --------------------------------
+ * Every expression in the statement is inferred, even where its value
+ * is an integer regardless, since any of them may contain an
+ * assignment.  INPUT takes the type of its variable and widens
+ * nothing.
+ */
+
+void inferTypes(Statement *stmt, SymbolTable & symbols) {
+   switch (stmt->getType()) {
+    case LET_STMT: {
+      LetStmt *let = (LetStmt *) stmt;
+      symbols.widenType(let->getSlot(), inferExp(let->getExp(), symbols));
+      break;
+    }
+    case PRINT_STMT:
+      inferExp(((PrintStmt *) stmt)->getExp(), symbols);
+      break;
+    case IF_STMT:
+      inferExp(((IfStmt *) stmt)->getLHS(), symbols);
+      inferExp(((IfStmt *) stmt)->getRHS(), symbols);
+      break;
+    case DIM_STMT:
+      inferExp(((DimStmt *) stmt)->getDeclarator(), symbols);
+      break;
+    case LET_ELEMENT_STMT:
+      inferExp(((LetElementStmt *) stmt)->getElement(), symbols);
+      inferExp(((LetElementStmt *) stmt)->getExp(), symbols);
+      break;
+    case MAT_STMT: {
+      Expression *scalar = ((MatStmt *) stmt)->getScalar();
+      if (scalar != NULL) inferExp(scalar, symbols);
+      break;
+    }
+    default:
+      break;
+   }
+}
+
+/*
+ * Implementation notes: inferExp
+ * ------------------------------
+ * Returns the type the expression has under the current table,
+ * widening the variable of every assignment inside it on the way.  A
+ * shift has an integer constant on the right, so its type is that of
+ * its left operand, as for the multiplication it replaced.
+ */
+
+static ValueType inferExp(Expression *exp, SymbolTable & symbols) {
+   switch (exp->getType()) {
+    case DOUBLE_CONSTANT:
+      return DOUBLE_TYPE;
+    case IDENTIFIER:
+      return symbols.getType(((IdentifierExp *) exp)->getSlot());
+    case ELEMENT: {
+      ElementExp *element = (ElementExp *) exp;
+      inferExp(element->getRow(), symbols);
+      if (element->getColumn() != NULL) inferExp(element->getColumn(), symbols);
+      return INTEGER_TYPE;
+    }
+    case COMPOUND: {
+      CompoundExp *compound = (CompoundExp *) exp;
+      ValueType rhs = inferExp(compound->getRHS(), symbols);
+      if (compound->getOperator() == ASSIGN_OP) {
+         Expression *lhs = compound->getLHS();
+         if (lhs->getType() != IDENTIFIER) return inferExp(lhs, symbols);
+         return symbols.widenType(((IdentifierExp *) lhs)->getSlot(), rhs);
+      }
+      return widerType(inferExp(compound->getLHS(), symbols), rhs);
+    }
+    default:
+      return INTEGER_TYPE;
+   }
+}
+
+/*
+ * Implementation notes: findWidenedSlots
+ * --------------------------------------
+ * The statements are visited as in inferTypes, looking for the same
+ * assignments: that of a LET and those inside any expression.
+ */
+
+void findWidenedSlots(Statement *stmt, SymbolTable & symbols, vector<int> & slots) {
+   switch (stmt->getType()) {
+    case LET_STMT: {
+      LetStmt *let = (LetStmt *) stmt;
+      findWidenedInExp(let->getExp(), symbols, slots);
+      checkWidening(let->getSlot(), let->getExp(), symbols, slots);
+      break;
+    }
+    case PRINT_STMT:
+      findWidenedInExp(((PrintStmt *) stmt)->getExp(), symbols, slots);
+      break;
+    case IF_STMT:
+      findWidenedInExp(((IfStmt *) stmt)->getLHS(), symbols, slots);
+      findWidenedInExp(((IfStmt *) stmt)->getRHS(), symbols, slots);
+      break;
+    case DIM_STMT:
+      findWidenedInExp(((DimStmt *) stmt)->getDeclarator(), symbols, slots);
+      break;
+    case LET_ELEMENT_STMT:
+      findWidenedInExp(((LetElementStmt *) stmt)->getElement(), symbols, slots);
+      findWidenedInExp(((LetElementStmt *) stmt)->getExp(), symbols, slots);
+      break;
+    case MAT_STMT: {
+      Expression *scalar = ((MatStmt *) stmt)->getScalar();
+      if (scalar != NULL) findWidenedInExp(scalar, symbols, slots);
+      break;
+    }
+    default:
+      break;
+   }
+}
+
+static void findWidenedInExp(Expression *exp, SymbolTable & symbols, vector<int> & slots) {
+   switch (exp->getType()) {
+    case ELEMENT: {
+      ElementExp *element = (ElementExp *) exp;
+      findWidenedInExp(element->getRow(), symbols, slots);
+      if (element->getColumn() != NULL) findWidenedInExp(element->getColumn(), symbols, slots);
+      break;
+    }
+    case COMPOUND: {
+      CompoundExp *compound = (CompoundExp *) exp;
+      findWidenedInExp(compound->getLHS(), symbols, slots);
+      findWidenedInExp(compound->getRHS(), symbols, slots);
+      Expression *lhs = compound->getLHS();
+      if (compound->getOperator() == ASSIGN_OP && lhs->getType() == IDENTIFIER) {
+         checkWidening(((IdentifierExp *) lhs)->getSlot(), compound->getRHS(), symbols, slots);
+      }
+      break;
+    }
+    default:
+      break;
+   }
+}
+
+static void checkWidening(int slot, Expression *value, SymbolTable & symbols,
+                          vector<int> & slots) {
+   if (symbols.getType(slot) != DOUBLE_TYPE) return;
+   if (typeBefore(value, symbols.getWidening(slot), symbols) == DOUBLE_TYPE) {
+      slots.push_back(slot);
+   }
+}
+
+/*
+ * Implementation notes: typeBefore
+ * --------------------------------
+ * Returns the type the expression has if only the variables that
+ * widened before the specified generation are doubles.  An assignment
+ * has the type of its variable, as in inferExp.
+ */
+
+static ValueType typeBefore(Expression *exp, int widening, SymbolTable & symbols) {
+   switch (exp->getType()) {
+    case DOUBLE_CONSTANT:
+      return DOUBLE_TYPE;
+    case IDENTIFIER: {
+      int slot = ((IdentifierExp *) exp)->getSlot();
+      bool earlier = symbols.getType(slot) == DOUBLE_TYPE
+                  && symbols.getWidening(slot) < widening;
+      return earlier ? DOUBLE_TYPE : INTEGER_TYPE;
+    }
+    case COMPOUND: {
+      CompoundExp *compound = (CompoundExp *) exp;
+      if (compound->getOperator() == ASSIGN_OP) {
+         if (compound->getLHS()->getType() != IDENTIFIER) return INTEGER_TYPE;
+         return typeBefore(compound->getLHS(), widening, symbols);
+      }
+      return widerType(typeBefore(compound->getLHS(), widening, symbols),
+                       typeBefore(compound->getRHS(), widening, symbols));
+    }
+    default:
+      return INTEGER_TYPE;
+   }
+}
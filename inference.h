@@ -0,0 +1,83 @@
+/*
+ * File: inference.h
+ * -----------------
+ * This interface exports the type inference pass, which keeps the
+ * types recorded in parsed statements consistent with the types of
+ * the variables in the symbol table.
+ */
+
+#ifndef _inference_h
+#define _inference_h
+
+#include <vector>
+#include "arena.h"
+#include "exp.h"
+#include "statement.h"
+#include "symtab.h"
+
+/*
+ * Function: retypeStatement
+ * Usage: bool changed = retypeStatement(stmt, symbols, arena);
+ * ------------------------------------------------------------
+ * Brings the types in a parsed statement up to date with the symbol
+ * table and returns true if anything in the statement changed.  Every
+ * identifier takes the type of its variable, every arithmetic node
+ * whose operands now include a double is rebuilt in the arena as a
+ * double node, and a LET or an assignment whose value is a double
+ * widens its variable in the table.  A widened variable can change
+ * other statements in turn, so a caller retyping a whole program
+ * repeats the pass until the table stops changing, which it does
+ * after at most one round per variable, since types only widen.
+ *
+ * Statements are typed when they are parsed, so this pass is needed
+ * only when a variable widens after a statement that uses it has been
+ * parsed, as when a later line assigns it a double, or when the types
+ * have been worked out again with inferTypes.
+ */
+
+bool retypeStatement(Statement *stmt, SymbolTable & symbols, Arena & arena);
+
+/*
+ * Function: inferTypes
+ * Usage: inferTypes(stmt, symbols);
+ * ---------------------------------
+ * Widens each variable the statement assigns so that it can hold the
+ * value assigned, judging the type of every expression from the table
+ * rather than from the types recorded in its nodes, and leaves the
+ * statement itself unchanged.  A caller that resets the table and
+ * repeats this over every line of a program until the table stops
+ * changing finds the types that the program's current lines call for,
+ * whatever was parsed against the table before.  Retyping the
+ * statements afterwards rebuilds only the nodes whose final type
+ * differs, so no node is rebuilt twice on the way.
+ */
+
+void inferTypes(Statement *stmt, SymbolTable & symbols);
+
+/*
+ * Function: findWidenedSlots
+ * Usage: findWidenedSlots(stmt, symbols, slots);
+ * ----------------------------------------------
+ * Appends to slots the slot of each DOUBLE_TYPE variable whose type
+ * the statement accounts for: those it assigns a value that is a
+ * double even when every variable that widened no earlier than the
+ * assigned one is read as an integer.  A statement such as
+ * LET X = X + 1 agrees with the type of X but does not account for it,
+ * so it is not counted, and a variable that no remaining statement
+ * accounts for may narrow.  The table is not changed.
+ */
+
+void findWidenedSlots(Statement *stmt, SymbolTable & symbols, std::vector<int> & slots);
+
+/*
+ * Function: retypeExp
+ * Usage: exp = retypeExp(exp, changed, symbols, arena);
+ * -----------------------------------------------------
+ * Returns the expression brought up to date with the symbol table, which
+ * may be a different node, and sets changed to true if anything in it
+ * changed.  Nodes that are replaced stay in their arena.
+ */
+
+Expression *retypeExp(Expression *exp, bool & changed, SymbolTable & symbols, Arena & arena);
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * File: input.cpp
+ * ---------------
+ * This file implements the InputSource class.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "error.h"
+#include "input.h"
+#include "simpio.h"
+#include "strlib.h"
+using namespace std;
+
+/* Private function prototypes */
+
+static bool parseInteger(const string & line, long long & value);
+static bool parseDouble(const string & line, double & value);
+static bool isSpace(char ch);
+
+InputSource::InputSource() {
+   stream = NULL;
+   fd = -1;
+}
+
+InputSource::~InputSource() {
+   closeFile();
+}
+
+void InputSource::setStream(istream & stream) {
+   closeFile();
+   this->stream = &stream;
+}
+
+/*
+ * Implementation notes: setFile
+ * -----------------------------
+ * The block holds one byte more than is ever read into it, so that a
+ * '\0' can always follow the data.  The loops that scan a number stop
+ * at that sentinel without testing for the end of the block.
+ */
+
+void InputSource::setFile(const string & filename) {
+   int newFd = (filename == "-") ? STDIN_FILENO : open(filename.c_str(), O_RDONLY);
+   if (newFd < 0) error("Cannot open " + filename);
+   closeFile();
+   stream = NULL;
+   fd = newFd;
+   this->filename = (filename == "-") ? "standard input" : filename;
+   block.resize(INPUT_BLOCK_SIZE + 1);
+   cursor = limit = block.data();
+   *limit = '\0';
+   atEnd = false;
+   offset = 0;
+   line = 1;
+   lineStart = 0;
+}
+
+void InputSource::setConsole() {
+   closeFile();
+   stream = NULL;
+}
+
+/*
+ * Implementation notes: readInteger, readDouble
+ * ---------------------------------------------
+ * A console line must hold exactly one number, as getInteger in
+ * simpio.h requires, and a bad line is asked for again with the same
+ * messages getInteger and getReal use.  Those functions cannot be
+ * called directly, since getInteger stops at the range of an int.  A
+ * stream or a file cannot be asked again, so a bad value there is an
+ * error.  A stream is read a whole token at a time and the token held
+ * to the same test as a console line, so that "1.5" or "12abc" is an
+ * illegal integer rather than the number at its start, and a value out
+ * of range is illegal rather than the end of the input.
+ */
+
+long long InputSource::readInteger() {
+   if (fd >= 0) return readFileInteger();
+   long long value;
+   if (stream == NULL) {
+      while (!parseInteger(trim(getLine(" ? ")), value)) {
+         cout << "Illegal integer format. Try again." << endl;
+      }
+   } else if (!parseInteger(readStreamToken(), value)) {
+      error("Illegal input value");
+   }
+   return value;
+}
+
+double InputSource::readDouble() {
+   if (fd >= 0) return readFileDouble();
+   double value;
+   if (stream == NULL) {
+      while (!parseDouble(trim(getLine(" ? ")), value)) {
+         cout << "Illegal numeric format. Try again." << endl;
+      }
+   } else if (!parseDouble(readStreamToken(), value)) {
+      error("Illegal input value");
+   }
+   return value;
+}
+
+/*
+ * Implementation notes: readStreamToken
+ * -------------------------------------
+ * The token is read straight from the stream's buffer into a string
+ * the source keeps, which is what extracting a string would do, less
+ * the cost of a sentry and a locale lookup for every character.  White
+ * space is what isSpace accepts, as for a file.
+ */
+
+const string & InputSource::readStreamToken() {
+   streambuf *buffer = stream->rdbuf();
+   int ch = buffer->sgetc();
+   while (ch != EOF && isSpace(ch)) {
+      ch = buffer->snextc();
+   }
+   if (ch == EOF) {
+      stream->setstate(ios::eofbit);
+      error("No more input values");
+   }
+   token.clear();
+   while (ch != EOF && !isSpace(ch)) {
+      token += (char) ch;
+      ch = buffer->snextc();
+   }
+   return token;
+}
+
+/*
+ * Implementation notes: readFileInteger
+ * -------------------------------------
+ * The digits are accumulated as an unsigned value, which holds any 19
+ * digits without overflow, and the range of a long long is checked
+ * once at the end.  A number that runs into the end of the block may
+ * continue in the next one, so the block is refilled from the start of
+ * the number and the number parsed again.
+ */
+
+long long InputSource::readFileInteger() {
+   while (true) {
+      char *start = skipSpace();
+      if (start == NULL) error("No more input values");
+      char *p = start;
+      bool negative = (*p == '-');
+      if (*p == '-' || *p == '+') p++;
+      char *digits = p;
+      unsigned long long value = 0;
+      while ((unsigned char) (*p - '0') < 10) {
+         value = value * 10 + (*p++ - '0');
+      }
+      if (p == limit && !atEnd) {
+         cursor = start;
+         fillBlock();
+         continue;
+      }
+      if (p == digits || p - digits > 19 || (p != limit && !isSpace(*p))
+          || value > (unsigned long long) LLONG_MAX + negative) {
+         reportFileError(start);
+      }
+      cursor = p;
+      return negative ? (long long) (0 - value) : (long long) value;
+   }
+}
+
+/*
+ * Implementation notes: readFileDouble
+ * ------------------------------------
+ * Doubles are rare enough in bulk input that the conversion is left to
+ * strtod, which stops at the white space or the sentinel after the
+ * number.  As in parseDouble, a value out of range is illegal.  A NUL
+ * byte before the sentinel ends the token just as the sentinel does,
+ * so it is illegal too; otherwise strtod would read an empty token at
+ * the NUL as 0 without moving, and every later value would be 0.
+ */
+
+double InputSource::readFileDouble() {
+   while (true) {
+      char *start = skipSpace();
+      if (start == NULL) error("No more input values");
+      char *p = start;
+      while (*p != '\0' && !isSpace(*p)) {
+         p++;
+      }
+      if (p == limit && !atEnd) {
+         cursor = start;
+         fillBlock();
+         continue;
+      }
+      char *end;
+      errno = 0;
+      double value = strtod(start, &end);
+      if (p == start || (*p == '\0' && p != limit) || end != p || errno != 0) {
+         reportFileError(start);
+      }
+      cursor = p;
+      return value;
+   }
+}
+
+/*
+ * Implementation notes: skipSpace
+ * -------------------------------
+ * Returns the start of the next token, reading further blocks as the
+ * white space runs out, or NULL if the file holds no more tokens.
+ * Every newline passed over advances the line count.
+ */
+
+char *InputSource::skipSpace() {
+   while (true) {
+      char *p = cursor;
+      while (isSpace(*p)) {
+         if (*p == '\n') {
+            line++;
+            lineStart = offset + (p - block.data()) + 1;
+         }
+         p++;
+      }
+      cursor = p;
+      if (p != limit) return p;
+      if (!fillBlock()) return NULL;
+   }
+}
+
+/*
+ * Implementation notes: fillBlock
+ * -------------------------------
+ * Moves the unparsed data from the cursor to the front of the block
+ * and reads as much more as fits after it, returning false if the file
+ * has nothing more.  A token that fills the whole block by itself is
+ * reported as illegal, since it cannot be any number.
+ */
+
+bool InputSource::fillBlock() {
+   char *base = block.data();
+   long long kept = limit - cursor;
+   if (kept == INPUT_BLOCK_SIZE) reportFileError(cursor);
+   offset += cursor - base;
+   memmove(base, cursor, kept);
+   cursor = base;
+   limit = base + kept;
+   if (atEnd) return false;
+   ssize_t count;
+   do {
+      count = read(fd, limit, INPUT_BLOCK_SIZE - kept);
+   } while (count < 0 && errno == EINTR);
+   if (count < 0) error("Cannot read " + filename + ": " + strerror(errno));
+   if (count == 0) atEnd = true;
+   limit += count;
+   *limit = '\0';
+   return count > 0;
+}
+
+void InputSource::reportFileError(const char *start) {
+   long long column = offset + (start - block.data()) - lineStart + 1;
+   error("Illegal input value at line " + to_string(line) + ", column "
+         + to_string(column) + " of " + filename);
+}
+
+void InputSource::closeFile() {
+   if (fd > STDIN_FILENO) close(fd);
+   fd = -1;
+}
+
+/*
+ * Implementation notes: parseInteger, parseDouble
+ * -----------------------------------------------
+ * These functions accept a line only if the conversion consumes all
+ * of it and the value is in range.
+ */
+
+static bool parseInteger(const string & line, long long & value) {
+   if (line.empty()) return false;
+   char *end;
+   errno = 0;
+   value = strtoll(line.c_str(), &end, 10);
+   return *end == '\0' && errno == 0;
+}
+
+static bool parseDouble(const string & line, double & value) {
+   if (line.empty()) return false;
+   char *end;
+   errno = 0;
+   value = strtod(line.c_str(), &end);
+   return *end == '\0' && errno == 0;
+}
+
+/*
+ * Function: isSpace
+ * Usage: if (isSpace(ch)) . . .
+ * -----------------------------
+ * Returns true if the character separates values in a file: a space
+ * or one of the controls from tab to carriage return.  The '\0'
+ * sentinel is not white space, so the loops that skip it stop at the
+ * end of the data.
+ */
+
+static bool isSpace(char ch) {
+   return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
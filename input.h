@@ -0,0 +1,142 @@
+/*
+ * File: input.h
+ * -------------
+ * This interface exports the InputSource class, from which the
+ * interpreter reads the values requested by INPUT statements.
+ */
+
+#ifndef _input_h
+#define _input_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* Constants */
+
+const int INPUT_BLOCK_SIZE = 1 << 20;
+
+/*
+ * Class: InputSource
+ * ------------------
+ * This class supplies values to INPUT statements.  A new source reads
+ * from the console, prompting with " ? " and asking again until the
+ * user types a number of the requested type.  A source attached to a
+ * stream instead reads whitespace-separated numbers from it without
+ * prompting, which is how a program runs against a prepared set of
+ * inputs.
+ *
+ * A source attached to a file reads the same format, but for programs
+ * that read a great many values.  It reads the file in blocks of
+ * INPUT_BLOCK_SIZE bytes and parses each number where it lies in the
+ * block, so a value costs a few comparisons per digit and allocates
+ * nothing.  It keeps count of lines as it goes, so that a bad value is
+ * reported with its line and column.  The file may equally be a pipe
+ * or standard input.
+ */
+
+class InputSource {
+
+public:
+
+/*
+ * Constructor: InputSource
+ * Usage: InputSource input;
+ * -------------------------
+ * Creates a source that reads from the console.
+ */
+
+   InputSource();
+
+/*
+ * Destructor: ~InputSource
+ * Usage: usually implicit
+ * -----------------------
+ * Closes the file the source reads, if it opened one.
+ */
+
+   ~InputSource();
+
+/*
+ * Methods: setStream, setFile, setConsole
+ * Usage: input.setStream(stream);
+ *        input.setFile(filename);
+ *        input.setConsole();
+ * -------------------------------
+ * These methods attach the source to a stream, which must outlive
+ * its use, attach it to the named file, or return it to reading from
+ * the console.  The file name "-" stands for standard input.  A file
+ * that cannot be opened is reported by calling error, and leaves the
+ * source as it was.
+ */
+
+   void setStream(std::istream & stream);
+   void setFile(const std::string & filename);
+   void setConsole();
+
+/*
+ * Method: isInteractive
+ * Usage: if (input.isInteractive()) . . .
+ * ---------------------------------------
+ * Returns true if the source reads from the console.  The engines
+ * flush the output before an INPUT only in that case, so that the
+ * user sees everything printed before the prompt.
+ */
+
+   bool isInteractive();
+
+/*
+ * Methods: readInteger, readDouble
+ * Usage: long long value = input.readInteger();
+ *        double value = input.readDouble();
+ * ---------------------------------------------
+ * These methods return the next input value, which is an integer for
+ * an integer variable and any number for a double one.  When reading
+ * from a stream, they raise an error if the stream is exhausted or the
+ * next token is not a number of the requested type, giving its line and
+ * column if the source is a file.
+ */
+
+   long long readInteger();
+   double readDouble();
+
+private:
+
+   const std::string & readStreamToken();
+   long long readFileInteger();
+   double readFileDouble();
+   char *skipSpace();
+   bool fillBlock();
+   void reportFileError(const char *start);
+   void closeFile();
+
+   std::istream *stream;       /* The stream, or NULL for the console       */
+   std::string token;          /* The last token read from the stream       */
+   int fd;                     /* The file read in blocks, or -1            */
+   std::string filename;       /* The name of that file, for errors         */
+   std::vector<char> block;    /* The block, with room for a sentinel       */
+   char *cursor;               /* The next character to be parsed           */
+   char *limit;                /* The end of the data, which holds a '\0'   */
+   bool atEnd;                 /* True once the whole file has been read    */
+   long long offset;           /* The file offset of the start of the block */
+   long long line;             /* The line of the cursor, counting from 1   */
+   long long lineStart;        /* The file offset at which that line begins */
+
+/* Sources cannot be copied, since the copies would share one file */
+
+   InputSource(const InputSource & src) = delete;
+   InputSource & operator=(const InputSource & src) = delete;
+
+};
+
+/*
+ * Implementation notes: isInteractive
+ * -----------------------------------
+ * This is defined here so that the engine loops can inline it.
+ */
+
+inline bool InputSource::isInteractive() {
+   return stream == NULL && fd < 0;
+}
+
+#endif
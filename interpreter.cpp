@@ -0,0 +1,61 @@
+/*
+ * File: interpreter.cpp
+ * ---------------------
+ * This file implements the functions that run a program.  The
+ * statement loop itself is a template defined in interpreter.h.
+ */
+
+#include "bytecode.h"
+#include "compiler.h"
+#include "error.h"
+#include "interpreter.h"
+#include "jit.h"
+#include "strlib.h"
+#include "vm.h"
+using namespace std;
+
+void runProgram(Program & program, EvalState & state) {
+   program.keepDoubles(state);
+   Bytecode bytecode;
+   compileProgram(program, bytecode);
+   state.getCheckpointer().prepare(program);
+   executeBytecode(bytecode, state);
+}
+
+void runProgram(IncrementalCompiler & compiler, EvalState & state) {
+   compiler.getProgram().keepDoubles(state);
+   const Bytecode & bytecode = compiler.compile(state.getGovernor().isActive());
+   state.getCheckpointer().prepare(compiler.getProgram());
+   executeBytecode(bytecode, state);
+}
+
+void resumeProgram(IncrementalCompiler & compiler, EvalState & state, int lineNumber) {
+   compiler.getProgram().keepDoubles(state);
+   const Bytecode & bytecode = compiler.compile(true);
+   int address = findLineAddress(bytecode, lineNumber);
+   if (address == -1) error("Cannot resume at line " + integerToString(lineNumber));
+   state.getCheckpointer().prepare(compiler.getProgram());
+   executeBytecode(bytecode, state, address);
+}
+
+void runProgramJIT(Program & program, EvalState & state) {
+   program.keepDoubles(state);
+   Bytecode bytecode;
+   compileProgram(program, bytecode);
+   state.getCheckpointer().prepare(program);
+   JitCompiler jit(bytecode, state);
+   executeBytecode(bytecode, state, jit);
+}
+
+void runStatements(Program & program, EvalState & state) {
+   DirectExecutor executor;
+   walkStatements(program, state, executor);
+}
+
+long long countLoopLines(Program::SourceLine *line) {
+   long long count = 1;
+   for (Program::SourceLine *cp = line->target; cp != line; cp = cp->next) {
+      count++;
+   }
+   return count;
+}
@@ -0,0 +1,168 @@
+/*
+ * File: interpreter.h
+ * -------------------
+ * This interface exports the ways of running a program: on the
+ * bytecode virtual machine, with or without native code for its hot
+ * loops, and by walking the parsed statements.  It
+ * holds everything needed to run a program apart from the console,
+ * so that tools such as the benchmarks can run programs without
+ * Basic.cpp.
+ */
+
+#ifndef _interpreter_h
+#define _interpreter_h
+
+#include <unordered_map>
+#include "compiler.h"
+#include "evalstate.h"
+#include "program.h"
+
+/* Constants */
+
+const int END_PROGRAM_LINE_NUMBER = -1;
+
+/*
+ * Function: runProgram
+ * Usage: runProgram(program, state);
+ * ----------------------------------
+ * Compiles the program to bytecode and executes it on the virtual
+ * machine.
+ */
+
+void runProgram(Program & program, EvalState & state);
+
+/*
+ * Function: runProgram
+ * Usage: runProgram(compiler, state);
+ * -----------------------------------
+ * Brings the bytecode held by an IncrementalCompiler up to date with
+ * its program and executes it on the virtual machine.  After an edit,
+ * only the lines the edit affects are compiled again, unless the run
+ * is held to limits, which need the code of a full compilation.
+ */
+
+void runProgram(IncrementalCompiler & compiler, EvalState & state);
+
+/*
+ * Function: resumeProgram
+ * Usage: resumeProgram(compiler, state, lineNumber);
+ * --------------------------------------------------
+ * Runs the program on the virtual machine as runProgram does, but
+ * starting at the specified line rather than the first, which is how
+ * RESUME continues from a checkpoint restored into the state.  A line
+ * at which no checkpoint could have been taken is reported by calling
+ * error.
+ */
+
+void resumeProgram(IncrementalCompiler & compiler, EvalState & state, int lineNumber);
+
+/*
+ * Function: runProgramJIT
+ * Usage: runProgramJIT(program, state);
+ * -------------------------------------
+ * Compiles the program to bytecode and executes it on the virtual
+ * machine with a JitCompiler, which runs hot loops as native code.
+ */
+
+void runProgramJIT(Program & program, EvalState & state);
+
+/*
+ * Function: runStatements
+ * Usage: runStatements(program, state);
+ * -------------------------------------
+ * Executes the parsed statements one at a time, as walkStatements
+ * does with a DirectExecutor.
+ */
+
+void runStatements(Program & program, EvalState & state);
+
+/*
+ * Function: walkStatements
+ * Usage: walkStatements(program, state, executor);
+ * ------------------------------------------------
+ * Executes the parsed statements one at a time, following the links
+ * resolved by Program::link, and calls executor.execute(line, state)
+ * to run each one.  The loop is instantiated separately for each kind
+ * of executor, so that a plain run contains no code belonging to,
+ * say, the profiler.
+ */
+
+template <typename Executor>
+void walkStatements(Program & program, EvalState & state, Executor & executor);
+
+/*
+ * Function: countLoopLines
+ * Usage: long long cost = countLoopLines(line);
+ * ---------------------------------------------
+ * Returns the number of lines from the target of a line that jumps
+ * backward through the line itself.  This is what every engine charges
+ * the governor for one pass around the loop the jump closes, as
+ * described for Bytecode in bytecode.h, so that all of them stop a
+ * run at the same point.
+ */
+
+long long countLoopLines(Program::SourceLine *line);
+
+/*
+ * Class: DirectExecutor
+ * ---------------------
+ * This executor runs each statement and does nothing else.
+ */
+
+class DirectExecutor {
+
+public:
+
+   void execute(Program::SourceLine *line, EvalState & state) {
+      line->lineParsed->execute(state);
+   }
+
+};
+
+/*
+ * Implementation notes: walkStatements
+ * ------------------------------------
+ * The current line is set to the following line before each statement
+ * runs, so a statement has jumped exactly when it changed that value.
+ * At each jump backward, which is the only place a program can begin
+ * to repeat itself, the governor is charged for the loop the jump
+ * closes before the line jumped to begins, exactly as the virtual
+ * machine charges it.  The cost of each jump is found on its first use
+ * and kept for the rest of the run.  A checkpoint that has fallen due
+ * is taken there too.
+ */
+
+template <typename Executor>
+void walkStatements(Program & program, EvalState & state, Executor & executor) {
+   program.keepDoubles(state);
+   Program::SourceLine *line = program.link();
+   Governor & governor = state.getGovernor();
+   bool governed = governor.isActive();
+   std::unordered_map<Program::SourceLine *, long long> loopCosts;
+   state.getCheckpointer().prepare(program);
+   state.startRun();
+   while (line != NULL) {
+      int nextLineNumber = (line->next == NULL) ? END_PROGRAM_LINE_NUMBER
+                                                : line->next->lineNumber;
+      state.setCurrentLine(nextLineNumber);
+      executor.execute(line, state);
+      int currentLineNumber = state.getCurrentLine();
+      if (currentLineNumber == nextLineNumber) {
+         line = line->next;
+      } else if (currentLineNumber == END_PROGRAM_LINE_NUMBER) {
+         line = NULL;
+      } else {
+         if (governed && currentLineNumber <= line->lineNumber) {
+            long long & cost = loopCosts[line];
+            if (cost == 0) cost = countLoopLines(line);
+            governor.charge(cost);
+            if (governor.isCheckpointDue()) {
+               state.getCheckpointer().save(state, currentLineNumber);
+            }
+         }
+         line = line->target;
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,1096 @@
+/*
+ * File: jit.cpp
+ * -------------
+ * This file implements the JitCompiler class.  The x86-64 instruction
+ * encoder and the translation of a loop from bytecode are private to
+ * this file.
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <set>
+#include <vector>
+#include "bytecode.h"
+#include "evalstate.h"
+#include "exp.h"
+#include "jit.h"
+#include "output.h"
+using namespace std;
+
+JitCompiler::JitCompiler(const Bytecode & bytecode, EvalState & state)
+      : bytecode(bytecode), state(state) {
+   compiledLoopCount = 0;
+}
+
+JitCompiler::~JitCompiler() {
+   for (auto & entry : loops) {
+      Loop & loop = entry.second;
+      if (loop.memory != NULL) munmap(loop.memory, loop.memorySize);
+   }
+}
+
+/*
+ * Implementation notes: backEdge
+ * ------------------------------
+ * A loop whose compilation failed is remembered, so that the machine
+ * does not try again on every iteration.  The native code assumes that
+ * every variable it reads holds an integer, so it is entered only when
+ * that holds; otherwise the machine runs the next iteration itself,
+ * which usually defines them.  Native code that ran out of fuel has
+ * exited, and the limits are checked before the machine goes on.
+ */
+
+int JitCompiler::backEdge(int from, int target) {
+   Loop & loop = loops[target];
+   if (loop.code == NULL) {
+      if (loop.failed || ++loop.count < HOT_LOOP_THRESHOLD) return target;
+      int end = from + instructionLength(bytecode.code[from]);
+      if (!compileLoop(loop, target, end)) {
+         loop.failed = true;
+         return target;
+      }
+      compiledLoopCount++;
+   }
+   if (!canEnter(loop)) return target;
+   int pc = loop.code(state.getBindings());
+   Governor & governor = state.getGovernor();
+   if (*governor.getFuel() < 0) governor.refuel();
+   return pc;
+}
+
+int JitCompiler::getCompiledLoopCount() {
+   return compiledLoopCount;
+}
+
+bool JitCompiler::canEnter(const Loop & loop) {
+   EvalState::Binding *vars = state.getBindings();
+   for (int slot : loop.requiredSlots) {
+      if (vars[slot].type != INTEGER_TYPE) return false;
+   }
+   return true;
+}
+
+#if defined(__x86_64__)
+
+/*
+ * Implementation notes: register use
+ * ----------------------------------
+ * The native code follows the System V calling convention.  R15 holds
+ * the variable array.  Up to five variables are kept in the remaining
+ * callee-saved registers, so they survive the call that prints a value.
+ * Intermediate values of an expression live in the caller-saved
+ * registers listed as temporaries; RAX and RDX are left free for
+ * division.  Every statement leaves no intermediate values behind, so
+ * nothing but the variables is live across a PRINT or an exit.  In a
+ * run held to limits, R14 holds the governor's fuel instead of a
+ * variable; it is loaded on entry and stored by the common exit.  Values
+ * are 64 bits wide, so every arithmetic instruction carries REX.W, and
+ * constants, which are at most one word, are sign-extended immediates.
+ */
+
+enum Register {
+   RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+static const Register VARIABLE_REGISTERS[] = { RBX, RBP, R12, R13, R14 };
+static const int VARIABLE_REGISTER_COUNT = 5;
+static const Register TEMPORARY_REGISTERS[] = { R11, R10, R9, R8, RDI, RSI, RCX };
+static const int TEMPORARY_REGISTER_COUNT = 7;
+static const Register VARS_REGISTER = R15;
+static const Register FUEL_REGISTER = R14;
+
+/*
+ * Type: Condition
+ * ---------------
+ * This enumerated type gives the x86 condition codes used by the
+ * conditional jumps, which follow a comparison of the left operand
+ * with the right.
+ */
+
+enum Condition {
+   CC_E = 0x4, CC_NE = 0x5, CC_S = 0x8, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+};
+
+/* Private function prototypes */
+
+static bool isConditionalJump(int op);
+static Condition jumpCondition(int op);
+static Condition relationCondition(int relation);
+static Condition swapCondition(Condition cc);
+static bool testCondition(Condition cc, int lhs, int rhs);
+static void computeDivisionMagic(long long divisor, long long & magic, int & shift);
+static void printValue(OutputBuffer *output, long long value);
+
+/*
+ * Implementation notes: LoopAssembler
+ * -----------------------------------
+ * The assembler translates the bytecode of one loop in a single pass.
+ * The evaluation stack is simulated at compile time: each entry is a
+ * constant, a variable's register or a temporary register, and an
+ * operation combines its operands into a temporary only when it needs
+ * one, so that I + 1 becomes a single add of an immediate.
+ *
+ * Jumps are emitted with a placeholder displacement and patched at the
+ * end, like the fixups of the bytecode compiler.  A jump whose target
+ * lies outside the loop goes to an exit stub that loads the target
+ * into EAX and joins the common exit, which writes the variables back
+ * and returns.  A division by zero exits to the start of its statement,
+ * so that the virtual machine evaluates the statement again and
+ * reports the error; because the loop may not contain assignments
+ * inside expressions, no variable has changed since the statement
+ * began.
+ *
+ * When the run is governed, each jump back within the loop subtracts
+ * the cost of its loop from the fuel with an lea, which leaves the
+ * flags of the comparison intact, so a conditional jump back is
+ * charged before it is known to be taken.  The path on which it is not
+ * taken adds the cost back with a second lea, so the native code
+ * charges exactly what the machine charges.  The target of every such
+ * jump begins with a test of the fuel that exits there once it is
+ * negative, leaving the machine to check the limits.  The loop thus
+ * gains no branch that is taken.
+ */
+
+class LoopAssembler {
+
+public:
+
+   LoopAssembler(const Bytecode & bytecode, OutputBuffer & output, long long *fuel);
+   bool assemble(int start, int end, vector<unsigned char> & machineCode,
+                 vector<int> & requiredSlots);
+
+private:
+
+   struct Operand {
+      bool isConstant;
+      bool isTemporary;
+      int value;
+      Register reg;
+   };
+
+   struct Patch {
+      int offset;
+      int address;
+      bool isExit;
+   };
+
+   bool scanLoop(vector<int> & requiredSlots);
+   void translate(int pc);
+   void translateLoad(int slot);
+   void translateStore(int slot);
+   void translateAddTo(int slot, int k);
+   void translateMulTo(int slot, int k);
+   void translateArithmetic(int op);
+   void translateDivide();
+   void translateDivideByConstant(Operand lhs, int divisor);
+   void translateShift(int op, int k);
+   void translatePrint();
+   void translateCompare(Condition cc, int address);
+
+   void push(Operand operand);
+   Operand pop();
+   Operand constantOperand(int value);
+   Operand registerOperand(Register reg, bool isTemporary);
+   Register allocateTemporary();
+   void release(Operand operand);
+   Register toTemporary(Operand operand);
+   int valueOffset(int slot);
+   int typeOffset(int slot);
+
+   void emitPrologue();
+   void emitCommonExit();
+   void emitExitStubs();
+   void emitJump(int address);
+   void emitJumpIf(Condition cc, int address);
+   void emitExit(int address);
+   void emitExitIf(Condition cc, int address);
+   bool isChargedBackEdge(int address);
+   int getLoopCost();
+   void emitFuelChange(int amount);
+   void emitFuelCheck(int address);
+   void addPatch(int address, bool isExit);
+   bool resolvePatches();
+
+   void emitByte(int byte);
+   void emitInt32(int32_t value);
+   void emitInt64(int64_t value);
+   void emitRex(bool wide, int reg, int rm);
+   void emitModRM(int mod, int reg, int rm);
+   void emitRegReg(int opcode, Register reg, Register rm);
+   void emitMem(bool wide, int opcode, int reg, int disp);
+   void emitMoveImmediate(Register dst, int value);
+   void emitMoveAddress(Register dst, const void *address);
+   void emitMoveOperand(Register dst, Operand operand);
+   void emitGroup1(int ext, Register dst, int value);
+   void emitShift(int ext, Register dst, int k);
+   void emitPush(Register reg);
+   void emitPop(Register reg);
+
+   const Bytecode & bytecode;
+   OutputBuffer & output;
+   long long *fuel;
+   int start;
+   int end;
+   int current;
+   int statementStart;
+   bool ok;
+   vector<unsigned char> code;
+   vector<int> labels;
+   vector<Patch> patches;
+   map<int,int> exitStubs;
+   int commonExit;
+   map<int,Register> cachedVars;
+   set<int> loopHeads;
+   vector<Operand> stack;
+   vector<Register> freeTemporaries;
+
+};
+
+LoopAssembler::LoopAssembler(const Bytecode & bytecode, OutputBuffer & output, long long *fuel)
+      : bytecode(bytecode), output(output), fuel(fuel) {
+   start = end = current = statementStart = commonExit = 0;
+   ok = true;
+   for (int i = 0; i < TEMPORARY_REGISTER_COUNT; i++) {
+      freeTemporaries.push_back(TEMPORARY_REGISTERS[i]);
+   }
+}
+
+bool LoopAssembler::assemble(int start, int end, vector<unsigned char> & machineCode,
+                             vector<int> & requiredSlots) {
+   this->start = start;
+   this->end = end;
+   if (!scanLoop(requiredSlots)) return false;
+   emitPrologue();
+   labels.assign(end - start, -1);
+   int pc = start;
+   while (pc < end && ok) {
+      if (stack.empty()) statementStart = pc;
+      labels[pc - start] = code.size();
+      current = pc;
+      if (loopHeads.count(pc) != 0) emitFuelCheck(pc);
+      translate(pc);
+      pc += instructionLength(bytecode.code[pc]);
+   }
+   if (!ok || !stack.empty()) return false;
+   emitJump(end);
+   emitCommonExit();
+   emitExitStubs();
+   if (!resolvePatches()) return false;
+   machineCode.swap(code);
+   return true;
+}
+
+/*
+ * Implementation notes: scanLoop
+ * ------------------------------
+ * The scan rejects loops containing instructions the assembler does not
+ * translate, which include every instruction on doubles and on wide
+ * constants, counts the references to each variable to choose the ones
+ * kept in registers, and collects the slots that must hold integers
+ * when the native code is entered: every variable the loop reads and
+ * every variable held in a register, whose value is loaded on entry.
+ * In a governed run it also records the targets of the jumps back.
+ */
+
+bool LoopAssembler::scanLoop(vector<int> & requiredSlots) {
+   map<int,int> uses;
+   set<int> required;
+   int pc = start;
+   while (pc < end) {
+      int op = bytecode.code[pc];
+      switch (op) {
+       case OP_LOAD:
+         uses[bytecode.code[pc + 1]]++;
+         required.insert(bytecode.code[pc + 1]);
+         break;
+       case OP_STORE:
+         uses[bytecode.code[pc + 1]]++;
+         break;
+       case OP_ADD_TO: case OP_MUL_TO: case OP_JUMP_VAR_CONST: case OP_INC_JUMP_CONST:
+         uses[bytecode.code[pc + 1]] += 2;
+         required.insert(bytecode.code[pc + 1]);
+         break;
+       case OP_INC_JUMP_VAR:
+         uses[bytecode.code[pc + 1]] += 2;
+         required.insert(bytecode.code[pc + 1]);
+         uses[bytecode.code[pc + 4]]++;
+         required.insert(bytecode.code[pc + 4]);
+         break;
+       case OP_HALT: case OP_PUSH: case OP_POP: case OP_ADD: case OP_SUB:
+       case OP_MUL: case OP_DIV: case OP_SHL: case OP_SHR: case OP_PRINT:
+       case OP_INPUT: case OP_JUMP: case OP_JUMP_CONST:
+         break;
+       default:
+         if (!isConditionalJump(op)) return false;
+         break;
+      }
+      int index = jumpTargetIndex(op);
+      if (fuel != NULL && index != 0) {
+         int target = bytecode.code[pc + index];
+         if (target >= start && target <= pc) loopHeads.insert(target);
+      }
+      pc += instructionLength(op);
+   }
+   if (pc != end) return false;
+   vector<pair<int,int>> ranked;
+   for (auto & entry : uses) {
+      ranked.push_back(make_pair(-entry.second, entry.first));
+   }
+   sort(ranked.begin(), ranked.end());
+   int registerCount = (fuel == NULL) ? VARIABLE_REGISTER_COUNT : VARIABLE_REGISTER_COUNT - 1;
+   for (int i = 0; i < (int) ranked.size() && i < registerCount; i++) {
+      int slot = ranked[i].second;
+      cachedVars[slot] = VARIABLE_REGISTERS[i];
+      required.insert(slot);
+   }
+   requiredSlots.assign(required.begin(), required.end());
+   return true;
+}
+
+/*
+ * Implementation notes: translate
+ * -------------------------------
+ * The superinstructions are translated as the sequences they replace,
+ * except that adding a constant to a variable is a single add.
+ */
+
+void LoopAssembler::translate(int pc) {
+   const int *instruction = &bytecode.code[pc];
+   int op = instruction[0];
+   int operand = (instructionLength(op) > 1) ? instruction[1] : 0;
+   switch (op) {
+    case OP_PUSH:
+      push(constantOperand(operand));
+      break;
+    case OP_LOAD:
+      translateLoad(operand);
+      break;
+    case OP_STORE:
+      translateStore(operand);
+      break;
+    case OP_POP:
+      release(pop());
+      break;
+    case OP_ADD: case OP_SUB: case OP_MUL:
+      translateArithmetic(op);
+      break;
+    case OP_DIV:
+      translateDivide();
+      break;
+    case OP_SHL: case OP_SHR:
+      translateShift(op, operand);
+      break;
+    case OP_PRINT:
+      translatePrint();
+      break;
+    case OP_INPUT: case OP_HALT:
+      emitExit(pc);
+      break;
+    case OP_JUMP:
+      emitJump(operand);
+      break;
+    case OP_ADD_TO:
+      translateAddTo(operand, instruction[2]);
+      break;
+    case OP_MUL_TO:
+      translateMulTo(operand, instruction[2]);
+      break;
+    case OP_JUMP_CONST:
+      push(constantOperand(instruction[2]));
+      translateCompare(relationCondition(operand), instruction[3]);
+      break;
+    case OP_JUMP_VAR_CONST:
+      translateLoad(operand);
+      push(constantOperand(instruction[3]));
+      translateCompare(relationCondition(instruction[2]), instruction[4]);
+      break;
+    case OP_INC_JUMP_CONST:
+      translateAddTo(operand, instruction[2]);
+      translateLoad(operand);
+      push(constantOperand(instruction[4]));
+      translateCompare(relationCondition(instruction[3]), instruction[5]);
+      break;
+    case OP_INC_JUMP_VAR:
+      translateAddTo(operand, instruction[2]);
+      translateLoad(operand);
+      translateLoad(instruction[4]);
+      translateCompare(relationCondition(instruction[3]), instruction[5]);
+      break;
+    default:
+      translateCompare(jumpCondition(op), operand);
+      break;
+   }
+}
+
+void LoopAssembler::translateLoad(int slot) {
+   if (cachedVars.count(slot) != 0) {
+      push(registerOperand(cachedVars[slot], false));
+   } else {
+      Register dst = allocateTemporary();
+      emitMem(true, 0x8B, dst, valueOffset(slot));
+      push(registerOperand(dst, true));
+   }
+}
+
+void LoopAssembler::translateStore(int slot) {
+   Operand value = pop();
+   if (cachedVars.count(slot) != 0) {
+      emitMoveOperand(cachedVars[slot], value);
+   } else {
+      if (value.isConstant) {
+         emitMem(true, 0xC7, 0, valueOffset(slot));
+         emitInt32(value.value);
+      } else {
+         emitMem(true, 0x89, value.reg, valueOffset(slot));
+      }
+      emitMem(false, 0xC7, 0, typeOffset(slot));
+      emitInt32(INTEGER_TYPE);
+   }
+   release(value);
+}
+
+void LoopAssembler::translateAddTo(int slot, int k) {
+   if (cachedVars.count(slot) != 0) {
+      emitGroup1(0, cachedVars[slot], k);
+   } else {
+      emitMem(true, 0x81, 0, valueOffset(slot));
+      emitInt32(k);
+   }
+}
+
+void LoopAssembler::translateMulTo(int slot, int k) {
+   translateLoad(slot);
+   push(constantOperand(k));
+   translateArithmetic(OP_MUL);
+   translateStore(slot);
+}
+
+void LoopAssembler::translateArithmetic(int op) {
+   Operand rhs = pop();
+   Operand lhs = pop();
+   if (lhs.isConstant && !rhs.isConstant && op != OP_SUB) swap(lhs, rhs);
+   Register dst = toTemporary(lhs);
+   if (op == OP_MUL) {
+      if (rhs.isConstant) {
+         emitRex(true, dst, dst);
+         emitByte(0x69);
+         emitModRM(3, dst, dst);
+         emitInt32(rhs.value);
+      } else {
+         emitRex(true, dst, rhs.reg);
+         emitByte(0x0F);
+         emitByte(0xAF);
+         emitModRM(3, dst, rhs.reg);
+      }
+   } else if (rhs.isConstant) {
+      emitGroup1((op == OP_ADD) ? 0 : 5, dst, rhs.value);
+   } else {
+      emitRegReg((op == OP_ADD) ? 0x01 : 0x29, rhs.reg, dst);
+   }
+   release(rhs);
+   push(registerOperand(dst, true));
+}
+
+/*
+ * Implementation notes: translateDivide
+ * -------------------------------------
+ * A 64-bit idiv is several times slower than a 32-bit one on most
+ * processors, and the operands of a division rarely need the width.
+ * A division by a constant other than 0 or -1 therefore becomes a
+ * multiplication, and any other division tests whether both operands
+ * are nonnegative 31-bit values, for which the quotient of an unsigned
+ * 32-bit div is the same, before falling back on the full idiv.  The
+ * wide path negates the dividend for a divisor of -1, as divideIntegers
+ * does, since idiv traps on the smallest integer divided by -1.
+ */
+
+void LoopAssembler::translateDivide() {
+   Operand rhs = pop();
+   Operand lhs = pop();
+   if (rhs.isConstant && rhs.value != 0 && rhs.value != -1) {
+      translateDivideByConstant(lhs, rhs.value);
+      return;
+   }
+   bool mayBeZero = !rhs.isConstant || rhs.value == 0;
+   if (rhs.isConstant) rhs = registerOperand(toTemporary(rhs), true);
+   if (mayBeZero) {
+      emitRegReg(0x85, rhs.reg, rhs.reg);
+      emitExitIf(CC_E, statementStart);
+   }
+   emitMoveOperand(RAX, lhs);
+   emitRegReg(0x89, RAX, RDX);
+   emitRegReg(0x09, rhs.reg, RDX);
+   emitShift(5, RDX, 31);
+   emitByte(0x75);
+   int wide = code.size();
+   emitByte(0);
+   emitByte(0x31);
+   emitModRM(3, RDX, RDX);
+   emitRex(false, 0, rhs.reg);
+   emitByte(0xF7);
+   emitModRM(3, 6, rhs.reg);
+   emitByte(0xEB);
+   int done = code.size();
+   emitByte(0);
+   code[wide] = code.size() - (wide + 1);
+   emitRex(true, 0, rhs.reg);
+   emitByte(0x83);
+   emitModRM(3, 7, rhs.reg);
+   emitByte(0xFF);
+   emitByte(0x75);
+   int divide = code.size();
+   emitByte(0);
+   emitRex(true, 0, RAX);
+   emitByte(0xF7);
+   emitModRM(3, 3, RAX);
+   emitByte(0xEB);
+   int negated = code.size();
+   emitByte(0);
+   code[divide] = code.size() - (divide + 1);
+   emitByte(0x48);
+   emitByte(0x99);
+   emitRex(true, 0, rhs.reg);
+   emitByte(0xF7);
+   emitModRM(3, 7, rhs.reg);
+   code[done] = code.size() - (done + 1);
+   code[negated] = code.size() - (negated + 1);
+   release(rhs);
+   release(lhs);
+   Register dst = allocateTemporary();
+   emitRegReg(0x89, RAX, dst);
+   push(registerOperand(dst, true));
+}
+
+/*
+ * Implementation notes: translateDivideByConstant
+ * -----------------------------------------------
+ * The quotient is the high word of the product of the dividend and a
+ * magic number, corrected by the dividend when the sign of the magic
+ * number differs from that of the divisor, shifted right, and rounded
+ * toward zero by adding its own sign bit.  This is the method of
+ * Granlund and Montgomery, as given in Hacker's Delight, section 10-4.
+ */
+
+void LoopAssembler::translateDivideByConstant(Operand lhs, int divisor) {
+   if (divisor == 1) {
+      push(lhs);
+      return;
+   }
+   long long magic;
+   int shift;
+   computeDivisionMagic(divisor, magic, shift);
+   if (lhs.isConstant) lhs = registerOperand(toTemporary(lhs), true);
+   emitRex(true, 0, RAX);
+   emitByte(0xB8 + (RAX & 7));
+   emitInt64(magic);
+   emitRex(true, 0, lhs.reg);
+   emitByte(0xF7);
+   emitModRM(3, 5, lhs.reg);
+   if (divisor > 0 && magic < 0) emitRegReg(0x01, lhs.reg, RDX);
+   if (divisor < 0 && magic > 0) emitRegReg(0x29, lhs.reg, RDX);
+   if (shift > 0) emitShift(7, RDX, shift);
+   emitRegReg(0x89, RDX, RAX);
+   emitShift(5, RAX, 63);
+   emitRegReg(0x01, RAX, RDX);
+   release(lhs);
+   Register dst = allocateTemporary();
+   emitRegReg(0x89, RDX, dst);
+   push(registerOperand(dst, true));
+}
+
+/*
+ * Implementation notes: translateShift
+ * ------------------------------------
+ * The right shift rounds toward zero, as shiftRightTowardZero does, by
+ * adding 2^k - 1 to negative values before the arithmetic shift.  That
+ * bias is the sign mask shifted right logically by 64 - k, which needs
+ * no immediate however large k is.
+ */
+
+void LoopAssembler::translateShift(int op, int k) {
+   Register dst = toTemporary(pop());
+   if (op == OP_SHL) {
+      emitShift(4, dst, k);
+   } else {
+      emitRegReg(0x89, dst, RAX);
+      emitShift(7, RAX, 63);
+      emitShift(5, RAX, 64 - k);
+      emitRegReg(0x01, RAX, dst);
+      emitShift(7, dst, k);
+   }
+   push(registerOperand(dst, true));
+}
+
+/*
+ * Implementation notes: translatePrint
+ * ------------------------------------
+ * The stack is 16-byte aligned at the call, since the prologue pushes
+ * six registers and subtracts eight bytes.  printValue cannot throw,
+ * which matters because the native frames have no unwind information.
+ */
+
+void LoopAssembler::translatePrint() {
+   Operand value = pop();
+   if (!stack.empty()) {
+      ok = false;
+      return;
+   }
+   emitMoveOperand(RSI, value);
+   release(value);
+   emitMoveAddress(RDI, &output);
+   emitMoveAddress(RAX, (const void *) &printValue);
+   emitByte(0xFF);
+   emitModRM(3, 2, RAX);
+}
+
+void LoopAssembler::translateCompare(Condition cc, int address) {
+   Operand rhs = pop();
+   Operand lhs = pop();
+   if (lhs.isConstant && rhs.isConstant) {
+      if (testCondition(cc, lhs.value, rhs.value)) emitJump(address);
+      return;
+   }
+   if (lhs.isConstant) {
+      swap(lhs, rhs);
+      cc = swapCondition(cc);
+   }
+   if (rhs.isConstant) {
+      emitGroup1(7, lhs.reg, rhs.value);
+   } else {
+      emitRegReg(0x39, rhs.reg, lhs.reg);
+   }
+   release(lhs);
+   release(rhs);
+   emitJumpIf(cc, address);
+}
+
+void LoopAssembler::push(Operand operand) {
+   stack.push_back(operand);
+}
+
+LoopAssembler::Operand LoopAssembler::pop() {
+   Operand operand = stack.back();
+   stack.pop_back();
+   return operand;
+}
+
+LoopAssembler::Operand LoopAssembler::constantOperand(int value) {
+   Operand operand;
+   operand.isConstant = true;
+   operand.isTemporary = false;
+   operand.value = value;
+   operand.reg = RAX;
+   return operand;
+}
+
+LoopAssembler::Operand LoopAssembler::registerOperand(Register reg, bool isTemporary) {
+   Operand operand;
+   operand.isConstant = false;
+   operand.isTemporary = isTemporary;
+   operand.value = 0;
+   operand.reg = reg;
+   return operand;
+}
+
+/*
+ * Implementation notes: allocateTemporary
+ * ---------------------------------------
+ * An expression too deep for the temporaries abandons the loop, which
+ * then stays on the virtual machine.
+ */
+
+Register LoopAssembler::allocateTemporary() {
+   if (freeTemporaries.empty()) {
+      ok = false;
+      return TEMPORARY_REGISTERS[0];
+   }
+   Register reg = freeTemporaries.back();
+   freeTemporaries.pop_back();
+   return reg;
+}
+
+void LoopAssembler::release(Operand operand) {
+   if (operand.isTemporary) freeTemporaries.push_back(operand.reg);
+}
+
+Register LoopAssembler::toTemporary(Operand operand) {
+   if (operand.isTemporary) return operand.reg;
+   Register dst = allocateTemporary();
+   emitMoveOperand(dst, operand);
+   return dst;
+}
+
+int LoopAssembler::valueOffset(int slot) {
+   return slot * sizeof(EvalState::Binding) + offsetof(EvalState::Binding, value);
+}
+
+int LoopAssembler::typeOffset(int slot) {
+   return slot * sizeof(EvalState::Binding) + offsetof(EvalState::Binding, type);
+}
+
+void LoopAssembler::emitPrologue() {
+   emitPush(RBX);
+   emitPush(RBP);
+   emitPush(R12);
+   emitPush(R13);
+   emitPush(R14);
+   emitPush(R15);
+   emitByte(0x48);
+   emitByte(0x83);
+   emitModRM(3, 5, RSP);
+   emitByte(8);
+   emitRex(true, RDI, VARS_REGISTER);
+   emitByte(0x89);
+   emitModRM(3, RDI, VARS_REGISTER);
+   for (auto & entry : cachedVars) {
+      emitMem(true, 0x8B, entry.second, valueOffset(entry.first));
+   }
+   if (fuel != NULL) {
+      emitMoveAddress(RAX, fuel);
+      emitRex(true, FUEL_REGISTER, RAX);
+      emitByte(0x8B);
+      emitModRM(0, FUEL_REGISTER, RAX);
+   }
+}
+
+void LoopAssembler::emitCommonExit() {
+   commonExit = code.size();
+   for (auto & entry : cachedVars) {
+      emitMem(true, 0x89, entry.second, valueOffset(entry.first));
+   }
+   if (fuel != NULL) {
+      emitMoveAddress(RCX, fuel);
+      emitRex(true, FUEL_REGISTER, RCX);
+      emitByte(0x89);
+      emitModRM(0, FUEL_REGISTER, RCX);
+   }
+   emitByte(0x48);
+   emitByte(0x83);
+   emitModRM(3, 0, RSP);
+   emitByte(8);
+   emitPop(R15);
+   emitPop(R14);
+   emitPop(R13);
+   emitPop(R12);
+   emitPop(RBP);
+   emitPop(RBX);
+   emitByte(0xC3);
+}
+
+void LoopAssembler::emitExitStubs() {
+   for (auto & entry : exitStubs) {
+      entry.second = code.size();
+      emitMoveImmediate(RAX, entry.first);
+      emitByte(0xE9);
+      emitInt32(commonExit - (int) (code.size() + 4));
+   }
+}
+
+/*
+ * Implementation notes: emitJump, emitJumpIf, emitExit, emitExitIf
+ * ----------------------------------------------------------------
+ * A jump goes to the native code for its target if the target lies in
+ * the loop and leaves the loop otherwise.  An exit always leaves, even
+ * to an address in the loop, so that the virtual machine runs the
+ * instruction there.
+ */
+
+void LoopAssembler::emitJump(int address) {
+   if (isChargedBackEdge(address)) emitFuelChange(-getLoopCost());
+   emitByte(0xE9);
+   addPatch(address, address < start || address >= end);
+}
+
+void LoopAssembler::emitJumpIf(Condition cc, int address) {
+   bool charged = isChargedBackEdge(address);
+   if (charged) emitFuelChange(-getLoopCost());
+   emitByte(0x0F);
+   emitByte(0x80 + cc);
+   addPatch(address, address < start || address >= end);
+   if (charged) emitFuelChange(getLoopCost());
+}
+
+void LoopAssembler::emitExit(int address) {
+   emitByte(0xE9);
+   addPatch(address, true);
+}
+
+void LoopAssembler::emitExitIf(Condition cc, int address) {
+   emitByte(0x0F);
+   emitByte(0x80 + cc);
+   addPatch(address, true);
+}
+
+bool LoopAssembler::isChargedBackEdge(int address) {
+   return fuel != NULL && address >= start && address <= current;
+}
+
+int LoopAssembler::getLoopCost() {
+   return bytecode.backEdgeCosts.empty() ? 1 : bytecode.backEdgeCosts[current];
+}
+
+void LoopAssembler::emitFuelChange(int amount) {
+   emitRex(true, FUEL_REGISTER, FUEL_REGISTER);
+   emitByte(0x8D);
+   emitModRM(2, FUEL_REGISTER, FUEL_REGISTER);
+   emitInt32(amount);
+}
+
+void LoopAssembler::emitFuelCheck(int address) {
+   emitRegReg(0x85, FUEL_REGISTER, FUEL_REGISTER);
+   emitExitIf(CC_S, address);
+}
+
+void LoopAssembler::addPatch(int address, bool isExit) {
+   Patch patch;
+   patch.offset = code.size();
+   patch.address = address;
+   patch.isExit = isExit;
+   if (isExit) exitStubs[address] = -1;
+   patches.push_back(patch);
+   emitInt32(0);
+}
+
+bool LoopAssembler::resolvePatches() {
+   for (Patch & patch : patches) {
+      int target = patch.isExit ? exitStubs[patch.address] : labels[patch.address - start];
+      if (target < 0) return false;
+      int32_t displacement = target - (patch.offset + 4);
+      memcpy(&code[patch.offset], &displacement, 4);
+   }
+   return true;
+}
+
+void LoopAssembler::emitByte(int byte) {
+   code.push_back((unsigned char) byte);
+}
+
+void LoopAssembler::emitInt32(int32_t value) {
+   unsigned char bytes[4];
+   memcpy(bytes, &value, 4);
+   code.insert(code.end(), bytes, bytes + 4);
+}
+
+void LoopAssembler::emitInt64(int64_t value) {
+   unsigned char bytes[8];
+   memcpy(bytes, &value, 8);
+   code.insert(code.end(), bytes, bytes + 8);
+}
+
+void LoopAssembler::emitRex(bool wide, int reg, int rm) {
+   int rex = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+   if (rex != 0x40) emitByte(rex);
+}
+
+void LoopAssembler::emitModRM(int mod, int reg, int rm) {
+   emitByte((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+void LoopAssembler::emitRegReg(int opcode, Register reg, Register rm) {
+   emitRex(true, reg, rm);
+   emitByte(opcode);
+   emitModRM(3, reg, rm);
+}
+
+/*
+ * Implementation notes: emitMem
+ * -----------------------------
+ * Variables are addressed as [R15 + disp32].  R15 needs no SIB byte,
+ * since its low three bits are not those of RSP.  The wide flag
+ * selects a 64-bit operand, as for a value; a type is 32 bits.
+ */
+
+void LoopAssembler::emitMem(bool wide, int opcode, int reg, int disp) {
+   emitRex(wide, reg, VARS_REGISTER);
+   emitByte(opcode);
+   emitModRM(2, reg, VARS_REGISTER);
+   emitInt32(disp);
+}
+
+void LoopAssembler::emitMoveImmediate(Register dst, int value) {
+   emitRex(true, 0, dst);
+   emitByte(0xC7);
+   emitModRM(3, 0, dst);
+   emitInt32(value);
+}
+
+void LoopAssembler::emitMoveAddress(Register dst, const void *address) {
+   emitRex(true, 0, dst);
+   emitByte(0xB8 + (dst & 7));
+   emitInt64((int64_t) (intptr_t) address);
+}
+
+void LoopAssembler::emitMoveOperand(Register dst, Operand operand) {
+   if (operand.isConstant) {
+      emitMoveImmediate(dst, operand.value);
+   } else if (operand.reg != dst) {
+      emitRegReg(0x89, operand.reg, dst);
+   }
+}
+
+void LoopAssembler::emitGroup1(int ext, Register dst, int value) {
+   emitRex(true, 0, dst);
+   emitByte(0x81);
+   emitModRM(3, ext, dst);
+   emitInt32(value);
+}
+
+void LoopAssembler::emitShift(int ext, Register dst, int k) {
+   emitRex(true, 0, dst);
+   emitByte(0xC1);
+   emitModRM(3, ext, dst);
+   emitByte(k);
+}
+
+void LoopAssembler::emitPush(Register reg) {
+   if (reg & 8) emitByte(0x41);
+   emitByte(0x50 + (reg & 7));
+}
+
+void LoopAssembler::emitPop(Register reg) {
+   if (reg & 8) emitByte(0x41);
+   emitByte(0x58 + (reg & 7));
+}
+
+/*
+ * Implementation notes: compileLoop
+ * ---------------------------------
+ * The code is written into a private mapping that is made executable
+ * only after it is complete, so no page is ever writable and
+ * executable at once.
+ */
+
+bool JitCompiler::compileLoop(Loop & loop, int start, int end) {
+   Governor & governor = state.getGovernor();
+   LoopAssembler assembler(bytecode, state.getOutput(),
+                           governor.isActive() ? governor.getFuel() : NULL);
+   vector<unsigned char> machineCode;
+   if (!assembler.assemble(start, end, machineCode, loop.requiredSlots)) return false;
+   size_t pageSize = sysconf(_SC_PAGESIZE);
+   size_t size = (machineCode.size() + pageSize - 1) / pageSize * pageSize;
+   void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (memory == MAP_FAILED) return false;
+   memcpy(memory, machineCode.data(), machineCode.size());
+   if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+      munmap(memory, size);
+      return false;
+   }
+   loop.memory = memory;
+   loop.memorySize = size;
+   loop.code = (NativeLoop) memory;
+   return true;
+}
+
+static bool isConditionalJump(int op) {
+   return op == OP_JUMP_EQ || op == OP_JUMP_NE || op == OP_JUMP_LT
+       || op == OP_JUMP_LE || op == OP_JUMP_GT || op == OP_JUMP_GE;
+}
+
+static Condition jumpCondition(int op) {
+   switch (op) {
+    case OP_JUMP_EQ: return CC_E;
+    case OP_JUMP_NE: return CC_NE;
+    case OP_JUMP_LT: return CC_L;
+    case OP_JUMP_LE: return CC_LE;
+    case OP_JUMP_GT: return CC_G;
+    default: return CC_GE;
+   }
+}
+
+static Condition relationCondition(int relation) {
+   switch (relation) {
+    case EQ_REL: return CC_E;
+    case NE_REL: return CC_NE;
+    case LT_REL: return CC_L;
+    case LE_REL: return CC_LE;
+    case GT_REL: return CC_G;
+    default: return CC_GE;
+   }
+}
+
+/*
+ * Function: swapCondition
+ * Usage: cc = swapCondition(cc);
+ * ------------------------------
+ * Returns the condition that holds for (b, a) when cc holds for (a, b).
+ */
+
+static Condition swapCondition(Condition cc) {
+   switch (cc) {
+    case CC_L: return CC_G;
+    case CC_LE: return CC_GE;
+    case CC_G: return CC_L;
+    case CC_GE: return CC_LE;
+    default: return cc;
+   }
+}
+
+static bool testCondition(Condition cc, int lhs, int rhs) {
+   switch (cc) {
+    case CC_E: return lhs == rhs;
+    case CC_NE: return lhs != rhs;
+    case CC_L: return lhs < rhs;
+    case CC_LE: return lhs <= rhs;
+    case CC_G: return lhs > rhs;
+    default: return lhs >= rhs;
+   }
+}
+
+/*
+ * Implementation notes: computeDivisionMagic
+ * ------------------------------------------
+ * This is the search of Hacker's Delight, figure 10-1, widened to 64
+ * bits.  It finds the least power 2^p for which the magic number
+ * 2^p / |d|, rounded up, gives the exact quotient of every dividend,
+ * and returns that number with the sign of the divisor and p - 64 as
+ * the shift.  The divisor must be neither 0, 1 nor -1.
+ */
+
+static void computeDivisionMagic(long long divisor, long long & magic, int & shift) {
+   const unsigned long long TWO_63 = 1ULL << 63;
+   unsigned long long ad = (divisor < 0) ? 0 - (unsigned long long) divisor : divisor;
+   unsigned long long t = TWO_63 + ((unsigned long long) divisor >> 63);
+   unsigned long long anc = t - 1 - t % ad;
+   unsigned long long q1 = TWO_63 / anc;
+   unsigned long long r1 = TWO_63 - q1 * anc;
+   unsigned long long q2 = TWO_63 / ad;
+   unsigned long long r2 = TWO_63 - q2 * ad;
+   unsigned long long delta;
+   int p = 63;
+   do {
+      p++;
+      q1 *= 2;
+      r1 *= 2;
+      if (r1 >= anc) {
+         q1++;
+         r1 -= anc;
+      }
+      q2 *= 2;
+      r2 *= 2;
+      if (r2 >= ad) {
+         q2++;
+         r2 -= ad;
+      }
+      delta = ad - r2;
+   } while (q1 < delta || (q1 == delta && r1 == 0));
+   magic = (long long) (q2 + 1);
+   if (divisor < 0) magic = -magic;
+   shift = p - 64;
+}
+
+static void printValue(OutputBuffer *output, long long value) {
+   output->printInteger(value);
+}
+
+#else
+
+bool JitCompiler::compileLoop(Loop & loop, int start, int end) {
+   return false;
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * File: jit.h
+ * -----------
+ * This interface exports the JitCompiler class, which translates hot
+ * loops of a bytecode program into native x86-64 code for RUN JIT.
+ */
+
+#ifndef _jit_h
+#define _jit_h
+
+#include <unordered_map>
+#include <vector>
+#include "bytecode.h"
+#include "evalstate.h"
+
+/* Constants */
+
+const int HOT_LOOP_THRESHOLD = 50;
+
+/*
+ * Class: JitCompiler
+ * ------------------
+ * This class watches the backward jumps taken by the virtual machine.
+ * When a jump has been taken HOT_LOOP_THRESHOLD times, the bytecode
+ * from its target through the jump itself is compiled to native code,
+ * and from then on the machine hands the loop to that code whenever it
+ * reaches the jump.  The most used variables of the loop live in
+ * registers while it runs and are written back to the EvalState when
+ * the native code exits.  The native code exits to the machine at the
+ * start of any statement it cannot finish itself, such as an INPUT, a
+ * jump out of the loop or a division by zero, so that the machine
+ * performs that statement and reports any error exactly as it would
+ * have without the compiler.  In a run held to limits, the native code
+ * charges the governor for each pass around a loop as the machine
+ * does, and returns to the machine when its fuel runs out.
+ *
+ * Native code is generated only on x86-64; on other processors every
+ * loop stays on the virtual machine.
+ */
+
+class JitCompiler {
+
+public:
+
+/*
+ * Constructor: JitCompiler
+ * Usage: JitCompiler jit(bytecode, state);
+ * ----------------------------------------
+ * Creates a compiler for loops of the bytecode when it runs with the
+ * specified state.  Both must outlive the compiler.
+ */
+
+   JitCompiler(const Bytecode & bytecode, EvalState & state);
+
+/*
+ * Destructor: ~JitCompiler
+ * Usage: usually implicit
+ * -----------------------
+ * Frees the memory holding the native code.
+ */
+
+   ~JitCompiler();
+
+/*
+ * Method: backEdge
+ * Usage: int pc = jit.backEdge(from, target);
+ * -------------------------------------------
+ * Called by the virtual machine when the jump at address from is about
+ * to continue at the earlier address target.  If the loop starting at
+ * target has native code that can run in the current state, the code
+ * runs and the method returns the address at which the machine should
+ * continue; otherwise it returns target.  The evaluation stack must be
+ * empty, as it is at every statement boundary.
+ */
+
+   int backEdge(int from, int target);
+
+/*
+ * Method: getCompiledLoopCount
+ * Usage: int n = jit.getCompiledLoopCount();
+ * ------------------------------------------
+ * Returns the number of loops translated to native code so far.
+ */
+
+   int getCompiledLoopCount();
+
+private:
+
+/*
+ * Type: NativeLoop
+ * ----------------
+ * This is the type of the generated code.  It takes the variable
+ * array and returns the address at which the machine continues.
+ */
+
+   typedef int (*NativeLoop)(EvalState::Binding *vars);
+
+/*
+ * Type: Loop
+ * ----------
+ * This structure holds what is known about the loop that starts at
+ * one jump target: how often its back edge has been taken, its native
+ * code if it has been compiled, the slots that must hold integers
+ * before that code may run, and whether compiling it failed.
+ */
+
+   struct Loop {
+      int count;
+      bool failed;
+      NativeLoop code;
+      void *memory;
+      size_t memorySize;
+      std::vector<int> requiredSlots;
+   };
+
+   bool compileLoop(Loop & loop, int start, int end);
+   bool canEnter(const Loop & loop);
+
+   const Bytecode & bytecode;
+   EvalState & state;
+   std::unordered_map<int,Loop> loops;
+   int compiledLoopCount;
+
+/* Compilers cannot be copied, since the copies would free the same code */
+
+   JitCompiler(const JitCompiler & src) = delete;
+   JitCompiler & operator=(const JitCompiler & src) = delete;
+
+};
+
+#endif
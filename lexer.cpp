@@ -0,0 +1,266 @@
+/*
+ * File: lexer.cpp
+ * ---------------
+ * This file implements the lexer.h interface.
+ */
+
+#include <charconv>
+#include <climits>
+#include <string>
+#include <string_view>
+#include "error.h"
+#include "lexer.h"
+using namespace std;
+
+/*
+ * Implementation notes: character classes
+ * ---------------------------------------
+ * Every character is classified by a single lookup in a table built at
+ * compile time, which also holds the uppercase form of each character
+ * for the keyword lookup.  White space is what isspace accepts in the
+ * C locale, which is what TokenScanner ignored.
+ */
+
+enum {
+   SPACE_CLASS = 1,
+   DIGIT_CLASS = 2,
+   WORD_START_CLASS = 4,
+   WORD_CLASS = 8
+};
+
+struct CharTable {
+   unsigned char classes[256];
+   unsigned char upper[256];
+};
+
+static constexpr CharTable makeCharTable() {
+   CharTable table = {};
+   for (int ch = 0; ch < 256; ch++) {
+      unsigned char classes = 0;
+      bool lower = ch >= 'a' && ch <= 'z';
+      bool letter = lower || (ch >= 'A' && ch <= 'Z') || ch == '_';
+      if (ch == ' ' || (ch >= '\t' && ch <= '\r')) classes |= SPACE_CLASS;
+      if (ch >= '0' && ch <= '9') classes |= DIGIT_CLASS | WORD_CLASS;
+      if (letter) classes |= WORD_START_CLASS | WORD_CLASS;
+      table.classes[ch] = classes;
+      table.upper[ch] = lower ? ch - 'a' + 'A' : ch;
+   }
+   return table;
+}
+
+static constexpr CharTable CHARS = makeCharTable();
+
+static inline bool hasClass(char ch, int mask) {
+   return (CHARS.classes[(unsigned char) ch] & mask) != 0;
+}
+
+/*
+ * Implementation notes: keyword lookup
+ * ------------------------------------
+ * Keywords are found with a perfect hash of the first two characters
+ * and the length of the word, taken without regard to case.  The
+ * multipliers were chosen so that no two keywords share a slot in the
+ * table, which is checked when the table is built, so a word is
+ * recognized or rejected with one hash and one comparison.
+ */
+
+struct KeywordEntry {
+   const char *name;
+   int length;
+   Keyword keyword;
+};
+
+static const KeywordEntry KEYWORDS[] = {
+   { "REM", 3, REM_KEYWORD }, { "LET", 3, LET_KEYWORD },
+   { "PRINT", 5, PRINT_KEYWORD }, { "INPUT", 5, INPUT_KEYWORD },
+   { "GOTO", 4, GOTO_KEYWORD }, { "IF", 2, IF_KEYWORD },
+   { "THEN", 4, THEN_KEYWORD }, { "END", 3, END_KEYWORD },
+   { "DIM", 3, DIM_KEYWORD }, { "MAT", 3, MAT_KEYWORD }, { "SUM", 3, SUM_KEYWORD },
+   { "RUN", 3, RUN_KEYWORD }, { "LIST", 4, LIST_KEYWORD },
+   { "CLEAR", 5, CLEAR_KEYWORD }, { "QUIT", 4, QUIT_KEYWORD },
+   { "HELP", 4, HELP_KEYWORD }, { "STATS", 5, STATS_KEYWORD },
+   { "COMPILE", 7, COMPILE_KEYWORD }, { "SAVE", 4, SAVE_KEYWORD },
+   { "LOAD", 4, LOAD_KEYWORD }, { "IMAGE", 5, IMAGE_KEYWORD },
+   { "AST", 3, AST_KEYWORD }, { "JIT", 3, JIT_KEYWORD },
+   { "PROFILE", 7, PROFILE_KEYWORD }
+};
+
+const int KEYWORD_COUNT = sizeof KEYWORDS / sizeof KEYWORDS[0];
+const int KEYWORD_TABLE_SIZE = 64;
+const int MIN_KEYWORD_LENGTH = 2;
+const int MAX_KEYWORD_LENGTH = 7;
+
+static constexpr int hashKeyword(const char *word, int length) {
+   return (CHARS.upper[(unsigned char) word[0]] * 3
+           + CHARS.upper[(unsigned char) word[1]] * 53 + length) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+struct KeywordTable {
+   KeywordEntry slots[KEYWORD_TABLE_SIZE];
+};
+
+static KeywordTable makeKeywordTable() {
+   KeywordTable table = {};
+   for (int i = 0; i < KEYWORD_COUNT; i++) {
+      KeywordEntry & slot = table.slots[hashKeyword(KEYWORDS[i].name, KEYWORDS[i].length)];
+      if (slot.name != NULL) error("Keyword hash collision: " + string(KEYWORDS[i].name));
+      slot = KEYWORDS[i];
+   }
+   return table;
+}
+
+static const KeywordTable KEYWORD_TABLE = makeKeywordTable();
+
+static Keyword lookupKeyword(const char *word, int length, bool & upperCase) {
+   if (length < MIN_KEYWORD_LENGTH || length > MAX_KEYWORD_LENGTH) return NO_KEYWORD;
+   const KeywordEntry & slot = KEYWORD_TABLE.slots[hashKeyword(word, length)];
+   if (slot.length != length) return NO_KEYWORD;
+   upperCase = true;
+   for (int i = 0; i < length; i++) {
+      if (word[i] != slot.name[i]) {
+         if (CHARS.upper[(unsigned char) word[i]] != slot.name[i]) return NO_KEYWORD;
+         upperCase = false;
+      }
+   }
+   return slot.keyword;
+}
+
+/* Implementation of the Lexer class */
+
+Lexer::Lexer() {
+   setInput(string_view());
+}
+
+Lexer::Lexer(string_view line) {
+   setInput(line);
+}
+
+void Lexer::setInput(string_view line) {
+   cp = line.data();
+   end = cp + line.size();
+   hasSaved = false;
+}
+
+Token Lexer::nextToken() {
+   if (hasSaved) {
+      hasSaved = false;
+      return saved;
+   }
+   Token token;
+   scan(token);
+   return token;
+}
+
+const Token & Lexer::peekToken() {
+   if (!hasSaved) {
+      scan(saved);
+      hasSaved = true;
+   }
+   return saved;
+}
+
+bool Lexer::hasMoreTokens() {
+   return peekToken().kind != END_TOKEN;
+}
+
+void Lexer::saveToken(const Token & token) {
+   saved = token;
+   hasSaved = true;
+}
+
+string_view Lexer::getRest() {
+   const char *start = hasSaved ? saved.text.data() : cp;
+   hasSaved = false;
+   while (start < end && hasClass(*start, SPACE_CLASS)) start++;
+   const char *finish = end;
+   while (finish > start && hasClass(finish[-1], SPACE_CLASS)) finish--;
+   cp = end;
+   return string_view(start, finish - start);
+}
+
+/*
+ * Implementation notes: scan
+ * --------------------------
+ * The token is filled in place, so that peekToken can scan straight
+ * into the saved slot.  Number values are accumulated as the digits
+ * are read; once a value would pass LLONG_MAX the rest of the digits
+ * are only skipped, so that the message can show the whole number.
+ * A real is recognized by what follows its digits and converted by
+ * from_chars, which neither allocates nor depends on the locale.  An
+ * E begins an exponent only if a digit follows it, with or without a
+ * sign, so that a number followed by a word still scans as before.
+ */
+
+void Lexer::scan(Token & token) {
+   while (cp < end && hasClass(*cp, SPACE_CLASS)) cp++;
+   const char *start = cp;
+   token.keyword = NO_KEYWORD;
+   token.upperCase = false;
+   token.op = 0;
+   token.value = 0;
+   token.real = 0;
+   if (cp == end) {
+      token.kind = END_TOKEN;
+   } else if (hasClass(*cp, DIGIT_CLASS) || isFractionStart(cp)) {
+      long long value = 0;
+      bool overflow = false;
+      while (cp < end && hasClass(*cp, DIGIT_CLASS)) {
+         int digit = *cp++ - '0';
+         if (value > LLONG_MAX / 10 || (value == LLONG_MAX / 10 && digit > LLONG_MAX % 10)) {
+            overflow = true;
+         }
+         if (!overflow) value = value * 10 + digit;
+      }
+      bool real = false;
+      if (cp < end && *cp == '.') {
+         real = true;
+         cp++;
+         while (cp < end && hasClass(*cp, DIGIT_CLASS)) cp++;
+      }
+      if (isExponentStart(cp)) {
+         real = true;
+         cp += (cp[1] == '+' || cp[1] == '-') ? 2 : 1;
+         while (cp < end && hasClass(*cp, DIGIT_CLASS)) cp++;
+      }
+      if (real) {
+         from_chars_result result = from_chars(start, cp, token.real);
+         if (result.ec != errc()) error("Number out of range: " + string(start, cp - start));
+         token.kind = REAL_TOKEN;
+      } else {
+         if (overflow) error("Number too large: " + string(start, cp - start));
+         token.kind = NUMBER_TOKEN;
+         token.value = value;
+      }
+   } else if (hasClass(*cp, WORD_START_CLASS)) {
+      while (cp < end && hasClass(*cp, WORD_CLASS)) cp++;
+      token.kind = WORD_TOKEN;
+      token.keyword = lookupKeyword(start, cp - start, token.upperCase);
+   } else {
+      token.kind = OPERATOR_TOKEN;
+      token.op = *cp++;
+   }
+   token.text = string_view(start, cp - start);
+}
+
+bool Lexer::isFractionStart(const char *p) {
+   return p + 1 < end && p[0] == '.' && hasClass(p[1], DIGIT_CLASS);
+}
+
+bool Lexer::isExponentStart(const char *p) {
+   if (p >= end || (*p != 'E' && *p != 'e')) return false;
+   p++;
+   if (p < end && (*p == '+' || *p == '-')) p++;
+   return p < end && hasClass(*p, DIGIT_CLASS);
+}
+
+/*
+ * Implementation notes: getLineNumber
+ * -----------------------------------
+ * The message is the one the lexer gave for every number beyond the
+ * range of an int before numbers became 64 bits wide.
+ */
+
+int getLineNumber(const Token & token) {
+   if (token.value > INT_MAX) error("Number too large: " + string(token.text));
+   return (int) token.value;
+}
@@ -0,0 +1,176 @@
+/*
+ * File: lexer.h
+ * -------------
+ * This interface exports the Lexer class, which divides a line of BASIC
+ * into typed tokens.  It replaces the general-purpose TokenScanner on
+ * every path that parses statements or commands, since that class
+ * builds a new string for every token it returns.
+ */
+
+#ifndef _lexer_h
+#define _lexer_h
+
+#include <string_view>
+
+/*
+ * Type: TokenKind
+ * ---------------
+ * This enumerated type identifies the kinds of token the lexer returns.
+ * A number is a run of digits.  A real is a number with a fraction, an
+ * exponent or both, as in 2.5, .5, 1E-3 or 6.02E23, and always denotes
+ * a double, even if its value is whole.  A word is a letter or
+ * underscore followed by letters, digits and underscores, and any other
+ * character that is not white space is an operator token of its own.
+ * END_TOKEN marks the end of the line.
+ */
+
+enum TokenKind { NUMBER_TOKEN, REAL_TOKEN, WORD_TOKEN, OPERATOR_TOKEN, END_TOKEN };
+
+/*
+ * Type: Keyword
+ * -------------
+ * This enumerated type identifies the words that begin statements and
+ * commands, along with the words that may follow them.
+ */
+
+enum Keyword {
+   NO_KEYWORD,
+   REM_KEYWORD, LET_KEYWORD, PRINT_KEYWORD, INPUT_KEYWORD, GOTO_KEYWORD,
+   IF_KEYWORD, THEN_KEYWORD, END_KEYWORD, DIM_KEYWORD, MAT_KEYWORD, SUM_KEYWORD,
+   RUN_KEYWORD, LIST_KEYWORD, CLEAR_KEYWORD, QUIT_KEYWORD, HELP_KEYWORD,
+   STATS_KEYWORD, COMPILE_KEYWORD, SAVE_KEYWORD, LOAD_KEYWORD, IMAGE_KEYWORD,
+   AST_KEYWORD, JIT_KEYWORD, PROFILE_KEYWORD
+};
+
+/*
+ * Type: Token
+ * -----------
+ * This structure describes one token.  The text is a view of the line
+ * being scanned and is valid only as long as that line.  A number
+ * token carries its value in value and a real token in real.  A word token carries the keyword it spells,
+ * ignoring case, or NO_KEYWORD; statements are written in capitals, so
+ * upperCase records whether the keyword was spelled that way.  An
+ * operator token carries its character in op.
+ */
+
+struct Token {
+   TokenKind kind;
+   Keyword keyword;
+   bool upperCase;
+   char op;
+   long long value;
+   double real;
+   std::string_view text;
+};
+
+/*
+ * Class: Lexer
+ * ------------
+ * This class returns the tokens of one line at a time.  It keeps no
+ * copy of the line and allocates nothing, so a single lexer can be
+ * reused for every line of a program by calling setInput.
+ */
+
+class Lexer {
+
+public:
+
+/*
+ * Constructor: Lexer
+ * Usage: Lexer lexer;
+ *        Lexer lexer(line);
+ * -------------------------
+ * Creates a lexer, optionally reading the specified line.  The line
+ * must outlive the lexer's use of it.
+ */
+
+   Lexer();
+   Lexer(std::string_view line);
+
+/*
+ * Method: setInput
+ * Usage: lexer.setInput(line);
+ * ----------------------------
+ * Starts reading tokens from the specified line, discarding any token
+ * saved from the previous one.
+ */
+
+   void setInput(std::string_view line);
+
+/*
+ * Method: nextToken
+ * Usage: Token token = lexer.nextToken();
+ * ---------------------------------------
+ * Returns the next token from the line, or a token of kind END_TOKEN
+ * with empty text once the line is exhausted.  A number too large for
+ * a 64-bit integer or a real too large for a double is reported by
+ * calling error.
+ */
+
+   Token nextToken();
+
+/*
+ * Method: peekToken
+ * Usage: const Token & token = lexer.peekToken();
+ * -----------------------------------------------
+ * Returns the token that the next call to nextToken will return,
+ * without consuming it.  The reference is valid until the lexer is
+ * next used.
+ */
+
+   const Token & peekToken();
+
+/*
+ * Method: hasMoreTokens
+ * Usage: if (lexer.hasMoreTokens()) . . .
+ * ---------------------------------------
+ * Returns true if any tokens remain on the line.
+ */
+
+   bool hasMoreTokens();
+
+/*
+ * Method: saveToken
+ * Usage: lexer.saveToken(token);
+ * ------------------------------
+ * Pushes the token back so that the next call to nextToken returns
+ * it again.  Only one token can be saved at a time.
+ */
+
+   void saveToken(const Token & token);
+
+/*
+ * Method: getRest
+ * Usage: std::string_view rest = lexer.getRest();
+ * -----------------------------------------------
+ * Consumes and returns the rest of the line, including any saved
+ * token, without the white space that surrounds it.  This is used for
+ * arguments such as file names that are not made of tokens.
+ */
+
+   std::string_view getRest();
+
+private:
+
+   void scan(Token & token);
+   bool isFractionStart(const char *p);
+   bool isExponentStart(const char *p);
+
+   const char *cp;
+   const char *end;
+   Token saved;
+   bool hasSaved;
+
+};
+
+/*
+ * Function: getLineNumber
+ * Usage: int lineNumber = getLineNumber(token);
+ * ---------------------------------------------
+ * Returns the value of a number token that is used as a line number,
+ * calling error if it is too large for an int.
+ */
+
+int getLineNumber(const Token & token);
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * File: loader.cpp
+ * ----------------
+ * This file implements the program loaders.
+ */
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "arena.h"
+#include "error.h"
+#include "lexer.h"
+#include "loader.h"
+#include "mappedfile.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "program.h"
+#include "strlib.h"
+using namespace std;
+
+/* Constants */
+
+const int MIN_CHUNK_BYTES = 64 * 1024;
+
+/*
+ * Type: Chunk
+ * -----------
+ * This structure describes the part of the file handled by one thread
+ * and collects its results.  Each chunk parses into an arena of its
+ * own, so the threads never share an allocator; the program adopts the
+ * arenas once every chunk has succeeded.  The lineCount field counts
+ * every line in the chunk, including blank ones, so that the file
+ * position of an error can be recovered from the counts of the chunks
+ * before it.
+ */
+
+struct Chunk {
+   const char *begin;
+   const char *end;
+   Arena arena;
+   vector<Program::ParsedLine> parsedLines;
+   int lineCount;
+   int removedNodes;
+   int errorLine;
+   string errorMessage;
+};
+
+/*
+ * Function: parseLine
+ * Usage: parseLine(text, lexer, symbols, arena, parsedLine);
+ * ----------------------------------------------------------
+ * Parses one numbered line in the same way addProgramLine does.
+ * Returns false if the line is blank.  The line is read
+ * in place from the file, and its text is copied only once it has
+ * parsed.
+ */
+
+static bool parseLine(string_view text, Lexer & lexer, SymbolTable & symbols,
+                      Arena & arena, Program::ParsedLine & parsedLine) {
+   lexer.setInput(text);
+   Token token = lexer.nextToken();
+   if (token.kind == END_TOKEN) return false;
+   if (token.kind != NUMBER_TOKEN) error("Missing line number");
+   if (!lexer.hasMoreTokens()) error("Missing statement");
+   parsedLine.lineNumber = getLineNumber(token);
+   parsedLine.stmt = parseStatement(lexer, symbols, arena);
+   if (parsedLine.stmt == NULL) error("Illegal statement");
+   parsedLine.text = string(text);
+   return true;
+}
+
+/*
+ * Function: parseChunk
+ * Usage: parseChunk(chunk, symbols);
+ * ----------------------------------
+ * Parses and optimizes every line of a chunk, stopping at the first
+ * error.  Each thread has its own lexer; the only state the threads
+ * share is the program's symbol table, which is safe for concurrent
+ * interning.  Line ends are found with memchr, which the C library
+ * implements with vector instructions.
+ */
+
+static void parseChunk(Chunk & chunk, SymbolTable & symbols) {
+   Lexer lexer;
+   chunk.lineCount = 0;
+   chunk.removedNodes = 0;
+   chunk.errorLine = -1;
+   const char *cp = chunk.begin;
+   while (cp < chunk.end) {
+      const char *lineEnd = (const char *) memchr(cp, '\n', chunk.end - cp);
+      if (lineEnd == NULL) lineEnd = chunk.end;
+      const char *textEnd = lineEnd;
+      if (textEnd > cp && textEnd[-1] == '\r') textEnd--;
+      chunk.lineCount++;
+      try {
+         Program::ParsedLine parsedLine;
+         if (parseLine(string_view(cp, textEnd - cp), lexer, symbols, chunk.arena, parsedLine)) {
+            chunk.removedNodes += optimizeStatement(parsedLine.stmt, chunk.arena);
+            chunk.parsedLines.push_back(parsedLine);
+         }
+      } catch (ErrorException & ex) {
+         chunk.errorLine = chunk.lineCount;
+         chunk.errorMessage = ex.getMessage();
+         return;
+      }
+      cp = lineEnd + 1;
+   }
+}
+
+/*
+ * Function: splitChunks
+ * Usage: splitChunks(data, size, chunks);
+ * ---------------------------------------
+ * Divides the file into as many roughly equal chunks as the vector
+ * holds, moving each boundary forward to just past the next newline
+ * so that no line is split.
+ */
+
+static void splitChunks(const char *data, size_t size, vector<Chunk> & chunks) {
+   const char *end = data + size;
+   const char *begin = data;
+   int count = chunks.size();
+   for (int i = 1; i <= count; i++) {
+      const char *boundary = (i == count) ? end : data + size / count * i;
+      if (boundary < begin) boundary = begin;
+      while (boundary < end && boundary > data && boundary[-1] != '\n') boundary++;
+      chunks[i - 1].begin = begin;
+      chunks[i - 1].end = boundary;
+      begin = boundary;
+   }
+}
+
+void loadProgramFile(const string & filename, Program & program, int threadCount) {
+   MappedFile file(filename);
+   if (file.getSize() == 0) return;
+   if (threadCount <= 0) threadCount = thread::hardware_concurrency();
+   int maxThreads = file.getSize() / MIN_CHUNK_BYTES + 1;
+   if (threadCount > maxThreads) threadCount = maxThreads;
+   if (threadCount < 1) threadCount = 1;
+   vector<Chunk> chunks(threadCount);
+   splitChunks(file.getData(), file.getSize(), chunks);
+   SymbolTable & symbols = program.getSymbolTable();
+   vector<thread> workers;
+   for (int i = 1; i < (int) chunks.size(); i++) {
+      workers.push_back(thread(parseChunk, ref(chunks[i]), ref(symbols)));
+   }
+   parseChunk(chunks[0], symbols);
+   for (thread & worker : workers) {
+      worker.join();
+   }
+   int linesBefore = 0;
+   string message;
+   for (Chunk & chunk : chunks) {
+      if (message == "" && chunk.errorLine != -1) {
+         message = filename + ":" + integerToString(linesBefore + chunk.errorLine)
+                 + ": " + chunk.errorMessage;
+      }
+      linesBefore += chunk.lineCount;
+   }
+   if (message != "") error(message);
+   vector<Program::ParsedLine> parsedLines;
+   for (Chunk & chunk : chunks) {
+      program.getArena().adopt(chunk.arena);
+      program.addRemovedNodes(chunk.removedNodes);
+      if (parsedLines.empty()) {
+         parsedLines.swap(chunk.parsedLines);
+      } else {
+         parsedLines.insert(parsedLines.end(), chunk.parsedLines.begin(), chunk.parsedLines.end());
+      }
+   }
+   program.addParsedLines(parsedLines);
+}
+
+void addProgramLine(Program & program, const string & line) {
+   Lexer lexer(line);
+   Token token = lexer.nextToken();
+   if (token.kind != NUMBER_TOKEN) error("Missing line number");
+   if (!lexer.hasMoreTokens()) error("Missing statement");
+   int lineNumber = getLineNumber(token);
+   program.addSourceLine(lineNumber, line);
+   Statement *stmt = parseStatement(lexer, program.getSymbolTable(), program.getArena());
+   program.addRemovedNodes(optimizeStatement(stmt, program.getArena()));
+   program.setParsedStatement(lineNumber, stmt);
+}
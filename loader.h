@@ -0,0 +1,48 @@
+/*
+ * File: loader.h
+ * --------------
+ * This interface exports the functions that add numbered lines to a
+ * program: one line at a time, as the console does, or a whole source
+ * file at once, which is how the interpreter runs in batch mode.
+ */
+
+#ifndef _loader_h
+#define _loader_h
+
+#include <string>
+#include "program.h"
+
+/*
+ * Function: loadProgramFile
+ * Usage: loadProgramFile(filename, program);
+ *        loadProgramFile(filename, program, threadCount);
+ * ------------------------------------------------------
+ * Reads the named file, in which every non-blank line must be a
+ * numbered program line, and adds all of its lines to the program.
+ * The file is memory-mapped and split into chunks on line boundaries,
+ * and the chunks are tokenized and parsed on separate threads before
+ * the results are installed with a single call to addParsedLines.
+ * The threadCount argument defaults to the number of hardware threads.
+ * If any line fails to parse, nothing is added and the error is
+ * reported together with the file name and line.
+ */
+
+void loadProgramFile(const std::string & filename, Program & program, int threadCount = 0);
+
+/*
+ * Function: addProgramLine
+ * Usage: addProgramLine(program, line);
+ * -------------------------------------
+ * Adds one numbered line to the program as typing it at the console
+ * does: the text is stored under its line number, replacing any line
+ * with that number, and the statement is parsed and optimized into the
+ * program's arena.  A line that does not begin with a line number or
+ * holds nothing after it is reported by calling error, leaving the
+ * program unchanged.  A statement that fails to parse is reported the
+ * same way, but its text stays in the program without a statement, so
+ * that it can be listed and edited and RUN reports it again.
+ */
+
+void addProgramLine(Program & program, const std::string & line);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * File: mappedfile.cpp
+ * --------------------
+ * This file implements the MappedFile class.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include "error.h"
+#include "mappedfile.h"
+using namespace std;
+
+MappedFile::MappedFile(const string & filename) {
+   data = NULL;
+   size = 0;
+   int fd = open(filename.c_str(), O_RDONLY);
+   if (fd < 0) error("Cannot open " + filename);
+   struct stat info;
+   if (fstat(fd, &info) < 0) {
+      close(fd);
+      error("Cannot read " + filename);
+   }
+   size = info.st_size;
+   if (size > 0) {
+      void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping == MAP_FAILED) {
+         close(fd);
+         error("Cannot map " + filename);
+      }
+      madvise(mapping, size, MADV_SEQUENTIAL);
+      data = (const char *) mapping;
+   }
+   close(fd);
+}
+
+MappedFile::~MappedFile() {
+   if (data != NULL) munmap((void *) data, size);
+}
+
+const char *MappedFile::getData() {
+   return data;
+}
+
+size_t MappedFile::getSize() {
+   return size;
+}
@@ -0,0 +1,69 @@
+/*
+ * File: mappedfile.h
+ * ------------------
+ * This interface exports the MappedFile class, which gives read-only
+ * access to the contents of a file through a memory mapping.
+ */
+
+#ifndef _mappedfile_h
+#define _mappedfile_h
+
+#include <cstddef>
+#include <string>
+
+/*
+ * Class: MappedFile
+ * -----------------
+ * This class maps a file read-only into memory for as long as the
+ * object exists.  Pages are read from the file only when they are
+ * first touched, so mapping a large file costs almost nothing until
+ * its contents are used.
+ */
+
+class MappedFile {
+
+public:
+
+/*
+ * Constructor: MappedFile
+ * Usage: MappedFile file(filename);
+ * ---------------------------------
+ * Maps the named file, calling error if it cannot be opened or mapped.
+ * An empty file has no mapping, and getData returns NULL for it.
+ */
+
+   MappedFile(const std::string & filename);
+
+/*
+ * Destructor: ~MappedFile
+ * Usage: usually implicit
+ * -----------------------
+ * Removes the mapping.
+ */
+
+   ~MappedFile();
+
+/*
+ * Methods: getData, getSize
+ * Usage: const char *data = file.getData();
+ *        size_t size = file.getSize();
+ * ----------------------------------------
+ * These methods return the address and length of the mapped contents.
+ */
+
+   const char *getData();
+   size_t getSize();
+
+private:
+
+   const char *data;
+   size_t size;
+
+/* Files cannot be copied, since the copies would unmap the same pages */
+
+   MappedFile(const MappedFile & src) = delete;
+   MappedFile & operator=(const MappedFile & src) = delete;
+
+};
+
+#endif
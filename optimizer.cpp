@@ -0,0 +1,300 @@
+/*
+ * File: optimizer.cpp
+ * -------------------
+ * This file implements the expression optimizer.
+ */
+
+#include "exp.h"
+#include "optimizer.h"
+#include "statement.h"
+using namespace std;
+
+/* Private function prototypes */
+
+static Expression *foldConstants(CompoundExp *exp, int & removed, Arena & arena);
+static Expression *simplify(CompoundExp *exp, int & removed, Arena & arena);
+static Expression *keepOperand(CompoundExp *exp, Expression *operand, int & removed);
+static Expression *replaceWithConstant(CompoundExp *exp, long long value, int & removed,
+                                       Arena & arena);
+static Expression *replaceWithShift(Operator op, Expression *operand, int k, Arena & arena);
+static bool isConstant(Expression *exp, long long value);
+static bool isNumber(Expression *exp);
+static double getNumber(Expression *exp);
+static bool isPure(Expression *exp);
+static bool isSameExp(Expression *e1, Expression *e2);
+static int powerOfTwo(Expression *exp);
+static int countNodes(Expression *exp);
+
+/*
+ * Implementation notes: optimizeStatement
+ * ---------------------------------------
+ * Only LET, PRINT, IF, DIM and MAT statements contain expressions.
+ * The subscripts of the element that a LET assigns, and the extents of
+ * a DIM, are expressions like any other.
+ */
+
+int optimizeStatement(Statement *stmt, Arena & arena) {
+   int removed = 0;
+   if (stmt == NULL) return 0;
+   switch (stmt->getType()) {
+    case LET_STMT:
+      ((LetStmt *) stmt)->setExp(optimizeExp(((LetStmt *) stmt)->getExp(), removed, arena));
+      break;
+    case PRINT_STMT:
+      ((PrintStmt *) stmt)->setExp(optimizeExp(((PrintStmt *) stmt)->getExp(), removed, arena));
+      break;
+    case IF_STMT:
+      ((IfStmt *) stmt)->setLHS(optimizeExp(((IfStmt *) stmt)->getLHS(), removed, arena));
+      ((IfStmt *) stmt)->setRHS(optimizeExp(((IfStmt *) stmt)->getRHS(), removed, arena));
+      break;
+    case DIM_STMT:
+      optimizeExp(((DimStmt *) stmt)->getDeclarator(), removed, arena);
+      break;
+    case LET_ELEMENT_STMT: {
+      LetElementStmt *let = (LetElementStmt *) stmt;
+      optimizeExp(let->getElement(), removed, arena);
+      let->setExp(optimizeExp(let->getExp(), removed, arena));
+      break;
+    }
+    case MAT_STMT: {
+      MatStmt *mat = (MatStmt *) stmt;
+      if (mat->getScalar() != NULL) mat->setScalar(optimizeExp(mat->getScalar(), removed, arena));
+      break;
+    }
+    default:
+      break;
+   }
+   return removed;
+}
+
+/*
+ * Implementation notes: optimizeExp
+ * ---------------------------------
+ * The tree is simplified bottom-up, so that folding a subtree can make
+ * its parent foldable in turn.  The right side of an assignment is
+ * optimized, but the assignment itself is always kept.  The subscripts
+ * of an array element are optimized in place, and the element itself
+ * is never removed.
+ */
+
+Expression *optimizeExp(Expression *exp, int & removed, Arena & arena) {
+   if (exp->getType() == ELEMENT) {
+      ElementExp *element = (ElementExp *) exp;
+      element->setRow(optimizeExp(element->getRow(), removed, arena));
+      if (element->getColumn() != NULL) {
+         element->setColumn(optimizeExp(element->getColumn(), removed, arena));
+      }
+      return element;
+   }
+   if (exp->getType() != COMPOUND) return exp;
+   CompoundExp *compound = (CompoundExp *) exp;
+   compound->setRHS(optimizeExp(compound->getRHS(), removed, arena));
+   if (compound->getOperator() == ASSIGN_OP) return compound;
+   compound->setLHS(optimizeExp(compound->getLHS(), removed, arena));
+   if (isNumber(compound->getLHS()) && isNumber(compound->getRHS())) {
+      return foldConstants(compound, removed, arena);
+   }
+   return simplify(compound, removed, arena);
+}
+
+/*
+ * Implementation notes: foldConstants
+ * -----------------------------------
+ * The arithmetic is done on unsigned values so that the folded result
+ * wraps exactly as the machine arithmetic at run time would, without
+ * relying on signed overflow.  Divisions use divideIntegers, as the
+ * engines do, and a division by zero is left in the tree to fail at
+ * run time.  If either constant is a double, the operation is folded
+ * in double arithmetic, which gives the same result at compile time
+ * as at run time.
+ */
+
+static Expression *foldConstants(CompoundExp *exp, int & removed, Arena & arena) {
+   Operator op = exp->getOperator();
+   Expression *lhs = exp->getLHS();
+   Expression *rhs = exp->getRHS();
+   if (lhs->getType() == DOUBLE_CONSTANT || rhs->getType() == DOUBLE_CONSTANT) {
+      double left = getNumber(lhs);
+      double right = getNumber(rhs);
+      double result;
+      if (op == ADD_OP) result = left + right;
+      else if (op == SUB_OP) result = left - right;
+      else if (op == MUL_OP) result = left * right;
+      else if (op == DIV_OP && right != 0) result = left / right;
+      else return exp;
+      removed += countNodes(exp) - 1;
+      return new (arena) DoubleConstantExp(result);
+   }
+   long long left = ((ConstantExp *) lhs)->getValue();
+   long long right = ((ConstantExp *) rhs)->getValue();
+   unsigned long long result;
+   if (op == ADD_OP) result = (unsigned long long) left + (unsigned long long) right;
+   else if (op == SUB_OP) result = (unsigned long long) left - (unsigned long long) right;
+   else if (op == MUL_OP) result = (unsigned long long) left * (unsigned long long) right;
+   else if (op == DIV_OP && right != 0) result = divideIntegers(left, right);
+   else {
+      return exp;
+   }
+   return replaceWithConstant(exp, (long long) result, removed, arena);
+}
+
+/*
+ * Implementation notes: simplify
+ * ------------------------------
+ * This function applies the algebraic identities and the strength
+ * reductions to a node with at least one non-constant operand.  The
+ * order of evaluation of operands that remain is never changed, except
+ * that a constant operand may move, which is unobservable.  The
+ * identities with an integer 0 or 1 hold exactly for doubles as well,
+ * and the operand that remains in a double node is then the double
+ * one.  The rest hold only for integers: x * 0 is not 0 if x is an
+ * infinity, and there is no shift for a double.
+ */
+
+static Expression *simplify(CompoundExp *exp, int & removed, Arena & arena) {
+   Operator op = exp->getOperator();
+   Expression *lhs = exp->getLHS();
+   Expression *rhs = exp->getRHS();
+   if (exp->getValueType() != INTEGER_TYPE) {
+      if ((op == ADD_OP || op == SUB_OP) && isConstant(rhs, 0)) {
+         return keepOperand(exp, lhs, removed);
+      }
+      if ((op == MUL_OP || op == DIV_OP) && isConstant(rhs, 1)) {
+         return keepOperand(exp, lhs, removed);
+      }
+      if ((op == ADD_OP && isConstant(lhs, 0)) || (op == MUL_OP && isConstant(lhs, 1))) {
+         return keepOperand(exp, rhs, removed);
+      }
+      return exp;
+   }
+   if (op == ADD_OP) {
+      if (isConstant(rhs, 0)) return keepOperand(exp, lhs, removed);
+      if (isConstant(lhs, 0)) return keepOperand(exp, rhs, removed);
+   } else if (op == SUB_OP) {
+      if (isConstant(rhs, 0)) return keepOperand(exp, lhs, removed);
+      if (isPure(lhs) && isSameExp(lhs, rhs)) return replaceWithConstant(exp, 0, removed, arena);
+   } else if (op == MUL_OP) {
+      if (isConstant(rhs, 1)) return keepOperand(exp, lhs, removed);
+      if (isConstant(lhs, 1)) return keepOperand(exp, rhs, removed);
+      if (isConstant(rhs, 0) && isPure(lhs)) return replaceWithConstant(exp, 0, removed, arena);
+      if (isConstant(lhs, 0) && isPure(rhs)) return replaceWithConstant(exp, 0, removed, arena);
+      int k = powerOfTwo(rhs);
+      if (k > 0) return replaceWithShift(SHL_OP, lhs, k, arena);
+      k = powerOfTwo(lhs);
+      if (k > 0) return replaceWithShift(SHL_OP, rhs, k, arena);
+   } else if (op == DIV_OP) {
+      if (isConstant(rhs, 1)) return keepOperand(exp, lhs, removed);
+      int k = powerOfTwo(rhs);
+      if (k > 0) return replaceWithShift(SHR_OP, lhs, k, arena);
+   }
+   return exp;
+}
+
+/*
+ * Implementation notes: tree surgery
+ * ----------------------------------
+ * Each replacement returns the node that takes the place of exp and
+ * counts how many nodes disappeared.  The nodes that are dropped stay
+ * in the arena, which frees them along with the rest of the program.
+ */
+
+static Expression *keepOperand(CompoundExp *exp, Expression *operand, int & removed) {
+   removed += countNodes(exp) - countNodes(operand);
+   return operand;
+}
+
+static Expression *replaceWithConstant(CompoundExp *exp, long long value, int & removed,
+                                       Arena & arena) {
+   removed += countNodes(exp) - 1;
+   return new (arena) ConstantExp(value);
+}
+
+static Expression *replaceWithShift(Operator op, Expression *operand, int k, Arena & arena) {
+   return CompoundExp::create(op, operand, new (arena) ConstantExp(k), arena);
+}
+
+static bool isConstant(Expression *exp, long long value) {
+   return exp->getType() == CONSTANT && ((ConstantExp *) exp)->getValue() == value;
+}
+
+static bool isNumber(Expression *exp) {
+   return exp->getType() == CONSTANT || exp->getType() == DOUBLE_CONSTANT;
+}
+
+static double getNumber(Expression *exp) {
+   if (exp->getType() == DOUBLE_CONSTANT) return ((DoubleConstantExp *) exp)->getValue();
+   return (double) ((ConstantExp *) exp)->getValue();
+}
+
+/*
+ * Implementation notes: isPure
+ * ----------------------------
+ * An expression is pure if evaluating it can neither fail nor change a
+ * variable.  Constants are pure; compound expressions are pure if they
+ * contain no assignment or division and their operands are pure.  An
+ * array element or a sum can fail if the array is not dimensioned.
+ */
+
+static bool isPure(Expression *exp) {
+   switch (exp->getType()) {
+    case CONSTANT: case DOUBLE_CONSTANT:
+      return true;
+    case IDENTIFIER: case ELEMENT: case SUM:
+      return false;
+    case COMPOUND: {
+      CompoundExp *compound = (CompoundExp *) exp;
+      Operator op = compound->getOperator();
+      if (op == ASSIGN_OP || op == DIV_OP) return false;
+      return isPure(compound->getLHS()) && isPure(compound->getRHS());
+    }
+   }
+   return false;
+}
+
+static bool isSameExp(Expression *e1, Expression *e2) {
+   if (e1->getType() != e2->getType()) return false;
+   switch (e1->getType()) {
+    case CONSTANT:
+      return ((ConstantExp *) e1)->getValue() == ((ConstantExp *) e2)->getValue();
+    case DOUBLE_CONSTANT:
+      return ((DoubleConstantExp *) e1)->getValue() == ((DoubleConstantExp *) e2)->getValue();
+    case IDENTIFIER:
+      return ((IdentifierExp *) e1)->getSlot() == ((IdentifierExp *) e2)->getSlot();
+    case COMPOUND: {
+      CompoundExp *c1 = (CompoundExp *) e1;
+      CompoundExp *c2 = (CompoundExp *) e2;
+      return c1->getOperator() == c2->getOperator() && isSameExp(c1->getLHS(), c2->getLHS())
+          && isSameExp(c1->getRHS(), c2->getRHS());
+    }
+    case ELEMENT: case SUM:
+      return false;
+   }
+   return false;
+}
+
+/*
+ * Implementation notes: powerOfTwo
+ * --------------------------------
+ * Returns k if the expression is the integer constant 2 to the power k
+ * for k between 1 and 62, and 0 otherwise.
+ */
+
+static int powerOfTwo(Expression *exp) {
+   if (exp->getType() != CONSTANT) return 0;
+   long long value = ((ConstantExp *) exp)->getValue();
+   if (value < 2 || (value & (value - 1)) != 0) return 0;
+   int k = 0;
+   while ((1LL << k) != value) k++;
+   return k;
+}
+
+static int countNodes(Expression *exp) {
+   if (exp->getType() == ELEMENT) {
+      ElementExp *element = (ElementExp *) exp;
+      Expression *column = element->getColumn();
+      return 1 + countNodes(element->getRow()) + ((column == NULL) ? 0 : countNodes(column));
+   }
+   if (exp->getType() != COMPOUND) return 1;
+   CompoundExp *compound = (CompoundExp *) exp;
+   return 1 + countNodes(compound->getLHS()) + countNodes(compound->getRHS());
+}
@@ -0,0 +1,53 @@
+/*
+ * File: optimizer.h
+ * -----------------
+ * This interface exports the optimization pass that simplifies the
+ * expression trees of a statement after it has been parsed.
+ */
+
+#ifndef _optimizer_h
+#define _optimizer_h
+
+#include "arena.h"
+#include "exp.h"
+#include "statement.h"
+
+/*
+ * Function: optimizeStatement
+ * Usage: int removed = optimizeStatement(stmt, arena);
+ * ----------------------------------------------------
+ * Rewrites the expressions of the statement in place and returns the
+ * number of expression nodes that were removed.  New nodes are
+ * allocated in the arena, which should be the one holding the
+ * statement.  The statement may be
+ * NULL, in which case nothing happens.  The rewrites never change what
+ * a statement prints, assigns or reports as an error:
+ *
+ *  1. Subtrees whose operands are all constants are folded into a
+ *     single constant of their type, except a division by zero, which
+ *     is left to report its error when it runs.
+ *  2. The identities x + 0, 0 + x, x - 0, x * 1, 1 * x and x / 1 are
+ *     replaced by x, which is still evaluated.
+ *  3. x * 0, 0 * x and x - x become 0 only when x is pure, meaning it
+ *     can neither fail nor assign.  A variable reference is not pure,
+ *     because reading an unassigned variable is an error.
+ *  4. Multiplying or dividing by a constant power of two becomes the
+ *     "<<" or ">>" operator described in exp.h.
+ *
+ * Rules 3 and 4 apply only to integer expressions.
+ */
+
+int optimizeStatement(Statement *stmt, Arena & arena);
+
+/*
+ * Function: optimizeExp
+ * Usage: exp = optimizeExp(exp, removed, arena);
+ * ----------------------------------------------
+ * Returns the simplified form of the expression, which may be a
+ * different node, and adds the number of nodes removed to removed.
+ * Nodes that are no longer needed stay in their arena.
+ */
+
+Expression *optimizeExp(Expression *exp, int & removed, Arena & arena);
+
+#endif
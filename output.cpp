@@ -0,0 +1,92 @@
+/*
+ * File: output.cpp
+ * ----------------
+ * This file implements the OutputBuffer class.  The printInteger
+ * method is defined inline in output.h.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "output.h"
+#include "value.h"
+using namespace std;
+
+OutputBuffer::OutputBuffer(ostream & stream) {
+   count = 0;
+   this->stream = &stream;
+   policy = LINE_BUFFERED;
+}
+
+OutputBuffer::~OutputBuffer() {
+   flush();
+}
+
+void OutputBuffer::setStream(ostream & stream) {
+   flush();
+   this->stream = &stream;
+}
+
+void OutputBuffer::setFlushPolicy(FlushPolicy policy) {
+   this->policy = policy;
+   if (policy == LINE_BUFFERED) flush();
+}
+
+FlushPolicy OutputBuffer::getFlushPolicy() {
+   return policy;
+}
+
+/*
+ * Implementation notes: printDouble
+ * ---------------------------------
+ * MAX_LINE_LENGTH leaves room for the longest text formatDouble writes
+ * and the newline, so the double is formatted straight into the
+ * buffer.
+ */
+
+void OutputBuffer::printDouble(double value) {
+   if (count > BUFFER_SIZE - MAX_LINE_LENGTH) flush();
+   count += formatDouble(buffer + count, value);
+   buffer[count++] = '\n';
+   if (policy == LINE_BUFFERED) flush();
+}
+
+string OutputBuffer::getPending() {
+   return string(buffer, count);
+}
+
+/*
+ * Implementation notes: printText
+ * -------------------------------
+ * Text too long for the space left in the buffer is written straight
+ * to the stream after what the buffer holds.
+ */
+
+void OutputBuffer::printText(const string & text) {
+   if (count + text.length() > (size_t) BUFFER_SIZE) {
+      flush();
+      if (text.length() > (size_t) BUFFER_SIZE) {
+         stream->write(text.data(), text.length());
+         return;
+      }
+   }
+   memcpy(buffer + count, text.data(), text.length());
+   count += text.length();
+   if (policy == LINE_BUFFERED) flush();
+}
+
+/*
+ * Implementation notes: flush
+ * ---------------------------
+ * The whole buffer goes to the stream in a single write, and the
+ * stream is flushed at once so that the stream's own buffering does
+ * not split the block up again.
+ */
+
+void OutputBuffer::flush() {
+   if (count > 0) {
+      stream->write(buffer, count);
+      count = 0;
+   }
+   stream->flush();
+}
@@ -0,0 +1,166 @@
+/*
+ * File: output.h
+ * --------------
+ * This interface exports the OutputBuffer class, through which the
+ * interpreter writes everything a BASIC program prints.
+ */
+
+#ifndef _output_h
+#define _output_h
+
+#include <iostream>
+#include <string>
+
+/*
+ * Type: FlushPolicy
+ * -----------------
+ * This enumerated type selects when an OutputBuffer passes its contents
+ * on to the stream.  LINE_BUFFERED flushes after every line, which is
+ * what an interactive user expects.  BLOCK_BUFFERED flushes only when
+ * the buffer fills or when flush is called, which lets a batch run
+ * write its output with a few large writes.  Under either policy the
+ * interpreter flushes before reading input and after every command.
+ */
+
+enum FlushPolicy { LINE_BUFFERED, BLOCK_BUFFERED };
+
+/*
+ * Class: OutputBuffer
+ * -------------------
+ * This class collects program output in a fixed buffer and writes it
+ * to an output stream according to its flush policy.  Values are
+ * formatted directly into the buffer, so printing never allocates.
+ */
+
+class OutputBuffer {
+
+public:
+
+/*
+ * Constructor: OutputBuffer
+ * Usage: OutputBuffer output;
+ *        OutputBuffer output(stream);
+ * -----------------------------------
+ * Creates an empty buffer that writes to the specified stream, which
+ * defaults to cout, with the LINE_BUFFERED policy.
+ */
+
+   OutputBuffer(std::ostream & stream = std::cout);
+
+/*
+ * Destructor: ~OutputBuffer
+ * Usage: usually implicit
+ * -----------------------
+ * Flushes any output that remains in the buffer.
+ */
+
+   ~OutputBuffer();
+
+/*
+ * Methods: setStream, setFlushPolicy, getFlushPolicy
+ * Usage: output.setStream(stream);
+ *        output.setFlushPolicy(BLOCK_BUFFERED);
+ *        FlushPolicy policy = output.getFlushPolicy();
+ * ----------------------------------------------------
+ * These methods change where and when the buffer writes.  Pending
+ * output is flushed to the old stream before the stream changes.
+ */
+
+   void setStream(std::ostream & stream);
+   void setFlushPolicy(FlushPolicy policy);
+   FlushPolicy getFlushPolicy();
+
+/*
+ * Methods: printInteger, printDouble
+ * Usage: output.printInteger(value);
+ *        output.printDouble(value);
+ * ---------------------------------
+ * These methods append the decimal form of value followed by a
+ * newline, which is exactly what a PRINT statement displays.  Doubles
+ * are formatted by formatDouble from value.h.
+ */
+
+   void printInteger(long long value);
+   void printDouble(double value);
+
+/*
+ * Methods: getPending, printText
+ * Usage: string text = output.getPending();
+ *        output.printText(text);
+ * ----------------------------------------
+ * The first method returns the output held in the buffer that has not
+ * yet been written, which a checkpoint saves; the second appends text
+ * to the buffer as if it had been printed, which is how that output is
+ * restored.
+ */
+
+   std::string getPending();
+   void printText(const std::string & text);
+
+/*
+ * Method: flush
+ * Usage: output.flush();
+ * ----------------------
+ * Writes the contents of the buffer to the stream and flushes the
+ * stream.
+ */
+
+   void flush();
+
+private:
+
+/* Constants */
+
+   static const int BUFFER_SIZE = 64 * 1024;
+   static const int MAX_LINE_LENGTH = 32;     /* Covers "-9223372036854775808\n" */
+
+/* Instance variables */
+
+   char buffer[BUFFER_SIZE];   /* The output not yet written         */
+   int count;                  /* The number of characters in buffer */
+   std::ostream *stream;       /* The stream the buffer writes to    */
+   FlushPolicy policy;         /* When the buffer is flushed         */
+
+/* Buffers cannot be copied, since each copy would write the same output */
+
+   OutputBuffer(const OutputBuffer & src) = delete;
+   OutputBuffer & operator=(const OutputBuffer & src) = delete;
+
+};
+
+/*
+ * Implementation notes: printInteger
+ * ----------------------------------
+ * This method is defined here so that it can be inlined into the
+ * virtual machine's PRINT instruction.  The digits are produced from
+ * right to left in a small array and then copied into the buffer.
+ * The magnitude is computed as an unsigned value so that the most
+ * negative integer is handled correctly.  Once it fits in 32 bits, the
+ * remaining digits are produced with 32-bit arithmetic, which is
+ * cheaper and covers every digit of most values.
+ */
+
+inline void OutputBuffer::printInteger(long long value) {
+   if (count > BUFFER_SIZE - MAX_LINE_LENGTH) flush();
+   char digits[MAX_LINE_LENGTH];
+   char *cp = digits + MAX_LINE_LENGTH;
+   *--cp = '\n';
+   unsigned long long magnitude = (value < 0) ? 0ull - (unsigned long long) value
+                                              : (unsigned long long) value;
+   while (magnitude > 0xFFFFFFFFull) {
+      *--cp = '0' + magnitude % 10;
+      magnitude /= 10;
+   }
+   unsigned low = (unsigned) magnitude;
+   do {
+      *--cp = '0' + low % 10;
+      low /= 10;
+   } while (low != 0);
+   if (value < 0) *--cp = '-';
+   while (cp < digits + MAX_LINE_LENGTH) {
+      buffer[count++] = *cp++;
+   }
+   if (policy == LINE_BUFFERED) flush();
+}
+
+#endif
@@ -4,105 +4,258 @@
  * Implements the parser.h interface.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include "error.h"
 #include "exp.h"
+#include "lexer.h"
 #include "parser.h"
 #include "strlib.h"
-#include "tokenscanner.h"
 #include "statement.h"
 using namespace std;
 
+/* Private function prototypes */
+
+static Expression *readExp(Lexer & lexer, SymbolTable & symbols, Arena & arena,
+                           int prec, int depth, int & height);
+static Expression *readTerm(Lexer & lexer, SymbolTable & symbols, Arena & arena,
+                            int depth, int & height);
+static ElementExp *readSubscripts(string name, Lexer & lexer, SymbolTable & symbols,
+                                  Arena & arena, int depth, int & height);
+static void checkDepth(int depth);
+static Operator charToOperator(char op);
+
 /*
  * Implementation notes: parseExp
  * ------------------------------
  * This code just reads an expression and then checks for extra tokens.
  */
 
-Expression *parseExp(TokenScanner & scanner) {
-   Expression *exp = readE(scanner);
-   if (scanner.hasMoreTokens()) {
-      error("parseExp: Found extra token: " + scanner.nextToken());
+Expression *parseExp(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+   Expression *exp = readE(lexer, symbols, arena);
+   if (lexer.hasMoreTokens()) {
+      error("parseExp: Found extra token: " + string(lexer.nextToken().text));
    }
    return exp;
 }
 
 /*
- * Implementation notes: readE
- * Usage: exp = readE(scanner, prec);
- * ----------------------------------
+ * Implementation notes: readE, readT, readElement
+ * -----------------------------------------------
+ * These functions start the private versions below at the top of an
+ * expression.
+ */
+
+Expression *readE(Lexer & lexer, SymbolTable & symbols, Arena & arena, int prec) {
+   int height;
+   return readExp(lexer, symbols, arena, prec, 0, height);
+}
+
+Expression *readT(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+   int height;
+   return readTerm(lexer, symbols, arena, 0, height);
+}
+
+ElementExp *readElement(string name, Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+   int height;
+   return readSubscripts(name, lexer, symbols, arena, 0, height);
+}
+
+/*
+ * Implementation notes: readExp
+ * Usage: exp = readExp(lexer, symbols, arena, prec, depth, height);
+ * -----------------------------------------------------------------
  * This version of readE uses precedence to resolve the ambiguity in
  * the grammar.  At each recursive level, the parser reads operators and
  * subexpressions until it finds an operator whose precedence is greater
  * than the prevailing one.  When a higher-precedence operator is found,
- * readE calls itself recursively to read in that subexpression as a unit.
+ * readExp calls itself recursively to read in that subexpression as a
+ * unit.  The operator is only peeked at until it is known to belong to
+ * this level, so nothing has to be pushed back.  An assignment of a
+ * double widens the type of its variable at once.
+ *
+ * The depth argument counts the recursive calls above this one, which
+ * bounds the parser's own stack, and height returns the height of the
+ * tree, which grows without recursion along a chain such as 1+1+1.
+ * Both are held to MAX_EXPRESSION_DEPTH.
  */
 
-Expression *readE(TokenScanner & scanner, int prec) {
-   Expression *exp = readT(scanner);
-   string token;
+static Expression *readExp(Lexer & lexer, SymbolTable & symbols, Arena & arena,
+                           int prec, int depth, int & height) {
+   checkDepth(depth);
+   Expression *exp = readTerm(lexer, symbols, arena, depth + 1, height);
    while (true) {
-      token = scanner.nextToken();
-      int newPrec = precedence(token);
+      int newPrec = precedence(lexer.peekToken());
       if (newPrec <= prec) break;
-      Expression *rhs = readE(scanner, newPrec);
-      exp = new CompoundExp(token, exp, rhs);
+      Operator op = charToOperator(lexer.nextToken().op);
+      int rhsHeight;
+      Expression *rhs = readExp(lexer, symbols, arena, newPrec, depth + 1, rhsHeight);
+      if (op == ASSIGN_OP && exp->getType() == IDENTIFIER
+          && rhs->getValueType() == DOUBLE_TYPE) {
+         IdentifierExp *target = (IdentifierExp *) exp;
+         symbols.widenType(target->getSlot(), DOUBLE_TYPE);
+         target->setValueType(DOUBLE_TYPE);
+      }
+      exp = CompoundExp::create(op, exp, rhs, arena);
+      height = max(height, rhsHeight) + 1;
+      checkDepth(height);
    }
-   scanner.saveToken(token);
    return exp;
 }
 
 /*
- * Implementation notes: readT
- * ---------------------------
- * This function scans a term, which is either an integer, an identifier,
- * or a parenthesized subexpression.
+ * Implementation notes: readTerm
+ * ------------------------------
+ * This function scans a term, which is either a number, an identifier,
+ * or a parenthesized subexpression.  The name of an identifier is
+ * copied into a string only to be interned.  A name followed by an
+ * opening parenthesis is an array element, except that SUM in capitals
+ * takes the name of an array instead of subscripts.
  */
 
-Expression *readT(TokenScanner & scanner) {
-   string token = scanner.nextToken();
-   TokenType type = scanner.getTokenType(token);
-   if (type == WORD) return new IdentifierExp(token);
-   if (type == NUMBER) return new ConstantExp(stringToInteger(token));
-   if (token != "(") error("Illegal term in expression");
-   Expression *exp = readE(scanner);
-   if (scanner.nextToken() != ")") {
+static Expression *readTerm(Lexer & lexer, SymbolTable & symbols, Arena & arena,
+                            int depth, int & height) {
+   checkDepth(depth);
+   height = 1;
+   Token token = lexer.nextToken();
+   if (token.kind == WORD_TOKEN) {
+      if (lexer.peekToken().op != '(') {
+         return new (arena) IdentifierExp(string(token.text), symbols, arena);
+      }
+      if (token.keyword != SUM_KEYWORD || !token.upperCase) {
+         return readSubscripts(string(token.text), lexer, symbols, arena, depth + 1, height);
+      }
+      lexer.nextToken();
+      Token name = lexer.nextToken();
+      if (name.kind != WORD_TOKEN) error("Illegal array name in SUM");
+      if (lexer.nextToken().op != ')') error("Unbalanced parentheses in expression");
+      return new (arena) SumExp(string(name.text), symbols, arena);
+   }
+   if (token.kind == NUMBER_TOKEN) return new (arena) ConstantExp(token.value);
+   if (token.kind == REAL_TOKEN) return new (arena) DoubleConstantExp(token.real);
+   if (token.op != '(') error("Illegal term in expression");
+   Expression *exp = readExp(lexer, symbols, arena, 0, depth + 1, height);
+   if (lexer.nextToken().op != ')') {
       error("Unbalanced parentheses in expression");
    }
    return exp;
 }
 
+/*
+ * Implementation notes: readSubscripts
+ * ------------------------------------
+ * Each subscript is a full expression, read as a parenthesized
+ * subexpression is.
+ */
+
+static ElementExp *readSubscripts(string name, Lexer & lexer, SymbolTable & symbols,
+                                  Arena & arena, int depth, int & height) {
+   checkDepth(depth);
+   if (lexer.nextToken().op != '(') error("Missing subscripts for " + name);
+   Expression *row = readExp(lexer, symbols, arena, 0, depth + 1, height);
+   Expression *column = NULL;
+   Token token = lexer.nextToken();
+   if (token.op == ',') {
+      int columnHeight;
+      column = readExp(lexer, symbols, arena, 0, depth + 1, columnHeight);
+      height = max(height, columnHeight);
+      token = lexer.nextToken();
+      if (token.op == ',') error("Too many subscripts for " + arrayKey(name));
+   }
+   if (token.op != ')') error("Unbalanced parentheses in expression");
+   height++;
+   checkDepth(height);
+   return new (arena) ElementExp(name, row, column, symbols, arena);
+}
+
+static void checkDepth(int depth) {
+   if (depth > MAX_EXPRESSION_DEPTH) error("Expression nested too deeply");
+}
+
 /*
  * Implementation notes: precedence
  * --------------------------------
- * This function checks the token against each of the defined operators
- * and returns the appropriate precedence value.
+ * This function checks the operator character of the token against
+ * each of the defined operators and returns the appropriate precedence
+ * value.  Tokens that are not operators have a zero character.
  */
 
-int precedence(string token) {
-   if (token == "=") return 1;
-   if (token == "+" || token == "-") return 2;
-   if (token == "*" || token == "/") return 3;
-   return 0;
+int precedence(const Token & token) {
+   switch (token.op) {
+    case '=': return 1;
+    case '+': case '-': return 2;
+    case '*': case '/': return 3;
+    default: return 0;
+   }
+}
+
+/*
+ * Implementation notes: charToOperator
+ * ------------------------------------
+ * This function is only called for tokens that have a precedence, so
+ * every character it sees is one of the five operators.
+ */
+
+static Operator charToOperator(char op) {
+   switch (op) {
+    case '=': return ASSIGN_OP;
+    case '+': return ADD_OP;
+    case '-': return SUB_OP;
+    case '*': return MUL_OP;
+    case '/': return DIV_OP;
+    default: return ILLEGAL_OP;
+   }
+}
+
+/*
+ * Implementation notes: readLineNumber
+ * ------------------------------------
+ * A real is not a line number, so it is reported as any other
+ * illegal token is.
+ */
+
+int readLineNumber(Lexer & lexer) {
+   Token token = lexer.nextToken();
+   if (token.kind == END_TOKEN) error("Missing line number");
+   if (token.kind != NUMBER_TOKEN) error("Illegal line number: " + string(token.text));
+   return getLineNumber(token);
 }
 
 /*
  * Implementation notes: parseStatement
  * ------------------------------------
  * The strategy for parsing a statement begins by reading the first token
- * on the line. If that token is the name of one of the seven legal statement
+ * on the line. If that token is the name of one of the legal statement
  * forms, the constructor for the appropriate Statment subclass is called.
+ * The lexer has already recognized the keyword, so the choice is a
+ * switch on its value rather than a series of string comparisons.  A
+ * LET whose variable is followed by an opening parenthesis assigns to
+ * an array element; a copy of the lexer looks ahead to find out.
  */
 
-Statement *parseStatement(TokenScanner & scanner) {
-    string commandStatement = scanner.nextToken();
-    if (commandStatement == "REM") return new RemStmt(scanner);
-    else if (commandStatement == "LET") return new LetStmt(scanner);
-    else if (commandStatement == "PRINT") return new PrintStmt(scanner);
-    else if (commandStatement == "INPUT") return new InputStmt(scanner);
-    else if (commandStatement == "GOTO") return new GoToStmt(scanner);
-    else if (commandStatement == "IF") return new IfStmt(scanner);
-    else if (commandStatement == "END") return new EndStmt(scanner);
-    else return NULL;
+Statement *parseStatement(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    Token token = lexer.nextToken();
+    if (!token.upperCase) return NULL;
+    return parseStatement(token.keyword, lexer, symbols, arena);
+}
+
+Statement *parseStatement(Keyword keyword, Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    switch (keyword) {
+     case REM_KEYWORD: return new (arena) RemStmt(lexer);
+     case LET_KEYWORD: {
+        Lexer lookahead = lexer;
+        lookahead.nextToken();
+        if (lookahead.peekToken().op == '(') return new (arena) LetElementStmt(lexer, symbols, arena);
+        return new (arena) LetStmt(lexer, symbols, arena);
+     }
+     case PRINT_KEYWORD: return new (arena) PrintStmt(lexer, symbols, arena);
+     case INPUT_KEYWORD: return new (arena) InputStmt(lexer, symbols, arena);
+     case GOTO_KEYWORD: return new (arena) GoToStmt(lexer);
+     case IF_KEYWORD: return new (arena) IfStmt(lexer, symbols, arena);
+     case END_KEYWORD: return new (arena) EndStmt(lexer);
+     case DIM_KEYWORD: return new (arena) DimStmt(lexer, symbols, arena);
+     case MAT_KEYWORD: return new (arena) MatStmt(lexer, symbols, arena);
+     default: return NULL;
+    }
 }
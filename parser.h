@@ -8,41 +8,68 @@
 #define _parser_h
 
 #include <string>
+#include "arena.h"
 #include "exp.h"
-#include "tokenscanner.h"
+#include "lexer.h"
+#include "symtab.h"
+
+/*
+ * Constant: MAX_EXPRESSION_DEPTH
+ * ------------------------------
+ * The deepest expression the parser accepts, counting both the nesting
+ * of parentheses and subscripts and the height of the tree it builds.
+ * Every pass over an expression recurses on its tree, so a deeper one
+ * is reported as an error rather than left to overflow the stack.
+ */
+
+const int MAX_EXPRESSION_DEPTH = 1000;
 #include "statement.h"
 
 /*
  * Function: parseExp
- * Usage: Expression *exp = parseExp(scanner);
- * -------------------------------------------
- * Parses an expression by reading tokens from the scanner, which must
- * be provided by the client.  The scanner should be set to ignore
- * whitespace and to scan numbers.
+ * Usage: Expression *exp = parseExp(lexer, symbols, arena);
+ * ---------------------------------------------------------
+ * Parses an expression by reading tokens from the lexer, which must
+ * be provided by the client.  Identifiers are interned in the
+ * specified symbol table, and the nodes are allocated in the arena.
  */
 
-Expression *parseExp(TokenScanner & scanner);
+Expression *parseExp(Lexer & lexer, SymbolTable & symbols, Arena & arena);
 
 /*
  * Function: readE
- * Usage: Expression *exp = readE(scanner, prec);
- * ----------------------------------------------
- * Returns the next expression from the scanner involving only operators
+ * Usage: Expression *exp = readE(lexer, symbols, arena, prec);
+ * ------------------------------------------------------------
+ * Returns the next expression from the lexer involving only operators
  * whose precedence is at least prec.  The prec argument is optional and
  * defaults to 0, which means that the function reads the entire expression.
+ * An expression deeper than MAX_EXPRESSION_DEPTH is reported by calling
+ * error, here and in the functions below.
  */
 
-Expression *readE(TokenScanner & scanner, int prec = 0);
+Expression *readE(Lexer & lexer, SymbolTable & symbols, Arena & arena, int prec = 0);
 
 /*
  * Function: readT
- * Usage: Expression *exp = readT(scanner);
- * ----------------------------------------
+ * Usage: Expression *exp = readT(lexer, symbols, arena);
+ * ------------------------------------------------------
  * Returns the next individual term, which is either a constant, an
- * identifier, or a parenthesized subexpression.
+ * identifier, an array element, SUM of an array, or a parenthesized
+ * subexpression.
  */
 
-Expression *readT(TokenScanner & scanner);
+Expression *readT(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+
+/*
+ * Function: readElement
+ * Usage: ElementExp *exp = readElement(name, lexer, symbols, arena);
+ * ------------------------------------------------------------------
+ * Reads the parenthesized subscripts that follow the name of an array,
+ * which the caller has already read, and returns a reference to the
+ * element.  There must be one or two subscripts.
+ */
+
+ElementExp *readElement(std::string name, Lexer & lexer, SymbolTable & symbols, Arena & arena);
 
 /*
  * Function: precedence
@@ -52,18 +79,36 @@ Expression *readT(TokenScanner & scanner);
  * is not an operator, precedence returns 0.
  */
 
-int precedence(std::string token);
+int precedence(const Token & token);
+
+/*
+ * Function: readLineNumber
+ * Usage: int lineNumber = readLineNumber(lexer);
+ * ----------------------------------------------
+ * Reads the line number that is the target of a GOTO or an IF, calling
+ * error if the next token is not a number.
+ */
+
+int readLineNumber(Lexer & lexer);
 
 /*
  * Function: parseStatement
- * Usage: Statement *stmt = parseStatement(scanner);
- * ------------------------------------
+ * Usage: Statement *stmt = parseStatement(lexer, symbols, arena);
+ *        Statement *stmt = parseStatement(keyword, lexer, symbols, arena);
+ * -----------------------------------------------------------------------
  * The strategy for parsing a statement begins by reading the first token
- * on the line. If that token is the name of one of the seven legal statement
- * forms, the constructor for the appropriate Statment subclass is called.
+ * on the line. If that token is the name of one of the legal statement
+ * forms, spelled in capitals, the constructor for the appropriate Statment
+ * subclass is called; otherwise parseStatement returns NULL.  The second
+ * form is for a caller that has already read the keyword and accepts it
+ * in any case, as the console does.
+ * Variable names are interned in the specified symbol table, and the
+ * statement and its expressions are allocated in the arena; both are
+ * normally the ones owned by the program the statement belongs to.
  */
 
-Statement *parseStatement(TokenScanner & scanner);
+Statement *parseStatement(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+Statement *parseStatement(Keyword keyword, Lexer & lexer, SymbolTable & symbols, Arena & arena);
 
 #endif
 
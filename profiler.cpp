@@ -0,0 +1,85 @@
+/*
+ * File: profiler.cpp
+ * ------------------
+ * This file implements the reports of the Profiler class.  The
+ * methods used while the program runs are defined inline in
+ * profiler.h.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "profiler.h"
+using namespace std;
+
+Profiler::Profiler() {
+   /* Empty */
+}
+
+/*
+ * Implementation notes: getRankedLines
+ * ------------------------------------
+ * Lines with equal cycle counts are ordered by line number, so the
+ * report does not depend on the order of the hash table.
+ */
+
+void Profiler::getRankedLines(vector<LineProfile> & ranked) {
+   ranked.clear();
+   for (auto & entry : lines) {
+      ranked.push_back(entry.second);
+   }
+   sort(ranked.begin(), ranked.end(), [](const LineProfile & a, const LineProfile & b) {
+      if (a.cycles != b.cycles) return a.cycles > b.cycles;
+      return a.line->lineNumber < b.line->lineNumber;
+   });
+}
+
+void Profiler::printReport(ostream & os, int maxLines) {
+   vector<LineProfile> ranked;
+   getRankedLines(ranked);
+   uint64_t total = 0;
+   for (LineProfile & profile : ranked) {
+      total += profile.cycles;
+   }
+   os << setw(6) << "Rank" << setw(14) << "Count" << setw(18) << "Cycles"
+      << setw(8) << "Time" << "  Source" << endl;
+   for (int i = 0; i < (int) ranked.size() && i < maxLines; i++) {
+      LineProfile & profile = ranked[i];
+      double percent = (total == 0) ? 0 : 100.0 * profile.cycles / total;
+      os << setw(6) << (i + 1) << setw(14) << profile.count << setw(18) << profile.cycles
+         << setw(7) << fixed << setprecision(1) << percent << "%  "
+         << profile.line->lineString << endl;
+   }
+   if ((int) ranked.size() > maxLines) {
+      os << "(" << ranked.size() - maxLines << " more lines ran)" << endl;
+   }
+}
+
+/*
+ * Implementation notes: writeCSV
+ * ------------------------------
+ * Quotes in the source text are doubled, as the CSV convention
+ * requires.
+ */
+
+void Profiler::writeCSV(ostream & os) {
+   vector<LineProfile> sorted;
+   getRankedLines(sorted);
+   sort(sorted.begin(), sorted.end(), [](const LineProfile & a, const LineProfile & b) {
+      return a.line->lineNumber < b.line->lineNumber;
+   });
+   os << "line,count,cycles,source" << endl;
+   for (LineProfile & profile : sorted) {
+      string source = profile.line->lineString;
+      string quoted = "\"";
+      for (char ch : source) {
+         if (ch == '"') quoted += '"';
+         quoted += ch;
+      }
+      quoted += '"';
+      os << profile.line->lineNumber << "," << profile.count << "," << profile.cycles
+         << "," << quoted << endl;
+   }
+}
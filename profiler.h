@@ -0,0 +1,143 @@
+/*
+ * File: profiler.h
+ * ----------------
+ * This interface exports the Profiler class, which records how often
+ * each line of a program runs and how long it takes, for the RUN
+ * PROFILE command.
+ */
+
+#ifndef _profiler_h
+#define _profiler_h
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "evalstate.h"
+#include "program.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/*
+ * Class: Profiler
+ * ---------------
+ * This class executes statements on behalf of the statement
+ * interpreter and charges each execution to its source line.  Time
+ * is measured with the processor's cycle counter where there is one
+ * and in nanoseconds elsewhere.  The interpreter loop is a template
+ * that calls execute on either a Profiler or a class whose execute
+ * simply runs the statement, so a run without profiling contains no
+ * profiling code at all.
+ */
+
+class Profiler {
+
+public:
+
+/*
+ * Constructor: Profiler
+ * Usage: Profiler profiler;
+ * -------------------------
+ * Creates a profiler with no data.
+ */
+
+   Profiler();
+
+/*
+ * Method: execute
+ * Usage: profiler.execute(line, state);
+ * -------------------------------------
+ * Executes the statement on the line and adds one execution and the
+ * elapsed cycles to the line's totals.  The time includes everything
+ * the statement does, such as waiting for INPUT.
+ */
+
+   void execute(Program::SourceLine *line, EvalState & state);
+
+/*
+ * Method: printReport
+ * Usage: profiler.printReport(os, maxLines);
+ * ------------------------------------------
+ * Writes a table of the lines that ran, ranked by cycles with the
+ * most expensive first, showing for each its execution count, cycles,
+ * share of the total and source text.  At most maxLines rows are
+ * shown.
+ */
+
+   void printReport(std::ostream & os, int maxLines);
+
+/*
+ * Method: writeCSV
+ * Usage: profiler.writeCSV(os);
+ * -----------------------------
+ * Writes the data for every line that ran, in line number order, as
+ * comma-separated values with a header row.  The source text is
+ * quoted.
+ */
+
+   void writeCSV(std::ostream & os);
+
+private:
+
+/*
+ * Type: LineProfile
+ * -----------------
+ * This structure holds the totals for one line.
+ */
+
+   struct LineProfile {
+      Program::SourceLine *line;
+      uint64_t count;
+      uint64_t cycles;
+   };
+
+   static uint64_t readCycleCounter();
+   void charge(Program::SourceLine *line, uint64_t cycles);
+   void getRankedLines(std::vector<LineProfile> & ranked);
+
+   std::unordered_map<Program::SourceLine *, LineProfile> lines;
+
+};
+
+/*
+ * Implementation notes: readCycleCounter, charge, execute
+ * -------------------------------------------------------
+ * These are defined here so that they are inlined into the template
+ * loop.  The hash lookup happens after the second reading of the
+ * counter, so only the statement itself is charged to the line.  A
+ * statement that fails is charged before the error propagates.
+ */
+
+inline uint64_t Profiler::readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline void Profiler::charge(Program::SourceLine *line, uint64_t cycles) {
+   LineProfile & profile = lines[line];
+   profile.line = line;
+   profile.count++;
+   profile.cycles += cycles;
+}
+
+inline void Profiler::execute(Program::SourceLine *line, EvalState & state) {
+   uint64_t start = readCycleCounter();
+   try {
+      line->lineParsed->execute(state);
+   } catch (...) {
+      charge(line, readCycleCounter() - start);
+      throw;
+   }
+   charge(line, readCycleCounter() - start);
+}
+
+#endif
@@ -1,14 +1,27 @@
 /*
  * File: program.cpp
  * -----------------
+ * This file implements the Program class.  The lines are kept in a
+ * std::map keyed by line number, so every editing operation and every
+ * neighbor query costs O(log n), and loading a program of n lines in
+ * any order costs O(n log n).
  */
 
+#include <algorithm>
+#include <iterator>
 #include <string>
+#include "error.h"
+#include "evalstate.h"
+#include "inference.h"
 #include "program.h"
 #include "statement.h"
+#include "strlib.h"
 using namespace std;
 
 Program::Program() {
+   generation = 0;
+   removedNodes = 0;
+   typeGeneration = symbols.getTypeGeneration();
 }
 
 Program::~Program() {
@@ -19,15 +32,24 @@ Program::~Program() {
  * Method: clear
  * Usage: program.clear();
  * -----------------------
- * Removes all lines from the program.
+ * Removes all lines from the program and frees every parsed
+ * statement by clearing the arena.
  */
 
 void Program::clear() {
-   for (int key : storage) { //Goes through and deletes all entries in the map
-       delete storage[key];
-   }
-   lineNumbers.clear();
-   storage.clear();
+   lines.clear();
+   arena.clear(); //Frees every parsed statement at once
+   referrers.clear();
+   unparsedLines.clear();
+   unresolvedLines.clear();
+   edits.clear();
+   keptDoubles.clear();
+   widenedSlots.clear();
+   wideningCounts.clear();
+   symbols.resetTypes();
+   narrowable.clear();
+   generation++;
+   removedNodes = 0;
 }
 
 /*
@@ -37,55 +59,86 @@ void Program::clear() {
  * Adds a source line to the program with the specified line number.
  * If that line already exists, the text of the line replaces
  * the text of any existing line and the parsed representation
- * (if any) is deleted.  If the line is new, it is added to the
+ * (if any) is discarded.  If the line is new, it is added to the
  * program in the correct sequence.
  */
 
 void Program::addSourceLine(int lineNumber, string line) {
-   int newLineNumberIndex; //The following lines add line numbers to the vector
-   if (lineNumbers.isEmpty()) { //Adds first element to vector
-       lineNumbers.add(lineNumber);
-       newLineNumberIndex = 0;
-   }
-   else {
-       for (int i = lineNumbers.size() - 1; i >= 0; i--) { //Inserts line number according to order in vector
-           if (lineNumber > lineNumbers[i]) {
-               lineNumbers.insert(i + 1, lineNumber);
-               newLineNumberIndex = i;
-               break;
-           }
-           if (i == 0) {
-               lineNumbers.insert(0, lineNumber);
-               newLineNumberIndex = i;
-
-           }
-       }
+   SourceLine & sourceLine = insertLine(lineNumber);
+   sourceLine.lineString = line;
+   setStatement(sourceLine, NULL);
+   edits.push_back(lineNumber);
+}
+
+/*
+ * Method: addParsedLines
+ * Usage: program.addParsedLines(parsedLines);
+ * -------------------------------------------
+ * Adds every line in the vector together with its parsed statement.
+ * A stable sort keeps duplicates in their original order, so the last
+ * one wins just as it would if the lines were typed.  insertLine
+ * appends in amortized constant time when the new lines all follow
+ * the existing ones, which is the usual case of loading a file into
+ * an empty program.  Loading into an empty program starts a new
+ * generation instead of recording every line as an edit.
+ */
+
+void Program::addParsedLines(vector<ParsedLine> & parsedLines) {
+   stable_sort(parsedLines.begin(), parsedLines.end(),
+               [](const ParsedLine & a, const ParsedLine & b) {
+                   return a.lineNumber < b.lineNumber;
+               });
+   bool wasEmpty = lines.empty();
+   if (wasEmpty) {
+       edits.clear();
+       generation++;
    }
-   SourceLine *newSourceLine = new SourceLine; //Deals with adding information to the map "storage"
-   newSourceLine->lineString = line;
-   newSourceLine->lineNumbersIndex = newLineNumberIndex;
-   newSourceLine->lineParsed = NULL;
-   storage.put(lineNumber, newSourceLine);
-   for (int i = 0; i < lineNumbers.size(); i++) { //Shift line numbers indices accordingly in the map
-                                                  //when something is added
-       storage[lineNumbers[i]]->lineNumbersIndex = i;
+   for (ParsedLine & parsedLine : parsedLines) {
+       SourceLine & sourceLine = insertLine(parsedLine.lineNumber);
+       sourceLine.lineString.swap(parsedLine.text);
+       setStatement(sourceLine, parsedLine.stmt);
+       if (!wasEmpty) edits.push_back(parsedLine.lineNumber);
    }
+   parsedLines.clear();
 }
 
 /*
  * Method: removeSourceLine
  * Usage: program.removeSourceLine(lineNumber);
  * --------------------------------------------
- * Removes the line with the specified number from the program,
- * freeing the memory associated with any parsed representation.
+ * Removes the line with the specified number from the program.
  * If no such line exists, this method simply returns without
- * performing any action.
+ * performing any action.  The line before it is linked to the line
+ * after it, and the lines that jump to it lose their target.
  */
 
 void Program::removeSourceLine(int lineNumber) {
-   int removeIndex = storage.get(lineNumber)->lineNumbersIndex; //Obtain index to remove from vector
-   lineNumbers.remove(removeIndex);
-   storage.remove(lineNumber); //Remove from map
+   auto it = lines.find(lineNumber);
+   if (it == lines.end()) return;
+   SourceLine & line = it->second;
+   setStatement(line, NULL);
+   unparsedLines.erase(lineNumber);
+   if (it != lines.begin()) std::prev(it)->second.next = line.next;
+   auto found = referrers.find(lineNumber);
+   if (found != referrers.end()) {
+       for (SourceLine *referrer : found->second) {
+           referrer->target = NULL;
+           unresolvedLines.insert(referrer->lineNumber);
+       }
+   }
+   lines.erase(it);
+   edits.push_back(lineNumber);
+}
+
+/*
+ * Method: containsLine
+ * Usage: if (program.containsLine(lineNumber)) . . .
+ * --------------------------------------------------
+ * Returns true if the program contains a line with the specified number.
+ */
+
+bool Program::containsLine(int lineNumber) {
+   return lines.count(lineNumber) != 0;
 }
 
 /*
@@ -97,7 +150,9 @@ void Program::removeSourceLine(int lineNumber) {
  */
 
 string Program::getSourceLine(int lineNumber) {
-   return storage.get(lineNumber)->lineString;
+   auto it = lines.find(lineNumber);
+   if (it == lines.end()) return "";
+   return it->second.lineString;
 }
 
 /*
@@ -106,17 +161,17 @@ string Program::getSourceLine(int lineNumber) {
  * ----------------------------------------------------
  * Adds the parsed representation of the statement to the statement
  * at the specified line number.  If no such line exists, this
- * method raises an error.  If a previous parsed representation
- * exists, the memory for that statement is reclaimed.
+ * method raises an error.  Any previous parsed representation stays
+ * in the arena until the program is cleared.
  */
 
 void Program::setParsedStatement(int lineNumber, Statement *stmt) {
-   if (storage.containsKey(lineNumber)) {
-       if (storage[lineNumber]->lineParsed != NULL) delete storage[lineNumber]->lineParsed;
-       //If the line parsed field of the source line containes something, delete it and replace it with
-       //given statement
-       storage[lineNumber]->lineParsed = stmt;
+   auto it = lines.find(lineNumber);
+   if (it == lines.end()) {
+       error("Line " + integerToString(lineNumber) + " does not exist");
    }
+   setStatement(it->second, stmt);
+   edits.push_back(lineNumber);
 }
 
 /*
@@ -129,8 +184,9 @@ void Program::setParsedStatement(int lineNumber, Statement *stmt) {
  */
 
 Statement *Program::getParsedStatement(int lineNumber) {
-    if (storage.containsKey(lineNumber)) return storage.get(lineNumber)->lineParsed;
-    else return NULL;
+    auto it = lines.find(lineNumber);
+    if (it == lines.end()) return NULL;
+    return it->second.lineParsed;
 }
 
 /*
@@ -142,10 +198,8 @@ Statement *Program::getParsedStatement(int lineNumber) {
  */
 
 int Program::getFirstLineNumber() {
-   if (!lineNumbers.isEmpty()) {
-       return lineNumbers[0];
-   }
-   return -1;
+   if (lines.empty()) return -1;
+   return lines.begin()->first;
 }
 
 /*
@@ -153,15 +207,356 @@ int Program::getFirstLineNumber() {
  * Usage: int nextLine = program.getNextLineNumber(lineNumber);
  * ------------------------------------------------------------
  * Returns the line number of the first line in the program whose
- * number is larger than the specified one, which must already exist
- * in the program.  If no more lines remain, this method returns -1.
+ * number is larger than the specified one.  If no more lines remain,
+ * this method returns -1.
  */
+
 int Program::getNextLineNumber(int lineNumber) {
-   if (!lineNumbers.isEmpty()) {
-       int nextLineNumberIndex = storage.get(lineNumber)->lineNumbersIndex + 1; //Obtains the index of the next line number
-       if (nextLineNumberIndex < lineNumbers.size() && lineNumbers.size() != 0) { //If that index is in the vector
-           return lineNumbers[nextLineNumberIndex]; //Return that next line number
+   auto it = lines.upper_bound(lineNumber);
+   if (it == lines.end()) return -1;
+   return it->first;
+}
+
+/*
+ * Method: getPreviousLineNumber
+ * Usage: int previousLine = program.getPreviousLineNumber(lineNumber);
+ * --------------------------------------------------------------------
+ * Returns the line number of the last line in the program whose
+ * number is smaller than the specified one, or -1 if there is none.
+ */
+
+int Program::getPreviousLineNumber(int lineNumber) {
+   auto it = lines.lower_bound(lineNumber);
+   if (it == lines.begin()) return -1;
+   return std::prev(it)->first;
+}
+
+/*
+ * Method: getLineNumberAtOrAfter
+ * Usage: int lineNumber = program.getLineNumberAtOrAfter(start);
+ * --------------------------------------------------------------
+ * Returns the smallest line number in the program that is greater
+ * than or equal to the specified one, or -1 if there is none.
+ */
+
+int Program::getLineNumberAtOrAfter(int lineNumber) {
+   auto it = lines.lower_bound(lineNumber);
+   if (it == lines.end()) return -1;
+   return it->first;
+}
+
+/*
+ * Method: size
+ * Usage: int count = program.size();
+ * ----------------------------------
+ * Returns the number of lines in the program.
+ */
+
+int Program::size() {
+   return lines.size();
+}
+
+/*
+ * Method: getSymbolTable
+ * Usage: SymbolTable & symbols = program.getSymbolTable();
+ * --------------------------------------------------------
+ * Returns the table that assigns slots to the variable names used by
+ * this program.
+ */
+
+SymbolTable & Program::getSymbolTable() {
+   return symbols;
+}
+
+/*
+ * Method: getArena
+ * Usage: Arena & arena = program.getArena();
+ * ------------------------------------------
+ * Returns the arena in which the statements of this program are
+ * allocated.
+ */
+
+Arena & Program::getArena() {
+   return arena;
+}
+
+/*
+ * Methods: addRemovedNodes, getRemovedNodes
+ * Usage: program.addRemovedNodes(optimizeStatement(stmt));
+ *        int count = program.getRemovedNodes();
+ * -------------------------------------------------------
+ * These methods keep a running total of the expression nodes removed
+ * by the optimizer.
+ */
+
+void Program::addRemovedNodes(int count) {
+   removedNodes += count;
+}
+
+int Program::getRemovedNodes() {
+   return removedNodes;
+}
+
+/*
+ * Method: findLine
+ * Usage: Program::SourceLine *line = program.findLine(lineNumber);
+ * ----------------------------------------------------------------
+ * Returns the stored line with the specified number, or NULL.
+ */
+
+Program::SourceLine *Program::findLine(int lineNumber) {
+   auto it = lines.find(lineNumber);
+   if (it == lines.end()) return NULL;
+   return &it->second;
+}
+
+/*
+ * Implementation notes: link
+ * --------------------------
+ * The editing methods keep two ordered sets of problem lines: those
+ * without a parsed statement and those whose jump target is missing.
+ * The error reported is the one for the lowest numbered problem line,
+ * which is the one a walk over every line would have met first.  The
+ * statements are retyped only when a variable has widened since they
+ * were last typed, which is rare once a program has been entered.
+ */
+
+/*
+ * Implementation notes: keepDoubles
+ * ---------------------------------
+ * A slot that newly holds a double is widened at once, which changes
+ * the type generation and so makes link work the types out again.  A
+ * slot that no longer holds one may let its variable narrow, which link
+ * checks.  Only the slots of the table are considered, since a state
+ * may have room for more.
+ */
+
+void Program::keepDoubles(EvalState & state) {
+   vector<int> slots;
+   int count = min(state.getSlotCount(), symbols.size());
+   for (int slot = 0; slot < count; slot++) {
+       if (state.getType(slot) == DOUBLE_TYPE) slots.push_back(slot);
+   }
+   if (slots == keptDoubles) return;
+   for (int slot : slots) {
+       symbols.widenType(slot, DOUBLE_TYPE);
+   }
+   for (int slot : keptDoubles) {
+       if (!binary_search(slots.begin(), slots.end(), slot)) narrowable.push_back(slot);
+   }
+   keptDoubles.swap(slots);
+}
+
+Program::SourceLine *Program::link() {
+   if (lines.empty()) return NULL;
+   int unparsed = unparsedLines.empty() ? -1 : *unparsedLines.begin();
+   int unresolved = unresolvedLines.empty() ? -1 : *unresolvedLines.begin();
+   if (unparsed != -1 && (unresolved == -1 || unparsed < unresolved)) {
+       error("Illegal statement on line " + integerToString(unparsed));
+   }
+   if (unresolved != -1) {
+       int targetLineNumber = getJumpTarget(lines[unresolved].lineParsed);
+       error("Line " + integerToString(targetLineNumber) + " does not exist");
+   }
+   if (symbols.getTypeGeneration() != typeGeneration || mayNarrow()) updateTypes();
+   narrowable.clear();
+   return &lines.begin()->second;
+}
+
+/*
+ * Implementation notes: mayNarrow
+ * -------------------------------
+ * A slot that has lost a line or a value that made it a double can
+ * narrow only if it is still a double and nothing else makes it one.
+ * The check is made at link rather than as each line is discarded, so
+ * that replacing the only line that widens a variable with another
+ * that widens it too does not count as a change.
+ */
+
+bool Program::mayNarrow() {
+   for (int slot : narrowable) {
+       if (symbols.getType(slot) == DOUBLE_TYPE && getWideningCount(slot) == 0
+           && !binary_search(keptDoubles.begin(), keptDoubles.end(), slot)) {
+           return true;
+       }
+   }
+   return false;
+}
+
+/*
+ * Implementation notes: updateTypes
+ * ---------------------------------
+ * The table is reset and widened by the variables passed to keepDoubles
+ * and the current lines alone, in rounds until a round widens nothing,
+ * so that no statement typed at the console or since deleted leaves a
+ * variable wider than the program and the values it starts from make
+ * it.  Only then is each statement retyped, once, and the ones that
+ * changed recorded as edits, so that compiled code is brought up to
+ * date.  The lines that account for the type of each variable are
+ * counted again on the way, since the order in which the variables
+ * widened has changed.
+ */
+
+void Program::updateTypes() {
+   symbols.resetTypes();
+   for (int slot : keptDoubles) {
+       symbols.widenType(slot, DOUBLE_TYPE);
+   }
+   int before;
+   do {
+       before = symbols.getTypeGeneration();
+       for (auto & entry : lines) {
+           Statement *stmt = entry.second.lineParsed;
+           if (stmt != NULL) inferTypes(stmt, symbols);
+       }
+   } while (symbols.getTypeGeneration() != before);
+   widenedSlots.clear();
+   wideningCounts.clear();
+   for (auto & entry : lines) {
+       Statement *stmt = entry.second.lineParsed;
+       if (stmt == NULL) continue;
+       if (retypeStatement(stmt, symbols, arena)) edits.push_back(entry.first);
+       addWidenings(entry.first, stmt);
+   }
+   typeGeneration = symbols.getTypeGeneration();
+}
+
+/*
+ * Methods: getEdits, getGeneration
+ * Usage: const vector<int> & edits = program.getEdits();
+ *        int generation = program.getGeneration();
+ * -----------------------------------------------------
+ * Return the list of edited line numbers and its generation.
+ */
+
+const vector<int> & Program::getEdits() {
+   return edits;
+}
+
+int Program::getGeneration() {
+   return generation;
+}
+
+/*
+ * Implementation notes: insertLine
+ * --------------------------------
+ * Returns the line with the specified number, creating it without a
+ * statement if it does not exist.  A new line is spliced between its
+ * neighbors, and any lines that were waiting for a line with its
+ * number to jump to now target it.  Appending after the last line
+ * uses the end of the map as a hint and costs amortized constant time.
+ */
+
+Program::SourceLine & Program::insertLine(int lineNumber) {
+   auto it = lines.end();
+   if (!lines.empty() && lines.rbegin()->first >= lineNumber) {
+       it = lines.lower_bound(lineNumber);
+       if (it->first == lineNumber) return it->second;
+   }
+   it = lines.emplace_hint(it, lineNumber, SourceLine());
+   SourceLine & line = it->second;
+   line.lineNumber = lineNumber;
+   line.lineParsed = NULL;
+   line.target = NULL;
+   auto after = std::next(it);
+   line.next = (after == lines.end()) ? NULL : &after->second;
+   if (it != lines.begin()) std::prev(it)->second.next = &line;
+   auto found = referrers.find(lineNumber);
+   if (found != referrers.end()) {
+       for (SourceLine *referrer : found->second) {
+           referrer->target = &line;
+           unresolvedLines.erase(referrer->lineNumber);
+       }
+   }
+   return line;
+}
+
+/*
+ * Implementation notes: setStatement
+ * ----------------------------------
+ * Replaces the statement of a line, moving the line from the referrers
+ * of its old jump target to those of its new one and updating the
+ * sets of problem lines.  A line that is not yet in the unparsed set
+ * costs only an unsuccessful search to remove from it.  Discarding the
+ * last statement that made some variable a double lets link work the
+ * types out again, while an edit that leaves every type as it was
+ * relinks only the lines it touches.
+ */
+
+void Program::setStatement(SourceLine & line, Statement *stmt) {
+   if (line.lineParsed != NULL) removeWidenings(line.lineNumber);
+   int oldTarget = getJumpTarget(line.lineParsed);
+   if (oldTarget != -1) {
+       vector<SourceLine *> & sources = referrers[oldTarget];
+       sources.erase(std::find(sources.begin(), sources.end(), &line));
+       if (sources.empty()) referrers.erase(oldTarget);
+       if (line.target == NULL) unresolvedLines.erase(line.lineNumber);
+   }
+   line.lineParsed = stmt;
+   line.target = NULL;
+   if (stmt == NULL) {
+       unparsedLines.insert(line.lineNumber);
+   } else {
+       unparsedLines.erase(line.lineNumber);
+       addWidenings(line.lineNumber, stmt);
+   }
+   int newTarget = getJumpTarget(stmt);
+   if (newTarget != -1) {
+       referrers[newTarget].push_back(&line);
+       auto target = lines.find(newTarget);
+       if (target == lines.end()) {
+           unresolvedLines.insert(line.lineNumber);
+       } else {
+           line.target = &target->second;
        }
    }
+}
+
+/*
+ * Implementation notes: addWidenings, removeWidenings
+ * ---------------------------------------------------
+ * Each line that accounts for the type of some variable keeps the
+ * slots it was counted for, so that removing it undoes exactly what
+ * adding it did, even if the types have changed in between.  A count
+ * that reaches zero means the variable may narrow, which link checks.
+ * A line added between links is judged against the types of the
+ * moment; the next full pass counts every line afresh.
+ */
+
+void Program::addWidenings(int lineNumber, Statement *stmt) {
+   vector<int> slots;
+   findWidenedSlots(stmt, symbols, slots);
+   if (slots.empty()) return;
+   for (int slot : slots) {
+       if (slot >= (int) wideningCounts.size()) wideningCounts.resize(slot + 1, 0);
+       wideningCounts[slot]++;
+   }
+   widenedSlots[lineNumber].swap(slots);
+}
+
+void Program::removeWidenings(int lineNumber) {
+   auto found = widenedSlots.find(lineNumber);
+   if (found == widenedSlots.end()) return;
+   for (int slot : found->second) {
+       if (--wideningCounts[slot] == 0) narrowable.push_back(slot);
+   }
+   widenedSlots.erase(found);
+}
+
+int Program::getWideningCount(int slot) {
+   return (slot < (int) wideningCounts.size()) ? wideningCounts[slot] : 0;
+}
+
+/*
+ * Implementation notes: getJumpTarget
+ * -----------------------------------
+ * Returns the line number named by a GOTO or IF statement, or -1 for
+ * any other statement or for NULL.
+ */
+
+int Program::getJumpTarget(Statement *stmt) {
+   if (stmt == NULL) return -1;
+   if (stmt->getType() == GOTO_STMT) return ((GoToStmt *) stmt)->getLineNumber();
+   if (stmt->getType() == IF_STMT) return ((IfStmt *) stmt)->getLineNumber();
    return -1;
 }
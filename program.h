@@ -9,14 +9,23 @@
 #ifndef _program_h
 #define _program_h
 
+#include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
+#include "arena.h"
 #include "statement.h"
-#include "hashmap.h"
+#include "symtab.h"
+
+class EvalState;
 using namespace std;
 
 /*
  * This class stores the lines in a BASIC program.  Each line
- * in the program is stored in order according to its line number.
+ * in the program is stored in order according to its line number,
+ * in a balanced search tree, so that adding, removing and finding
+ * the next line each take O(log n) time in the size of the program.
  * Moreover, each line in the program is associated with two
  * components:
  *
@@ -25,12 +34,41 @@ using namespace std;
  *
  * 2. The parsed representation of that statement, which is a
  *    pointer to a Statement.
+ *
+ * The statements and their expressions are allocated in an arena that
+ * the program owns.  Replacing or removing a line leaves its old nodes
+ * in the arena; all of them are freed at once when the program is
+ * cleared or destroyed.
+ *
+ * The links from each line to the line that follows it and to the line
+ * it jumps to are kept up to date by every edit, at a cost that depends
+ * only on the lines the edit affects, so running a large program after
+ * changing one line does not revisit the rest.
  */
 
 class Program {
 
 public:
 
+/*
+ * Type: SourceLine
+ * ----------------
+ * This structure holds everything the program stores for one line.
+ * The next field points to the line that follows in numeric order,
+ * and target points to the line named by a GOTO or IF statement.  Both
+ * are NULL when there is no such line, so execution can follow
+ * pointers instead of looking line numbers up.  The program updates
+ * both fields as it is edited; clients must treat them as read-only.
+ */
+
+   struct SourceLine {
+      int lineNumber;
+      string lineString;
+      Statement *lineParsed;
+      SourceLine *next; //line that follows this one
+      SourceLine *target; //line this statement can jump to
+   };
+
 /*
  * Constructor: Program
  * Usage: Program program;
@@ -53,7 +91,9 @@ public:
  * Method: clear
  * Usage: program.clear();
  * -----------------------
- * Removes all lines from the program.
+ * Removes all lines from the program and frees every parsed
+ * statement by clearing the arena, which takes time proportional
+ * to the number of lines, not the number of nodes.
  */
 
    void clear();
@@ -65,24 +105,61 @@ public:
  * Adds a source line to the program with the specified line number.
  * If that line already exists, the text of the line replaces
  * the text of any existing line and the parsed representation
- * (if any) is deleted.  If the line is new, it is added to the
+ * (if any) is discarded.  If the line is new, it is added to the
  * program in the correct sequence.
  */
 
    void addSourceLine(int lineNumber, std::string line);
 
+/*
+ * Type: ParsedLine
+ * ----------------
+ * This structure carries one line that has already been parsed, for
+ * use with addParsedLines.
+ */
+
+   struct ParsedLine {
+      int lineNumber;
+      std::string text;
+      Statement *stmt;
+   };
+
+/*
+ * Method: addParsedLines
+ * Usage: program.addParsedLines(parsedLines);
+ * -------------------------------------------
+ * Adds every line in the vector together with its parsed statement,
+ * which must be allocated in the program's arena or in one that is
+ * later adopted by it.  The effect is the same as
+ * calling addSourceLine and setParsedStatement for each entry in turn,
+ * so a later entry replaces an earlier one with the same number, but
+ * the lines are sorted first and appended in one pass, which costs
+ * O(n) for n lines in increasing order.  The vector's contents are
+ * consumed.
+ */
+
+   void addParsedLines(std::vector<ParsedLine> & parsedLines);
+
 /*
  * Method: removeSourceLine
  * Usage: program.removeSourceLine(lineNumber);
  * --------------------------------------------
- * Removes the line with the specified number from the program,
- * freeing the memory associated with any parsed representation.
+ * Removes the line with the specified number from the program.
  * If no such line exists, this method simply returns without
  * performing any action.
  */
 
    void removeSourceLine(int lineNumber);
 
+/*
+ * Method: containsLine
+ * Usage: if (program.containsLine(lineNumber)) . . .
+ * --------------------------------------------------
+ * Returns true if the program contains a line with the specified number.
+ */
+
+   bool containsLine(int lineNumber);
+
 /*
  * Method: getSourceLine
  * Usage: string line = program.getSourceLine(lineNumber);
@@ -99,8 +176,8 @@ public:
  * ----------------------------------------------------
  * Adds the parsed representation of the statement to the statement
  * at the specified line number.  If no such line exists, this
- * method raises an error.  If a previous parsed representation
- * exists, the memory for that statement is reclaimed.
+ * method raises an error.  The statement must be allocated in the
+ * program's arena.
  */
 
    void setParsedStatement(int lineNumber, Statement *stmt);
@@ -131,26 +208,181 @@ public:
  * Usage: int nextLine = program.getNextLineNumber(lineNumber);
  * ------------------------------------------------------------
  * Returns the line number of the first line in the program whose
- * number is larger than the specified one, which must already exist
- * in the program.  If no more lines remain, this method returns -1.
+ * number is larger than the specified one.  The specified line need
+ * not exist.  If no more lines remain, this method returns -1.
  */
 
    int getNextLineNumber(int lineNumber);
 
-private:
+/*
+ * Method: getPreviousLineNumber
+ * Usage: int previousLine = program.getPreviousLineNumber(lineNumber);
+ * --------------------------------------------------------------------
+ * Returns the line number of the last line in the program whose
+ * number is smaller than the specified one, which need not exist.  If
+ * there is no such line, this method returns -1.
+ */
+
+   int getPreviousLineNumber(int lineNumber);
+
+/*
+ * Method: getLineNumberAtOrAfter
+ * Usage: int lineNumber = program.getLineNumberAtOrAfter(start);
+ * --------------------------------------------------------------
+ * Returns the smallest line number in the program that is greater
+ * than or equal to the specified one, or -1 if there is none.  Together
+ * with getNextLineNumber this lets clients walk any range of lines.
+ */
+
+   int getLineNumberAtOrAfter(int lineNumber);
+
+/*
+ * Method: size
+ * Usage: int count = program.size();
+ * ----------------------------------
+ * Returns the number of lines in the program.
+ */
 
-   /* Type used for line */
+   int size();
+
+/*
+ * Method: getSymbolTable
+ * Usage: SymbolTable & symbols = program.getSymbolTable();
+ * --------------------------------------------------------
+ * Returns the table that assigns slots to the variable names used by
+ * this program.  Statements are parsed against this table, including
+ * those executed directly, so that every EvalState used with the
+ * program agrees on the slot of each name.  Clearing the program does
+ * not clear the table, because variable values outlive the lines that
+ * assigned them, but it returns every variable to INTEGER_TYPE, since
+ * the lines that widened them are gone.
+ */
+
+   SymbolTable & getSymbolTable();
+
+/*
+ * Method: getArena
+ * Usage: Arena & arena = program.getArena();
+ * ------------------------------------------
+ * Returns the arena in which the statements of this program are
+ * allocated.  Statements that will be stored in the program must be
+ * parsed and optimized against this arena.
+ */
+
+   Arena & getArena();
+
+/*
+ * Methods: addRemovedNodes, getRemovedNodes
+ * Usage: program.addRemovedNodes(optimizeStatement(stmt));
+ *        int count = program.getRemovedNodes();
+ * -------------------------------------------------------
+ * These methods keep a running total of the expression nodes that the
+ * optimizer removed from statements parsed for this program, which the
+ * STATS command reports.  Clearing the program resets the total.
+ */
+
+   void addRemovedNodes(int count);
+   int getRemovedNodes();
+
+/*
+ * Method: findLine
+ * Usage: Program::SourceLine *line = program.findLine(lineNumber);
+ * ----------------------------------------------------------------
+ * Returns the stored line with the specified number, or NULL if there
+ * is none.  The pointer stays valid until that line is removed or the
+ * program is cleared.
+ */
+
+   SourceLine *findLine(int lineNumber);
+
+/*
+ * Method: keepDoubles
+ * Usage: program.keepDoubles(state);
+ * ----------------------------------
+ * Records which variables already hold a double in the state that the
+ * next run will use, so that link keeps them DOUBLE_TYPE even if no
+ * line of the program assigns them one, as when a double was stored at
+ * the console.  Every engine calls this before it links the program,
+ * so that a run never reads such a value as an integer.
+ */
+
+   void keepDoubles(EvalState & state);
+
+/*
+ * Method: link
+ * Usage: Program::SourceLine *first = program.link();
+ * ---------------------------------------------------
+ * Prepares the program for execution and returns its first line, or
+ * NULL if the program is empty.  Jumps to lines that do not exist and
+ * lines whose statement could not be parsed are reported here, before
+ * anything runs, by raising an error for the first such line.  Since
+ * the links are maintained by the editing methods, this takes time
+ * proportional to log n rather than to the size of the program,
+ * except when the types may have changed since the last call: when a
+ * variable has widened, by a line or at the console, when the last line
+ * that made some variable a double was replaced or deleted, or when a
+ * variable passed to keepDoubles no longer holds a double and no line
+ * makes it one.  The types are then
+ * worked out again from the current lines and those variables, every
+ * statement is retyped as described in inference.h, and the lines that
+ * change are recorded as edits.
+ */
+
+   SourceLine *link();
+
+/*
+ * Methods: getEdits, getGeneration
+ * Usage: const vector<int> & edits = program.getEdits();
+ *        int generation = program.getGeneration();
+ * -----------------------------------------------------
+ * These methods let a client that keeps something derived from the
+ * program, such as compiled code, bring it up to date by looking only
+ * at what changed.  getEdits returns the numbers of the lines added,
+ * replaced or removed, in the order of the edits; a line may appear
+ * more than once.  getGeneration returns a number that changes
+ * whenever the list starts over, which happens when the program is
+ * cleared and when lines are loaded into an empty program, so a client
+ * that sees a new generation must treat every line as changed.
+ */
+
+   const vector<int> & getEdits();
+   int getGeneration();
+
+private:
 
-      struct SourceLine {
-         int lineNumbersIndex; //index of the line number in the vector "lineNumbers"
-         string lineString;
-         Statement *lineParsed;
-      };
+   SourceLine & insertLine(int lineNumber);
+   void setStatement(SourceLine & line, Statement *stmt);
+   static int getJumpTarget(Statement *stmt);
+   void updateTypes();
+   void addWidenings(int lineNumber, Statement *stmt);
+   void removeWidenings(int lineNumber);
+   int getWideningCount(int slot);
+   bool mayNarrow();
 
    /* Instance variables */
 
-      Vector<int> lineNumbers; //Vector holding the line numbers for each source line
-      HashMap<int, SourceLine*> storage; //Hashmap mapping line numbers to source lines
+      std::map<int, SourceLine> lines; //Source lines ordered by line number. A std::map is
+                                       //used rather than Map because it offers ordered
+                                       //neighbor queries and never moves its entries,
+                                       //which keeps the next and target links valid.
+      SymbolTable symbols; //Slots for the variable names used by the program
+      Arena arena; //Storage for the parsed statements and their expressions
+      std::unordered_map<int, vector<SourceLine *> > referrers; //Lines that jump to each
+                                                                //line number, whether or
+                                                                //not that line exists
+      std::set<int> unparsedLines; //Lines that have no parsed statement
+      std::set<int> unresolvedLines; //Lines whose jump target does not exist
+      vector<int> edits; //Line numbers edited in this generation
+      vector<int> keptDoubles; //Slots the state of the next run holds doubles in
+      int generation; //Changes whenever the edit list starts over
+      int removedNodes; //Expression nodes removed by the optimizer
+      int typeGeneration; //Type generation of the symbol table the statements match
+      vector<int> narrowable; //Slots that have lost a line or value making them doubles
+      std::unordered_map<int, vector<int> > widenedSlots; //Slots each line accounts for
+                                                         //the type of, as found by
+                                                         //findWidenedSlots, for the
+                                                         //lines that account for any
+      vector<int> wideningCounts; //Number of lines that account for each slot's type
 
 };
 
@@ -0,0 +1,658 @@
+/*
+ * File: server.cpp
+ * ----------------
+ * This file implements the session server.
+ */
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "error.h"
+#include "lexer.h"
+#include "server.h"
+using namespace std;
+
+/* Constants */
+
+const int MAX_EVENTS = 256;
+const int READ_SIZE = 64 * 1024;
+const int MAX_WAITING_LINES = 1024;
+const int LISTEN_BACKLOG = 1024;
+const int ACCEPT_RETRY_MS = 1000;
+
+/* Private function prototypes */
+
+static bool isShortCommand(const string & line);
+
+/*
+ * Class: CappedBuffer
+ * -------------------
+ * This stream buffer collects what a session prints, up to
+ * SERVER_MAX_OUTPUT bytes for each command.  Anything past that is
+ * dropped and the overflow noted, so that a program printing in a loop
+ * cannot fill the server's memory.
+ */
+
+class CappedBuffer : public streambuf {
+
+public:
+
+   CappedBuffer() {
+      overflowed = false;
+   }
+
+   void take(string & answer) {
+      answer += text;
+      text.clear();
+   }
+
+   bool hasOverflowed() {
+      return overflowed;
+   }
+
+   void reset() {
+      text.clear();
+      overflowed = false;
+   }
+
+protected:
+
+   virtual streamsize xsputn(const char *data, streamsize count) {
+      streamsize room = SERVER_MAX_OUTPUT - (streamsize) text.size();
+      if (count > room) {
+         overflowed = true;
+         text.append(data, room);
+      } else {
+         text.append(data, count);
+      }
+      return count;
+   }
+
+   virtual int overflow(int ch) {
+      if (ch != traits_type::eof()) {
+         char c = ch;
+         xsputn(&c, 1);
+      }
+      return 0;
+   }
+
+private:
+
+   string text;
+   bool overflowed;
+
+};
+
+/*
+ * Type: Session
+ * -------------
+ * This structure holds the interpreter side of a connection.  PRINT
+ * output is block buffered into the capped stream that also collects
+ * what each command prints, and INPUT reads from an empty stream until
+ * INPUT FROM names a file.  The streams are declared before the
+ * EvalState so that the buffer's final flush still has a destination.
+ */
+
+struct Session {
+   CappedBuffer outBuffer;
+   ostream out;
+   istringstream noInput;
+   Program program;
+   IncrementalCompiler compiler;
+   EvalState state;
+   Session() : out(&outBuffer), compiler(program) { }
+};
+
+/*
+ * Type: Connection
+ * ----------------
+ * This structure holds one client.  Everything in it belongs to the
+ * event loop, except that while running is true the session, the line
+ * being run and the result fields belong to the worker that runs it.
+ */
+
+struct Connection {
+   int fd;                   /* The socket, or -1 once it is closed       */
+   Session session;
+   string input;             /* Bytes read but not yet part of a line     */
+   deque<string> lines;      /* Lines waiting to be carried out           */
+   string output;            /* Answers not yet written to the client     */
+   bool closing;             /* True once no more lines will be read      */
+   bool running;             /* True while a worker holds the session     */
+   uint32_t events;          /* The events epoll is watching for          */
+   string job;               /* The line the worker runs                  */
+   string result;            /* Its answer                                */
+   bool keepOpen;            /* False if it ended the session             */
+};
+
+/*
+ * Class: SessionServer
+ * --------------------
+ * This class holds the sockets, the connections and the worker pool of
+ * a running server.  Its methods other than workerLoop all run on the
+ * event loop's thread.  The destructor shuts the server down: it
+ * removes the socket file, waits for the commands being run and closes
+ * every connection.
+ */
+
+class SessionServer {
+
+public:
+
+   SessionServer(const string & socketPath, LineProcessor process, int threadCount,
+                 const ResourceLimits & limits);
+   ~SessionServer();
+   void serve();
+
+private:
+
+   void listenOn(const string & socketPath);
+   void acceptClients();
+   void setAccepting(bool on);
+   void readInput(Connection *conn);
+   void addLine(Connection *conn, string line);
+   void advance(Connection *conn);
+   void writeOutput(Connection *conn);
+   void update(Connection *conn);
+   void collectResults();
+   void retire(Connection *conn);
+   void workerLoop();
+   bool carryOut(Session & session, const string & line, string & answer);
+
+   LineProcessor process;
+   ResourceLimits limits;
+   int epollFd;
+   int listenFd;
+   int wakeFd;                     /* An eventfd the workers signal          */
+   int signalFd;                   /* A signalfd for SIGINT and SIGTERM      */
+   sigset_t savedMask;             /* The signal mask before the server      */
+   string boundPath;               /* The socket file, once it is created    */
+   bool accepting;                 /* False while accepting is paused        */
+   unordered_set<Connection *> connections;
+   vector<Connection *> retired;   /* Closed connections to delete           */
+   vector<thread> workers;
+   mutex lock;                     /* Guards the fields below                */
+   condition_variable jobReady;
+   deque<Connection *> jobs;       /* Sessions waiting for a worker          */
+   vector<Connection *> done;      /* Sessions whose worker has finished     */
+   bool stopping;
+
+};
+
+void runServer(const string & socketPath, LineProcessor process, int threadCount,
+               const ResourceLimits & limits) {
+   SessionServer server(socketPath, process, threadCount, limits);
+   server.serve();
+}
+
+SessionServer::SessionServer(const string & socketPath, LineProcessor process,
+                             int threadCount, const ResourceLimits & limits) {
+   this->process = process;
+   this->limits = limits;
+   stopping = false;
+   accepting = true;
+   listenFd = -1;
+   wakeFd = -1;
+   signalFd = -1;
+   epollFd = epoll_create1(EPOLL_CLOEXEC);
+   if (epollFd < 0) error(string("Cannot create epoll instance: ") + strerror(errno));
+   sigset_t signals;
+   sigemptyset(&signals);
+   sigaddset(&signals, SIGINT);
+   sigaddset(&signals, SIGTERM);
+   pthread_sigmask(SIG_BLOCK, &signals, &savedMask);
+   try {
+      listenOn(socketPath);
+      wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (wakeFd < 0) error(string("Cannot create eventfd: ") + strerror(errno));
+      epoll_event event;
+      event.events = EPOLLIN;
+      event.data.ptr = &wakeFd;
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+      signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+      if (signalFd < 0) error(string("Cannot create signalfd: ") + strerror(errno));
+      event.data.ptr = &signalFd;
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &event);
+   } catch (ErrorException &) {
+      if (!boundPath.empty()) unlink(boundPath.c_str());
+      if (listenFd >= 0) close(listenFd);
+      if (wakeFd >= 0) close(wakeFd);
+      close(epollFd);
+      pthread_sigmask(SIG_SETMASK, &savedMask, NULL);
+      throw;
+   }
+   if (threadCount <= 0) threadCount = SERVER_THREADS_PER_CORE * thread::hardware_concurrency();
+   if (threadCount <= 0) threadCount = SERVER_THREADS_PER_CORE;
+   for (int i = 0; i < threadCount; i++) {
+      workers.push_back(thread(&SessionServer::workerLoop, this));
+   }
+}
+
+/*
+ * Implementation notes: ~SessionServer
+ * ------------------------------------
+ * The socket file goes first, so that new clients fail at once rather
+ * than wait in the backlog.  The signals are unblocked before waiting
+ * for the workers, so that a second SIGINT or SIGTERM ends a server
+ * whose commands are taking too long.  The workers take no new jobs
+ * once stopping is set, and the sessions of jobs left waiting are
+ * deleted with the rest.
+ */
+
+SessionServer::~SessionServer() {
+   unlink(boundPath.c_str());
+   close(listenFd);
+   close(signalFd);
+   pthread_sigmask(SIG_SETMASK, &savedMask, NULL);
+   {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+   }
+   jobReady.notify_all();
+   for (thread & worker : workers) {
+      worker.join();
+   }
+   for (Connection *conn : connections) {
+      if (conn->fd >= 0) close(conn->fd);
+      delete conn;
+   }
+   close(wakeFd);
+   close(epollFd);
+}
+
+/*
+ * Implementation notes: listenOn
+ * ------------------------------
+ * A socket file left by a server that has gone is removed, but one
+ * that still accepts connections belongs to a running server and is
+ * left alone.
+ */
+
+void SessionServer::listenOn(const string & socketPath) {
+   sockaddr_un address;
+   memset(&address, 0, sizeof address);
+   address.sun_family = AF_UNIX;
+   if (socketPath.empty() || socketPath.length() >= sizeof address.sun_path) {
+      error("Illegal socket path: " + socketPath);
+   }
+   strcpy(address.sun_path, socketPath.c_str());
+   struct stat info;
+   if (stat(socketPath.c_str(), &info) == 0) {
+      if (!S_ISSOCK(info.st_mode)) error(socketPath + " exists and is not a socket");
+      int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      bool live = probe >= 0 && connect(probe, (sockaddr *) &address, sizeof address) == 0;
+      if (probe >= 0) close(probe);
+      if (live) error("A server is already listening on " + socketPath);
+      unlink(socketPath.c_str());
+   }
+   listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if (listenFd < 0) error(string("Cannot create socket: ") + strerror(errno));
+   if (bind(listenFd, (sockaddr *) &address, sizeof address) < 0) {
+      error("Cannot listen on " + socketPath + ": " + strerror(errno));
+   }
+   boundPath = socketPath;
+   if (listen(listenFd, LISTEN_BACKLOG) < 0) {
+      error("Cannot listen on " + socketPath + ": " + strerror(errno));
+   }
+   epoll_event event;
+   event.events = EPOLLIN;
+   event.data.ptr = &listenFd;
+   epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+}
+
+/*
+ * Implementation notes: serve
+ * ---------------------------
+ * The epoll data of each socket is its Connection, or the address of
+ * the listening, wakeup or signal descriptor.  A connection closed
+ * while its events are being handled may still appear later in the
+ * same batch, so closed connections are deleted only once the batch is
+ * done.  While accepting is paused, the wait times out so that
+ * accepting is tried again even if no session closes.  A SIGINT or
+ * SIGTERM ends the loop, leaving the rest to the destructor.
+ */
+
+void SessionServer::serve() {
+   epoll_event events[MAX_EVENTS];
+   bool signaled = false;
+   while (!signaled) {
+      int count = epoll_wait(epollFd, events, MAX_EVENTS, accepting ? -1 : ACCEPT_RETRY_MS);
+      if (count < 0) {
+         if (errno == EINTR) continue;
+         error(string("epoll_wait failed: ") + strerror(errno));
+      }
+      if (count == 0 && !accepting) setAccepting(true);
+      for (int i = 0; i < count; i++) {
+         void *tag = events[i].data.ptr;
+         if (tag == &listenFd) {
+            acceptClients();
+         } else if (tag == &signalFd) {
+            signalfd_siginfo info;
+            while (read(signalFd, &info, sizeof info) > 0) {
+               signaled = true;
+            }
+         } else if (tag == &wakeFd) {
+            collectResults();
+         } else {
+            Connection *conn = (Connection *) tag;
+            if (conn->fd < 0) continue;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readInput(conn);
+            if (conn->fd >= 0) update(conn);
+         }
+      }
+      for (Connection *conn : retired) {
+         connections.erase(conn);
+         delete conn;
+      }
+      retired.clear();
+   }
+}
+
+/*
+ * Implementation notes: acceptClients
+ * -----------------------------------
+ * The listening socket is level-triggered, so an error that leaves a
+ * connection waiting, such as running out of descriptors, would wake
+ * the loop again at once.  Any error other than an empty queue or a
+ * connection that was aborted before it could be accepted is therefore
+ * reported and pauses accepting, until a session closes or the retry
+ * interval passes.
+ */
+
+void SessionServer::acceptClients() {
+   while (true) {
+      int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+         if (errno == EINTR || errno == ECONNABORTED) continue;
+         if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+         cerr << "Server: cannot accept a connection: " << strerror(errno) << endl;
+         setAccepting(false);
+         return;
+      }
+      Connection *conn = new Connection;
+      connections.insert(conn);
+      conn->fd = fd;
+      conn->closing = false;
+      conn->running = false;
+      conn->events = EPOLLIN;
+      EvalState & state = conn->session.state;
+      state.getOutput().setStream(conn->session.out);
+      state.getOutput().setFlushPolicy(BLOCK_BUFFERED);
+      state.getInput().setStream(conn->session.noInput);
+      state.getGovernor().setLimits(limits);
+      epoll_event event;
+      event.events = conn->events;
+      event.data.ptr = conn;
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+   }
+}
+
+void SessionServer::setAccepting(bool on) {
+   accepting = on;
+   epoll_event event;
+   event.events = on ? EPOLLIN : 0;
+   event.data.ptr = &listenFd;
+   epoll_ctl(epollFd, EPOLL_CTL_MOD, listenFd, &event);
+}
+
+/*
+ * Implementation notes: readInput
+ * -------------------------------
+ * Each call reads once, so that a client sending a flood of lines
+ * gets no more than its turn.  The end of the input completes a last
+ * line that has no newline.
+ */
+
+void SessionServer::readInput(Connection *conn) {
+   if (conn->closing) {
+      retire(conn);
+      return;
+   }
+   char buffer[READ_SIZE];
+   ssize_t count = read(conn->fd, buffer, sizeof buffer);
+   if (count < 0) {
+      if (errno != EAGAIN && errno != EINTR) retire(conn);
+      return;
+   }
+   if (count == 0) {
+      if (!conn->input.empty()) addLine(conn, conn->input);
+      conn->input.clear();
+      conn->closing = true;
+      return;
+   }
+   size_t start = 0;
+   conn->input.append(buffer, count);
+   size_t newline;
+   while ((newline = conn->input.find('\n', start)) != string::npos) {
+      addLine(conn, conn->input.substr(start, newline - start));
+      start = newline + 1;
+   }
+   conn->input.erase(0, start);
+   if (conn->input.size() > SERVER_MAX_LINE) {
+      conn->input.clear();
+      conn->lines.clear();
+      conn->output += "Error: Line too long\n";
+      conn->closing = true;
+   }
+}
+
+void SessionServer::addLine(Connection *conn, string line) {
+   if (!line.empty() && line.back() == '\r') line.pop_back();
+   conn->lines.push_back(line);
+}
+
+/*
+ * Implementation notes: advance
+ * -----------------------------
+ * Program lines are carried out here, on the loop's thread, since
+ * their work is bounded by the length of the line.  The first other
+ * command is handed to a worker, since even LIST or PRINT SUM(A) takes
+ * time in proportion to the program or its arrays, and the lines after
+ * it wait until the worker is done.
+ */
+
+void SessionServer::advance(Connection *conn) {
+   while (!conn->running && !conn->lines.empty()
+          && conn->output.size() < SERVER_MAX_OUTPUT) {
+      string line = conn->lines.front();
+      conn->lines.pop_front();
+      if (!isShortCommand(line)) {
+         conn->running = true;
+         conn->job = line;
+         conn->result.clear();
+         {
+            lock_guard<mutex> guard(lock);
+            jobs.push_back(conn);
+         }
+         jobReady.notify_one();
+         return;
+      }
+      if (!carryOut(conn->session, line, conn->output)) {
+         conn->lines.clear();
+         conn->closing = true;
+      }
+   }
+}
+
+void SessionServer::writeOutput(Connection *conn) {
+   size_t written = 0;
+   while (written < conn->output.size()) {
+      ssize_t count = send(conn->fd, conn->output.data() + written,
+                           conn->output.size() - written, MSG_NOSIGNAL);
+      if (count < 0) {
+         if (errno == EINTR) continue;
+         if (errno == EAGAIN) break;
+         retire(conn);
+         return;
+      }
+      written += count;
+   }
+   conn->output.erase(0, written);
+}
+
+/*
+ * Implementation notes: update
+ * ----------------------------
+ * Carries out what lines it can, writes what answers it can and then
+ * tells epoll what the connection is waiting for.  Reading stops while
+ * too many lines or too much output are waiting, and a connection is
+ * closed once it will read no more and has nothing left to do.
+ */
+
+void SessionServer::update(Connection *conn) {
+   advance(conn);
+   if (!conn->output.empty()) writeOutput(conn);
+   if (conn->fd < 0) return;
+   if (conn->closing && !conn->running && conn->lines.empty() && conn->output.empty()) {
+      retire(conn);
+      return;
+   }
+   uint32_t wanted = 0;
+   if (!conn->closing && conn->lines.size() < MAX_WAITING_LINES
+       && conn->output.size() < SERVER_MAX_OUTPUT) {
+      wanted |= EPOLLIN;
+   }
+   if (!conn->output.empty()) wanted |= EPOLLOUT;
+   if (wanted != conn->events) {
+      conn->events = wanted;
+      epoll_event event;
+      event.events = wanted;
+      event.data.ptr = conn;
+      epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &event);
+   }
+}
+
+void SessionServer::collectResults() {
+   uint64_t signals;
+   while (read(wakeFd, &signals, sizeof signals) > 0) {
+   }
+   vector<Connection *> finished;
+   {
+      lock_guard<mutex> guard(lock);
+      finished.swap(done);
+   }
+   for (Connection *conn : finished) {
+      conn->running = false;
+      if (conn->fd < 0) {
+         retired.push_back(conn);
+         continue;
+      }
+      conn->output += conn->result;
+      if (!conn->keepOpen) {
+         conn->lines.clear();
+         conn->closing = true;
+      }
+      update(conn);
+   }
+}
+
+/*
+ * Implementation notes: retire
+ * ----------------------------
+ * Closes the socket at once, so that epoll reports nothing more for
+ * it.  A connection whose session a worker still holds is deleted when
+ * the worker's result arrives.  The descriptor it frees lets accepting
+ * resume if it was paused.
+ */
+
+void SessionServer::retire(Connection *conn) {
+   epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, NULL);
+   close(conn->fd);
+   conn->fd = -1;
+   if (!conn->running) retired.push_back(conn);
+   if (!accepting) setAccepting(true);
+}
+
+void SessionServer::workerLoop() {
+   while (true) {
+      Connection *conn;
+      {
+         unique_lock<mutex> guard(lock);
+         jobReady.wait(guard, [this] { return stopping || !jobs.empty(); });
+         if (stopping) return;
+         conn = jobs.front();
+         jobs.pop_front();
+      }
+      conn->keepOpen = carryOut(conn->session, conn->job, conn->result);
+      {
+         lock_guard<mutex> guard(lock);
+         done.push_back(conn);
+      }
+      uint64_t one = 1;
+      ssize_t ignored = write(wakeFd, &one, sizeof one);
+      (void) ignored;
+   }
+}
+
+/*
+ * Implementation notes: carryOut
+ * ------------------------------
+ * Runs one line for the session and appends its answer, returning
+ * false if the line was QUIT.  An INPUT FROM CONSOLE is undone before
+ * the next line, since the server's console belongs to no session.
+ * The last line of the answer is added after the printed text, so
+ * that it survives a command whose output was cut short, which is
+ * reported as an error on a line of its own.
+ */
+
+bool SessionServer::carryOut(Session & session, const string & line, string & answer) {
+   EvalState & state = session.state;
+   if (state.getInput().isInteractive()) state.getInput().setStream(session.noInput);
+   session.outBuffer.reset();
+   bool keepOpen = true;
+   string status;
+   try {
+      keepOpen = process(line, session.program, session.compiler, state, session.out);
+      state.getOutput().flush();
+      if (keepOpen) status = "OK";
+   } catch (ErrorException & ex) {
+      state.getOutput().flush();
+      status = "Error: " + ex.getMessage();
+   }
+   session.out.flush();
+   session.outBuffer.take(answer);
+   if (session.outBuffer.hasOverflowed()) {
+      if (!answer.empty() && answer.back() != '\n') answer += '\n';
+      status = "Error: Output limit exceeded";
+   }
+   if (status != "") answer += status + "\n";
+   return keepOpen;
+}
+
+/*
+ * Function: isShortCommand
+ * Usage: if (isShortCommand(line)) . . .
+ * --------------------------------------
+ * Returns true if the line is a program line, an empty line or QUIT,
+ * whose work does not grow with the program or its data.  A line the
+ * lexer rejects is short, since processLine reports the error at once.
+ */
+
+static bool isShortCommand(const string & line) {
+   try {
+      Lexer lexer(line);
+      Token token = lexer.nextToken();
+      return token.kind == NUMBER_TOKEN || token.kind == END_TOKEN
+          || token.keyword == QUIT_KEYWORD;
+   } catch (ErrorException &) {
+      return true;
+   }
+}
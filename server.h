@@ -0,0 +1,80 @@
+/*
+ * File: server.h
+ * --------------
+ * This interface exports the session server, which hosts many
+ * independent interpreter sessions in one process and serves them to
+ * clients over a Unix-domain socket.
+ */
+
+#ifndef _server_h
+#define _server_h
+
+#include <iostream>
+#include <string>
+#include "compiler.h"
+#include "evalstate.h"
+#include "governor.h"
+#include "program.h"
+
+/* Constants */
+
+const int SERVER_MAX_LINE = 64 * 1024;
+const int SERVER_MAX_OUTPUT = 1024 * 1024;
+const int SERVER_THREADS_PER_CORE = 4;
+
+/*
+ * Type: LineProcessor
+ * -------------------
+ * This type is a function that carries out one command line for a
+ * session, as processLine in Basic.cpp does at the console.  It writes
+ * what the command prints to out, reports a failed command by calling
+ * error, and returns false if the line ends the session.
+ */
+
+typedef bool (*LineProcessor)(std::string line, Program & program,
+                              IncrementalCompiler & compiler, EvalState & state,
+                              std::ostream & out);
+
+/*
+ * Function: runServer
+ * Usage: runServer(socketPath, process, threadCount, limits);
+ * -----------------------------------------------------------
+ * Listens on a Unix-domain socket at the specified path and serves
+ * sessions until the process receives SIGINT or SIGTERM.  It then
+ * stops accepting, removes the socket, waits for the commands already
+ * running and returns; a second signal ends the process at once.  A
+ * stale socket left at the path is replaced; failing to listen is
+ * reported by calling error.  If a connection cannot be accepted, for
+ * instance because the process has run out of descriptors, the error
+ * is written to cerr and accepting pauses until a session closes or a
+ * second has passed.
+ *
+ * Every connection is a session with its own Program, compiler and
+ * EvalState, held to the specified limits.  The client sends command
+ * lines, exactly as typed at the console, and the server answers each
+ * with what the command printed, followed by a line that is either OK
+ * or "Error: " and the message.  Program lines answer OK with nothing
+ * before it.  QUIT closes the connection.  A session has no console:
+ * INPUT reads from a file chosen with INPUT FROM, and otherwise finds
+ * no values.
+ *
+ * One thread runs an epoll loop that reads and writes every socket
+ * and carries out program lines as they arrive.  Every other command,
+ * since any of them may take time that grows with the program or its
+ * arrays, goes to a pool of threadCount workers, so that a long RUN or
+ * MAT does not hold up the other sessions.  The default of
+ * SERVER_THREADS_PER_CORE workers per core lets short runs share the
+ * processors with long ones rather than queue behind them.  Lines
+ * that arrive while a session's command runs wait for it, so each
+ * session sees its commands carried out in order.  A line longer than
+ * SERVER_MAX_LINE closes its connection, and the server stops reading
+ * from a client that has SERVER_MAX_OUTPUT bytes of answers waiting,
+ * until the client takes them.  A command that prints more than
+ * SERVER_MAX_OUTPUT bytes has the rest dropped and answers
+ * "Error: Output limit exceeded".
+ */
+
+void runServer(const std::string & socketPath, LineProcessor process, int threadCount,
+               const ResourceLimits & limits);
+
+#endif
@@ -2,11 +2,11 @@
  * File: statement.cpp
  * -------------------
  * This file implements the constructor and destructor for
- * the Statement class itself. 
+ * the Statement class itself, along with its subclasses.
  */
 
+#include <algorithm>
 #include <string>
-#include "simpio.h"
 #include "statement.h"
 #include "parser.h"
 using namespace std;
@@ -21,6 +21,14 @@ Statement::~Statement() {
    /* Empty */
 }
 
+void *Statement::operator new(size_t size, Arena & arena) {
+   return arena.allocate(size);
+}
+
+void Statement::operator delete(void *ptr, Arena & arena) {
+   /* Empty */
+}
+
 /*
  * Implementation notes: RemStmt
  * -----------------------------
@@ -28,13 +36,17 @@ Statement::~Statement() {
  * the line after the keyword "REM" is ignored.
  */
 
-RemStmt::RemStmt(TokenScanner & scanner) { //Nothing is done in this subclass since it's a comment
+RemStmt::RemStmt(Lexer & lexer) { //Nothing is done in this subclass since it's a comment
 }
 
-RemStmt::~RemStmt() {
+RemStmt::RemStmt() {
 }
 
-void RemStmt::execute(EvalState &state) {
+void RemStmt::execute(EvalState &state) const {
+}
+
+StatementType RemStmt::getType() {
+    return REM_STMT;
 }
 
 /*
@@ -42,68 +54,163 @@ void RemStmt::execute(EvalState &state) {
  * -----------------------------
  * This subclass represents an assignment statement. The
  * implementation of execute assigns an expression to a
- * variable.
+ * variable.  Assigning a double widens the type of the variable,
+ * and the statement stores the value in the type of the variable,
+ * so that execute tests one type per statement and none per
+ * operation.  The table is asked to widen the variable only when the
+ * expression is wider than the type found when the name was interned;
+ * an assignment inside the expression that widens the same variable
+ * is caught when the program is linked and retyped.
  */
 
-LetStmt::LetStmt(TokenScanner & scanner) {
-    name = scanner.nextToken();
-    if (scanner.nextToken() != "=") error("Not an equal sign for assignment");
-    exp = parseExp(scanner);
+LetStmt::LetStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    string token(lexer.nextToken().text);
+    name = arena.copyString(token);
+    slot = symbols.intern(token, type);
+    if (lexer.nextToken().op != '=') error("Not an equal sign for assignment");
+    exp = parseExp(lexer, symbols, arena);
+    if (exp->getValueType() > type) type = symbols.widenType(slot, exp->getValueType());
+}
+
+LetStmt::LetStmt(string name, Expression *exp, SymbolTable & symbols, Arena & arena) {
+    this->name = arena.copyString(name);
+    this->slot = symbols.intern(name, type);
+    this->exp = exp;
+    if (exp->getValueType() > type) type = symbols.widenType(slot, exp->getValueType());
+}
+
+void LetStmt::execute(EvalState &state) const {
+    if (type == INTEGER_TYPE) {
+        state.setValue(slot, exp->eval(state));
+    } else {
+        state.setDouble(slot, exp->evalDouble(state));
+    }
+}
+
+StatementType LetStmt::getType() {
+    return LET_STMT;
+}
+
+string LetStmt::getName() {
+    return name;
+}
+
+int LetStmt::getSlot() {
+    return slot;
+}
 
+Expression *LetStmt::getExp() {
+    return exp;
 }
 
-LetStmt::~LetStmt() {
-    delete exp;
+void LetStmt::setExp(Expression *exp) {
+    this->exp = exp;
 }
 
-void LetStmt::execute(EvalState &state) {
-    int expEval = exp->eval(state);
-    state.setValue(name, expEval);
+ValueType LetStmt::getValueType() {
+    return type;
+}
+
+void LetStmt::setValueType(ValueType type) {
+    this->type = type;
 }
 
 /*
  * Implementation notes: PrintStmt
  * -----------------------------
  * This subclass represents a printed expression. The implementation
- * of execute prints the value of the expression onto the console and
- * then prints a newline character so that the output from the next
- * PRINT statement begins on a new line.
+ * of execute prints the value of the expression and then a newline
+ * character so that the output from the next PRINT statement begins
+ * on a new line.  The output goes through the state's OutputBuffer,
+ * which decides when it reaches the console.
  */
 
-PrintStmt::PrintStmt(TokenScanner & scanner) {
-    exp = parseExp(scanner);
-    if (scanner.hasMoreTokens()) {
+PrintStmt::PrintStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    exp = parseExp(lexer, symbols, arena);
+    if (lexer.hasMoreTokens()) {
         error ("Too many tokens");
     }
+    type = exp->getValueType();
+}
+
+PrintStmt::PrintStmt(Expression *exp) {
+    this->exp = exp;
+    this->type = exp->getValueType();
+}
+
+void PrintStmt::execute(EvalState &state) const {
+    if (type == INTEGER_TYPE) {
+        state.getOutput().printInteger(exp->eval(state));
+    } else {
+        state.getOutput().printDouble(exp->evalDouble(state));
+    }
 }
 
-PrintStmt::~PrintStmt() {
-    delete exp;
+StatementType PrintStmt::getType() {
+    return PRINT_STMT;
 }
 
-void PrintStmt::execute(EvalState &state) {
-    cout << exp->eval(state) << endl;
+Expression *PrintStmt::getExp() {
+    return exp;
+}
+
+void PrintStmt::setExp(Expression *exp) {
+    this->exp = exp;
+    type = exp->getValueType();
 }
 
 /*
  * Implementation notes: InputStmt
  * -----------------------------
  * This subclass represents statements read in from the user. The
- * implementation of execute prompts the user and then reads in a
- * value to be read in the variable.
+ * implementation of execute flushes any buffered output if the state's
+ * InputSource reads from the console, so the user sees everything
+ * printed so far, then reads a value from the source and stores it in
+ * the variable.  A double variable
+ * accepts any number and an integer variable only an integer.
+ * Nothing is stored in the statement itself while it runs, so one
+ * parsed program can run on several threads.
  */
 
 
-InputStmt::InputStmt(TokenScanner & scanner) {
-    name = scanner.nextToken();
+InputStmt::InputStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    string token(lexer.nextToken().text);
+    name = arena.copyString(token);
+    slot = symbols.intern(token, type);
+}
+
+InputStmt::InputStmt(string name, SymbolTable & symbols, Arena & arena) {
+    this->name = arena.copyString(name);
+    this->slot = symbols.intern(name, type);
+}
+
+void InputStmt::execute(EvalState &state) const {
+    if (state.getInput().isInteractive()) state.getOutput().flush();
+    if (type == INTEGER_TYPE) {
+        state.setValue(slot, state.getInput().readInteger());
+    } else {
+        state.setDouble(slot, state.getInput().readDouble());
+    }
 }
 
-InputStmt::~InputStmt() {
+StatementType InputStmt::getType() {
+    return INPUT_STMT;
 }
 
-void InputStmt::execute(EvalState &state) {
-    inputPrompt = getInteger(" ? ");
-    state.setValue(name, inputPrompt);
+string InputStmt::getName() {
+    return name;
+}
+
+int InputStmt::getSlot() {
+    return slot;
+}
+
+ValueType InputStmt::getValueType() {
+    return type;
+}
+
+void InputStmt::setValueType(ValueType type) {
+    this->type = type;
 }
 
 /*
@@ -115,17 +222,26 @@ void InputStmt::execute(EvalState &state) {
  */
 
 
-GoToStmt::GoToStmt(TokenScanner & scanner) {
-    goingToLineNumber = stringToInteger(scanner.nextToken());
+GoToStmt::GoToStmt(Lexer & lexer) {
+    goingToLineNumber = readLineNumber(lexer);
 }
 
-GoToStmt::~GoToStmt() {
+GoToStmt::GoToStmt(int lineNumber) {
+    goingToLineNumber = lineNumber;
 }
 
-void GoToStmt::execute(EvalState &state) {
+void GoToStmt::execute(EvalState &state) const {
     state.setCurrentLine(goingToLineNumber);
 }
 
+StatementType GoToStmt::getType() {
+    return GOTO_STMT;
+}
+
+int GoToStmt::getLineNumber() {
+    return goingToLineNumber;
+}
+
 /*
  * Implementation notes: IfStmt
  * -----------------------------
@@ -133,34 +249,107 @@ void GoToStmt::execute(EvalState &state) {
  * The implementation of execute evaluates the condition. If the
  * condition holds, the program should continue from line n just
  * as in the GoTo statement. If not, the program continues on to the
- * next line.
+ * next line.  The two sides are compared as doubles if either is a
+ * double and as integers otherwise; the type is kept up to date by
+ * the setters, so execute makes the choice with a single test.
  */
 
-IfStmt::IfStmt(TokenScanner & scanner) {
-    lhs = readE(scanner);
-    comparison = scanner.nextToken();
-    rhs = readE(scanner);
-    if (scanner.nextToken() != "THEN") {
+IfStmt::IfStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    lhs = readE(lexer, symbols, arena, 1);
+    relation = readRelation(lexer);
+    rhs = readE(lexer, symbols, arena, 1);
+    Token token = lexer.nextToken();
+    if (token.keyword != THEN_KEYWORD || !token.upperCase) {
         error("Wrong statement: no 'then' included");
     }
     else {
-        goingToLineNumber = stringToInteger(scanner.nextToken());
+        goingToLineNumber = readLineNumber(lexer);
     }
+    type = widerType(lhs->getValueType(), rhs->getValueType());
 }
 
-IfStmt::~IfStmt() {
-    delete lhs;
-    delete rhs;
+IfStmt::IfStmt(Expression *lhs, Relation relation, Expression *rhs, int lineNumber) {
+    this->lhs = lhs;
+    this->relation = relation;
+    this->rhs = rhs;
+    this->goingToLineNumber = lineNumber;
+    this->type = widerType(lhs->getValueType(), rhs->getValueType());
 }
 
-void IfStmt::execute(EvalState &state) {
-    int lhsEval = lhs->eval(state);
-    int rhsEval = rhs->eval(state);
-    if ((comparison == "=" && lhsEval == rhsEval) || (comparison == ">" && lhsEval > rhsEval) || (comparison == "<" && lhsEval < rhsEval)) {
+/*
+ * Implementation notes: readRelation
+ * ----------------------------------
+ * The lexer returns each punctuation character as a separate token,
+ * so the two-character relations are put back together here.  Both
+ * sides of the comparison are read with readE at the precedence of
+ * the assignment operator, which keeps readE from consuming the "="
+ * relation as an assignment.
+ */
+
+Relation IfStmt::readRelation(Lexer & lexer) {
+    Token token = lexer.nextToken();
+    string name(token.text);
+    if (token.op == '<' || token.op == '>') {
+        char next = lexer.peekToken().op;
+        if (next == '=' || (token.op == '<' && next == '>')) {
+            name += lexer.nextToken().op;
+        }
+    }
+    Relation relation = stringToRelation(name);
+    if (relation == ILLEGAL_REL) error("Illegal comparison operator");
+    return relation;
+}
+
+void IfStmt::execute(EvalState &state) const {
+    bool holds;
+    if (type == INTEGER_TYPE) {
+        long long lhsEval = lhs->eval(state);
+        long long rhsEval = rhs->eval(state);
+        holds = testRelation(relation, lhsEval, rhsEval);
+    } else {
+        double lhsEval = lhs->evalDouble(state);
+        double rhsEval = rhs->evalDouble(state);
+        holds = testRelation(relation, lhsEval, rhsEval);
+    }
+    if (holds) {
         state.setCurrentLine(goingToLineNumber);
     }
 }
 
+StatementType IfStmt::getType() {
+    return IF_STMT;
+}
+
+Expression *IfStmt::getLHS() {
+    return lhs;
+}
+
+Expression *IfStmt::getRHS() {
+    return rhs;
+}
+
+Relation IfStmt::getRelation() {
+    return relation;
+}
+
+int IfStmt::getLineNumber() {
+    return goingToLineNumber;
+}
+
+void IfStmt::setLHS(Expression *lhs) {
+    this->lhs = lhs;
+    type = widerType(lhs->getValueType(), rhs->getValueType());
+}
+
+void IfStmt::setRHS(Expression *rhs) {
+    this->rhs = rhs;
+    type = widerType(lhs->getValueType(), rhs->getValueType());
+}
+
+ValueType IfStmt::getValueType() {
+    return type;
+}
+
 /*
  * Implementation notes: EndStmt
  * -----------------------------
@@ -168,14 +357,219 @@ void IfStmt::execute(EvalState &state) {
  * of execute halts the execution once the marked line is reached.
  */
 
-EndStmt::EndStmt(TokenScanner & scanner) {
+EndStmt::EndStmt(Lexer & lexer) {
 }
 
-EndStmt::~EndStmt() {
+EndStmt::EndStmt() {
 }
 
-void EndStmt::execute(EvalState &state) {
+void EndStmt::execute(EvalState &state) const {
     state.setCurrentLine(-1);
 }
 
+StatementType EndStmt::getType() {
+    return END_STMT;
+}
+
+/*
+ * Implementation notes: DimStmt
+ * -----------------------------
+ * This subclass represents the creation of an array. The declarator
+ * is read like an element reference, and the implementation of
+ * execute evaluates its subscripts as the extents and gives the array
+ * its shape.
+ */
+
+DimStmt::DimStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    Token name = lexer.nextToken();
+    if (name.kind != WORD_TOKEN || lexer.peekToken().op != '(') {
+        error("Illegal DIM statement");
+    }
+    declarator = readElement(string(name.text), lexer, symbols, arena);
+    if (lexer.hasMoreTokens()) {
+        error ("Too many tokens");
+    }
+}
+
+DimStmt::DimStmt(ElementExp *declarator) {
+    this->declarator = declarator;
+}
+
+void DimStmt::execute(EvalState &state) const {
+    long long rows = declarator->getRow()->eval(state);
+    long long columns = 1;
+    if (declarator->getColumn() != NULL) columns = declarator->getColumn()->eval(state);
+    state.dimensionArray(declarator->getSlot(), declarator->getKey(), declarator->getRank(),
+                         rows, columns);
+}
+
+StatementType DimStmt::getType() {
+    return DIM_STMT;
+}
+
+ElementExp *DimStmt::getDeclarator() {
+    return declarator;
+}
+
+/*
+ * Implementation notes: LetElementStmt
+ * -----------------------------
+ * This subclass represents an assignment to an array element. The
+ * element is located only after the assigned expression has been
+ * evaluated, which also keeps the pointer valid if evaluating the
+ * expression grew the state's table of arrays.
+ */
 
+LetElementStmt::LetElementStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    string name(lexer.nextToken().text);
+    element = readElement(name, lexer, symbols, arena);
+    if (lexer.nextToken().op != '=') error("Not an equal sign for assignment");
+    exp = parseExp(lexer, symbols, arena);
+}
+
+LetElementStmt::LetElementStmt(ElementExp *element, Expression *exp) {
+    this->element = element;
+    this->exp = exp;
+}
+
+void LetElementStmt::execute(EvalState &state) const {
+    long long row = element->getRow()->eval(state);
+    long long column = 1;
+    if (element->getColumn() != NULL) column = element->getColumn()->eval(state);
+    long long value = exp->eval(state);
+    *element->locate(state, row, column) = value;
+}
+
+StatementType LetElementStmt::getType() {
+    return LET_ELEMENT_STMT;
+}
+
+ElementExp *LetElementStmt::getElement() {
+    return element;
+}
+
+Expression *LetElementStmt::getExp() {
+    return exp;
+}
+
+void LetElementStmt::setExp(Expression *exp) {
+    this->exp = exp;
+}
+
+/*
+ * Implementation notes: MatStmt
+ * -----------------------------
+ * This subclass represents an operation on whole arrays. The parser
+ * tells a scalar from an array by the parenthesis around it, and any
+ * form not listed in statement.h is reported as an illegal MAT
+ * statement. The implementation of execute evaluates the scalar,
+ * reserves the slots of every array it names, so that holding all of
+ * them at once is safe, and hands them to executeMat.
+ */
+
+static string readArrayName(Lexer & lexer) {
+    Token token = lexer.nextToken();
+    if (token.kind != WORD_TOKEN) error("Illegal MAT statement");
+    return string(token.text);
+}
+
+static MatOperation charToMatOperation(char op, bool scalar) {
+    switch (op) {
+     case '+': return scalar ? MAT_ADD_SCALAR : MAT_ADD;
+     case '-': return scalar ? MAT_SUB_SCALAR : MAT_SUB;
+     case '*': return scalar ? MAT_SCALE : MAT_PRODUCT;
+     default: return ILLEGAL_MAT;
+    }
+}
+
+MatStmt::MatStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena) {
+    string target = readArrayName(lexer);
+    string lhs, rhs;
+    if (lexer.nextToken().op != '=') error("Illegal MAT statement");
+    op = ILLEGAL_MAT;
+    scalar = NULL;
+    if (lexer.peekToken().op == '(') {
+        scalar = readT(lexer, symbols, arena);
+        if (!lexer.hasMoreTokens()) {
+            op = MAT_FILL;
+        } else if (lexer.nextToken().op == '*') {
+            lhs = readArrayName(lexer);
+            op = MAT_SCALE;
+        }
+    } else {
+        lhs = readArrayName(lexer);
+        Token token = lexer.nextToken();
+        if (token.kind == END_TOKEN) {
+            op = MAT_COPY;
+        } else if (lexer.peekToken().op == '(') {
+            scalar = readT(lexer, symbols, arena);
+            op = charToMatOperation(token.op, true);
+        } else {
+            rhs = readArrayName(lexer);
+            op = charToMatOperation(token.op, false);
+        }
+    }
+    if (op == ILLEGAL_MAT || lexer.hasMoreTokens()) error("Illegal MAT statement");
+    intern(target, targetSlot, targetKey, symbols, arena);
+    intern(lhs, lhsSlot, lhsKey, symbols, arena);
+    intern(rhs, rhsSlot, rhsKey, symbols, arena);
+}
+
+MatStmt::MatStmt(MatOperation op, string target, string lhs, string rhs, Expression *scalar,
+                 SymbolTable & symbols, Arena & arena) {
+    this->op = op;
+    this->scalar = scalar;
+    intern(target, targetSlot, targetKey, symbols, arena);
+    intern(lhs, lhsSlot, lhsKey, symbols, arena);
+    intern(rhs, rhsSlot, rhsKey, symbols, arena);
+}
+
+void MatStmt::intern(string name, int & slot, const char *& key, SymbolTable & symbols,
+                     Arena & arena) {
+    if (name == "") {
+        slot = -1;
+        key = NULL;
+    } else {
+        key = arena.copyString(arrayKey(name));
+        slot = symbols.intern(key);
+    }
+}
+
+void MatStmt::execute(EvalState &state) const {
+    long long value = (scalar == NULL) ? 0 : scalar->eval(state);
+    state.reserveSlots(max(targetSlot, max(lhsSlot, rhsSlot)) + 1);
+    Array *lhs = (lhsSlot == -1) ? NULL : &state.getArray(lhsSlot);
+    Array *rhs = (rhsSlot == -1) ? NULL : &state.getArray(rhsSlot);
+    long long elements = executeMat(op, state.getArray(targetSlot), lhs, rhs, value,
+                                    targetKey, lhsKey, rhsKey);
+    state.checkMemory();
+    state.getGovernor().chargeElements(elements);
+}
+
+StatementType MatStmt::getType() {
+    return MAT_STMT;
+}
+
+MatOperation MatStmt::getOperation() {
+    return op;
+}
+
+int MatStmt::getTargetSlot() {
+    return targetSlot;
+}
+
+int MatStmt::getLHSSlot() {
+    return lhsSlot;
+}
+
+int MatStmt::getRHSSlot() {
+    return rhsSlot;
+}
+
+Expression *MatStmt::getScalar() {
+    return scalar;
+}
+
+void MatStmt::setScalar(Expression *scalar) {
+    this->scalar = scalar;
+}
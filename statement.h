@@ -6,11 +6,28 @@
 #ifndef _statement_h
 #define _statement_h
 
+#include "arena.h"
+#include "array.h"
 #include "evalstate.h"
 #include "exp.h"
+#include "lexer.h"
+#include "symtab.h"
 #include "strlib.h"
 #include "string.h"
-#include "tokenscanner.h"
+
+/*
+ * Type: StatementType
+ * -------------------
+ * This enumerated type is used to differentiate the statement forms,
+ * so that clients such as the bytecode compiler can inspect a parsed
+ * statement without executing it.  An assignment to an array element
+ * is a form of its own, LET_ELEMENT_STMT.
+ */
+
+enum StatementType {
+   REM_STMT, LET_STMT, PRINT_STMT, INPUT_STMT, GOTO_STMT, IF_STMT, END_STMT, DIM_STMT,
+   LET_ELEMENT_STMT, MAT_STMT
+};
 
 /*
  * Class: Statement
@@ -19,7 +36,8 @@
  * The model for this class is Expression in the exp.h interface.
  * Like Expression, Statement is an abstract class with subclasses
  * for each of the statement and command types required for the
- * BASIC interpreter.
+ * BASIC interpreter.  Also like Expression, statements are
+ * allocated in an Arena together with their expressions.
  */
 
 class Statement {
@@ -36,15 +54,15 @@ public:
    Statement();
 
 /*
- * Destructor: ~Statement
- * Usage: delete stmt;
- * -------------------
- * The destructor deallocates the storage for this expression.
- * It must be declared virtual to ensure that the correct subclass
- * destructor is called when deleting a statement.
+ * Operators: new, delete
+ * Usage: Statement *stmt = new (arena) EndStmt(lexer);
+ * ----------------------------------------------------
+ * Allocates the statement in the specified arena, in the same way
+ * as the operators of the same name in Expression.
  */
 
-   virtual ~Statement();
+   static void *operator new(size_t size, Arena & arena);
+   static void operator delete(void *ptr, Arena & arena);
 
 /*
  * Method: execute
@@ -54,10 +72,33 @@ public:
  * defines its own execute method that implements the necessary
  * operations.  As was true for the expression evaluator, this
  * method takes an EvalState object for looking up variables or
- * controlling the operation of the interpreter.
+ * controlling the operation of the interpreter.  The method is const:
+ * everything a run changes is kept in the state, so that threads can
+ * execute the same statement at once, as FrozenProgram requires.
+ */
+
+   virtual void execute(EvalState & state) const = 0;
+
+/*
+ * Method: getType
+ * Usage: StatementType type = stmt->getType();
+ * --------------------------------------------
+ * Returns the type of the statement, which must be one of the
+ * constants in StatementType.
+ */
+
+   virtual StatementType getType() = 0;
+
+protected:
+
+/*
+ * Destructor: ~Statement
+ * ----------------------
+ * The destructor is protected, which makes deleting a statement a
+ * compile-time error.  The arena reclaims statements instead.
  */
 
-   virtual void execute(EvalState & state) = 0;
+   ~Statement();
 
 };
 
@@ -65,11 +106,12 @@ public:
  * The remainder of this file must consists of subclass
  * definitions for the individual statement forms.  Each of
  * those subclasses must define a constructor that parses a
- * statement from a scanner and a method called execute,
- * which executes that statement.  If the private data for
- * a subclass includes data allocated on the heap (such as
- * an Expression object), the class implementation must also
- * specify its own destructor method to free that memory.
+ * statement from a lexer, a constructor that builds it from
+ * its parts for the image loader, and a method called execute,
+ * which executes that statement.  Any data a subclass
+ * allocates, such as its Expression objects, must come from
+ * the arena passed to its constructor, since no destructor
+ * runs when a statement is freed.
  */
 
 /*
@@ -89,12 +131,13 @@ public:
  * Creates a new comment statement.
  */
 
-    RemStmt(TokenScanner & scanner);
+    RemStmt(Lexer & lexer);
+    RemStmt();
 
 /* Prototypes for the virtual methods overridden by this class */
 
-    virtual ~RemStmt();
-    virtual void execute(EvalState & state);
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
 
     };
 
@@ -106,7 +149,8 @@ public:
  * expression. As in C++, the effect of this statement is to assign
  * the value of the expression to the variable, replacing any previous
  * value. In Basic, assignment is not an operator and may not be nested
- * inside other expressions.
+ * inside other expressions.  The statement records the type of the
+ * variable, which decides how the value is evaluated and stored.
  */
 
 class LetStmt : public Statement {
@@ -116,20 +160,61 @@ public:
 /*
  * Constructor: LetStmt
  * -------------------
- * Creates a new assignment statement.
+ * Creates a new assignment statement, either by parsing it or from
+ * the name of the variable and the assigned expression.
  */
 
-    LetStmt(TokenScanner & scanner);
+    LetStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+    LetStmt(std::string name, Expression *exp, SymbolTable & symbols, Arena & arena);
 
 /* Prototypes for the virtual methods overridden by this class */
 
-    virtual ~LetStmt();
-    virtual void execute(EvalState & state);
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+/*
+ * Methods: getName, getSlot, getExp
+ * Usage: string name = ((LetStmt *) stmt)->getName();
+ *        int slot = ((LetStmt *) stmt)->getSlot();
+ *        Expression *exp = ((LetStmt *) stmt)->getExp();
+ * ------------------------------------------------------
+ * These methods return the components of an assignment and can be
+ * applied only to an object known to be a LetStmt.
+ */
+
+    std::string getName();
+    int getSlot();
+    Expression *getExp();
+
+/*
+ * Method: setExp
+ * Usage: ((LetStmt *) stmt)->setExp(exp);
+ * ---------------------------------------
+ * Replaces the assigned expression without freeing the previous one,
+ * as the optimizer does when it rewrites the tree.
+ */
+
+    void setExp(Expression *exp);
+
+/*
+ * Methods: getValueType, setValueType
+ * Usage: ValueType type = ((LetStmt *) stmt)->getValueType();
+ *        ((LetStmt *) stmt)->setValueType(type);
+ * -----------------------------------------------------------
+ * These methods return and change the type of the variable as the
+ * statement knows it, which retyping brings up to date when the type
+ * widens after the statement is parsed.
+ */
+
+    ValueType getValueType();
+    void setValueType(ValueType type);
 
 private:
 
-    std::string name;
+    const char *name;
+    int slot;
     Expression *exp;
+    ValueType type;
 
     };
 
@@ -149,19 +234,44 @@ public:
 /*
  * Constructor: PrintStmt
  * -------------------
- * Creates a new print statement.
+ * Creates a new print statement, either by parsing it or from the
+ * printed expression.
  */
 
-    PrintStmt(TokenScanner & scanner);
+    PrintStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+    PrintStmt(Expression *exp);
 
 /* Prototypes for the virtual methods overridden by this class */
 
-    virtual ~PrintStmt();
-    virtual void execute(EvalState & state);
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+/*
+ * Method: getExp
+ * Usage: Expression *exp = ((PrintStmt *) stmt)->getExp();
+ * --------------------------------------------------------
+ * Returns the printed expression and can be applied only to an
+ * object known to be a PrintStmt.
+ */
+
+    Expression *getExp();
+
+/*
+ * Method: setExp
+ * Usage: ((PrintStmt *) stmt)->setExp(exp);
+ * -----------------------------------------
+ * Replaces the printed expression without freeing the previous one,
+ * as the optimizer does when it rewrites the tree.  The statement
+ * records the type of the expression, so it must be set again after
+ * the expression is retyped.
+ */
+
+    void setExp(Expression *exp);
 
 private:
 
     Expression *exp;
+    ValueType type;
 
     };
 
@@ -170,8 +280,9 @@ private:
  * ----------------------------
  * This subclass represents a statement where a variable is read in
  * from the user. The effect of this statement is to print a prompt
- * consisting of the string " ? " and then to read in a value ot be
- * stored in the variable.
+ * consisting of the string " ? " and then to read in a value to be
+ * stored in the variable.  When the EvalState's InputSource reads
+ * from a stream or a file, the value comes from there without a prompt.
  */
 
 class InputStmt : public Statement {
@@ -181,20 +292,47 @@ public:
 /*
  * Constructor: InputStmt
  * -------------------
- * Creates a new input statement.
+ * Creates a new input statement, either by parsing it or from the name
+ * of the variable.
  */
 
-    InputStmt(TokenScanner & scanner);
+    InputStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+    InputStmt(std::string name, SymbolTable & symbols, Arena & arena);
 
 /* Prototypes for the virtual methods overridden by this class */
 
-    virtual ~InputStmt();
-    virtual void execute(EvalState & state);
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+/*
+ * Methods: getName, getSlot
+ * Usage: string name = ((InputStmt *) stmt)->getName();
+ *        int slot = ((InputStmt *) stmt)->getSlot();
+ * -----------------------------------------------------
+ * These methods return the variable being read and can be applied
+ * only to an object known to be an InputStmt.
+ */
+
+    std::string getName();
+    int getSlot();
+
+/*
+ * Methods: getValueType, setValueType
+ * Usage: ValueType type = ((InputStmt *) stmt)->getValueType();
+ *        ((InputStmt *) stmt)->setValueType(type);
+ * -------------------------------------------------------------
+ * These methods return and change the type of the variable as the
+ * statement knows it, as for LetStmt.
+ */
+
+    ValueType getValueType();
+    void setValueType(ValueType type);
 
 private:
 
-    std::string name;
-    int inputPrompt;
+    const char *name;
+    int slot;
+    ValueType type;
 
     };
 
@@ -215,15 +353,27 @@ public:
 /*
  * Constructor: GoToStmt
  * -------------------
- * Creates a new GoTo statement.
+ * Creates a new GoTo statement, either by parsing it or from the
+ * target line number.
  */
 
-    GoToStmt(TokenScanner & scanner);
+    GoToStmt(Lexer & lexer);
+    GoToStmt(int lineNumber);
 
 /* Prototypes for the virtual methods overridden by this class */
 
-    virtual ~GoToStmt();
-    virtual void execute(EvalState & state);
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+/*
+ * Method: getLineNumber
+ * Usage: int target = ((GoToStmt *) stmt)->getLineNumber();
+ * ---------------------------------------------------------
+ * Returns the target line number and can be applied only to an
+ * object known to be a GoToStmt.
+ */
+
+    int getLineNumber();
 
 private:
 
@@ -237,7 +387,8 @@ private:
  * This subclass represents a statement that provides conditional
  * control. If the condition holds, the program should continue
  * from line n just as in the GoTo statement. If not, the program
- * continues on to the next line.
+ * continues on to the next line.  The condition compares two
+ * expressions using one of the relations =, <>, <, <=, > or >=.
 */
 
 class IfStmt : public Statement {
@@ -247,22 +398,66 @@ public:
 /*
  * Constructor: IfStmt
  * -------------------
- * Creates a new if statement.
+ * Creates a new if statement, either by parsing it or from the two
+ * sides of the comparison, the relation and the target line number.
  */
 
-    IfStmt(TokenScanner & scanner);
+    IfStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+    IfStmt(Expression *lhs, Relation relation, Expression *rhs, int lineNumber);
 
 /* Prototypes for the virtual methods overridden by this class */
 
-    virtual ~IfStmt();
-    virtual void execute(EvalState & state);
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+/*
+ * Methods: getLHS, getRHS, getRelation, getLineNumber
+ * Usage: Expression *lhs = ((IfStmt *) stmt)->getLHS();
+ *        Expression *rhs = ((IfStmt *) stmt)->getRHS();
+ *        Relation relation = ((IfStmt *) stmt)->getRelation();
+ *        int target = ((IfStmt *) stmt)->getLineNumber();
+ * ---------------------------------------------------------------
+ * These methods return the components of a conditional and can be
+ * applied only to an object known to be an IfStmt.
+ */
+
+    Expression *getLHS();
+    Expression *getRHS();
+    Relation getRelation();
+    int getLineNumber();
+
+/*
+ * Methods: setLHS, setRHS
+ * Usage: ((IfStmt *) stmt)->setLHS(lhs);
+ *        ((IfStmt *) stmt)->setRHS(rhs);
+ * --------------------------------------
+ * These methods replace one side of the comparison without freeing
+ * the previous expression, as the optimizer does when it rewrites
+ * the tree.
+ */
+
+    void setLHS(Expression *lhs);
+    void setRHS(Expression *rhs);
+
+/*
+ * Method: getValueType
+ * Usage: ValueType type = ((IfStmt *) stmt)->getValueType();
+ * ----------------------------------------------------------
+ * Returns the type in which the comparison is made, which is the
+ * wider of the types of its two sides.
+ */
+
+    ValueType getValueType();
 
 private:
 
     Expression *lhs;
     Expression *rhs;
-    std::string comparison;
+    Relation relation;
     int goingToLineNumber;
+    ValueType type;
+
+    Relation readRelation(Lexer & lexer);
 
     };
 
@@ -285,15 +480,187 @@ public:
  * Creates a new end statement.
  */
 
-    EndStmt(TokenScanner & scanner);
+    EndStmt(Lexer & lexer);
+    EndStmt();
+
+/* Prototypes for the virtual methods overridden by this class */
+
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+private:
+
+    };
+
+/*
+ * Subclass: DimStmt
+ * ----------------------------
+ * This subclass represents a statement that creates an array, as in
+ * DIM A(N) or DIM M(R, C).  The extents are expressions evaluated when
+ * the statement runs, and every element starts at 0.  Running DIM
+ * again for the same array gives it the new shape and clears it.
+ */
+
+class DimStmt : public Statement {
+
+public:
+
+/*
+ * Constructor: DimStmt
+ * -------------------
+ * Creates a new DIM statement, either by parsing it or from the
+ * declarator, whose subscripts are the extents.
+ */
+
+    DimStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+    DimStmt(ElementExp *declarator);
 
 /* Prototypes for the virtual methods overridden by this class */
 
-    virtual ~EndStmt();
-    virtual void execute(EvalState & state);
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+/*
+ * Method: getDeclarator
+ * Usage: ElementExp *declarator = ((DimStmt *) stmt)->getDeclarator();
+ * --------------------------------------------------------------------
+ * Returns the declarator and can be applied only to an object known
+ * to be a DimStmt.  The optimizer rewrites its subscripts in place.
+ */
+
+    ElementExp *getDeclarator();
 
 private:
 
+    ElementExp *declarator;
+
+    };
+
+/*
+ * Subclass: LetElementStmt
+ * ----------------------------
+ * This subclass represents an assignment to an array element, such as
+ * LET A(I, J) = A(I, J) + 1.  The subscripts are evaluated first, then
+ * the assigned expression, and the element is located last, so that
+ * the order of errors is the same on every engine.
+ */
+
+class LetElementStmt : public Statement {
+
+public:
+
+/*
+ * Constructor: LetElementStmt
+ * -------------------
+ * Creates a new element assignment, either by parsing it or from the
+ * element reference and the assigned expression.
+ */
+
+    LetElementStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+    LetElementStmt(ElementExp *element, Expression *exp);
+
+/* Prototypes for the virtual methods overridden by this class */
+
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+/*
+ * Methods: getElement, getExp, setExp
+ * Usage: ElementExp *element = ((LetElementStmt *) stmt)->getElement();
+ *        Expression *exp = ((LetElementStmt *) stmt)->getExp();
+ *        ((LetElementStmt *) stmt)->setExp(exp);
+ * ---------------------------------------------------------------------
+ * These methods return and replace the components of the assignment
+ * and can be applied only to an object known to be a LetElementStmt.
+ */
+
+    ElementExp *getElement();
+    Expression *getExp();
+    void setExp(Expression *exp);
+
+private:
+
+    ElementExp *element;
+    Expression *exp;
+
+    };
+
+/*
+ * Subclass: MatStmt
+ * ----------------------------
+ * This subclass represents a statement that operates on whole arrays:
+ *
+ *    MAT C = A          MAT C = A + B      MAT C = A + (e)
+ *    MAT C = (e)        MAT C = A - B      MAT C = A - (e)
+ *                       MAT C = A * B      MAT C = A * (e)
+ *                                          MAT C = (e) * A
+ *
+ * where A * B is the matrix product and a parenthesized expression is
+ * a scalar applied to every element.  The work is done by executeMat
+ * in array.h, which describes the rules for shapes.
+ */
+
+class MatStmt : public Statement {
+
+public:
+
+/*
+ * Constructor: MatStmt
+ * -------------------
+ * Creates a new MAT statement, either by parsing it or from its
+ * operation, the names of the arrays and the scalar expression.  The
+ * names and the scalar that the operation does not use are empty
+ * strings and NULL.
+ */
+
+    MatStmt(Lexer & lexer, SymbolTable & symbols, Arena & arena);
+    MatStmt(MatOperation op, std::string target, std::string lhs, std::string rhs,
+            Expression *scalar, SymbolTable & symbols, Arena & arena);
+
+/* Prototypes for the virtual methods overridden by this class */
+
+    virtual void execute(EvalState & state) const;
+    virtual StatementType getType();
+
+/*
+ * Methods: getOperation, getTargetSlot, getLHSSlot, getRHSSlot
+ * Usage: MatOperation op = ((MatStmt *) stmt)->getOperation();
+ *        int slot = ((MatStmt *) stmt)->getTargetSlot();
+ * -----------------------------------------------------------
+ * These methods return the operation and the slots of the keys of the
+ * arrays it involves, or -1 for an operand it does not use, and can be
+ * applied only to an object known to be a MatStmt.
+ */
+
+    MatOperation getOperation();
+    int getTargetSlot();
+    int getLHSSlot();
+    int getRHSSlot();
+
+/*
+ * Methods: getScalar, setScalar
+ * Usage: Expression *scalar = ((MatStmt *) stmt)->getScalar();
+ *        ((MatStmt *) stmt)->setScalar(scalar);
+ * ------------------------------------------------------------
+ * These methods return and replace the scalar operand, which is NULL
+ * if the operation takes none.
+ */
+
+    Expression *getScalar();
+    void setScalar(Expression *scalar);
+
+private:
+
+    MatOperation op;
+    int targetSlot, lhsSlot, rhsSlot;
+    const char *targetKey;
+    const char *lhsKey;
+    const char *rhsKey;
+    Expression *scalar;
+
+    void intern(std::string name, int & slot, const char *& key, SymbolTable & symbols,
+                Arena & arena);
+
     };
 
 #endif
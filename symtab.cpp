@@ -0,0 +1,108 @@
+/*
+ * File: symtab.cpp
+ * ----------------
+ * This file implements the SymbolTable class.  The public methods are
+ * simple enough that they need no individual documentation.  Every
+ * method holds the lock, since the table is only consulted while
+ * parsing and compiling and never while a program runs.  Most calls
+ * to intern find a name that is already present, so intern first
+ * looks under a shared lock and takes the exclusive lock only to add
+ * a new name, which lets parser threads proceed side by side; widenType
+ * does the same, since most assignments do not change a type.
+ */
+
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include "symtab.h"
+using namespace std;
+
+SymbolTable::SymbolTable() {
+   typeGeneration = 0;
+}
+
+SymbolTable::~SymbolTable() {
+   /* Empty */
+}
+
+int SymbolTable::intern(const string & name) {
+   ValueType type;
+   return intern(name, type);
+}
+
+int SymbolTable::intern(const string & name, ValueType & type) {
+   {
+      shared_lock<shared_mutex> guard(lock);
+      if (slots.containsKey(name)) {
+         int slot = slots.get(name);
+         type = types[slot];
+         return slot;
+      }
+   }
+   unique_lock<shared_mutex> guard(lock);
+   if (slots.containsKey(name)) {
+      int slot = slots.get(name);
+      type = types[slot];
+      return slot;
+   }
+   int slot = names.size();
+   slots.put(name, slot);
+   names.add(name);
+   types.add(INTEGER_TYPE);
+   widenings.add(0);
+   type = INTEGER_TYPE;
+   return slot;
+}
+
+int SymbolTable::lookup(const string & name) {
+   shared_lock<shared_mutex> guard(lock);
+   if (slots.containsKey(name)) return slots.get(name);
+   return -1;
+}
+
+string SymbolTable::getName(int slot) {
+   shared_lock<shared_mutex> guard(lock);
+   return names[slot];
+}
+
+int SymbolTable::size() {
+   shared_lock<shared_mutex> guard(lock);
+   return names.size();
+}
+
+ValueType SymbolTable::getType(int slot) {
+   shared_lock<shared_mutex> guard(lock);
+   return types[slot];
+}
+
+ValueType SymbolTable::widenType(int slot, ValueType type) {
+   {
+      shared_lock<shared_mutex> guard(lock);
+      if (types[slot] >= type) return types[slot];
+   }
+   unique_lock<shared_mutex> guard(lock);
+   if (types[slot] < type) {
+      types[slot] = type;
+      typeGeneration++;
+      widenings[slot] = typeGeneration;
+   }
+   return types[slot];
+}
+
+void SymbolTable::resetTypes() {
+   unique_lock<shared_mutex> guard(lock);
+   for (int slot = 0; slot < types.size(); slot++) {
+      types[slot] = INTEGER_TYPE;
+   }
+   typeGeneration++;
+}
+
+int SymbolTable::getTypeGeneration() {
+   shared_lock<shared_mutex> guard(lock);
+   return typeGeneration;
+}
+
+int SymbolTable::getWidening(int slot) {
+   shared_lock<shared_mutex> guard(lock);
+   return widenings[slot];
+}
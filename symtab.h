@@ -0,0 +1,168 @@
+/*
+ * File: symtab.h
+ * --------------
+ * This interface exports a SymbolTable class, which assigns each
+ * variable name used by a program a small integer called its slot.
+ * Names are interned once, when the statements that mention them are
+ * parsed, so that evaluation can index a flat array of values instead
+ * of looking names up by string.  The table also records the static
+ * type of each variable.
+ */
+
+#ifndef _symtab_h
+#define _symtab_h
+
+#include <shared_mutex>
+#include <string>
+#include "hashmap.h"
+#include "value.h"
+#include "vector.h"
+
+/*
+ * Class: SymbolTable
+ * ------------------
+ * This class maps variable names to slots and back.  Slots are
+ * numbered consecutively from zero in the order in which names are
+ * first interned, and a name keeps its slot for the lifetime of the
+ * table.  Each slot has a type, which starts as INTEGER_TYPE and
+ * widens as soon as any statement parsed against the table assigns a
+ * double to it.  Statements typed at the console and lines since
+ * deleted widen the table too, so Program::link works the types out
+ * again from the program's current lines, and the doubles a run starts
+ * with, whenever they may have changed, starting from resetTypes.
+ */
+
+class SymbolTable {
+
+public:
+
+/*
+ * Constructor: SymbolTable
+ * Usage: SymbolTable symbols;
+ * ---------------------------
+ * Creates an empty symbol table.
+ */
+
+   SymbolTable();
+
+/*
+ * Destructor: ~SymbolTable
+ * Usage: usually implicit
+ * -----------------------
+ * Frees all heap storage associated with this object.
+ */
+
+   ~SymbolTable();
+
+/*
+ * Method: intern
+ * Usage: int slot = symbols.intern(name);
+ *        int slot = symbols.intern(name, type);
+ * ---------------------------------------------
+ * Returns the slot for the specified name, assigning the next free
+ * slot if the name has not been seen before.  The second form also
+ * sets type to the type of the variable, as getType would, without a
+ * second trip through the lock.  Several threads may intern names in
+ * the same table at once, as happens when a program file is parsed in
+ * parallel.
+ */
+
+   int intern(const std::string & name);
+   int intern(const std::string & name, ValueType & type);
+
+/*
+ * Method: lookup
+ * Usage: int slot = symbols.lookup(name);
+ * ---------------------------------------
+ * Returns the slot for the specified name, or -1 if the name has
+ * never been interned.
+ */
+
+   int lookup(const std::string & name);
+
+/*
+ * Method: getName
+ * Usage: string name = symbols.getName(slot);
+ * -------------------------------------------
+ * Returns the name that was assigned the specified slot.
+ */
+
+   std::string getName(int slot);
+
+/*
+ * Method: size
+ * Usage: int count = symbols.size();
+ * ----------------------------------
+ * Returns the number of slots assigned so far.
+ */
+
+   int size();
+
+/*
+ * Method: getType
+ * Usage: ValueType type = symbols.getType(slot);
+ * ----------------------------------------------
+ * Returns the static type of the variable in the specified slot.
+ */
+
+   ValueType getType(int slot);
+
+/*
+ * Method: widenType
+ * Usage: ValueType newType = symbols.widenType(slot, type);
+ * ---------------------------------------------------------
+ * Widens the type of the variable in the specified slot to hold values
+ * of the specified type, if it does not already, and returns the type
+ * the variable has afterwards.  Statements parsed before the change
+ * keep the old type until the program is linked again, which brings
+ * them up to date.
+ */
+
+   ValueType widenType(int slot, ValueType type);
+
+/*
+ * Method: resetTypes
+ * Usage: symbols.resetTypes();
+ * ----------------------------
+ * Returns every variable to INTEGER_TYPE, as when the program that
+ * widened them is cleared or its types are worked out again.
+ */
+
+   void resetTypes();
+
+/*
+ * Method: getTypeGeneration
+ * Usage: int generation = symbols.getTypeGeneration();
+ * ----------------------------------------------------
+ * Returns a number that changes whenever the type of a slot widens,
+ * so that the program can tell whether its statements need retyping.
+ */
+
+   int getTypeGeneration();
+
+/*
+ * Method: getWidening
+ * Usage: int when = symbols.getWidening(slot);
+ * --------------------------------------------
+ * Returns the type generation at which the variable in the specified
+ * slot became DOUBLE_TYPE, which orders the variables by when they
+ * widened.  A statement that widened a variable read only variables
+ * that had widened before it, which is how the program tells the
+ * statements a type depends on from those that merely agree with it.
+ * The result is meaningless for an INTEGER_TYPE variable.
+ */
+
+   int getWidening(int slot);
+
+private:
+
+   HashMap<std::string,int> slots;
+   Vector<std::string> names;
+   Vector<ValueType> types;
+   Vector<int> widenings;
+   int typeGeneration;
+   std::shared_mutex lock;
+
+};
+
+#endif
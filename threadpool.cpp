@@ -0,0 +1,135 @@
+/*
+ * File: threadpool.cpp
+ * --------------------
+ * This file implements the ThreadPool class.
+ */
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "threadpool.h"
+using namespace std;
+
+ThreadPool::ThreadPool(int threadCount) {
+   if (threadCount <= 0) threadCount = thread::hardware_concurrency();
+   if (threadCount <= 0) threadCount = 1;
+   currentJob = NULL;
+   generation = 0;
+   remaining = 0;
+   active = 0;
+   stopping = false;
+   for (int i = 0; i < threadCount; i++) {
+      queues.push_back(unique_ptr<WorkQueue>(new WorkQueue));
+   }
+   for (int i = 0; i < threadCount; i++) {
+      workers.push_back(thread(&ThreadPool::workerLoop, this, i));
+   }
+}
+
+ThreadPool::~ThreadPool() {
+   {
+      lock_guard<mutex> guard(lock);
+      stopping = true;
+   }
+   wakeup.notify_all();
+   for (thread & worker : workers) {
+      worker.join();
+   }
+}
+
+int ThreadPool::getThreadCount() {
+   return workers.size();
+}
+
+/*
+ * Implementation notes: run
+ * -------------------------
+ * The queues are filled before the generation changes, so a worker
+ * that wakes up finds all of its jobs in place.  The run is over when
+ * every job has completed and every worker that joined it has left,
+ * which guarantees that no worker still holds the job function when
+ * run returns.
+ */
+
+void ThreadPool::run(int jobCount, const function<void(int)> & job) {
+   if (jobCount <= 0) return;
+   int threadCount = queues.size();
+   for (int i = 0; i < threadCount; i++) {
+      WorkQueue & queue = *queues[i];
+      lock_guard<mutex> guard(queue.lock);
+      int end = (int) ((long long) jobCount * (i + 1) / threadCount);
+      for (int j = (int) ((long long) jobCount * i / threadCount); j < end; j++) {
+         queue.jobs.push_back(j);
+      }
+   }
+   unique_lock<mutex> guard(lock);
+   currentJob = &job;
+   remaining = jobCount;
+   generation++;
+   wakeup.notify_all();
+   finished.wait(guard, [this] { return remaining == 0 && active == 0; });
+   currentJob = NULL;
+}
+
+/*
+ * Implementation notes: workerLoop
+ * --------------------------------
+ * A worker that wakes after the run it was signaled for has already
+ * finished sees currentJob as NULL and goes back to sleep.
+ */
+
+void ThreadPool::workerLoop(int index) {
+   long seen = 0;
+   while (true) {
+      const function<void(int)> *job;
+      {
+         unique_lock<mutex> guard(lock);
+         wakeup.wait(guard, [this, seen] { return stopping || generation != seen; });
+         if (stopping) return;
+         seen = generation;
+         job = currentJob;
+         if (job == NULL) continue;
+         active++;
+      }
+      int jobIndex;
+      int completed = 0;
+      while (nextJob(index, jobIndex)) {
+         (*job)(jobIndex);
+         completed++;
+      }
+      {
+         lock_guard<mutex> guard(lock);
+         remaining -= completed;
+         active--;
+      }
+      finished.notify_all();
+   }
+}
+
+/*
+ * Implementation notes: nextJob
+ * -----------------------------
+ * The worker's own queue is used from the back, so that a thief taking
+ * from the front rarely contends with the owner.  Victims are tried in
+ * order starting from the next worker.
+ */
+
+bool ThreadPool::nextJob(int index, int & job) {
+   int threadCount = queues.size();
+   for (int i = 0; i < threadCount; i++) {
+      WorkQueue & queue = *queues[(index + i) % threadCount];
+      lock_guard<mutex> guard(queue.lock);
+      if (!queue.jobs.empty()) {
+         if (i == 0) {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+         } else {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+         }
+         return true;
+      }
+   }
+   return false;
+}
@@ -0,0 +1,112 @@
+/*
+ * File: threadpool.h
+ * ------------------
+ * This interface exports a ThreadPool class that runs a numbered set
+ * of independent jobs on a fixed group of worker threads.
+ */
+
+#ifndef _threadpool_h
+#define _threadpool_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Class: ThreadPool
+ * -----------------
+ * This class keeps its worker threads for its whole lifetime.  Each
+ * call to run divides the jobs into one contiguous range per worker.
+ * A worker takes jobs from the back of its own queue and, once that
+ * is empty, steals from the front of another worker's queue, so the
+ * load evens out even when some jobs take much longer than others.
+ */
+
+class ThreadPool {
+
+public:
+
+/*
+ * Constructor: ThreadPool
+ * Usage: ThreadPool pool;
+ *        ThreadPool pool(threadCount);
+ * ------------------------------------
+ * Starts the worker threads.  The count defaults to the number of
+ * hardware threads.
+ */
+
+   ThreadPool(int threadCount = 0);
+
+/*
+ * Destructor: ~ThreadPool
+ * Usage: usually implicit
+ * -----------------------
+ * Stops and joins the worker threads.
+ */
+
+   ~ThreadPool();
+
+/*
+ * Method: run
+ * Usage: pool.run(jobCount, job);
+ * -------------------------------
+ * Calls job(i) for every i from 0 to jobCount - 1, spread across the
+ * workers, and returns when every call has returned.  The calls may
+ * happen in any order and at the same time, so the job function must
+ * not modify shared state without synchronization, and it must not
+ * throw.  Only one thread may call run at a time.
+ */
+
+   void run(int jobCount, const std::function<void(int)> & job);
+
+/*
+ * Method: getThreadCount
+ * Usage: int count = pool.getThreadCount();
+ * -----------------------------------------
+ * Returns the number of worker threads.
+ */
+
+   int getThreadCount();
+
+private:
+
+/*
+ * Type: WorkQueue
+ * ---------------
+ * This structure holds the job numbers waiting for one worker.  Its
+ * lock is held only long enough to take one job.
+ */
+
+   struct WorkQueue {
+      std::mutex lock;
+      std::deque<int> jobs;
+   };
+
+   void workerLoop(int index);
+   bool nextJob(int index, int & job);
+
+/* Instance variables */
+
+   std::vector<std::thread> workers;
+   std::vector<std::unique_ptr<WorkQueue>> queues;
+   std::mutex lock;                            /* Guards the fields below   */
+   std::condition_variable wakeup;             /* Signals a new run or stop */
+   std::condition_variable finished;           /* Signals the end of a run  */
+   const std::function<void(int)> *currentJob; /* The job of the run, or NULL */
+   long generation;                            /* Counts calls to run       */
+   int remaining;                              /* Jobs not yet completed    */
+   int active;                                 /* Workers inside this run   */
+   bool stopping;                              /* Set by the destructor     */
+
+/* Pools cannot be copied, since the copies would share the threads */
+
+   ThreadPool(const ThreadPool & src) = delete;
+   ThreadPool & operator=(const ThreadPool & src) = delete;
+
+};
+
+#endif
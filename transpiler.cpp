@@ -0,0 +1,766 @@
+/*
+ * File: transpiler.cpp
+ * --------------------
+ * This file implements the translation of a program to C++ and the
+ * NativeProgram class, which builds, caches and loads the result.
+ */
+
+#include <dlfcn.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "array.h"
+#include "error.h"
+#include "evalstate.h"
+#include "exp.h"
+#include "program.h"
+#include "statement.h"
+#include "strlib.h"
+#include "transpiler.h"
+#include "value.h"
+using namespace std;
+
+/* Constants */
+
+const string CACHE_SUBDIRECTORY = "/.cache/basic";
+const string COMPILER_FLAGS = "-O2 -fwrapv -shared -fPIC";
+
+/*
+ * Constant: PRELUDE
+ * -----------------
+ * This text begins every translation.  It declares the layout of an
+ * EvalState::Binding and of NativeProgram::Runtime, the helpers that
+ * read a variable as the interpreter does, testing its type, and the
+ * helpers that reproduce the interpreter's shifts.  Arrays stay inside
+ * the EvalState, so the translation reaches them through the runtime.
+ * The version of the interface is thus part of every translation, and
+ * of the hash under which its object is cached.
+ */
+
+const char *const PRELUDE =
+   "enum ValueType { UNDEFINED_TYPE, INTEGER_TYPE, DOUBLE_TYPE };\n"
+   "\n"
+   "struct Binding {\n"
+   "   union {\n"
+   "      long long integer;\n"
+   "      double real;\n"
+   "   } value;\n"
+   "   ValueType type;\n"
+   "};\n"
+   "\n"
+   "struct Runtime {\n"
+   "   void *context;\n"
+   "   void (*print)(void *context, long long value);\n"
+   "   void (*printDouble)(void *context, double value);\n"
+   "   long long (*input)(void *context);\n"
+   "   double (*inputDouble)(void *context);\n"
+   "   long long (*toInteger)(double value);\n"
+   "   void (*fail)(const char *message);\n"
+   "   long long *(*element)(void *context, int slot, const char *key, int rank,\n"
+   "                         long long row, long long column);\n"
+   "   void (*dimension)(void *context, int slot, const char *key, int rank,\n"
+   "                     long long rows, long long columns);\n"
+   "   long long (*sum)(void *context, int slot, const char *key);\n"
+   "   void (*mat)(void *context, int op, int target, int lhs, int rhs, long long scalar,\n"
+   "               const char *targetKey, const char *lhsKey, const char *rhsKey);\n"
+   "   long long fuel;\n"
+   "   long long (*refuel)(void *context, long long fuel);\n"
+   "   const int *slots;\n"
+   "};\n"
+   "\n"
+   "[[noreturn]] static void fail(const Runtime *runtime, const char *message) {\n"
+   "   runtime->fail(message);\n"
+   "   __builtin_unreachable();\n"
+   "}\n"
+   "\n"
+   "static inline long long loadInteger(const Runtime *runtime, const Binding *var,\n"
+   "                                    const char *message) {\n"
+   "   if (var->type == INTEGER_TYPE) return var->value.integer;\n"
+   "   if (var->type == UNDEFINED_TYPE) fail(runtime, message);\n"
+   "   return runtime->toInteger(var->value.real);\n"
+   "}\n"
+   "\n"
+   "static inline double loadDouble(const Runtime *runtime, const Binding *var,\n"
+   "                                const char *message) {\n"
+   "   if (var->type == DOUBLE_TYPE) return var->value.real;\n"
+   "   if (var->type == UNDEFINED_TYPE) fail(runtime, message);\n"
+   "   return (double) var->value.integer;\n"
+   "}\n"
+   "\n"
+   "static inline long long shiftLeft(long long value, int k) {\n"
+   "   return (long long) ((unsigned long long) value << k);\n"
+   "}\n"
+   "\n"
+   "static inline long long shiftRightTowardZero(long long value, int k) {\n"
+   "   return (value + ((value >> 63) & ((1LL << k) - 1))) >> k;\n"
+   "}\n"
+   "\n"
+   "static inline long long divideIntegers(long long dividend, long long divisor) {\n"
+   "   if ((((unsigned long long) dividend | (unsigned long long) divisor) >> 31) == 0) {\n"
+   "      return (unsigned) dividend / (unsigned) divisor;\n"
+   "   }\n"
+   "   if (divisor == -1) return (long long) (0 - (unsigned long long) dividend);\n"
+   "   return dividend / divisor;\n"
+   "}\n"
+   "\n";
+
+/* Private function prototypes */
+
+static string hashText(const string & text);
+static string getCacheDirectory();
+static void makeDirectory(const string & path);
+static bool isPrivateDirectory(const string & path);
+static bool fileExists(const string & path);
+
+/*
+ * Implementation notes: ProgramTranslator
+ * ---------------------------------------
+ * The translator makes one pass over the linked program to find the
+ * lines that are jump targets, which are the only ones given labels,
+ * and a second pass to write the code.  Each statement is a block of
+ * its own, so its temporaries go out of scope before the next label
+ * and a goto never jumps past an initialization.  Undefined variables
+ * are tested on every read, as the interpreter does; the C++ compiler
+ * removes the tests it can prove redundant.  Every temporary has the
+ * type of the expression it holds, long long or double, and a value
+ * used as the other type is converted where it is used.
+ *
+ * A jump to the same or an earlier line first charges the governor's
+ * fuel, held in a local variable, for the lines from its target through
+ * the jump, as the virtual machine charges for a loop.  Without limits
+ * the fuel never runs out, so the charge is a subtraction and a branch
+ * that is never taken.
+ *
+ * Variables and arrays are numbered locally, in the order the lines
+ * use them, so that the same program always has the same translation.
+ * The body is written to a buffer first, since the references that
+ * bind each local number to its slot must precede it.  The compiler
+ * keeps the address of each variable as it kept the constant offsets
+ * of the global slots before.
+ */
+
+class ProgramTranslator {
+
+public:
+
+   ProgramTranslator(ostream & out, vector<int> & slots);
+   void translate(Program & program);
+
+private:
+
+   void translateStatement(Program::SourceLine *line);
+   string translateCharge(Program::SourceLine *line, const string & indent);
+   string translateExp(Expression *exp);
+   string translateExpAs(Expression *exp, ValueType type);
+   string translateElement(ElementExp *element);
+   void translateStore(int slot, ValueType type, const string & value);
+   string newTemporary(ValueType type);
+   string label(int lineNumber);
+   string literal(long long value);
+   string doubleLiteral(double value);
+   string var(int slot);
+   string arraySlot(int slot);
+   int local(int slot);
+   string key(const string & name);
+   string arrayKey(int slot);
+
+   ostream & out;
+   ostringstream os;
+   vector<int> & slots;
+   map<int,int> locals;
+   set<int> variables;
+   vector<string> names;
+   set<int> targets;
+   map<int,int> ordinals;
+   int temporaryCount;
+
+};
+
+ProgramTranslator::ProgramTranslator(ostream & out, vector<int> & slots)
+   : out(out), slots(slots) {
+   temporaryCount = 0;
+}
+
+void ProgramTranslator::translate(Program & program) {
+   Program::SourceLine *first = program.link();
+   SymbolTable & symbols = program.getSymbolTable();
+   for (int slot = 0; slot < symbols.size(); slot++) {
+      names.push_back(symbols.getName(slot));
+   }
+   for (Program::SourceLine *line = first; line != NULL; line = line->next) {
+      if (line->target != NULL) targets.insert(line->target->lineNumber);
+      int ordinal = ordinals.size();
+      ordinals[line->lineNumber] = ordinal;
+   }
+   slots.clear();
+   for (Program::SourceLine *line = first; line != NULL; line = line->next) {
+      if (targets.count(line->lineNumber) != 0) os << label(line->lineNumber) << ":" << endl;
+      os << "   {" << endl;
+      temporaryCount = 0;
+      translateStatement(line);
+      os << "   }" << endl;
+   }
+   out << PRELUDE;
+   out << "extern \"C\" void basic_main(const Runtime *runtime, Binding *vars) {" << endl;
+   out << "   const int *slots = runtime->slots;" << endl;
+   for (int index : variables) {
+      out << "   Binding & v" << index << " = vars[slots[" << index << "]];" << endl;
+   }
+   out << "   long long fuel = runtime->fuel;" << endl;
+   out << os.str();
+   out << "}" << endl;
+}
+
+void ProgramTranslator::translateStatement(Program::SourceLine *line) {
+   Statement *stmt = line->lineParsed;
+   switch (stmt->getType()) {
+    case REM_STMT:
+      break;
+    case LET_STMT: {
+      LetStmt *let = (LetStmt *) stmt;
+      string value = translateExpAs(let->getExp(), let->getValueType());
+      translateStore(let->getSlot(), let->getValueType(), value);
+      break;
+    }
+    case PRINT_STMT: {
+      Expression *exp = ((PrintStmt *) stmt)->getExp();
+      string value = translateExp(exp);
+      string function = (exp->getValueType() == DOUBLE_TYPE) ? "printDouble" : "print";
+      os << "      runtime->" << function << "(runtime->context, " << value << ");" << endl;
+      break;
+    }
+    case INPUT_STMT: {
+      InputStmt *input = (InputStmt *) stmt;
+      string function = (input->getValueType() == DOUBLE_TYPE) ? "inputDouble" : "input";
+      translateStore(input->getSlot(), input->getValueType(),
+                     "runtime->" + function + "(runtime->context)");
+      break;
+    }
+    case GOTO_STMT:
+      os << translateCharge(line, "      ");
+      os << "      goto " << label(line->target->lineNumber) << ";" << endl;
+      break;
+    case IF_STMT: {
+      IfStmt *ifStmt = (IfStmt *) stmt;
+      string lhs = translateExpAs(ifStmt->getLHS(), ifStmt->getValueType());
+      string rhs = translateExpAs(ifStmt->getRHS(), ifStmt->getValueType());
+      string relation = relationToString(ifStmt->getRelation());
+      if (relation == "=") relation = "==";
+      else if (relation == "<>") relation = "!=";
+      os << "      if (" << lhs << " " << relation << " " << rhs << ") {" << endl;
+      os << translateCharge(line, "         ");
+      os << "         goto " << label(line->target->lineNumber) << ";" << endl;
+      os << "      }" << endl;
+      break;
+    }
+    case END_STMT:
+      os << "      return;" << endl;
+      break;
+    case DIM_STMT: {
+      ElementExp *declarator = ((DimStmt *) stmt)->getDeclarator();
+      string rows = translateExpAs(declarator->getRow(), INTEGER_TYPE);
+      string columns = "1";
+      if (declarator->getColumn() != NULL) {
+         columns = translateExpAs(declarator->getColumn(), INTEGER_TYPE);
+      }
+      os << "      runtime->dimension(runtime->context, " << arraySlot(declarator->getSlot())
+         << ", " << key(declarator->getKey()) << ", " << declarator->getRank() << ", " << rows
+         << ", " << columns << ");" << endl;
+      break;
+    }
+    case LET_ELEMENT_STMT: {
+      LetElementStmt *let = (LetElementStmt *) stmt;
+      string location = translateElement(let->getElement());
+      string value = translateExpAs(let->getExp(), INTEGER_TYPE);
+      os << "      *" << location << " = " << value << ";" << endl;
+      break;
+    }
+    case MAT_STMT: {
+      MatStmt *mat = (MatStmt *) stmt;
+      string scalar = "0";
+      if (mat->getScalar() != NULL) scalar = translateExpAs(mat->getScalar(), INTEGER_TYPE);
+      os << "      runtime->mat(runtime->context, " << mat->getOperation() << ", "
+         << arraySlot(mat->getTargetSlot()) << ", " << arraySlot(mat->getLHSSlot()) << ", "
+         << arraySlot(mat->getRHSSlot()) << ", " << scalar << ", "
+         << arrayKey(mat->getTargetSlot()) << ", " << arrayKey(mat->getLHSSlot()) << ", "
+         << arrayKey(mat->getRHSSlot()) << ");" << endl;
+      break;
+    }
+   }
+}
+
+/*
+ * Implementation notes: translateElement
+ * --------------------------------------
+ * Evaluates the subscripts of an element and returns a call that
+ * locates it.  The call is left to the caller, so that an assignment
+ * can evaluate its value first, as the interpreter does.
+ */
+
+string ProgramTranslator::translateElement(ElementExp *element) {
+   string row = translateExpAs(element->getRow(), INTEGER_TYPE);
+   string column = "1";
+   if (element->getColumn() != NULL) column = translateExpAs(element->getColumn(), INTEGER_TYPE);
+   return "runtime->element(runtime->context, " + arraySlot(element->getSlot()) + ", "
+        + key(element->getKey()) + ", " + integerToString(element->getRank()) + ", " + row
+        + ", " + column + ")";
+}
+
+/*
+ * Implementation notes: translateExp
+ * ----------------------------------
+ * Writes the code that evaluates the expression and returns a C++
+ * expression for its value, which is either a literal or the name of
+ * a temporary.  Operands are evaluated into temporaries before the
+ * operation, because C++ leaves the order of evaluation of the
+ * operands of + unspecified and an assignment inside an expression
+ * can make the order visible.
+ */
+
+string ProgramTranslator::translateExp(Expression *exp) {
+   switch (exp->getType()) {
+    case CONSTANT:
+      return literal(((ConstantExp *) exp)->getValue());
+    case DOUBLE_CONSTANT:
+      return doubleLiteral(((DoubleConstantExp *) exp)->getValue());
+    case IDENTIFIER: {
+      IdentifierExp *id = (IdentifierExp *) exp;
+      ValueType type = id->getValueType();
+      string temp = newTemporary(type);
+      os << " = " << ((type == DOUBLE_TYPE) ? "loadDouble" : "loadInteger") << "(runtime, &"
+         << var(id->getSlot()) << ", \"" << id->getName() << " is undefined\");" << endl;
+      return temp;
+    }
+    case ELEMENT: {
+      string location = translateElement((ElementExp *) exp);
+      string temp = newTemporary(INTEGER_TYPE);
+      os << " = *" << location << ";" << endl;
+      return temp;
+    }
+    case SUM: {
+      SumExp *sum = (SumExp *) exp;
+      string temp = newTemporary(INTEGER_TYPE);
+      os << " = runtime->sum(runtime->context, " << arraySlot(sum->getSlot()) << ", "
+         << key(sum->getKey()) << ");" << endl;
+      return temp;
+    }
+    case COMPOUND:
+      break;
+   }
+   CompoundExp *compound = (CompoundExp *) exp;
+   Operator op = compound->getOperator();
+   if (op == ASSIGN_OP) {
+      if (compound->getLHS()->getType() != IDENTIFIER) {
+         os << "      fail(runtime, \"Illegal variable in assignment\");" << endl;
+         return "0";
+      }
+      IdentifierExp *id = (IdentifierExp *) compound->getLHS();
+      string value = translateExpAs(compound->getRHS(), id->getValueType());
+      translateStore(id->getSlot(), id->getValueType(), value);
+      return value;
+   }
+   ValueType type = compound->getValueType();
+   string lhs = translateExpAs(compound->getLHS(), type);
+   string rhs = translateExpAs(compound->getRHS(), type);
+   string result;
+   switch (op) {
+    case ADD_OP: result = lhs + " + " + rhs; break;
+    case SUB_OP: result = lhs + " - " + rhs; break;
+    case MUL_OP: result = lhs + " * " + rhs; break;
+    case DIV_OP:
+      os << "      if (" << rhs << " == 0) fail(runtime, \"Division by zero\");" << endl;
+      if (type == INTEGER_TYPE) {
+         result = "divideIntegers(" + lhs + ", " + rhs + ")";
+      } else {
+         result = lhs + " / " + rhs;
+      }
+      break;
+    case SHL_OP: result = "shiftLeft(" + lhs + ", " + rhs + ")"; break;
+    case SHR_OP: result = "shiftRightTowardZero(" + lhs + ", " + rhs + ")"; break;
+    default:
+      os << "      fail(runtime, \"Illegal operator in expression\");" << endl;
+      return "0";
+   }
+   string temp = newTemporary(type);
+   os << " = " << result << ";" << endl;
+   return temp;
+}
+
+/*
+ * Implementation notes: translateExpAs
+ * ------------------------------------
+ * A double becomes an integer through the runtime, which reports a
+ * value out of range as the interpreter does.
+ */
+
+string ProgramTranslator::translateExpAs(Expression *exp, ValueType type) {
+   string value = translateExp(exp);
+   if (exp->getValueType() == type) return value;
+   if (type == DOUBLE_TYPE) return "(double) " + value;
+   return "runtime->toInteger(" + value + ")";
+}
+
+void ProgramTranslator::translateStore(int slot, ValueType type, const string & value) {
+   bool isDouble = type == DOUBLE_TYPE;
+   os << "      " << var(slot) << ".value." << (isDouble ? "real" : "integer") << " = "
+      << value << ";" << endl;
+   os << "      " << var(slot) << ".type = " << (isDouble ? "DOUBLE_TYPE" : "INTEGER_TYPE")
+      << ";" << endl;
+}
+
+/*
+ * Implementation notes: newTemporary
+ * ----------------------------------
+ * Starts the declaration of a new temporary of the specified type and
+ * returns its name; the caller writes the initializer.
+ */
+
+string ProgramTranslator::newTemporary(ValueType type) {
+   string name = "t" + integerToString(temporaryCount++);
+   os << "      " << ((type == DOUBLE_TYPE) ? "double " : "long long ") << name;
+   return name;
+}
+
+string ProgramTranslator::label(int lineNumber) {
+   return "line_" + integerToString(lineNumber);
+}
+
+/*
+ * Implementation notes: literal
+ * -----------------------------
+ * Folded constants can be negative, and LLONG_MIN has no literal of
+ * its own in C++.  Doubles are written in hexadecimal, which keeps
+ * every bit of the value; infinities and NaNs, which folding can
+ * produce, have no literal at all.
+ */
+
+string ProgramTranslator::literal(long long value) {
+   if (value == LLONG_MIN) return "(-9223372036854775807LL - 1)";
+   if (value < 0) return "(" + to_string(value) + "LL)";
+   return to_string(value) + "LL";
+}
+
+string ProgramTranslator::doubleLiteral(double value) {
+   if (std::isnan(value)) return "__builtin_nan(\"\")";
+   if (std::isinf(value)) return (value < 0) ? "(-__builtin_inf())" : "__builtin_inf()";
+   char buffer[MAX_DOUBLE_LENGTH];
+   snprintf(buffer, sizeof buffer, "%a", value);
+   return (value < 0) ? "(" + string(buffer) + ")" : string(buffer);
+}
+
+string ProgramTranslator::var(int slot) {
+   int index = local(slot);
+   variables.insert(index);
+   return "v" + integerToString(index);
+}
+
+/*
+ * Implementation notes: arraySlot, local
+ * --------------------------------------
+ * An array is passed to the runtime by the slot the local number maps
+ * to.  An operand that a MAT operation does not use keeps slot -1.
+ */
+
+string ProgramTranslator::arraySlot(int slot) {
+   if (slot == -1) return "-1";
+   return "slots[" + integerToString(local(slot)) + "]";
+}
+
+int ProgramTranslator::local(int slot) {
+   auto found = locals.find(slot);
+   if (found != locals.end()) return found->second;
+   int index = slots.size();
+   locals[slot] = index;
+   slots.push_back(slot);
+   return index;
+}
+
+/*
+ * Implementation notes: key, arrayKey
+ * -----------------------------------
+ * Array keys are names followed by "()", which need no escaping in a
+ * string literal.  An operand that a MAT operation does not use has
+ * slot -1 and becomes a null pointer.
+ */
+
+string ProgramTranslator::key(const string & name) {
+   return "\"" + name + "\"";
+}
+
+string ProgramTranslator::arrayKey(int slot) {
+   return (slot == -1) ? "0" : key(names[slot]);
+}
+
+string ProgramTranslator::translateCharge(Program::SourceLine *line, const string & indent) {
+   if (line->target->lineNumber > line->lineNumber) return "";
+   int cost = ordinals[line->lineNumber] - ordinals[line->target->lineNumber] + 1;
+   return indent + "if ((fuel -= " + integerToString(cost)
+        + ") < 0) fuel = runtime->refuel(runtime->context, fuel);\n";
+}
+
+void translateProgram(Program & program, ostream & os, vector<int> & slots) {
+   ProgramTranslator translator(os, slots);
+   translator.translate(program);
+}
+
+/*
+ * Implementation notes: NativeProgram
+ * -----------------------------------
+ * The object is built under a temporary name and renamed into place,
+ * so another interpreter sharing the cache never loads a partly
+ * written file.  The compiler's messages are kept in a .log file next
+ * to the source for when the build fails.  Within one process, as in
+ * the session server, builds take turns, so that two threads compiling
+ * the same program never write its source file at the same time.
+ * The hash covers the compiler and its flags as well as the source, so
+ * changing either builds a new object rather than loading a stale one.
+ */
+
+NativeProgram::NativeProgram(Program & program) {
+   ostringstream source;
+   translateProgram(program, source, slots);
+   slotCount = program.getSymbolTable().size();
+   const char *compiler = getenv("CXX");
+   string build = string((compiler == NULL) ? "c++" : compiler) + " " + COMPILER_FLAGS;
+   string directory = getCacheDirectory();
+   string base = directory + "/" + hashText(build + "\n" + source.str());
+   objectPath = base + ".so";
+   static mutex buildLock;
+   unique_lock<mutex> guard(buildLock);
+   if (!fileExists(objectPath)) {
+      string sourcePath = base + ".cpp";
+      string logPath = base + ".log";
+      string tempPath = base + ".so.tmp" + integerToString(getpid());
+      ofstream sourceFile(sourcePath.c_str());
+      sourceFile << source.str();
+      sourceFile.close();
+      if (sourceFile.fail()) error("Cannot write " + sourcePath);
+      string command = build + " -o '" + tempPath + "' '" + sourcePath + "' 2> '" + logPath + "'";
+      if (system(command.c_str()) != 0) {
+         remove(tempPath.c_str());
+         error("C++ compilation failed; see " + logPath);
+      }
+      if (rename(tempPath.c_str(), objectPath.c_str()) != 0) {
+         remove(tempPath.c_str());
+         error("Cannot write " + objectPath);
+      }
+   }
+   guard.unlock();
+   handle = dlopen(objectPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+   if (handle == NULL) error(string("Cannot load compiled program: ") + dlerror());
+   mainFunction = (MainFunction) dlsym(handle, "basic_main");
+   if (mainFunction == NULL) {
+      dlclose(handle);
+      error("Compiled program has no basic_main");
+   }
+}
+
+NativeProgram::~NativeProgram() {
+   dlclose(handle);
+}
+
+void NativeProgram::run(EvalState & state) {
+   if (state.getCheckpointer().getFilename() != "") error("COMPILE cannot take checkpoints");
+   Runtime runtime;
+   runtime.context = &state;
+   runtime.print = printValue;
+   runtime.printDouble = printDouble;
+   runtime.input = readValue;
+   runtime.inputDouble = readDouble;
+   runtime.toInteger = doubleToInteger;
+   runtime.fail = fail;
+   runtime.element = locateElement;
+   runtime.dimension = dimensionArray;
+   runtime.sum = sumElements;
+   runtime.mat = executeMatOperation;
+   runtime.refuel = refuel;
+   runtime.slots = slots.data();
+   state.startRun();
+   runtime.fuel = *state.getGovernor().getFuel();
+   state.reserveSlots(slotCount);
+   mainFunction(&runtime, state.getBindings());
+   state.setCurrentLine(-1);
+}
+
+string NativeProgram::getObjectPath() {
+   return objectPath;
+}
+
+void NativeProgram::printValue(void *context, long long value) {
+   ((EvalState *) context)->getOutput().printInteger(value);
+}
+
+void NativeProgram::printDouble(void *context, double value) {
+   ((EvalState *) context)->getOutput().printDouble(value);
+}
+
+void NativeProgram::fail(const char *message) {
+   error(message);
+}
+
+long long NativeProgram::readValue(void *context) {
+   EvalState *state = (EvalState *) context;
+   if (state->getInput().isInteractive()) state->getOutput().flush();
+   return state->getInput().readInteger();
+}
+
+double NativeProgram::readDouble(void *context) {
+   EvalState *state = (EvalState *) context;
+   if (state->getInput().isInteractive()) state->getOutput().flush();
+   return state->getInput().readDouble();
+}
+
+/*
+ * Implementation notes: array services
+ * ------------------------------------
+ * Every slot of the program is reserved before basic_main is called,
+ * so these functions never move the state's table of arrays.
+ */
+
+long long *NativeProgram::locateElement(void *context, int slot, const char *key, int rank,
+                                        long long row, long long column) {
+   Array & array = ((EvalState *) context)->getArray(slot);
+   long long *element = array.getElement(rank, row, column);
+   if (element == NULL) array.reportElementError(key, rank, row, column);
+   return element;
+}
+
+void NativeProgram::dimensionArray(void *context, int slot, const char *key, int rank,
+                                   long long rows, long long columns) {
+   ((EvalState *) context)->dimensionArray(slot, key, rank, rows, columns);
+}
+
+long long NativeProgram::sumElements(void *context, int slot, const char *key) {
+   EvalState *state = (EvalState *) context;
+   Array & array = state->getArray(slot);
+   long long sum = sumArray(array, key);
+   state->getGovernor().chargeElements(array.getSize());
+   return sum;
+}
+
+void NativeProgram::executeMatOperation(void *context, int op, int target, int lhs, int rhs,
+                                        long long scalar, const char *targetKey,
+                                        const char *lhsKey, const char *rhsKey) {
+   EvalState *state = (EvalState *) context;
+   long long elements = executeMat((MatOperation) op, state->getArray(target),
+                                   (lhs == -1) ? NULL : &state->getArray(lhs),
+                                   (rhs == -1) ? NULL : &state->getArray(rhs), scalar,
+                                   targetKey, lhsKey, rhsKey);
+   state->checkMemory();
+   state->getGovernor().chargeElements(elements);
+}
+
+long long NativeProgram::refuel(void *context, long long fuel) {
+   Governor & governor = ((EvalState *) context)->getGovernor();
+   *governor.getFuel() = fuel;
+   governor.refuel();
+   return *governor.getFuel();
+}
+
+/*
+ * Implementation notes: hashText
+ * ------------------------------
+ * The hash is 64-bit FNV-1a, which is ample for telling programs
+ * apart in a cache.
+ */
+
+static string hashText(const string & text) {
+   uint64_t hash = 14695981039346656037ULL;
+   for (char ch : text) {
+      hash = (hash ^ (unsigned char) ch) * 1099511628211ULL;
+   }
+   char buffer[17];
+   snprintf(buffer, sizeof buffer, "%016llx", (unsigned long long) hash);
+   return buffer;
+}
+
+/*
+ * Implementation notes: getCacheDirectory
+ * ---------------------------------------
+ * The interpreter loads whatever object it finds in the cache, so a
+ * directory that someone else can write to would let them run code in
+ * it.  Without $BASIC_CACHE_DIR or $HOME the cache goes under the home
+ * directory in the password database, and then under the session's
+ * $XDG_RUNTIME_DIR, but never in a shared directory such as /tmp.  The
+ * directory is checked before every use, wherever it came from, and
+ * COMPILE refuses to run rather than use one that is not private.
+ */
+
+static string getCacheDirectory() {
+   const char *cacheDir = getenv("BASIC_CACHE_DIR");
+   string directory;
+   if (cacheDir != NULL && *cacheDir != '\0') {
+      directory = cacheDir;
+   } else {
+      const char *home = getenv("HOME");
+      if (home == NULL || *home == '\0') {
+         passwd *entry = getpwuid(getuid());
+         home = (entry == NULL) ? NULL : entry->pw_dir;
+      }
+      if (home != NULL && *home != '\0') {
+         directory = string(home) + CACHE_SUBDIRECTORY;
+      } else {
+         const char *runtimeDir = getenv("XDG_RUNTIME_DIR");
+         if (runtimeDir == NULL || *runtimeDir == '\0') {
+            error("COMPILE has no private cache directory; set BASIC_CACHE_DIR");
+         }
+         directory = string(runtimeDir) + "/basic";
+      }
+   }
+   makeDirectory(directory);
+   if (!isPrivateDirectory(directory)) {
+      error("COMPILE cannot use " + directory
+            + " as its cache, since it is not a directory that only you can write to");
+   }
+   return directory;
+}
+
+/*
+ * Implementation notes: makeDirectory
+ * -----------------------------------
+ * Creates each missing directory along the path, as mkdir -p does,
+ * with access for the user alone.
+ */
+
+static void makeDirectory(const string & path) {
+   for (size_t i = 1; i <= path.length(); i++) {
+      if (i == path.length() || path[i] == '/') {
+         string prefix = path.substr(0, i);
+         if (mkdir(prefix.c_str(), 0700) != 0 && !fileExists(prefix)) {
+            error("Cannot create " + prefix);
+         }
+      }
+   }
+}
+
+/*
+ * Implementation notes: isPrivateDirectory
+ * ----------------------------------------
+ * A cache made by an earlier version may be readable by others, which
+ * is harmless; what matters is that no one else owns it or can write
+ * to it.
+ */
+
+static bool isPrivateDirectory(const string & path) {
+   struct stat info;
+   return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode)
+       && info.st_uid == geteuid() && (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+static bool fileExists(const string & path) {
+   struct stat info;
+   return stat(path.c_str(), &info) == 0;
+}
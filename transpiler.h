@@ -0,0 +1,168 @@
+/*
+ * File: transpiler.h
+ * ------------------
+ * This interface exports the ahead-of-time compiler behind the COMPILE
+ * command, which translates a BASIC program into C++, builds it into a
+ * shared object with the system compiler and runs it in-process.
+ */
+
+#ifndef _transpiler_h
+#define _transpiler_h
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "evalstate.h"
+#include "program.h"
+
+/*
+ * Function: translateProgram
+ * Usage: translateProgram(program, os, slots);
+ * --------------------------------------------
+ * Writes a C++ translation of the program to the output stream.  Each
+ * line becomes a block of code preceded by a label if some GOTO or IF
+ * jumps to it, and jumps become goto statements.  Expressions are
+ * evaluated one operation at a time into temporaries, in the order the
+ * interpreter evaluates them, and every runtime error the interpreter
+ * can report is tested for with the same message.  The translation
+ * defines a single function, basic_main, which must be compiled with
+ * -fwrapv so that overflow wraps as it does in the interpreter.  The
+ * program is linked first, so jumps to missing lines are reported
+ * here.
+ *
+ * The translation numbers the variables and arrays it uses from 0 in
+ * the order it first meets them, and the slots vector is filled with
+ * the symbol table slot of each in turn.  The text therefore depends
+ * only on the program's lines, not on the order in which the symbol
+ * table happened to intern their names.
+ */
+
+void translateProgram(Program & program, std::ostream & os, std::vector<int> & slots);
+
+/*
+ * Class: NativeProgram
+ * --------------------
+ * This class holds a program compiled to a shared object and loaded
+ * into the interpreter.  Compiled objects are kept in a cache
+ * directory under a hash of their C++ translation and of the command
+ * that builds it.  The translation is determined by the program's
+ * lines alone and includes the declarations of the runtime interface,
+ * so compiling a program that has been compiled before, in any session,
+ * only loads the existing object.  The
+ * cache directory is $BASIC_CACHE_DIR if that is set and
+ * $HOME/.cache/basic otherwise, where a missing $HOME is looked up in
+ * the password database; without a home directory the cache goes in
+ * $XDG_RUNTIME_DIR/basic.  The directory is created with access for
+ * the user alone, and a cache that another user owns or can write to
+ * is an error.  The compiler is $CXX if that is set and c++ otherwise.
+ */
+
+class NativeProgram {
+
+public:
+
+/*
+ * Constructor: NativeProgram
+ * Usage: NativeProgram native(program);
+ * -------------------------------------
+ * Translates the program, builds the shared object unless the cache
+ * already holds it, and loads it.  Any failure, including a compiler
+ * error, is reported by calling error.
+ */
+
+   NativeProgram(Program & program);
+
+/*
+ * Destructor: ~NativeProgram
+ * Usage: usually implicit
+ * -----------------------
+ * Unloads the shared object.
+ */
+
+   ~NativeProgram();
+
+/*
+ * Method: run
+ * Usage: native.run(state);
+ * -------------------------
+ * Runs the compiled program with the specified state.  The output,
+ * the values read by INPUT and the text of every runtime error are the
+ * same as for RUN.  Compiled code cannot start at an arbitrary line,
+ * so a state that takes checkpoints is reported by calling error.
+ */
+
+   void run(EvalState & state);
+
+/*
+ * Method: getObjectPath
+ * Usage: string path = native.getObjectPath();
+ * --------------------------------------------
+ * Returns the path of the shared object in the cache.
+ */
+
+   std::string getObjectPath();
+
+private:
+
+/*
+ * Type: Runtime
+ * -------------
+ * This structure passes the services of the interpreter to the
+ * compiled code.  The translation declares an identical structure,
+ * which must be kept in step with this one.  The fuel field holds the
+ * governor's fuel when the run starts; the compiled code keeps its own
+ * count and calls refuel when it runs out.  The slots field maps the
+ * translation's numbering of the variables to the state's slots.
+ */
+
+   struct Runtime {
+      void *context;
+      void (*print)(void *context, long long value);
+      void (*printDouble)(void *context, double value);
+      long long (*input)(void *context);
+      double (*inputDouble)(void *context);
+      long long (*toInteger)(double value);
+      void (*fail)(const char *message);
+      long long *(*element)(void *context, int slot, const char *key, int rank,
+                            long long row, long long column);
+      void (*dimension)(void *context, int slot, const char *key, int rank,
+                        long long rows, long long columns);
+      long long (*sum)(void *context, int slot, const char *key);
+      void (*mat)(void *context, int op, int target, int lhs, int rhs, long long scalar,
+                  const char *targetKey, const char *lhsKey, const char *rhsKey);
+      long long fuel;
+      long long (*refuel)(void *context, long long fuel);
+      const int *slots;
+   };
+
+   typedef void (*MainFunction)(const Runtime *runtime, EvalState::Binding *vars);
+
+   static void printValue(void *context, long long value);
+   static void printDouble(void *context, double value);
+   static long long readValue(void *context);
+   static double readDouble(void *context);
+   static void fail(const char *message);
+   static long long *locateElement(void *context, int slot, const char *key, int rank,
+                                   long long row, long long column);
+   static void dimensionArray(void *context, int slot, const char *key, int rank,
+                              long long rows, long long columns);
+   static long long sumElements(void *context, int slot, const char *key);
+   static void executeMatOperation(void *context, int op, int target, int lhs, int rhs,
+                                   long long scalar, const char *targetKey,
+                                   const char *lhsKey, const char *rhsKey);
+   static long long refuel(void *context, long long fuel);
+
+   void *handle;
+   MainFunction mainFunction;
+   int slotCount;
+   std::vector<int> slots;
+   std::string objectPath;
+
+/* Programs cannot be copied, since the copies would unload the same object */
+
+   NativeProgram(const NativeProgram & src) = delete;
+   NativeProgram & operator=(const NativeProgram & src) = delete;
+
+};
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * File: value.cpp
+ * ---------------
+ * This file implements the conversions exported by value.h.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include "error.h"
+#include "value.h"
+using namespace std;
+
+/*
+ * Implementation notes: doubleToInteger
+ * -------------------------------------
+ * The limits are the powers of two that bound a 64-bit integer, which
+ * are exact as doubles.  A NaN fails both comparisons, so the single
+ * test rejects it along with the values out of range.
+ */
+
+long long doubleToInteger(double value) {
+   if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0)) {
+      error("Value out of integer range: " + doubleToString(value));
+   }
+   return (long long) value;
+}
+
+/*
+ * Implementation notes: formatDouble
+ * ----------------------------------
+ * Negative zero is printed as 0, since BASIC has no way to tell it
+ * apart from zero, and a NaN is printed without the sign it happens to
+ * carry, which depends on how it was computed.
+ */
+
+int formatDouble(char *buffer, double value) {
+   if (value == 0) value = 0;
+   if (std::isnan(value)) value = std::fabs(value);
+   return snprintf(buffer, MAX_DOUBLE_LENGTH, "%.15g", value);
+}
+
+string doubleToString(double value) {
+   char buffer[MAX_DOUBLE_LENGTH];
+   return string(buffer, formatDouble(buffer, value));
+}
@@ -0,0 +1,90 @@
+/*
+ * File: value.h
+ * -------------
+ * This interface exports the types that describe BASIC values, which
+ * are 64-bit integers or double-precision reals, together with the
+ * conversions between them.
+ */
+
+#ifndef _value_h
+#define _value_h
+
+#include <string>
+
+/*
+ * Type: ValueType
+ * ---------------
+ * This enumerated type identifies the type of a value.  Every variable
+ * and every expression has a static type, INTEGER_TYPE or DOUBLE_TYPE,
+ * which is fixed when the program is linked.  A variable is DOUBLE_TYPE
+ * if a line of the program assigns a double to it or if it already
+ * holds a double when a run starts, and INTEGER_TYPE otherwise; an
+ * arithmetic expression is DOUBLE_TYPE if either of its operands is.
+ * The types are ordered, so that the wider of two types is the
+ * greater.  UNDEFINED_TYPE marks a variable that has no value yet and
+ * is never the type of an expression.
+ */
+
+enum ValueType { UNDEFINED_TYPE, INTEGER_TYPE, DOUBLE_TYPE };
+
+/*
+ * Type: Value
+ * -----------
+ * This union holds a value of either type.  The type is always known
+ * from elsewhere, so the union carries no tag of its own.
+ */
+
+union Value {
+   long long integer;
+   double real;
+};
+
+/*
+ * Function: widerType
+ * Usage: ValueType type = widerType(t1, t2);
+ * ------------------------------------------
+ * Returns the type of an operation whose operands have the specified
+ * types, which is the wider of the two.
+ */
+
+inline ValueType widerType(ValueType t1, ValueType t2) {
+   return (t1 > t2) ? t1 : t2;
+}
+
+/*
+ * Function: doubleToInteger
+ * Usage: long long n = doubleToInteger(value);
+ * --------------------------------------------
+ * Converts a double to an integer by discarding its fraction, as
+ * storing a double into an integer variable or using one as a
+ * subscript does.  A value outside the range of a 64-bit integer,
+ * including an infinity or a NaN, is reported by calling error.
+ */
+
+long long doubleToInteger(double value);
+
+/*
+ * Function: formatDouble
+ * Usage: int length = formatDouble(buffer, value);
+ * ------------------------------------------------
+ * Writes the text that PRINT shows for a double into the buffer, which
+ * must hold at least MAX_DOUBLE_LENGTH characters, and returns its
+ * length.  The text has up to 15 significant digits, so that results
+ * such as 0.1 + 0.2 print as expected, and carries no decimal point if
+ * the value is whole.
+ */
+
+const int MAX_DOUBLE_LENGTH = 32;
+
+int formatDouble(char *buffer, double value);
+
+/*
+ * Function: doubleToString
+ * Usage: string str = doubleToString(value);
+ * ------------------------------------------
+ * Returns the text formatDouble writes as a string.
+ */
+
+std::string doubleToString(double value);
+
+#endif
@@ -0,0 +1,507 @@
+/*
+ * File: vm.cpp
+ * ------------
+ * This file implements the bytecode virtual machine.
+ */
+
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "array.h"
+#include "bytecode.h"
+#include "error.h"
+#include "evalstate.h"
+#include "exp.h"
+#include "input.h"
+#include "jit.h"
+#include "output.h"
+#include "value.h"
+#include "vm.h"
+using namespace std;
+
+/*
+ * Class: PlainBackEdges
+ * ---------------------
+ * This class stands in for the JitCompiler when the machine runs
+ * without one.  Its backEdge always continues at the target, so the
+ * compiler removes the test for backward jumps from the plain loop.
+ */
+
+class PlainBackEdges {
+
+public:
+
+   int backEdge(int from, int target) {
+      return target;
+   }
+
+};
+
+/*
+ * Class: FuelMeter
+ * ----------------
+ * This class charges the backward jumps of a governed run against a
+ * copy of the governor's fuel.  Variables are long longs in memory, so
+ * the governor's own counter would have to be read again after every
+ * store, while the meter is a local object of the machine that needs
+ * no register.  The copy is exchanged with the counter when the fuel
+ * runs out, so that the governor can check the limits, and around the
+ * calls to a handler that runs native code, which uses the counter
+ * itself.  The charge method returns true if the governor was
+ * consulted, which is the only time a checkpoint can fall due.
+ */
+
+class FuelMeter {
+
+public:
+
+   FuelMeter(const int *costs, Governor & governor) : costs(costs), governor(governor) {
+      fuel = *governor.getFuel();
+   }
+
+   bool charge(int from) {
+      fuel -= costs[from];
+      if (fuel >= 0) return false;
+      store();
+      governor.refuel();
+      load();
+      return true;
+   }
+
+   void store() {
+      *governor.getFuel() = fuel;
+   }
+
+   void load() {
+      fuel = *governor.getFuel();
+   }
+
+private:
+
+   long long fuel;
+   const int *costs;
+   Governor & governor;
+
+};
+
+/*
+ * Function: readInteger
+ * Usage: long long value = readInteger(var, name);
+ * ------------------------------------------------
+ * Returns the value of a variable read as an integer when it does not
+ * hold one, which is the uncommon path of every integer load: a double
+ * is converted and an undefined variable is reported.
+ */
+
+static long long readInteger(const EvalState::Binding & var, const string & name) {
+   if (var.type == UNDEFINED_TYPE) error(name + " is undefined");
+   return doubleToInteger(var.value.real);
+}
+
+/*
+ * Function: readDouble
+ * Usage: double value = readDouble(var, name);
+ * --------------------------------------------
+ * Returns the value of a variable read as a double when it does not
+ * hold one, converting an integer and reporting an undefined variable.
+ */
+
+static double readDouble(const EvalState::Binding & var, const string & name) {
+   if (var.type == UNDEFINED_TYPE) error(name + " is undefined");
+   return (double) var.value.integer;
+}
+
+/*
+ * Function: addTo
+ * Usage: long long value = addTo(var, k, name);
+ * ---------------------------------------------
+ * Adds k to an integer variable with wrapping and returns the result.
+ */
+
+static inline long long addTo(EvalState::Binding & var, long long k, const string & name) {
+   long long value = (var.type == INTEGER_TYPE) ? var.value.integer : readInteger(var, name);
+   var.value.integer = (long long) ((unsigned long long) value + (unsigned long long) k);
+   var.type = INTEGER_TYPE;
+   return var.value.integer;
+}
+
+/*
+ * Function: takeCheckpoint
+ * Usage: takeCheckpoint(bytecode, state, address);
+ * ------------------------------------------------
+ * Takes the checkpoint the governor has found due, from which the
+ * program resumes at the specified address.  Native code may leave a
+ * loop at an address within a line, and the checkpoint then waits for
+ * a jump that lands on the start of one.
+ */
+
+static void takeCheckpoint(const Bytecode & bytecode, EvalState & state, int address) {
+   int lineNumber = findLineNumber(bytecode, address);
+   if (lineNumber != -1) state.getCheckpointer().save(state, lineNumber);
+}
+
+/*
+ * Implementation notes: runMachine
+ * --------------------------------
+ * The machine keeps its program counter and stack pointer in local
+ * variables and dispatches on one switch per instruction.  The stack
+ * is allocated once at the size computed by the compiler, and every
+ * slot the program mentions is reserved in the EvalState before the
+ * loop starts, so variables are read and written directly in the
+ * value array and the loop itself never allocates.  Every jump that is
+ * taken goes through takeJump, which reports backward jumps to the
+ * handler; the handler may run the loop itself and return a different
+ * address.  The stack is empty at every jump, so nothing on it is lost.
+ * Reserving the slots also creates every array the program names, so
+ * the array instructions never move the table while they hold one.
+ * Starting the run first resets the governor's accounts, and the
+ * reservation then checks the variable and memory limits.
+ *
+ * When governed is true, each backward jump is also charged to a
+ * FuelMeter, and a checkpoint that has fallen due is taken once the
+ * jump's target is known.  A plain run is a separate instantiation
+ * without any of this code.  Every run starts at the start address,
+ * which RESUME sets to the line a checkpoint names.
+ *
+ * Each load tests the type of its variable against the type the
+ * compiler expects, which is all that the test for an undefined
+ * variable cost before; a mismatch, which arises only for a variable
+ * assigned before it was widened, takes the slow path that converts.
+ * Integer arithmetic wraps, as CompoundExp does, so it is carried out
+ * on unsigned values.
+ */
+
+template <typename BackEdgeHandler, bool governed>
+static void runMachine(const int *code, const int *costs, int start, const Bytecode & bytecode,
+                       EvalState & state, BackEdgeHandler & handler) {
+   typedef unsigned long long Unsigned;
+   vector<Value> stack(bytecode.maxStack + 1);
+   state.startRun();
+   state.reserveSlots(bytecode.names.size());
+   EvalState::Binding *vars = state.getBindings();
+   OutputBuffer & output = state.getOutput();
+   InputSource & input = state.getInput();
+   const int *pc = code + start;
+   Value *sp = stack.data();
+   const bool exchange = governed && !is_same<BackEdgeHandler, PlainBackEdges>::value;
+   FuelMeter meter(costs, state.getGovernor());
+   auto takeJump = [&](const int *jump, int target) {
+      if (target <= jump - code) {
+         bool refueled = governed && meter.charge(jump - code);
+         if (exchange) meter.store();
+         target = handler.backEdge(jump - code, target);
+         if (exchange) meter.load();
+         if ((refueled || exchange) && state.getGovernor().isCheckpointDue()) {
+            takeCheckpoint(bytecode, state, target);
+         }
+      }
+      return code + target;
+   };
+   while (true) {
+      switch (*pc) {
+       case OP_HALT:
+         state.setCurrentLine(-1);
+         return;
+       case OP_PUSH:
+         sp++->integer = pc[1];
+         pc += 2;
+         break;
+       case OP_LOAD: {
+         const EvalState::Binding & var = vars[pc[1]];
+         sp++->integer = (var.type == INTEGER_TYPE) ? var.value.integer
+                                                    : readInteger(var, bytecode.names[pc[1]]);
+         pc += 2;
+         break;
+       }
+       case OP_STORE:
+         vars[pc[1]].value.integer = (--sp)->integer;
+         vars[pc[1]].type = INTEGER_TYPE;
+         pc += 2;
+         break;
+       case OP_ASSIGN:
+         vars[pc[1]].value.integer = sp[-1].integer;
+         vars[pc[1]].type = INTEGER_TYPE;
+         pc += 2;
+         break;
+       case OP_POP:
+         sp--;
+         pc++;
+         break;
+       case OP_ADD:
+         sp--;
+         sp[-1].integer = (long long) ((Unsigned) sp[-1].integer + (Unsigned) sp[0].integer);
+         pc++;
+         break;
+       case OP_SUB:
+         sp--;
+         sp[-1].integer = (long long) ((Unsigned) sp[-1].integer - (Unsigned) sp[0].integer);
+         pc++;
+         break;
+       case OP_MUL:
+         sp--;
+         sp[-1].integer = (long long) ((Unsigned) sp[-1].integer * (Unsigned) sp[0].integer);
+         pc++;
+         break;
+       case OP_DIV:
+         sp--;
+         if (sp[0].integer == 0) error("Division by zero");
+         sp[-1].integer = divideIntegers(sp[-1].integer, sp[0].integer);
+         pc++;
+         break;
+       case OP_SHL:
+         sp[-1].integer = shiftLeft(sp[-1].integer, pc[1]);
+         pc += 2;
+         break;
+       case OP_SHR:
+         sp[-1].integer = shiftRightTowardZero(sp[-1].integer, pc[1]);
+         pc += 2;
+         break;
+       case OP_PRINT:
+         output.printInteger((--sp)->integer);
+         pc++;
+         break;
+       case OP_INPUT:
+         if (input.isInteractive()) output.flush();
+         vars[pc[1]].value.integer = input.readInteger();
+         vars[pc[1]].type = INTEGER_TYPE;
+         pc += 2;
+         break;
+       case OP_JUMP:
+         pc = takeJump(pc, pc[1]);
+         break;
+       case OP_JUMP_EQ:
+         sp -= 2;
+         pc = (sp[0].integer == sp[1].integer) ? takeJump(pc, pc[1]) : pc + 2;
+         break;
+       case OP_JUMP_GT:
+         sp -= 2;
+         pc = (sp[0].integer > sp[1].integer) ? takeJump(pc, pc[1]) : pc + 2;
+         break;
+       case OP_JUMP_LT:
+         sp -= 2;
+         pc = (sp[0].integer < sp[1].integer) ? takeJump(pc, pc[1]) : pc + 2;
+         break;
+       case OP_JUMP_NE:
+         sp -= 2;
+         pc = (sp[0].integer != sp[1].integer) ? takeJump(pc, pc[1]) : pc + 2;
+         break;
+       case OP_JUMP_LE:
+         sp -= 2;
+         pc = (sp[0].integer <= sp[1].integer) ? takeJump(pc, pc[1]) : pc + 2;
+         break;
+       case OP_JUMP_GE:
+         sp -= 2;
+         pc = (sp[0].integer >= sp[1].integer) ? takeJump(pc, pc[1]) : pc + 2;
+         break;
+       case OP_ERROR:
+         error(bytecode.messages[pc[1]]);
+         break;
+       case OP_PUSH_WIDE:
+         sp++->integer = wideOperand(pc + 1);
+         pc += 3;
+         break;
+       case OP_PUSH_DOUBLE:
+         sp++->real = doubleOperand(pc + 1);
+         pc += 3;
+         break;
+       case OP_LOAD_DOUBLE: {
+         const EvalState::Binding & var = vars[pc[1]];
+         sp++->real = (var.type == DOUBLE_TYPE) ? var.value.real
+                                                : readDouble(var, bytecode.names[pc[1]]);
+         pc += 2;
+         break;
+       }
+       case OP_STORE_DOUBLE:
+         vars[pc[1]].value.real = (--sp)->real;
+         vars[pc[1]].type = DOUBLE_TYPE;
+         pc += 2;
+         break;
+       case OP_ASSIGN_DOUBLE:
+         vars[pc[1]].value.real = sp[-1].real;
+         vars[pc[1]].type = DOUBLE_TYPE;
+         pc += 2;
+         break;
+       case OP_ADD_DOUBLE:
+         sp--;
+         sp[-1].real += sp[0].real;
+         pc++;
+         break;
+       case OP_SUB_DOUBLE:
+         sp--;
+         sp[-1].real -= sp[0].real;
+         pc++;
+         break;
+       case OP_MUL_DOUBLE:
+         sp--;
+         sp[-1].real *= sp[0].real;
+         pc++;
+         break;
+       case OP_DIV_DOUBLE:
+         sp--;
+         if (sp[0].real == 0) error("Division by zero");
+         sp[-1].real /= sp[0].real;
+         pc++;
+         break;
+       case OP_TO_DOUBLE:
+         sp[-1].real = (double) sp[-1].integer;
+         pc++;
+         break;
+       case OP_TO_INTEGER:
+         sp[-1].integer = doubleToInteger(sp[-1].real);
+         pc++;
+         break;
+       case OP_PRINT_DOUBLE:
+         output.printDouble((--sp)->real);
+         pc++;
+         break;
+       case OP_INPUT_DOUBLE:
+         if (input.isInteractive()) output.flush();
+         vars[pc[1]].value.real = input.readDouble();
+         vars[pc[1]].type = DOUBLE_TYPE;
+         pc += 2;
+         break;
+       case OP_JUMP_DOUBLE:
+         sp -= 2;
+         pc = testRelation((Relation) pc[1], sp[0].real, sp[1].real) ? takeJump(pc, pc[2])
+                                                                    : pc + 3;
+         break;
+       case OP_DIM: {
+         sp -= pc[2];
+         long long columns = (pc[2] == 2) ? sp[1].integer : 1;
+         state.dimensionArray(pc[1], bytecode.names[pc[1]], pc[2], sp[0].integer, columns);
+         pc += 3;
+         break;
+       }
+       case OP_LOAD_ELEMENT: {
+         sp -= pc[2];
+         long long row = sp[0].integer;
+         long long column = (pc[2] == 2) ? sp[1].integer : 1;
+         Array & array = state.getArray(pc[1]);
+         long long *element = array.getElement(pc[2], row, column);
+         if (element == NULL) array.reportElementError(bytecode.names[pc[1]], pc[2], row, column);
+         sp++->integer = *element;
+         pc += 3;
+         break;
+       }
+       case OP_STORE_ELEMENT: {
+         long long value = (--sp)->integer;
+         sp -= pc[2];
+         long long row = sp[0].integer;
+         long long column = (pc[2] == 2) ? sp[1].integer : 1;
+         Array & array = state.getArray(pc[1]);
+         long long *element = array.getElement(pc[2], row, column);
+         if (element == NULL) array.reportElementError(bytecode.names[pc[1]], pc[2], row, column);
+         *element = value;
+         pc += 3;
+         break;
+       }
+       case OP_SUM: {
+         Array & array = state.getArray(pc[1]);
+         sp++->integer = sumArray(array, bytecode.names[pc[1]].c_str());
+         state.getGovernor().chargeElements(array.getSize());
+         pc += 2;
+         break;
+       }
+       case OP_MAT: {
+         MatOperation op = (MatOperation) pc[1];
+         long long scalar = matTakesScalar(op) ? (--sp)->integer : 0;
+         Array *lhs = (pc[3] == -1) ? NULL : &state.getArray(pc[3]);
+         Array *rhs = (pc[4] == -1) ? NULL : &state.getArray(pc[4]);
+         long long elements = executeMat(op, state.getArray(pc[2]), lhs, rhs, scalar,
+                                         bytecode.names[pc[2]].c_str(),
+                                         (pc[3] == -1) ? NULL : bytecode.names[pc[3]].c_str(),
+                                         (pc[4] == -1) ? NULL : bytecode.names[pc[4]].c_str());
+         state.checkMemory();
+         state.getGovernor().chargeElements(elements);
+         pc += 5;
+         break;
+       }
+       case OP_ADD_TO:
+         addTo(vars[pc[1]], pc[2], bytecode.names[pc[1]]);
+         pc += 3;
+         break;
+       case OP_MUL_TO: {
+         EvalState::Binding & var = vars[pc[1]];
+         long long value = (var.type == INTEGER_TYPE) ? var.value.integer
+                                                      : readInteger(var, bytecode.names[pc[1]]);
+         var.value.integer = (long long) ((Unsigned) value * (Unsigned) (long long) pc[2]);
+         var.type = INTEGER_TYPE;
+         pc += 3;
+         break;
+       }
+       case OP_JUMP_CONST:
+         sp--;
+         pc = testRelation((Relation) pc[1], sp[0].integer, (long long) pc[2])
+            ? takeJump(pc, pc[3]) : pc + 4;
+         break;
+       case OP_JUMP_VAR_CONST: {
+         const EvalState::Binding & var = vars[pc[1]];
+         long long value = (var.type == INTEGER_TYPE) ? var.value.integer
+                                                      : readInteger(var, bytecode.names[pc[1]]);
+         pc = testRelation((Relation) pc[2], value, (long long) pc[3])
+            ? takeJump(pc, pc[4]) : pc + 5;
+         break;
+       }
+       case OP_INC_JUMP_CONST: {
+         long long value = addTo(vars[pc[1]], pc[2], bytecode.names[pc[1]]);
+         pc = testRelation((Relation) pc[3], value, (long long) pc[4])
+            ? takeJump(pc, pc[5]) : pc + 6;
+         break;
+       }
+       case OP_INC_JUMP_VAR: {
+         long long value = addTo(vars[pc[1]], pc[2], bytecode.names[pc[1]]);
+         const EvalState::Binding & limit = vars[pc[4]];
+         long long bound = (limit.type == INTEGER_TYPE) ? limit.value.integer
+                                                        : readInteger(limit, bytecode.names[pc[4]]);
+         pc = testRelation((Relation) pc[3], value, bound) ? takeJump(pc, pc[5]) : pc + 6;
+         break;
+       }
+       default:
+         error("Illegal instruction in bytecode");
+      }
+   }
+}
+
+/*
+ * Implementation notes: runWithHandler
+ * ------------------------------------
+ * The choice between the plain and the governed machine is made once
+ * per run.  A program without back-edge costs, such as code an update
+ * has moved out of line order, is charged one statement per backward
+ * jump.
+ */
+
+template <typename BackEdgeHandler>
+static void runWithHandler(const int *code, const int *costs, int start,
+                           const Bytecode & bytecode, EvalState & state,
+                           BackEdgeHandler & handler) {
+   if (state.getGovernor().isActive()) {
+      vector<int> ones;
+      if (costs == NULL) {
+         ones.assign(bytecode.code.size(), 1);
+         costs = ones.data();
+      }
+      runMachine<BackEdgeHandler, true>(code, costs, start, bytecode, state, handler);
+   } else {
+      runMachine<BackEdgeHandler, false>(code, costs, start, bytecode, state, handler);
+   }
+}
+
+static const int *getCosts(const Bytecode & bytecode) {
+   return bytecode.backEdgeCosts.empty() ? NULL : bytecode.backEdgeCosts.data();
+}
+
+void executeBytecode(const Bytecode & bytecode, EvalState & state, int start) {
+   PlainBackEdges handler;
+   runWithHandler(bytecode.code.data(), getCosts(bytecode), start, bytecode, state, handler);
+}
+
+void executeBytecode(const Bytecode & bytecode, EvalState & state, JitCompiler & jit) {
+   runWithHandler(bytecode.code.data(), getCosts(bytecode), 0, bytecode, state, jit);
+}
+
+void executeBytecode(const int *code, const int *costs, const Bytecode & bytecode,
+                     EvalState & state) {
+   PlainBackEdges handler;
+   runWithHandler(code, costs, 0, bytecode, state, handler);
+}
@@ -0,0 +1,58 @@
+/*
+ * File: vm.h
+ * ----------
+ * This interface exports the virtual machine that executes programs
+ * produced by the bytecode compiler.
+ */
+
+#ifndef _vm_h
+#define _vm_h
+
+#include "bytecode.h"
+#include "evalstate.h"
+
+class JitCompiler;
+
+/*
+ * Function: executeBytecode
+ * Usage: executeBytecode(bytecode, state);
+ *        executeBytecode(bytecode, state, start);
+ * -----------------------------------------------
+ * Runs a compiled program from its first instruction, or from the
+ * instruction at the start address, until it halts, reading and
+ * writing variables through the specified EvalState.  The observable
+ * behavior, including the text of every runtime error, is identical to
+ * running the parsed statements one at a time.  If the state's
+ * governor has limits, every backward jump is charged for the
+ * statements of its loop, as described in bytecode.h, and checkpoints
+ * are taken when the governor says they are due.
+ */
+
+void executeBytecode(const Bytecode & bytecode, EvalState & state, int start = 0);
+
+/*
+ * Function: executeBytecode
+ * Usage: executeBytecode(bytecode, state, jit);
+ * ---------------------------------------------
+ * Runs a compiled program as above, handing every backward jump to the
+ * JitCompiler so that hot loops run as native code.  The observable
+ * behavior is the same.
+ */
+
+void executeBytecode(const Bytecode & bytecode, EvalState & state, JitCompiler & jit);
+
+/*
+ * Function: executeBytecode
+ * Usage: executeBytecode(code, costs, bytecode, state);
+ * -----------------------------------------------------
+ * Runs instructions stored outside a Bytecode object, such as those of
+ * a memory-mapped program image, in place.  The costs array stands in
+ * for backEdgeCosts and must be as long as the code.  The names,
+ * messages and maxStack fields of bytecode describe the code; its own
+ * code and backEdgeCosts arrays are ignored.
+ */
+
+void executeBytecode(const int *code, const int *costs, const Bytecode & bytecode,
+                     EvalState & state);
+
+#endif